@@ -1,14 +1,36 @@
-// DataTransferManager.h (Header-only solution)
+// DataTrans.h (Header-only solution)
+//
+// Each data object owns a typed single producer / single consumer ring of samples. One scheduler thread,
+// shared by every object in a DataTransferManager, drains the rings and hands each callback the samples
+// as one batch:
+//   IMMEDIATE               addData marks the object ready and wakes the scheduler if it is asleep
+//   PERIODIC_WITH_INPUT     every periodMs, the samples added since the last period, nothing if none
+//   PERIODIC_WITHOUT_INPUT  every periodMs, the new samples or else the last one again ( T{} before any )
+// A full ring either overwrites its oldest sample ( counted in dropped() ) or, with OverflowPolicy::BLOCK,
+// makes addData sleep until the scheduler has drained it. A full BLOCK ring is delivered straight away,
+// a periodic one does not wait for its period.
+// stop() delivers whatever is still in the rings before the scheduler thread exits.
+// addData for an object must only be called from one thread at a time, any number of objects can be fed
+// from different threads. All the objects are added before start().
 
 #ifndef DATATRANSFERMANAGER_H
 #define DATATRANSFERMANAGER_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <functional>
-#include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
 #include <string>
-#include <chrono>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 enum class TransferMode {
     IMMEDIATE,
@@ -16,157 +38,401 @@ enum class TransferMode {
     PERIODIC_WITHOUT_INPUT
 };
 
-class DataTransferObject {
+enum class OverflowPolicy {
+    OVERWRITE_OLDEST,
+    BLOCK
+};
+
+template <typename T>
+struct Sample {
+    T data;
+    std::chrono::system_clock::time_point timestamp;
+};
+
+// Each slot carries a sequence, odd while the producer writes it and 2 * index + 2 once sample index is
+// in. The consumer checks it before and after the copy so a slot the producer laps mid read is dropped,
+// not torn. That is why T has to be trivially copyable.
+template <typename T>
+class SampleRing {
+    static_assert(std::is_trivially_copyable<T>::value, "SampleRing copies samples as plain bytes");
+
 public:
-    using DataCallback = std::function<void(int, std::chrono::system_clock::time_point)>;
+    explicit SampleRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        slots_ = std::unique_ptr<Slot[]>(new Slot[size]);
+        mask_ = size - 1;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
 
-    DataTransferObject(TransferMode mode, int periodMs = 1000)
-        : mode_(mode), periodMs_(periodMs), running_(false) {
-        lastDataInputs_.reserve(1024);
-        timestamps_.reserve(1024);
+    // overwrites the oldest sample when full
+    void push(const Sample<T>& sample) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[head & mask_];
+        slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.sample, &sample, sizeof(sample));
+        slot.seq.store(2 * head + 2, std::memory_order_release);
+        head_.store(head + 1, std::memory_order_release);
     }
 
-    ~DataTransferObject() {
-        stop();
+    // false when full
+    bool tryPush(const Sample<T>& sample) {
+        if (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire) > mask_)
+            return false;
+        push(sample);
+        return true;
     }
 
-    void setInputCallback(DataCallback callback) {
-        inputCallback_ = callback;
+    // appends everything in the ring to out
+    size_t drain(std::vector<Sample<T>>& out) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (head - tail > capacity()) {
+            lost_.fetch_add(head - tail - capacity(), std::memory_order_relaxed);
+            tail = head - capacity();
+        }
+        size_t count = 0;
+        Sample<T> sample;
+        for (; tail != head; ++tail) {
+            Slot& slot = slots_[tail & mask_];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq == 2 * tail + 2) {
+                std::memcpy(&sample, &slot.sample, sizeof(sample));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) == seq) {
+                    out.push_back(sample);
+                    ++count;
+                    continue;
+                }
+            }
+            lost_.fetch_add(1, std::memory_order_relaxed);
+        }
+        tail_.store(tail, std::memory_order_release);
+        return count;
     }
 
-    void addData(int data) {
-        // Create a new data object containing the data and timestamp
-        // We are using an int as an example, but this could be any data type
-        // with its respective transfer mode.
-        Data newData;
-        newData.data = data;
-        newData.timestamp = std::chrono::system_clock::now();
+    uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
 
-        if (lastDataInputs_.size() >= 1024) {
-            lastDataInputs_.erase(lastDataInputs_.begin());
-            timestamps_.erase(timestamps_.begin());
-        }
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        Sample<T> sample;
+    };
 
-        lastDataInputs_.push_back(newData);
-        timestamps_.push_back(newData.timestamp);
-    }
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<uint64_t> head_{0};   // producer
+    alignas(64) std::atomic<uint64_t> tail_{0};   // consumer
+    std::atomic<uint64_t> lost_{0};
+};
 
-    void start() {
-        if (running_)
+// how an object wakes the scheduler thread. ready bits are set by the producers and taken by the scheduler,
+// the mutex is only touched when the scheduler is asleep
+class TransferScheduler {
+public:
+    // keeps the bits already set
+    void resize(size_t objects) {
+        size_t words = (objects + 63) / 64;
+        if (words == words_)
             return;
-
-        running_ = true;
-        transferThread_ = std::thread(&DataTransferObject::transferData, this);
+        std::unique_ptr<std::atomic<uint64_t>[]> ready(new std::atomic<uint64_t>[words]);
+        for (size_t i = 0; i < words; ++i)
+            ready[i].store(i < words_ ? ready_[i].load() : 0);
+        ready_ = std::move(ready);
+        words_ = words;
     }
 
-    void stop() {
-        if (!running_)
-            return;
+    bool running() const { return running_.load(std::memory_order_relaxed); }
 
-        running_ = false;
-        if (transferThread_.joinable()) {
-            transferThread_.join();
+    void markReady(size_t index) {
+        ready_[index / 64].fetch_or(uint64_t(1) << (index % 64));
+        if (sleeping_.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_one();
         }
     }
 
 private:
-    struct Data {
-        int data;
-        std::chrono::system_clock::time_point timestamp;
-    };
+    friend class DataTransferManager;
+
+    bool anyReady() const {
+        for (size_t i = 0; i < words_; ++i)
+            if (ready_[i].load())
+                return true;
+        return false;
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> ready_;
+    size_t words_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> sleeping_{false};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+// what the scheduler sees of a DataTransferObject
+class TransferChannel {
+public:
+    TransferChannel(TransferMode mode, int periodMs) : mode_(mode), periodMs_(periodMs) {}
+    virtual ~TransferChannel() = default;
+
+    TransferMode mode() const { return mode_; }
+    std::chrono::milliseconds period() const { return std::chrono::milliseconds(std::max(periodMs_, 1)); }
+
+    // drains the ring into one callback batch, tick is set when a period is due. returns the batch size
+    virtual size_t deliver(bool tick) = 0;
 
+protected:
     TransferMode mode_;
     int periodMs_;
-    DataCallback inputCallback_;
-    std::vector<Data> lastDataInputs_;
-    std::vector<std::chrono::system_clock::time_point> timestamps_;
-    std::thread transferThread_;
-    bool running_;
-
-    void transferData() {
-        while (running_) {
-            switch (mode_) {
-                case TransferMode::IMMEDIATE: {
-                    if (inputCallback_ && !lastDataInputs_.empty()) {
-                        auto newData = lastDataInputs_.back();
-                        inputCallback_(newData.data, newData.timestamp);
-                    }
-                    break;
-                }
-                case TransferMode::PERIODIC_WITH_INPUT: {
-                    if (inputCallback_ && !lastDataInputs_.empty()) {
-                        auto newData = lastDataInputs_.back();
-                        inputCallback_(newData.data, newData.timestamp);
-                    }
-                    break;
-                }
-                case TransferMode::PERIODIC_WITHOUT_INPUT: {
-                    if (inputCallback_) {
-                        if (!lastDataInputs_.empty()) {
-                            auto newData = lastDataInputs_.back();
-                            inputCallback_(newData.data, newData.timestamp);
-                        } else {
-                            inputCallback_(0, std::chrono::system_clock::now());
-                        }
-                    }
-                    break;
-                }
-            }
+};
+
+template <typename T>
+class DataTransferObject : public TransferChannel {
+public:
+    using DataCallback = std::function<void(T, std::chrono::system_clock::time_point)>;
+    using BatchCallback = std::function<void(const Sample<T>*, size_t)>;
 
-            if (inputCallback_ && mode_ != TransferMode::IMMEDIATE) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(periodMs_));
+    DataTransferObject(TransferMode mode, int periodMs, size_t capacity, OverflowPolicy policy,
+                       TransferScheduler& scheduler, size_t index)
+        : TransferChannel(mode, periodMs), policy_(policy), ring_(capacity), scheduler_(scheduler), index_(index) {
+        batch_.reserve(ring_.capacity());
+    }
+
+    // called once per sample of a batch, setBatchCallback takes the whole batch instead
+    void setInputCallback(DataCallback callback) {
+        inputCallback_ = callback;
+    }
+
+    void setBatchCallback(BatchCallback callback) {
+        batchCallback_ = callback;
+    }
+
+    // false if a BLOCK ring is full and the manager is stopped, the sample is not added
+    bool addData(const T& data) {
+        Sample<T> sample{data, std::chrono::system_clock::now()};
+        if (policy_ == OverflowPolicy::BLOCK) {
+            if (!ring_.tryPush(sample) && !waitForRoom(sample))
+                return false;
+        } else {
+            ring_.push(sample);
+        }
+        if (mode_ == TransferMode::IMMEDIATE)
+            scheduler_.markReady(index_);
+        return true;
+    }
+
+    // samples overwritten before the scheduler got to them
+    uint64_t dropped() const { return ring_.lost(); }
+
+    size_t deliver(bool tick) override {
+        batch_.clear();
+        ring_.drain(batch_);
+        if (policy_ == OverflowPolicy::BLOCK) {
+            // pairs with the fence in waitForRoom, either the producer sees the room or we see it waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (blocked_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(roomMutex_);
+                room_.notify_one();
             }
         }
+        if (batch_.empty()) {
+            if (!tick || mode_ != TransferMode::PERIODIC_WITHOUT_INPUT)
+                return 0;
+            batch_.push_back(hasLast_ ? last_ : Sample<T>{T{}, std::chrono::system_clock::now()});
+        }
+        last_ = batch_.back();
+        hasLast_ = true;
+        if (batchCallback_) {
+            batchCallback_(batch_.data(), batch_.size());
+        } else if (inputCallback_) {
+            for (const auto& sample : batch_)
+                inputCallback_(sample.data, sample.timestamp);
+        }
+        return batch_.size();
     }
+
+private:
+    // the ring is full, have the scheduler drain it now and sleep until it has. the timeout only
+    // covers a stop() while we wait
+    bool waitForRoom(const Sample<T>& sample) {
+        std::unique_lock<std::mutex> lock(roomMutex_);
+        blocked_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool added;
+        while (!(added = ring_.tryPush(sample)) && scheduler_.running()) {
+            scheduler_.markReady(index_);
+            room_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        blocked_.store(false, std::memory_order_relaxed);
+        return added;
+    }
+
+    OverflowPolicy policy_;
+    SampleRing<T> ring_;
+    TransferScheduler& scheduler_;
+    size_t index_;
+    DataCallback inputCallback_;
+    BatchCallback batchCallback_;
+    std::vector<Sample<T>> batch_;
+    Sample<T> last_{};
+    bool hasLast_ = false;
+    std::atomic<bool> blocked_{false};
+    std::mutex roomMutex_;
+    std::condition_variable room_;
 };
 
 class DataTransferManager {
 public:
-    DataTransferManager() : running_(false) {}
+    DataTransferManager() = default;
 
     ~DataTransferManager() {
         stop();
     }
 
-    void addDataObject(const std::string& dataId, TransferMode mode, int periodMs = 1000) {
-        dataObjects_[dataId] = DataTransferObject(mode, periodMs);
+    DataTransferManager(const DataTransferManager&) = delete;
+    DataTransferManager& operator=(const DataTransferManager&) = delete;
+
+    // an existing dataId is replaced. throws std::logic_error once started, the producers of the other
+    // objects may be marking them ready while the ready list would be resized
+    template <typename T = int>
+    DataTransferObject<T>& addDataObject(const std::string& dataId, TransferMode mode, int periodMs = 1000,
+                                         size_t capacity = 1024, OverflowPolicy policy = OverflowPolicy::OVERWRITE_OLDEST) {
+        if (running())
+            throw std::logic_error("DataTransferManager::addDataObject " + dataId + " after start()");
+        auto it = ids_.find(dataId);
+        size_t index = it != ids_.end() ? it->second : dataObjects_.size();
+        auto object = std::make_unique<DataTransferObject<T>>(mode, periodMs, capacity, policy, scheduler_, index);
+        auto& ref = *object;
+        if (index == dataObjects_.size())
+            dataObjects_.push_back(std::move(object));
+        else
+            dataObjects_[index] = std::move(object);
+        ids_[dataId] = index;
+        scheduler_.resize(dataObjects_.size());
+        return ref;
+    }
+
+    // nullptr for an unknown dataId or one of another type
+    template <typename T = int>
+    DataTransferObject<T>* getDataObject(const std::string& dataId) {
+        auto it = ids_.find(dataId);
+        if (it == ids_.end())
+            return nullptr;
+        return dynamic_cast<DataTransferObject<T>*>(dataObjects_[it->second].get());
+    }
+
+    template <typename T = int>
+    void setInputCallback(const std::string& dataId, typename DataTransferObject<T>::DataCallback callback) {
+        if (auto* object = getDataObject<T>(dataId)) {
+            object->setInputCallback(callback);
+        }
     }
 
-    void setInputCallback(const std::string& dataId, DataTransferObject::DataCallback callback) {
-        if (dataObjects_.count(dataId) > 0) {
-            dataObjects_[dataId].setInputCallback(callback);
+    template <typename T = int>
+    void setBatchCallback(const std::string& dataId, typename DataTransferObject<T>::BatchCallback callback) {
+        if (auto* object = getDataObject<T>(dataId)) {
+            object->setBatchCallback(callback);
         }
     }
 
-    void addData(const std::string& dataId, int data) {
-        if (dataObjects_.count(dataId) > 0) {
-            dataObjects_[dataId].addData(data);
+    // looks the object up by name each call, keep the addDataObject reference for a hot path
+    template <typename T>
+    bool addData(const std::string& dataId, const T& data) {
+        if (auto* object = getDataObject<T>(dataId)) {
+            return object->addData(data);
         }
+        return false;
     }
 
+    bool running() const { return scheduler_.running(); }
+
     void start() {
-        if (running_)
+        if (running())
             return;
 
-        running_ = true;
-        for (auto& [dataId, dataObject] : dataObjects_) {
-            dataObject.start();
-        }
+        scheduler_.running_ = true;
+        schedulerThread_ = std::thread(&DataTransferManager::schedule, this);
     }
 
     void stop() {
-        if (!running_)
+        if (!running())
             return;
 
-        running_ = false;
-        for (auto& [dataId, dataObject] : dataObjects_) {
-            dataObject.stop();
+        {
+            std::lock_guard<std::mutex> lock(scheduler_.mutex_);
+            scheduler_.running_ = false;
+            scheduler_.wake_.notify_one();
+        }
+        if (schedulerThread_.joinable()) {
+            schedulerThread_.join();
         }
     }
 
 private:
-    std::map<std::string, DataTransferObject> dataObjects_;
-    bool running_;
+    using Clock = std::chrono::steady_clock;
+    using Due = std::pair<Clock::time_point, size_t>;
+
+    std::vector<std::unique_ptr<TransferChannel>> dataObjects_;
+    std::map<std::string, size_t> ids_;
+    TransferScheduler scheduler_;
+    std::thread schedulerThread_;
+
+    void deliverReady() {
+        for (size_t word = 0; word < scheduler_.words_; ++word) {
+            uint64_t bits = scheduler_.ready_[word].exchange(0);
+            while (bits) {
+                int bit = __builtin_ctzll(bits);
+                bits &= bits - 1;
+                dataObjects_[word * 64 + bit]->deliver(false);
+            }
+        }
+    }
+
+    void schedule() {
+        std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due;
+        auto now = Clock::now();
+        for (size_t i = 0; i < dataObjects_.size(); ++i) {
+            if (dataObjects_[i]->mode() != TransferMode::IMMEDIATE)
+                due.push({now + dataObjects_[i]->period(), i});
+        }
+
+        while (scheduler_.running()) {
+            deliverReady();
+
+            now = Clock::now();
+            while (!due.empty() && due.top().first <= now) {
+                Due next = due.top();
+                due.pop();
+                auto& object = *dataObjects_[next.second];
+                object.deliver(true);
+                // a late period is not made up, the next one is a full period away
+                next.first += object.period();
+                if (next.first <= now)
+                    next.first = now + object.period();
+                due.push(next);
+            }
+
+            std::unique_lock<std::mutex> lock(scheduler_.mutex_);
+            scheduler_.sleeping_ = true;
+            if (scheduler_.running() && !scheduler_.anyReady()) {
+                if (due.empty())
+                    scheduler_.wake_.wait(lock);
+                else
+                    scheduler_.wake_.wait_until(lock, due.top().first);
+            }
+            scheduler_.sleeping_ = false;
+        }
+        // whatever came in before the stop, the periodic samples go out without waiting for a period
+        deliverReady();
+        for (auto& object : dataObjects_) {
+            if (object->mode() != TransferMode::IMMEDIATE)
+                object->deliver(false);
+        }
+    }
 };
 
-#endif // DATATRANSFERMANAGER_H
\ No newline at end of file
+#endif // DATATRANSFERMANAGER_H
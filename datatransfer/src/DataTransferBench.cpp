@@ -0,0 +1,91 @@
+// DataTransferBench.cpp
+// data_transfer_bench [objects] [samples per object] [producer threads] [ring size]
+//
+// samples/sec through a DataTransferManager and the latency from addData to the callback, for the
+// IMMEDIATE mode with both overflow policies and for PERIODIC_WITH_INPUT. The producer threads split
+// the objects between them so each ring keeps a single producer. The paced run sends one sample to
+// every object each millisecond, the latency without the producers saturating the scheduler.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "DataTrans.h"
+
+struct BenchResult {
+    double secs;
+    uint64_t delivered;
+    uint64_t dropped;
+    std::vector<double> latUs;
+};
+
+static BenchResult run(TransferMode mode, OverflowPolicy policy, int objects, int samples, int producers, size_t ringSize,
+                       int paceUs = 0) {
+    DataTransferManager manager;
+    std::vector<DataTransferObject<double>*> channels;
+    BenchResult res{0, 0, 0, {}};
+    res.latUs.reserve((size_t)objects * samples);
+
+    for (int i = 0; i < objects; ++i) {
+        auto& object = manager.addDataObject<double>("obj" + std::to_string(i), mode, 10, ringSize, policy);
+        // callbacks all run on the scheduler thread, no locking needed
+        object.setBatchCallback([&res](const Sample<double>* batch, size_t num) {
+            auto now = std::chrono::system_clock::now();
+            for (size_t j = 0; j < num; ++j)
+                res.latUs.push_back(std::chrono::duration<double, std::micro>(now - batch[j].timestamp).count());
+            res.delivered += num;
+        });
+        channels.push_back(&object);
+    }
+
+    manager.start();
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            auto next = std::chrono::steady_clock::now();
+            for (int s = 0; s < samples; ++s) {
+                for (int i = p; i < objects; i += producers)
+                    channels[i]->addData(s * 0.5);
+                if (paceUs) {
+                    next += std::chrono::microseconds(paceUs);
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    // let the scheduler catch up, a periodic object needs its next period
+    if (mode != TransferMode::IMMEDIATE)
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    manager.stop();
+    res.secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for (auto* channel : channels)
+        res.dropped += channel->dropped();
+    std::sort(res.latUs.begin(), res.latUs.end());
+    return res;
+}
+
+static void report(const char* name, const BenchResult& res) {
+    auto pct = [&](double p) {
+        return res.latUs.empty() ? 0.0 : res.latUs[std::min(res.latUs.size() - 1, (size_t)(p * res.latUs.size()))];
+    };
+    printf("%-28s %10.0f samples/s  delivered %9llu dropped %9llu  p50 %8.1f us  p99 %8.1f us  max %9.1f us\n",
+           name, res.delivered / res.secs, (unsigned long long)res.delivered, (unsigned long long)res.dropped,
+           pct(0.50), pct(0.99), res.latUs.empty() ? 0.0 : res.latUs.back());
+}
+
+int main(int argc, char* argv[]) {
+    int objects = argc > 1 ? atoi(argv[1]) : 1000;
+    int samples = argc > 2 ? atoi(argv[2]) : 1000;
+    int producers = argc > 3 ? atoi(argv[3]) : 4;
+    size_t ringSize = argc > 4 ? atoi(argv[4]) : 1024;
+
+    printf("%d objects x %d samples, %d producers, ring %zu\n", objects, samples, producers, ringSize);
+    report("immediate, overwrite oldest", run(TransferMode::IMMEDIATE, OverflowPolicy::OVERWRITE_OLDEST, objects, samples, producers, ringSize));
+    report("immediate, block", run(TransferMode::IMMEDIATE, OverflowPolicy::BLOCK, objects, samples, producers, ringSize));
+    report("periodic 10ms, block", run(TransferMode::PERIODIC_WITH_INPUT, OverflowPolicy::BLOCK, objects, samples, producers, ringSize));
+    report("immediate, paced 1ms", run(TransferMode::IMMEDIATE, OverflowPolicy::BLOCK, objects, std::min(samples, 200), producers, ringSize, 1000));
+    return 0;
+}
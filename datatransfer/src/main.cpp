@@ -2,22 +2,40 @@
 #include <iostream>
 #include "DataTransferManager.h"
 
-// void inputDataCallback(int data, std::chrono::system_clock::time_point timestamp) {
-//     std::cout << "Received data: " << data << " Timestamp: "
-//               << std::chrono::system_clock::to_time_t(timestamp) << std::endl;
-// }
+static long long toMs(std::chrono::system_clock::time_point timestamp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(timestamp.time_since_epoch()).count();
+}
 
 int main() {
-    DataTransferManager dataTransfer(TransferMode::PERIODIC_WITH_INPUT, 1000);
-    // dataTransfer.setInputCallback(inputDataCallback);
-    // dataTransfer.start();
+    DataTransferManager dataTransfer;
+
+    auto& voltage = dataTransfer.addDataObject<float>("voltage", TransferMode::PERIODIC_WITH_INPUT, 250);
+    auto& count = dataTransfer.addDataObject<int>("count", TransferMode::IMMEDIATE);
+    auto& alarm = dataTransfer.addDataObject<bool>("alarm", TransferMode::PERIODIC_WITHOUT_INPUT, 400);
+
+    voltage.setBatchCallback([](const Sample<float>* samples, size_t num) {
+        std::cout << "voltage: " << num << " samples, last " << samples[num - 1].data
+                  << " Timestamp: " << toMs(samples[num - 1].timestamp) << "ms" << std::endl;
+    });
+    dataTransfer.setInputCallback("count", [](int data, std::chrono::system_clock::time_point timestamp) {
+        std::cout << "count: " << data << " Timestamp: " << toMs(timestamp) << "ms" << std::endl;
+    });
+    alarm.setInputCallback([](bool data, std::chrono::system_clock::time_point timestamp) {
+        std::cout << "alarm: " << data << " Timestamp: " << toMs(timestamp) << "ms" << std::endl;
+    });
+
+    dataTransfer.start();
 
-    // // Simulate data production
-    // for (int i = 1; i <= 10; ++i) {
-    //     dataTransfer.addData(i);
-    //     std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    // }
+    // Simulate data production
+    for (int i = 1; i <= 10; ++i) {
+        voltage.addData(480.0f + i * 0.5f);
+        count.addData(i);
+        if (i == 5)
+            alarm.addData(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
 
-    // dataTransfer.stop();
+    dataTransfer.stop();
+    std::cout << "dropped " << voltage.dropped() + count.dropped() + alarm.dropped() << std::endl;
     return 0;
 }
@@ -0,0 +1,700 @@
+#ifndef ASYNC_EVENT_SINK_HPP
+#define ASYNC_EVENT_SINK_HPP
+
+#include "logger/event_logger.hpp"
+#include "logger/circular_msg_q.hpp"
+
+#include "spdlog/pattern_formatter.h"
+#ifdef SPDLOG_FMT_EXTERNAL
+#include <fmt/args.h>
+#else
+#include "spdlog/fmt/bundled/args.h"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+//
+// Asynchronous binary version of rotating_event_sink.
+//
+// rotating_event_sink formats every message on the caller's thread (inside spdlog::logger::log and again in
+// sink_it_ under the sink mutex). Here the caller only writes a compact record into its own lock free ring:
+//     record_header { time, format id, level, number of args, size } then the raw args, each a type byte + value.
+// A background thread drains the rings into circular_msg_q (which now holds the raw records) and does the file
+// rotation when logIt asks for it. The file is either the binary log (the format strings then the raw records,
+// render it with event_log_decode) or, with setBinary(false), the same text rotating_event_sink writes.
+// A full ring drops the record and counts it, the caller never waits.
+//
+namespace event_log
+{
+    constexpr char file_magic[8] = {'E', 'V', 'T', 'L', 'O', 'G', '1', '\0'};
+    constexpr uint32_t file_version = 1;
+
+    // every record takes one slot, strings that don't fit get cut short
+    constexpr std::size_t slot_size = 256;
+
+    enum class arg_type : uint8_t
+    {
+        Int,
+        UInt,
+        Float,
+        Bool,
+        Char,
+        String
+    };
+
+    struct record_header
+    {
+        int64_t time_ns;    // system_clock since epoch
+        uint32_t fmt_id;
+        uint8_t level;
+        uint8_t nargs;
+        uint16_t size;      // bytes of args after the header
+    };
+
+    // binary file layout: file_header, num_formats x (uint32 id, uint32 len, chars), then the records to the end
+    struct file_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t num_formats;
+        uint64_t dropped;   // records lost to full rings since the sink started
+    };
+
+    // format strings are sent once, the records carry their id.
+    // ids are looked up by the pointer of the format string, the thread keeps its own cache of those
+    // and checks the text too in case a runtime string reuses an address. The cache is a small direct
+    // mapped table so runtime built formats only evict each other, they can't grow it.
+    class format_registry
+    {
+        std::mutex mtx_;
+        std::unordered_map<std::string, uint32_t> ids_;
+        std::deque<std::string> formats_;
+
+    public:
+        static format_registry& instance()
+        {
+            static format_registry registry;
+            return registry;
+        }
+
+        uint32_t id(std::string_view fmt)
+        {
+            struct cached
+            {
+                const char* ptr = nullptr;
+                uint32_t id = 0;
+                const std::string* text = nullptr;
+            };
+            static constexpr std::size_t cache_size = 256;
+            thread_local cached cache[cache_size];
+            auto key = reinterpret_cast<std::uintptr_t>(fmt.data());
+            auto& slot = cache[(key ^ (key >> 8)) % cache_size];
+            if (slot.ptr == fmt.data() && *slot.text == fmt)
+                return slot.id;
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto [id_it, added] = ids_.emplace(std::string(fmt), static_cast<uint32_t>(formats_.size()));
+            if (added)
+                formats_.emplace_back(fmt);
+            slot = cached{fmt.data(), id_it->second, &formats_[id_it->second]};
+            return id_it->second;
+        }
+
+        std::vector<std::string> formats()
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return std::vector<std::string>(formats_.begin(), formats_.end());
+        }
+    };
+
+    // packs the args of one call into a slot
+    class record_writer
+    {
+        char* buf_;
+        std::size_t pos_ = sizeof(record_header);
+        uint8_t nargs_ = 0;
+
+        bool room(std::size_t bytes) const
+        {
+            return pos_ + bytes <= slot_size;
+        }
+
+        template<typename T>
+        void put_raw(arg_type type, T value)
+        {
+            if (!room(1 + sizeof(T)))
+                return;
+            buf_[pos_++] = static_cast<char>(type);
+            std::memcpy(buf_ + pos_, &value, sizeof(T));
+            pos_ += sizeof(T);
+            ++nargs_;
+        }
+
+        void put_string(std::string_view str)
+        {
+            if (!room(1 + sizeof(uint16_t)))
+                return;
+            auto len = static_cast<uint16_t>(std::min(str.size(), slot_size - pos_ - 1 - sizeof(uint16_t)));
+            buf_[pos_++] = static_cast<char>(arg_type::String);
+            std::memcpy(buf_ + pos_, &len, sizeof(len));
+            pos_ += sizeof(len);
+            std::memcpy(buf_ + pos_, str.data(), len);
+            pos_ += len;
+            ++nargs_;
+        }
+
+    public:
+        explicit record_writer(char* slot)
+            : buf_(slot)
+        {}
+
+        template<typename T>
+        void put(const T& arg)
+        {
+            using U = std::decay_t<T>;
+            if constexpr (std::is_same_v<U, bool>)
+                put_raw(arg_type::Bool, static_cast<uint8_t>(arg));
+            else if constexpr (std::is_same_v<U, char>)
+                put_raw(arg_type::Char, arg);
+            else if constexpr (std::is_enum_v<U>)
+                put(static_cast<std::underlying_type_t<U>>(arg));
+            else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+                put_raw(arg_type::Int, static_cast<int64_t>(arg));
+            else if constexpr (std::is_integral_v<U>)
+                put_raw(arg_type::UInt, static_cast<uint64_t>(arg));
+            else if constexpr (std::is_floating_point_v<U>)
+                put_raw(arg_type::Float, static_cast<double>(arg));
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+                put_string(std::string_view(arg));
+            else // anything else with a formatter is turned into text here, the one case formatted on the caller
+            {
+                fmt::memory_buffer text;
+                fmt::format_to(std::back_inserter(text), "{}", arg);
+                put_string(std::string_view(text.data(), text.size()));
+            }
+        }
+
+        std::size_t finish(int64_t time_ns, uint32_t fmt_id, spdlog::level::level_enum level)
+        {
+            record_header head{time_ns, fmt_id, static_cast<uint8_t>(level), nargs_,
+                               static_cast<uint16_t>(pos_ - sizeof(record_header))};
+            std::memcpy(buf_, &head, sizeof(head));
+            return pos_;
+        }
+    };
+
+    // renders a record's args into dest with its format string, for the text sink and the decoder
+    inline void format_record(const char* rec, std::size_t len, fmt::string_view fmt, spdlog::memory_buf_t& dest)
+    {
+        record_header head;
+        std::memcpy(&head, rec, sizeof(head));
+        fmt::dynamic_format_arg_store<fmt::format_context> store;
+        std::size_t pos = sizeof(head);
+        for (uint8_t i = 0; i < head.nargs && pos < len; ++i)
+        {
+            auto type = static_cast<arg_type>(rec[pos++]);
+            auto get = [&](auto value) {
+                if (pos + sizeof(value) <= len)
+                    std::memcpy(&value, rec + pos, sizeof(value));
+                pos += sizeof(value);
+                return value;
+            };
+            switch (type)
+            {
+                case arg_type::Int:     store.push_back(get(int64_t{}));            break;
+                case arg_type::UInt:    store.push_back(get(uint64_t{}));           break;
+                case arg_type::Float:   store.push_back(get(double{}));             break;
+                case arg_type::Bool:    store.push_back(get(uint8_t{}) != 0);       break;
+                case arg_type::Char:    store.push_back(get(char{}));               break;
+                case arg_type::String:
+                {
+                    auto slen = get(uint16_t{});
+                    slen = static_cast<uint16_t>(std::min<std::size_t>(slen, pos < len ? len - pos : 0));
+                    store.push_back(std::string(rec + pos, slen));
+                    pos += slen;
+                    break;
+                }
+                default:
+                    pos = len;
+                    break;
+            }
+        }
+        try
+        {
+            fmt::vformat_to(std::back_inserter(dest), fmt, store);
+        }
+        catch (const fmt::format_error& err)
+        {
+            dest.append(fmt.data(), fmt.data() + fmt.size());
+            fmt::format_to(std::back_inserter(dest), " <{}>", err.what());
+        }
+    }
+
+    // one producer (the logging thread), one consumer (the sink's thread)
+    class record_ring
+    {
+        std::vector<char> slots_;
+        std::size_t mask_;
+        alignas(64) std::atomic<std::size_t> head_{0};
+        alignas(64) std::atomic<std::size_t> tail_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<bool> retired_{false};
+
+    public:
+        explicit record_ring(std::size_t size)
+        {
+            std::size_t cap = 1;
+            while (cap < size)
+                cap <<= 1;
+            slots_.resize(cap * slot_size);
+            mask_ = cap - 1;
+        }
+
+        std::size_t capacity() const
+        {
+            return mask_ + 1;
+        }
+
+        // nullptr (and the record counted as dropped) when the ring is full
+        char* claim()
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) > mask_)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            return &slots_[(head & mask_) * slot_size];
+        }
+
+        // returns how many records are waiting
+        std::size_t publish()
+        {
+            auto head = head_.load(std::memory_order_relaxed) + 1;
+            head_.store(head, std::memory_order_release);
+            return head - tail_.load(std::memory_order_relaxed);
+        }
+
+        template<typename Fn>
+        void drain(Fn&& fn)
+        {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            auto head = head_.load(std::memory_order_acquire);
+            for (; tail != head; ++tail)
+            {
+                const char* rec = &slots_[(tail & mask_) * slot_size];
+                record_header head_rec;
+                std::memcpy(&head_rec, rec, sizeof(head_rec));
+                fn(rec, sizeof(head_rec) + head_rec.size);
+            }
+            tail_.store(tail, std::memory_order_release);
+        }
+
+        uint64_t dropped() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+        // the producer's thread has gone, nothing more will be published
+        void retire()
+        {
+            retired_.store(true, std::memory_order_release);
+        }
+
+        bool retired() const
+        {
+            return retired_.load(std::memory_order_acquire);
+        }
+    };
+
+    // the rings a thread logs into, one per sink. They are retired when the thread exits
+    // and the sink frees each one once it has drained it.
+    struct thread_rings
+    {
+        std::vector<std::pair<uint64_t, std::shared_ptr<record_ring>>> rings;
+
+        ~thread_rings()
+        {
+            for (auto& ring : rings)
+                ring.second->retire();
+        }
+    };
+}
+
+template<typename FileNameCalc = event_time_filename_calculator>
+class async_event_sink final
+{
+    struct rotation
+    {
+        spdlog::filename_t fileName;
+        bool add_timestamp;
+    };
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> ids{0};
+        return ++ids;
+    }
+
+    const uint64_t id_ = next_id();
+    const std::size_t ring_size_;
+    std::string name_;
+
+    // owned by the sink thread, setters take state_mtx_
+    std::mutex state_mtx_;
+    circular_msg_q buf_;    // raw records
+    spdlog::details::file_helper file_helper_;
+    std::unique_ptr<spdlog::formatter> formatter_;
+    bool binary_ = true;
+
+    std::mutex rings_mtx_;
+    std::vector<std::shared_ptr<event_log::record_ring>> rings_;
+    uint64_t retired_dropped_ = 0;  // drops counted by rings already freed
+
+    std::mutex req_mtx_;
+    std::condition_variable req_cv_;
+    std::vector<rotation> rotations_;
+    std::atomic<bool> wake_{false};
+    bool stop_ = false;
+    std::chrono::milliseconds interval_{5};
+    std::thread worker_;
+
+    event_log::record_ring& ring()
+    {
+        // a ring outlives its thread until the sink thread has drained it, so nothing it logged is lost
+        thread_local event_log::thread_rings mine;
+        for (auto& [id, ring] : mine.rings)
+        {
+            if (id == id_)
+                return *ring;
+        }
+        auto ring = std::make_shared<event_log::record_ring>(ring_size_);
+        {
+            std::lock_guard<std::mutex> lock(rings_mtx_);
+            rings_.push_back(ring);
+        }
+        mine.rings.emplace_back(id_, ring);
+        return *ring;
+    }
+
+    uint64_t dropped()
+    {
+        std::lock_guard<std::mutex> lock(rings_mtx_);
+        uint64_t total = retired_dropped_;
+        for (auto& ring : rings_)
+            total += ring->dropped();
+        return total;
+    }
+
+    void drain_()
+    {
+        std::vector<std::shared_ptr<event_log::record_ring>> rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_mtx_);
+            rings = rings_;
+        }
+        bool freed = false;
+        for (auto& ring : rings)
+        {
+            // retired before the drain, so this drain takes its last record
+            bool done = ring->retired();
+            ring->drain([this](const char* rec, std::size_t len) {
+                buf_.newest().append(rec, rec + len);
+            });
+            if (done)
+            {
+                freed = true;
+                ring.reset();
+            }
+        }
+        if (!freed)
+            return;
+        std::lock_guard<std::mutex> lock(rings_mtx_);
+        auto it = rings_.begin();
+        for (auto& ring : rings)
+        {
+            // rings_ only grows at the back and only drain_ ( under state_mtx_ ) removes, so it lines up with our copy
+            if (ring)
+            {
+                ++it;
+                continue;
+            }
+            retired_dropped_ += (*it)->dropped();
+            it = rings_.erase(it);
+        }
+    }
+
+    void rotate_(const rotation& rot)
+    {
+        auto newFile = FileNameCalc::calc_filename(rot.fileName, rot.add_timestamp);
+        file_helper_.open(newFile);
+        if (binary_)
+        {
+            auto formats = event_log::format_registry::instance().formats();
+            event_log::file_header head;
+            std::memcpy(head.magic, event_log::file_magic, sizeof(head.magic));
+            head.version = event_log::file_version;
+            head.num_formats = static_cast<uint32_t>(formats.size());
+            head.dropped = dropped();
+            spdlog::memory_buf_t out;
+            out.append(reinterpret_cast<const char*>(&head), reinterpret_cast<const char*>(&head) + sizeof(head));
+            for (uint32_t id = 0; id < formats.size(); ++id)
+            {
+                auto len = static_cast<uint32_t>(formats[id].size());
+                out.append(reinterpret_cast<const char*>(&id), reinterpret_cast<const char*>(&id) + sizeof(id));
+                out.append(reinterpret_cast<const char*>(&len), reinterpret_cast<const char*>(&len) + sizeof(len));
+                out.append(formats[id].data(), formats[id].data() + len);
+            }
+            file_helper_.write(out);
+            buf_.dumpToFile(file_helper_);
+        }
+        else
+        {
+            auto formats = event_log::format_registry::instance().formats();
+            spdlog::memory_buf_t payload, line;
+            buf_.forEach([&](const spdlog::memory_buf_t& rec) {
+                event_log::record_header head;
+                std::memcpy(&head, rec.data(), sizeof(head));
+                payload.clear();
+                line.clear();
+                fmt::string_view fmt = head.fmt_id < formats.size() ? fmt::string_view(formats[head.fmt_id]) : fmt::string_view("?");
+                event_log::format_record(rec.data(), rec.size(), fmt, payload);
+                spdlog::details::log_msg msg(
+                    spdlog::log_clock::time_point(std::chrono::duration_cast<spdlog::log_clock::duration>(std::chrono::nanoseconds(head.time_ns))),
+                    spdlog::source_loc{}, name_, static_cast<spdlog::level::level_enum>(head.level),
+                    spdlog::string_view_t(payload.data(), payload.size()));
+                formatter_->format(msg, line);
+                file_helper_.write(line);
+            });
+        }
+        file_helper_.close();
+    }
+
+    void run_()
+    {
+        std::vector<rotation> rotations;
+        for (;;)
+        {
+            bool stopping;
+            {
+                std::unique_lock<std::mutex> lock(req_mtx_);
+                req_cv_.wait_for(lock, interval_, [this] { return stop_ || !rotations_.empty() || wake_.load(std::memory_order_relaxed); });
+                wake_.store(false, std::memory_order_relaxed);
+                rotations.swap(rotations_);
+                stopping = stop_;
+            }
+            {
+                std::lock_guard<std::mutex> lock(state_mtx_);
+                drain_();
+                for (auto& rot : rotations)
+                    rotate_(rot);
+            }
+            rotations.clear();
+            if (stopping)
+                return;
+        }
+    }
+
+public:
+    async_event_sink(std::string name, std::size_t bufSize, std::size_t ringSize = 4096)
+        : ring_size_(ringSize), name_(std::move(name)), buf_(bufSize),
+          formatter_(std::make_unique<spdlog::pattern_formatter>()),
+          worker_([this] { run_(); })
+    {}
+
+    ~async_event_sink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(req_mtx_);
+            stop_ = true;
+        }
+        req_cv_.notify_one();
+        worker_.join();
+    }
+
+    async_event_sink(const async_event_sink&) = delete;
+    async_event_sink& operator=(const async_event_sink&) = delete;
+
+    template<typename... Args>
+    void log(spdlog::level::level_enum severity, fmt::string_view fmt, const Args&... args)
+    {
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        auto id = event_log::format_registry::instance().id(std::string_view(fmt.data(), fmt.size()));
+        auto& ring = this->ring();
+        char* slot = ring.claim();
+        if (!slot)
+            return;
+        event_log::record_writer rec(slot);
+        (rec.put(args), ...);
+        rec.finish(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), id, severity);
+        // a burst wakes the sink thread at half a ring instead of waiting out its interval
+        if (ring.publish() == ring.capacity() / 2 && !wake_.exchange(true, std::memory_order_relaxed))
+            req_cv_.notify_one();
+    }
+
+    void set_backtrace(std::size_t size)
+    {
+        std::lock_guard<std::mutex> lock(state_mtx_);
+        buf_.reSize(size);
+    }
+
+    void set_formatter(std::unique_ptr<spdlog::formatter> formatter)
+    {
+        std::lock_guard<std::mutex> lock(state_mtx_);
+        formatter_ = std::move(formatter);
+    }
+
+    void set_binary(bool binary)
+    {
+        std::lock_guard<std::mutex> lock(state_mtx_);
+        binary_ = binary;
+    }
+
+    // how often the sink thread empties the rings when nothing wakes it
+    void set_interval(std::chrono::milliseconds interval)
+    {
+        std::lock_guard<std::mutex> lock(req_mtx_);
+        interval_ = interval;
+    }
+
+    // queues the dump of the current messages, everything this thread logged before the call is in it
+    void log_it_(const spdlog::filename_t& fileName, bool add_timestamp = false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(req_mtx_);
+            rotations_.push_back({fileName, add_timestamp});
+        }
+        req_cv_.notify_one();
+    }
+
+    // waits for the sink thread to take in every published record and finish the queued dumps
+    void flush_()
+    {
+        std::lock_guard<std::mutex> lock(state_mtx_);
+        drain_();
+        std::vector<rotation> rotations;
+        {
+            std::lock_guard<std::mutex> req_lock(req_mtx_);
+            rotations.swap(rotations_);
+        }
+        for (auto& rot : rotations)
+            rotate_(rot);
+    }
+
+    uint64_t dropped_count()
+    {
+        return dropped();
+    }
+};
+
+// EventLogger with the async_event_sink, the calls only cost the ring write.
+class AsyncEventLogger final
+{
+    async_event_sink<> mSink;
+    std::atomic<int> mLevel{spdlog::level::debug};
+
+public:
+    AsyncEventLogger(const char* name, std::size_t size, std::size_t ringSize = 4096)
+        : mSink(name, size, ringSize)
+    {}
+
+    void setBacktrace(std::size_t size)
+    {
+        mSink.set_backtrace(size);
+    }
+
+    void resetBacktrace(std::size_t size)
+    {
+        mSink.flush_();
+        mSink.set_backtrace(0); // flush all previous messages
+        mSink.set_backtrace(size); // set to new size. start fresh
+    }
+
+    void logIt(const spdlog::filename_t& fileName, bool add_timestamp = false)
+    {
+        mSink.log_it_(fileName, add_timestamp);
+    }
+
+    // binary (default) for event_log_decode, or text with the pattern below
+    void setBinary(bool binary)
+    {
+        mSink.set_binary(binary);
+    }
+
+    void setPattern(std::string pattern, spdlog::pattern_time_type time_type = spdlog::pattern_time_type::local)
+    {
+        mSink.set_formatter(std::make_unique<spdlog::pattern_formatter>(std::move(pattern), time_type));
+    }
+
+    void setFormatter(std::unique_ptr<spdlog::formatter> formatter)
+    {
+        mSink.set_formatter(std::move(formatter));
+    }
+
+    void set_level(spdlog::level::level_enum severity)
+    {
+        mLevel.store(severity, std::memory_order_relaxed);
+    }
+
+    // the sink thread does the writing, this waits for it
+    void flush()
+    {
+        mSink.flush_();
+    }
+
+    uint64_t dropped()
+    {
+        return mSink.dropped_count();
+    }
+
+    template<typename... Args>
+    void log(spdlog::level::level_enum severity, spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        if (severity < mLevel.load(std::memory_order_relaxed))
+            return;
+        mSink.log(severity, fmt::string_view(fmt), args...);
+    }
+
+    template<typename... Args>
+    void info(spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        log(spdlog::level::info, fmt, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void debug(spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        log(spdlog::level::debug, fmt, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void warn(spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        log(spdlog::level::warn, fmt, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void error(spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        log(spdlog::level::err, fmt, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void critical(spdlog::format_string_t<Args...> fmt, Args&&... args)
+    {
+        log(spdlog::level::critical, fmt, std::forward<Args>(args)...);
+    }
+};
+
+#endif
@@ -90,6 +90,18 @@ public:
         mBuf = std::move(tempBuf);
     }
 
+    // oldest to newest, for sinks that write something other than the stored bytes
+    template<typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        std::size_t tempTail = mTail;
+        for (std::size_t i = 0; i < mSize; ++i)
+        {
+            fn(mBuf[tempTail]);
+            tempTail = (tempTail + 1) % mBuf.capacity();
+        }
+    }
+
     void dumpToFile(spdlog::details::file_helper& helper)
     {
         std::size_t tempTail = mTail;
@@ -0,0 +1,95 @@
+#include "logger/async_event_sink.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+//g++ -std=c++17 -O2 -o event_log_bench -I include src/event_log_bench.cpp -lspdlog -lfmt -lpthread
+// event_log_bench [threads] [calls per thread] [ring size]
+
+// a fault burst from several io threads at once, rotating_event_sink (formatted under the sink mutex)
+// against the AsyncEventLogger rings. reports calls/sec and the caller side latency of each call.
+
+using bench_clock = std::chrono::steady_clock;
+
+struct burst_result
+{
+    double secs;
+    std::vector<double> lat_ns;
+};
+
+template<typename LogFn>
+static burst_result burst(int threads, int calls, LogFn&& log_fn)
+{
+    std::vector<std::vector<double>> lat(threads);
+    std::vector<std::thread> workers;
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            auto& mine = lat[t];
+            mine.reserve(calls);
+            ++ready;
+            while (!go.load())
+                ;
+            for (int i = 0; i < calls; ++i)
+            {
+                auto t0 = bench_clock::now();
+                log_fn(t, i);
+                mine.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - t0).count());
+            }
+        });
+    }
+    while (ready.load() != threads)
+        ;
+    auto t0 = bench_clock::now();
+    go = true;
+    for (auto& w : workers)
+        w.join();
+    burst_result res{std::chrono::duration<double>(bench_clock::now() - t0).count(), {}};
+    for (auto& mine : lat)
+        res.lat_ns.insert(res.lat_ns.end(), mine.begin(), mine.end());
+    std::sort(res.lat_ns.begin(), res.lat_ns.end());
+    return res;
+}
+
+static void report(const char* name, const burst_result& res)
+{
+    auto pct = [&](double p) { return res.lat_ns[std::min(res.lat_ns.size() - 1, static_cast<std::size_t>(p * res.lat_ns.size()))]; };
+    printf("%-22s %12.0f calls/s   p50 %8.0f ns  p99 %8.0f ns  p99.9 %8.0f ns  max %10.0f ns\n",
+           name, res.lat_ns.size() / res.secs, pct(0.50), pct(0.99), pct(0.999), res.lat_ns.back());
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int calls = argc > 2 ? atoi(argv[2]) : 100000;
+    std::size_t ring_size = argc > 3 ? atoi(argv[3]) : 4096;
+
+    printf("%d threads x %d calls, ring %zu\n", threads, calls, ring_size);
+
+    {
+        auto sink = std::make_shared<rotating_event_sink_mt>(64);
+        spdlog::logger logger("bench", sink);
+        logger.set_pattern("{\"time\": \"%H:%M:%S\", \"date\": \"%D\", \"level\": \"%l\", %v}");
+        auto res = burst(threads, calls, [&](int t, int i) {
+            logger.error("\"MSG\": \"device {} offset {} read failed errno {} ({})\"", t, i & 1023, 110, "Connection timed out");
+        });
+        report("rotating_event_sink", res);
+    }
+
+    {
+        AsyncEventLogger logger("bench", 64, ring_size);
+        auto res = burst(threads, calls, [&](int t, int i) {
+            logger.error("\"MSG\": \"device {} offset {} read failed errno {} ({})\"", t, i & 1023, 110, "Connection timed out");
+        });
+        auto t0 = bench_clock::now();
+        logger.flush();
+        double drain = std::chrono::duration<double, std::milli>(bench_clock::now() - t0).count();
+        report("AsyncEventLogger", res);
+        printf("%-22s dropped %llu, %.2f ms to drain after the burst\n", "",
+               static_cast<unsigned long long>(logger.dropped()), drain);
+    }
+    return 0;
+}
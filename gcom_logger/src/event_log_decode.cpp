@@ -0,0 +1,111 @@
+#include "logger/async_event_sink.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+//g++ -std=c++17 -o event_log_decode -I include src/event_log_decode.cpp -lspdlog -lfmt -lpthread
+
+// renders a binary log written by AsyncEventLogger to json:
+// {"dropped": n, "logs": [{"time": "...", "level": "...", "msg": "..."}, ...]}
+
+static void json_escape(std::string& out, const char* str, std::size_t len)
+{
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            case '\r': out += "\\r";  break;
+            default:
+                if (c < 0x20)
+                    out += fmt::format("\\u{:04x}", c);
+                else
+                    out += static_cast<char>(c);
+                break;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <binary log file>\n", argv[0]);
+        return 1;
+    }
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "unable to open %s\n", argv[1]);
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    event_log::file_header head;
+    if (data.size() < sizeof(head))
+    {
+        fprintf(stderr, "%s is too short for an event log\n", argv[1]);
+        return 1;
+    }
+    std::memcpy(&head, data.data(), sizeof(head));
+    if (std::memcmp(head.magic, event_log::file_magic, sizeof(head.magic)) != 0 || head.version != event_log::file_version)
+    {
+        fprintf(stderr, "%s is not a version %u event log\n", argv[1], event_log::file_version);
+        return 1;
+    }
+
+    std::size_t pos = sizeof(head);
+    std::unordered_map<uint32_t, std::string> formats;
+    for (uint32_t i = 0; i < head.num_formats; ++i)
+    {
+        uint32_t id, len;
+        if (pos + sizeof(id) + sizeof(len) > data.size())
+            break;
+        std::memcpy(&id, data.data() + pos, sizeof(id));
+        std::memcpy(&len, data.data() + pos + sizeof(id), sizeof(len));
+        pos += sizeof(id) + sizeof(len);
+        if (pos + len > data.size())
+            break;
+        formats[id] = data.substr(pos, len);
+        pos += len;
+    }
+
+    std::string out = fmt::format("{{\n    \"dropped\": {},\n    \"logs\": [", head.dropped);
+    spdlog::memory_buf_t msg;
+    bool first = true;
+    while (pos + sizeof(event_log::record_header) <= data.size())
+    {
+        event_log::record_header rec;
+        std::memcpy(&rec, data.data() + pos, sizeof(rec));
+        std::size_t len = sizeof(rec) + rec.size;
+        if (pos + len > data.size())
+        {
+            fprintf(stderr, "record at %zu runs past the end of the file\n", pos);
+            break;
+        }
+        msg.clear();
+        auto fmt_it = formats.find(rec.fmt_id);
+        if (fmt_it != formats.end())
+            event_log::format_record(data.data() + pos, len, fmt_it->second, msg);
+        else
+            fmt::format_to(std::back_inserter(msg), "<unknown format {}>", rec.fmt_id);
+
+        auto secs = static_cast<std::time_t>(rec.time_ns / 1000000000);
+        auto level = spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(rec.level));
+        out += first ? "\n" : ",\n";
+        out += fmt::format("        {{\"time\": \"{:%Y-%m-%dT%H:%M:%S}.{:06}Z\", \"level\": \"{}\", \"msg\": \"",
+                           fmt::gmtime(secs), (rec.time_ns % 1000000000) / 1000, std::string_view(level.data(), level.size()));
+        json_escape(out, msg.data(), msg.size());
+        out += "\"}";
+        first = false;
+        pos += len;
+    }
+    out += "\n    ]\n}\n";
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
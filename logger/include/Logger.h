@@ -5,6 +5,11 @@
 #include <chrono>
 #include <unordered_map>
 #include <map>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
 
 #ifndef LOGGER_H
 #define LOGGER_H
@@ -23,6 +28,29 @@ namespace Logging
         uint count;
     };
 
+    // One message of an FPS_*_LOG site, keyed by the hash of its format args
+    struct SiteRecord
+    {
+        int64_t last_logged = 0;                // steady_clock ns of the last time it went out
+        uint suppressed = 0;                    // repeats held back since then
+        std::string msg;                        // the text that went out, for the summary line
+    };
+
+    // One per FPS_*_LOG call site, made the first time the site runs.
+    // Repeats are found by the site and a hash of the raw format args, so the decision is made before
+    // anything gets formatted and different messages from one site are still each logged.
+    struct LogSite
+    {
+        LogSite(spdlog::level::level_enum severity, const char* file, const char* func, const int line);
+
+        spdlog::level::level_enum severity;
+        std::string pre;                        // pre_string of the site, built once
+        std::mutex mtx;                         // guards seen
+        std::unordered_map<uint64_t, SiteRecord> seen;
+        uint id;
+        LogSite* next = nullptr;                // every site, for the sweep in clear_records
+    };
+
     //smart pointer no mem leak
     extern std::shared_ptr<spdlog::logger> logger;
     extern std::shared_ptr<spdlog::logger> console;
@@ -33,7 +61,8 @@ namespace Logging
     extern std::map<spdlog::level::level_enum, std::string> severity_names; // Translation of spdlog levels to their string representations, used for logging
     extern spdlog::level::level_enum severity_threshold;                    // Log level at or above which messages will be logged
     extern std::chrono::seconds redundant_rate;                             // Minimum amount of time before logging the same message again
-    extern std::chrono::minutes clear_rate;                                 // Minimum amount of time before clearing the map of messages
+    extern std::chrono::minutes clear_rate;                                 // Minimum amount of time before an idle record or site is forgotten
+    extern std::chrono::seconds sweep_rate;                                 // Time between clear_records sweeps, which also flush the suppressed counts
     extern std::chrono::_V2::steady_clock::time_point last_records_clear;   // Last time the records map was cleared
 
     extern std::string parse_config_path(int argc, char** argv);
@@ -43,6 +72,50 @@ namespace Logging
     extern void log_test(spdlog::level::level_enum severity, std::string pre, std::string msg, std::string post);
     extern bool update_records(std::string msg, std::string& redundant_msg);
     extern void clear_records();
+    extern bool site_should_log(LogSite& site, uint64_t hash);
+    extern void log_site(LogSite& site, uint64_t hash, const std::string& msg);
+
+    inline bool site_enabled(const LogSite& site)
+    {
+        return site.severity >= severity_threshold;
+    }
+
+    // FNV-1a over the raw printf args, strings by their text and everything else by value
+    inline uint64_t hash_bytes(uint64_t hash, const void* data, size_t len)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    template <class T>
+    uint64_t hash_arg(uint64_t hash, const T& arg)
+    {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>)
+        {
+            const char* str = arg;
+            return str ? hash_bytes(hash, str, strlen(str)) : hash;
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            std::string_view str(arg);
+            return hash_bytes(hash, str.data(), str.size());
+        }
+        else if constexpr (std::is_arithmetic_v<U> || std::is_enum_v<U> || std::is_pointer_v<U>)
+            return hash_bytes(hash, &arg, sizeof(arg));
+        else
+            return hash;    // nothing printf can show differently, leave it out
+    }
+
+    template <class ... Types>
+    uint64_t args_hash(const Types&... args)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        ((hash = hash_arg(hash, args)), ...);
+        return hash;
+    }
 
     /**
      * @brief This function removes newlines and tabs from user messages to allow for valid json and 
@@ -68,10 +141,21 @@ namespace Logging
     extern spdlog::level::level_enum severity_to_level(int severity);
 }
 
-#define FPS_INFO_LOG(...)   ::Logging::log_msg(spdlog::level::info, ::Logging::pre_string(__FILE__, __FUNCTION__, __LINE__), ::Logging::msg_string(__VA_ARGS__), ::Logging::post_string())
-#define FPS_DEBUG_LOG(...)   ::Logging::log_msg(spdlog::level::debug, ::Logging::pre_string(__FILE__, __FUNCTION__, __LINE__), ::Logging::msg_string(__VA_ARGS__), ::Logging::post_string())
-#define FPS_WARNING_LOG(...)   ::Logging::log_msg(spdlog::level::warn, ::Logging::pre_string(__FILE__, __FUNCTION__, __LINE__), ::Logging::msg_string(__VA_ARGS__), ::Logging::post_string())
-#define FPS_ERROR_LOG(...)   ::Logging::log_msg(spdlog::level::err, ::Logging::pre_string(__FILE__, __FUNCTION__, __LINE__), ::Logging::msg_string(__VA_ARGS__), ::Logging::post_string())
+// the message is only formatted when the site is let through, repeats are found by hashing the args
+#define FPS_SITE_LOG(severity, ...) \
+    do { \
+        static ::Logging::LogSite fps_log_site(severity, __FILE__, __FUNCTION__, __LINE__); \
+        if (::Logging::site_enabled(fps_log_site)) { \
+            uint64_t fps_log_hash = ::Logging::args_hash(__VA_ARGS__); \
+            if (::Logging::site_should_log(fps_log_site, fps_log_hash)) \
+                ::Logging::log_site(fps_log_site, fps_log_hash, ::Logging::msg_string(__VA_ARGS__)); \
+        } \
+    } while (0)
+
+#define FPS_INFO_LOG(...)   FPS_SITE_LOG(spdlog::level::info, __VA_ARGS__)
+#define FPS_DEBUG_LOG(...)   FPS_SITE_LOG(spdlog::level::debug, __VA_ARGS__)
+#define FPS_WARNING_LOG(...)   FPS_SITE_LOG(spdlog::level::warn, __VA_ARGS__)
+#define FPS_ERROR_LOG(...)   FPS_SITE_LOG(spdlog::level::err, __VA_ARGS__)
 #define FPS_TEST_LOG(...)   ::Logging::log_test(spdlog::level::err, ::Logging::pre_string(__FILE__, __FUNCTION__, __LINE__), ::Logging::msg_string(__VA_ARGS__), ::Logging::post_string())
 
 #endif // header guard
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <sstream>
 #include <cjson/cJSON.h>
+#include <mutex>
 
 namespace Logging
 {
@@ -22,11 +23,56 @@ namespace Logging
     spdlog::level::level_enum severity_threshold = spdlog::level::info;
     std::chrono::seconds redundant_rate = std::chrono::seconds(10);
     std::chrono::minutes clear_rate = std::chrono::minutes(1);
+    std::chrono::seconds sweep_rate = std::chrono::seconds(1);
     std::chrono::_V2::steady_clock::time_point last_records_clear = std::chrono::steady_clock::now();
     // Declare other static objects that will be configured in Init()
     std::shared_ptr<spdlog::logger> logger;
     std::shared_ptr<spdlog::logger> console;
     std::unordered_map<std::string, RecordEntry> records;
+    // log_msg callers and the sweep run on any thread
+    static std::mutex records_mutex;
+
+    // every LogSite, newest first. Sites are statics so the list only grows
+    static std::atomic<LogSite*> sites{nullptr};
+    static std::atomic<uint> num_sites{0};
+    // clear_records works through a slice of the sites and of the records buckets per sweep
+    static constexpr size_t sweep_batch = 64;
+    static std::mutex sweep_mutex;
+    static LogSite* site_cursor = nullptr;
+    static size_t bucket_cursor = 0;
+    static std::atomic<int64_t> next_sweep{0};
+
+    static int64_t steady_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void maybe_sweep(int64_t now)
+    {
+        if (now < next_sweep.load(std::memory_order_relaxed))
+            return;
+        next_sweep.store(now + std::chrono::duration_cast<std::chrono::nanoseconds>(sweep_rate).count(), std::memory_order_relaxed);
+        clear_records();
+    }
+
+    static void write_log(spdlog::level::level_enum severity, const std::string& pre, const std::string& msg, const std::string& redundant_msg)
+    {
+        std::string line;
+        line.reserve(pre.size() + msg.size() + redundant_msg.size() + 1);
+        line.append(pre).append(msg).append(redundant_msg).append(post_string());
+        if (to_console)
+            console->log(severity, line);
+        if (to_file)
+            logger->log(severity, line);
+    }
+
+    LogSite::LogSite(spdlog::level::level_enum severity, const char* file, const char* func, const int line)
+        : severity(severity), pre(pre_string(file, func, line)), id(num_sites++)
+    {
+        next = sites.load();
+        while (!sites.compare_exchange_weak(next, this))
+            ;
+    }
 
     /**
      * Parse command line arguments for config file path
@@ -183,17 +229,63 @@ namespace Logging
         if (should_update_records)
             should_log = update_records(msg, redundant_msg);
 
-        if (!should_log)
-            return;
+        if (should_log)
+        {
+            if (to_console)
+                console->log(severity, pre+msg+redundant_msg+post);
+            if (to_file)
+                logger->log(severity, pre+msg+redundant_msg+post);
+        }
 
-        if (to_console)
-            console->log(severity, pre+msg+redundant_msg+post);
-        if (to_file)
-            logger->log(severity, pre+msg+redundant_msg+post);
+        maybe_sweep(steady_ns());
+    }
 
-        // Reset records if clear time has been exceeded
-        if (std::chrono::duration_cast<std::chrono::minutes>(std::chrono::steady_clock::now() - last_records_clear) > clear_rate)
-            clear_records();
+    /**
+     * Decide whether an FPS_*_LOG site logs this time, before its message is formatted.
+     * Debug and below always log, as with log_msg. Otherwise each message of the site, told apart by
+     * the hash of its args, logs once per redundant_rate and counts the calls in between.
+     * @param site The call site, already checked against the severity_threshold with site_enabled
+     * @param hash args_hash of the format args
+     * @return true if the caller should format the message and hand it to log_site
+     */
+    bool site_should_log(LogSite& site, uint64_t hash)
+    {
+        int64_t now = steady_ns();
+        maybe_sweep(now);
+        if (site.severity <= spdlog::level::debug)
+            return true;
+
+        int64_t rate = std::chrono::duration_cast<std::chrono::nanoseconds>(redundant_rate).count();
+        std::lock_guard<std::mutex> lock(site.mtx);
+        auto& record = site.seen[hash];
+        if (record.last_logged != 0 && now - record.last_logged <= rate)
+        {
+            record.suppressed++;
+            return false;
+        }
+        record.last_logged = now;
+        return true;
+    }
+
+    /**
+     * Log a message for a site that site_should_log let through, with the count of the repeats held back before it.
+     * @param site The call site
+     * @param hash args_hash of the format args
+     * @param msg The formatted message
+     */
+    void log_site(LogSite& site, uint64_t hash, const std::string& msg)
+    {
+        std::string redundant_msg;
+        if (site.severity > spdlog::level::debug)
+        {
+            std::lock_guard<std::mutex> lock(site.mtx);
+            auto& record = site.seen[hash];
+            if (record.suppressed != 0)
+                redundant_msg = std::string(" seen ") + std::to_string(record.suppressed) + " more times in redundant period";
+            record.suppressed = 0;
+            record.msg = msg;
+        }
+        write_log(site.severity, site.pre, msg, redundant_msg);
     }
 
     /**
@@ -218,6 +310,7 @@ namespace Logging
      */
     bool update_records(std::string msg, std::string& redundant_msg)
     {
+        std::lock_guard<std::mutex> lock(records_mutex);
         auto existing_record = records.find(msg);
         // Add the record if it does not exist
         if (existing_record == records.end())
@@ -248,12 +341,69 @@ namespace Logging
     }
 
     /**
-     * Clear the record of messages
+     * Incremental aging sweep, run every sweep_rate from the log calls.
+     * Each call takes the next sweep_batch sites and records buckets, so a big table never stalls a log call.
+     * A site message whose redundant period is over with repeats still counted and no call since gets a
+     * summary line with its text. Site messages and records idle for longer than clear_rate are forgotten.
      */
     void clear_records()
     {
-        records.clear();
-        last_records_clear = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(sweep_mutex, std::try_to_lock);
+        if (!lock.owns_lock())
+            return;
+
+        auto now_tp = std::chrono::steady_clock::now();
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(now_tp.time_since_epoch()).count();
+        int64_t rate = std::chrono::duration_cast<std::chrono::nanoseconds>(redundant_rate).count();
+        int64_t idle = std::chrono::duration_cast<std::chrono::nanoseconds>(clear_rate).count();
+
+        if (!site_cursor)
+            site_cursor = sites.load();
+        std::vector<std::pair<std::string, uint>> summaries;
+        for (size_t i = 0; i < sweep_batch && site_cursor; ++i, site_cursor = site_cursor->next)
+        {
+            LogSite& site = *site_cursor;
+            {
+                std::lock_guard<std::mutex> site_lock(site.mtx);
+                for (auto it = site.seen.begin(); it != site.seen.end();)
+                {
+                    auto& record = it->second;
+                    if (now - record.last_logged <= rate)
+                    {
+                        ++it;
+                        continue;
+                    }
+                    if (record.suppressed != 0)
+                        summaries.emplace_back(record.msg, record.suppressed);
+                    record.suppressed = 0;
+                    if (now - record.last_logged > idle)
+                        it = site.seen.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            // written outside the site lock, the sinks can take their time
+            for (auto& [msg, count] : summaries)
+                write_log(site.severity, site.pre, msg, std::string(" seen ") + std::to_string(count) + " more times in redundant period");
+            summaries.clear();
+        }
+
+        std::lock_guard<std::mutex> records_lock(records_mutex);
+        if (bucket_cursor >= records.bucket_count())
+            bucket_cursor = 0;
+        std::vector<std::string> aged;
+        for (size_t i = 0; i < sweep_batch && bucket_cursor < records.bucket_count(); ++i, ++bucket_cursor)
+        {
+            for (auto it = records.begin(bucket_cursor); it != records.end(bucket_cursor); ++it)
+            {
+                if (now_tp - it->second.timestamp > clear_rate)
+                    aged.push_back(it->first);
+            }
+        }
+        for (auto& msg : aged)
+            records.erase(msg);
+
+        last_records_clear = now_tp;
     }
 
     /**
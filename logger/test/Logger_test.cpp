@@ -0,0 +1,70 @@
+#include <Logger.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+// make test
+
+class LoggerTest : public ::testing::Test
+{
+protected:
+    std::ostringstream out;
+
+    void SetUp() override
+    {
+        Logging::to_file = false;
+        Logging::to_console = true;
+        Logging::severity_threshold = spdlog::level::info;
+        Logging::redundant_rate = std::chrono::seconds(1);
+        auto sink = std::make_shared<spdlog::sinks::ostream_sink_mt>(out);
+        Logging::console = std::make_shared<spdlog::logger>("test", sink);
+        Logging::console->set_pattern("%v");
+    }
+
+    size_t count(const std::string& text)
+    {
+        std::string all = out.str();
+        size_t found = 0;
+        for (size_t pos = all.find(text); pos != std::string::npos; pos = all.find(text, pos + 1))
+            ++found;
+        return found;
+    }
+};
+
+TEST_F(LoggerTest, DistinctMessagesFromOneSiteAreAllLogged)
+{
+    for (int d = 0; d < 3; ++d)
+        FPS_ERROR_LOG("device %d failed", d);
+    const char* names[] = {"pump", "fan", "valve"};
+    for (auto name : names)
+        FPS_ERROR_LOG("%s stopped", name);
+
+    EXPECT_EQ(count("device 0 failed"), 1u);
+    EXPECT_EQ(count("device 1 failed"), 1u);
+    EXPECT_EQ(count("device 2 failed"), 1u);
+    EXPECT_EQ(count("pump stopped"), 1u);
+    EXPECT_EQ(count("fan stopped"), 1u);
+    EXPECT_EQ(count("valve stopped"), 1u);
+    EXPECT_EQ(count("more times"), 0u);
+}
+
+TEST_F(LoggerTest, RepeatIsSuppressedThenSummarizedWithItsText)
+{
+    for (int i = 0; i < 3; ++i)
+        FPS_ERROR_LOG("device %d failed", 7);
+    EXPECT_EQ(count("device 7 failed"), 1u);
+
+    // the site goes quiet, the sweep writes the held back count with the message
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    Logging::clear_records();
+    Logging::clear_records();
+    EXPECT_EQ(count("device 7 failed seen 2 more times in redundant period"), 1u);
+    EXPECT_EQ(count("\"MSG\": \" seen"), 0u);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
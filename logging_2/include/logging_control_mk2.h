@@ -7,9 +7,22 @@
 #include <vector>
 #include <deque>
 #include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 #include <algorithm>
 
+// users and formats are interned to small int ids when they are added, the string calls look the
+// id up once and the id calls skip even that.
+// Each format keeps its history in a fixed ring of LogRecords, the raw args and a steady_clock time,
+// so logging a message copies the args and allocates nothing. A char* message too long for the record
+// is the one exception, it is kept whole in the record's overflow string. The message text and timestamp are only
+// made when a LogMessage goes to the output callback, as it passes the repeat filter or on replay.
+
+#define LOG_MAX_ARGS 4
+#define LOG_ARGS_SIZE 232
+
 struct LogMessage {
     std::string userid;
     std::string log_format_id;
@@ -17,8 +30,65 @@ struct LogMessage {
     std::string timestamp;
 };
 
+// one logged message, args are packed nul terminated into args
+struct LogRecord {
+    int64_t time_ns;             // steady_clock
+    int32_t user_id;
+    uint16_t num_args;
+    uint16_t preformatted;       // args[0] is the message, from the char* logMessage
+    uint16_t arg_len[LOG_MAX_ARGS];
+    char args[LOG_ARGS_SIZE];
+    std::string overflow;        // a preformatted message that does not fit in args, empty otherwise
+};
+
+// fixed capacity history, oldest first, the next push overwrites the oldest once full
+class LogRing {
+public:
+    explicit LogRing(int capacity = 0) : records_(std::max(capacity, 0)), head_(0), size_(0) {}
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return records_.size(); }
+    bool empty() const { return size_ == 0; }
+
+    const LogRecord& operator[](size_t i) const { return records_[(head_ + i) % records_.size()]; }
+
+    LogRecord& push() {
+        if (records_.empty())
+            return scratch_;
+        size_t slot = (head_ + size_) % records_.size();
+        if (size_ == records_.size())
+            head_ = (head_ + 1) % records_.size();
+        else
+            size_++;
+        return records_[slot];
+    }
+
+    // keeps the newest records that fit
+    void resize(int capacity) {
+        std::vector<LogRecord> records(std::max(capacity, 0));
+        size_t keep = std::min(size_, records.size());
+        for (size_t i = 0; i < keep; i++)
+            records[i] = (*this)[size_ - keep + i];
+        records_.swap(records);
+        head_ = 0;
+        size_ = keep;
+    }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+private:
+    std::vector<LogRecord> records_;
+    size_t head_;
+    size_t size_;
+    LogRecord scratch_;          // for a zero length buffer, still formats the callback message
+};
+
 struct UserData {
         std::string name;
+        std::string userid;
     };
 
 struct LogFormat {
@@ -28,7 +98,8 @@ struct LogFormat {
         int message_counter;
         int message_repeats;
         int buffer_length;
-        std::deque<LogMessage> log_messages; // Fixed-length buffer for log messages
+        LogRing log_messages; // Fixed-length buffer for log messages
+        std::string log_format_id;
     };
 
 class LoggingControl {
@@ -36,13 +107,20 @@ public:
     LoggingControl();
     ~LoggingControl();
 
-    void addUser(const std::string& userid, const std::string& name);
-    void addLogFormat(const std::string& log_format_id, const std::string& format_string, int max_message_count = 100);
+    // both return the interned id for the id based calls, adding an existing one resets it
+    int addUser(const std::string& userid, const std::string& name);
+    int addLogFormat(const std::string& log_format_id, const std::string& format_string, int max_message_count = 100);
+
+    // -1 if not added
+    int getUserId(const std::string& userid) const;
+    int getLogFormatId(const std::string& log_format_id) const;
 
     void setLogOutputCallback(std::function<void(const LogMessage&)> callback);
 
     void logMessage(const std::string& userid, const std::string& log_format_id, const std::vector<std::string>& data_values);
     void logMessage(const std::string& userid, const std::string& log_format_id, char *buffer);
+    void logMessage(int user_id, int log_format_id, const std::vector<std::string>& data_values);
+    void logMessage(int user_id, int log_format_id, const char *buffer);
 
     void resetMessageCountFilter(const std::string& log_format_id);
     void setMessageRepeats(int log_repeats); // Set the number of repeated messages to trigger callback
@@ -57,39 +135,66 @@ public:
     // Retrieve the user data based on userid
     const UserData* getUserData(const std::string& userid) const;
 
+    // the callback message for a record of log_format
+    LogMessage formatLogMessage(const LogFormat& log_format, const LogRecord& record) const;
+
 private:
-    // struct UserData {
-    //     std::string name;
-    // };
-
-    // struct LogFormat {
-    //     std::string format_string;
-    //     int max_message_count;
-    //     int current_message_count;
-    //     int message_counter;
-    //     int message_repeats;
-    //     int buffer_length;
-    //     std::deque<LogMessage> log_messages; // Fixed-length buffer for log messages
-    // };
-
-    std::unordered_map<std::string, UserData> users_;
-    std::unordered_map<std::string, LogFormat> log_formats_;
+    // ids index these, a deque so the getLogFormat / getUserData pointers stay put
+    std::unordered_map<std::string, int> user_ids_;
+    std::unordered_map<std::string, int> log_format_ids_;
+    std::deque<UserData> users_;
+    std::deque<LogFormat> log_formats_;
     std::function<void(const LogMessage&)> log_output_callback_;
 
-    std::string getCurrentTimestamp() const;
+    // steady_clock and system_clock at the same moment, turns a record time into a wall clock one
+    std::chrono::steady_clock::time_point steady_base_;
+    std::chrono::system_clock::time_point system_base_;
+
+    LogRecord* pushRecord(int user_id, int log_format_id, int& buffered);
+    void outputRecord(const LogFormat& log_format, const LogRecord& record, int buffered);
+    std::string getTimestamp(int64_t time_ns) const;
 };
 
 
-LoggingControl::LoggingControl() {}
+LoggingControl::LoggingControl()
+    : steady_base_(std::chrono::steady_clock::now()), system_base_(std::chrono::system_clock::now()) {}
 
 LoggingControl::~LoggingControl() {}
 
-void LoggingControl::addUser(const std::string& userid, const std::string& name) {
-    users_[userid] = {name};
+int LoggingControl::addUser(const std::string& userid, const std::string& name) {
+    auto it = user_ids_.find(userid);
+    if (it != user_ids_.end()) {
+        users_[it->second].name = name;
+        return it->second;
+    }
+    int id = (int)users_.size();
+    users_.push_back({name, userid});
+    user_ids_[userid] = id;
+    return id;
+}
+
+int LoggingControl::addLogFormat(const std::string& log_format_id, const std::string& format_string, int max_message_count) {
+    auto it = log_format_ids_.find(log_format_id);
+    int id;
+    if (it != log_format_ids_.end()) {
+        id = it->second;
+    } else {
+        id = (int)log_formats_.size();
+        log_formats_.push_back(LogFormat());
+        log_format_ids_[log_format_id] = id;
+    }
+    log_formats_[id] = {format_string, max_message_count, 0, 0, 10, 100, LogRing(100), log_format_id};
+    return id;
+}
+
+int LoggingControl::getUserId(const std::string& userid) const {
+    auto it = user_ids_.find(userid);
+    return it != user_ids_.end() ? it->second : -1;
 }
 
-void LoggingControl::addLogFormat(const std::string& log_format_id, const std::string& format_string, int max_message_count) {
-    log_formats_[log_format_id] = {format_string, max_message_count, 0, 0, 10, 100, {}};
+int LoggingControl::getLogFormatId(const std::string& log_format_id) const {
+    auto it = log_format_ids_.find(log_format_id);
+    return it != log_format_ids_.end() ? it->second : -1;
 }
 
 void LoggingControl::setLogOutputCallback(std::function<void(const LogMessage&)> callback) {
@@ -97,153 +202,178 @@ void LoggingControl::setLogOutputCallback(std::function<void(const LogMessage&)>
 }
 
 void LoggingControl::logMessage(const std::string& userid, const std::string& log_format_id, const std::vector<std::string>& data_values) {
-    auto user_it = users_.find(userid);
-    auto format_it = log_formats_.find(log_format_id);
-    if (user_it != users_.end() && format_it != log_formats_.end()) {
-        LogFormat& log_format = format_it->second;
-        if (log_format.current_message_count >= log_format.max_message_count) {
-            log_format.current_message_count = 0;
-            log_format.message_counter++;
-        }
-        log_format.current_message_count++;
-
-        LogMessage log_message;
-        log_message.userid = userid;
-        log_message.log_format_id = log_format_id;
-        log_message.timestamp = getCurrentTimestamp();
-
-        // Create the log message string using the format string and data values
-        char buffer[256]; // Assuming the log message won't exceed 256 characters
-        std::snprintf(buffer, sizeof(buffer), log_format.format_string.c_str(), data_values[0].c_str(), data_values[1].c_str());
-        log_message.message = buffer;
-
-        log_format.log_messages.push_back(log_message);
-
-        // Check if the message needs to be sent to the callback function based on the repeat count
-        if (((int)log_format.log_messages.size() == (int)log_format.message_repeats) 
-            || ((int)log_format.log_messages.size() % (int)log_format.message_repeats == 0)
-            || ((int)log_format.log_messages.size() == 1)
-            || ((int)log_format.log_messages.size() == 10)
-            ) 
-            {
-            if (log_output_callback_) {
-                log_output_callback_(log_message);
-            }
-        }
+    logMessage(getUserId(userid), getLogFormatId(log_format_id), data_values);
+}
 
-        // If the buffer length is reached, drop the oldest message
-        if ((int)log_format.log_messages.size() > (int)log_format.buffer_length) {
-            log_format.log_messages.pop_front();
-        }
+void LoggingControl::logMessage(const std::string& userid, const std::string& log_format_id, char *buffer) {
+    logMessage(getUserId(userid), getLogFormatId(log_format_id), (const char*)buffer);
+}
+
+void LoggingControl::logMessage(int user_id, int log_format_id, const std::vector<std::string>& data_values) {
+    int buffered;
+    LogRecord* record = pushRecord(user_id, log_format_id, buffered);
+    if (!record)
+        return;
+    // the args are cut short to fit the record, the old 256 byte message buffer cut them anyway
+    size_t pos = 0;
+    record->num_args = (uint16_t)std::min(data_values.size(), (size_t)LOG_MAX_ARGS);
+    record->preformatted = 0;
+    record->overflow.clear();
+    for (int i = 0; i < record->num_args; i++) {
+        size_t len = std::min(data_values[i].size(), LOG_ARGS_SIZE - pos - (record->num_args - i));
+        std::memcpy(record->args + pos, data_values[i].data(), len);
+        record->args[pos + len] = '\0';
+        record->arg_len[i] = (uint16_t)len;
+        pos += len + 1;
     }
+    outputRecord(log_formats_[log_format_id], *record, buffered);
 }
-void LoggingControl::logMessage(const std::string& userid, const std::string& log_format_id, char *buffer) {
-    auto user_it = users_.find(userid);
-    auto format_it = log_formats_.find(log_format_id);
-    if (user_it != users_.end() && format_it != log_formats_.end()) {
-        LogFormat& log_format = format_it->second;
-        if (log_format.current_message_count >= log_format.max_message_count) {
-            log_format.current_message_count = 0;
-            log_format.message_counter++;
-        }
-        log_format.current_message_count++;
-
-        LogMessage log_message;
-        log_message.userid = userid;
-        log_message.log_format_id = log_format_id;
-        log_message.timestamp = getCurrentTimestamp();
-
-        // Create the log message string using the format string and data values
-        // char buffer[256]; // Assuming the log message won't exceed 256 characters
-        // std::snprintf(buffer, sizeof(buffer), log_format.format_string.c_str(), data_values[0].c_str(), data_values[1].c_str());
-        log_message.message = buffer;
-
-        log_format.log_messages.push_back(log_message);
-
-        // Check if the message needs to be sent to the callback function based on the repeat count
-        if (((int)log_format.log_messages.size() == (int)log_format.message_repeats) 
-            || ((int)log_format.log_messages.size() % (int)log_format.message_repeats == 0)
-            || ((int)log_format.log_messages.size() == 1)
-            || ((int)log_format.log_messages.size() == 10)
-            ) 
-            {
-            if (log_output_callback_) {
-                log_output_callback_(log_message);
-            }
-        }
 
-        // If the buffer length is reached, drop the oldest message
-        if ((int)log_format.log_messages.size() > (int)log_format.buffer_length) {
-            log_format.log_messages.pop_front();
-        }
+void LoggingControl::logMessage(int user_id, int log_format_id, const char *buffer) {
+    int buffered;
+    LogRecord* record = pushRecord(user_id, log_format_id, buffered);
+    if (!record)
+        return;
+    size_t len = std::strlen(buffer);
+    record->num_args = 1;
+    record->preformatted = 1;
+    if (len < LOG_ARGS_SIZE) {
+        std::memcpy(record->args, buffer, len);
+        record->args[len] = '\0';
+        record->arg_len[0] = (uint16_t)len;
+        record->overflow.clear();
+    } else {
+        // too long for the record, keep all of it rather than cut it short
+        record->args[0] = '\0';
+        record->arg_len[0] = 0;
+        record->overflow.assign(buffer, len);
     }
+    outputRecord(log_formats_[log_format_id], *record, buffered);
+}
+
+// counts the message and takes the next ring slot, nullptr for an unknown user or format.
+// buffered is the count the repeat filter uses, the buffer with the new message in and the oldest
+// not yet dropped, so one over the buffer length once it is full
+LogRecord* LoggingControl::pushRecord(int user_id, int log_format_id, int& buffered) {
+    if (user_id < 0 || user_id >= (int)users_.size() || log_format_id < 0 || log_format_id >= (int)log_formats_.size())
+        return nullptr;
+    LogFormat& log_format = log_formats_[log_format_id];
+    if (log_format.current_message_count >= log_format.max_message_count) {
+        log_format.current_message_count = 0;
+        log_format.message_counter++;
+    }
+    log_format.current_message_count++;
+
+    buffered = (int)log_format.log_messages.size() + 1;
+    LogRecord& record = log_format.log_messages.push();
+    record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - steady_base_).count();
+    record.user_id = user_id;
+    return &record;
+}
 
+void LoggingControl::outputRecord(const LogFormat& log_format, const LogRecord& record, int buffered) {
+    if (!log_output_callback_)
+        return;
+    // Check if the message needs to be sent to the callback function based on the repeat count
+    if ((buffered == log_format.message_repeats)
+        || (buffered % log_format.message_repeats == 0)
+        || (buffered == 1)
+        || (buffered == 10)
+        )
+        {
+        log_output_callback_(formatLogMessage(log_format, record));
+    }
+}
+
+LogMessage LoggingControl::formatLogMessage(const LogFormat& log_format, const LogRecord& record) const {
+    LogMessage log_message;
+    log_message.userid = users_[record.user_id].userid;
+    log_message.log_format_id = log_format.log_format_id;
+    log_message.timestamp = getTimestamp(record.time_ns);
+    if (record.preformatted) {
+        if (!record.overflow.empty())
+            log_message.message = record.overflow;
+        else
+            log_message.message.assign(record.args, record.arg_len[0]);
+        return log_message;
+    }
+
+    // Create the log message string using the format string and data values
+    const char* args[2] = {"", ""};
+    size_t pos = 0;
+    for (int i = 0; i < record.num_args; i++) {
+        if (i < 2)
+            args[i] = record.args + pos;
+        pos += record.arg_len[i] + 1;
+    }
+    char buffer[256]; // Assuming the log message won't exceed 256 characters
+    std::snprintf(buffer, sizeof(buffer), log_format.format_string.c_str(), args[0], args[1]);
+    log_message.message = buffer;
+    return log_message;
 }
 
 void LoggingControl::resetMessageCountFilter(const std::string& log_format_id) {
-    auto format_it = log_formats_.find(log_format_id);
-    if (format_it != log_formats_.end()) {
-        format_it->second.current_message_count = 0;
-        format_it->second.message_counter = 0;
+    int id = getLogFormatId(log_format_id);
+    if (id >= 0) {
+        log_formats_[id].current_message_count = 0;
+        log_formats_[id].message_counter = 0;
     }
 }
 
 void LoggingControl::setMessageRepeats(int log_repeats) {
     for (auto& log_format : log_formats_) {
-        log_format.second.message_repeats = log_repeats;
+        log_format.message_repeats = log_repeats;
     }
 }
 
 void LoggingControl::setBufferLength(int log_buffer_length) {
     for (auto& log_format : log_formats_) {
-        log_format.second.buffer_length = log_buffer_length;
-        // If the buffer length is less than the current size, truncate the buffer
-        if ((int)log_format.second.log_messages.size() > (int)log_buffer_length) {
-            log_format.second.log_messages.resize(log_buffer_length);
-        }
+        log_format.buffer_length = log_buffer_length;
+        // If the buffer length is less than the current size, the oldest messages are dropped
+        log_format.log_messages.resize(log_buffer_length);
     }
 }
 
 void LoggingControl::replayLogMessages(const std::string& log_format_id) {
-    auto format_it = log_formats_.find(log_format_id);
-    if (format_it != log_formats_.end()) {
-        for (const auto& log_message : format_it->second.log_messages) {
-            if (log_output_callback_) {
-                log_output_callback_(log_message);
-            }
+    int id = getLogFormatId(log_format_id);
+    if (id >= 0 && log_output_callback_) {
+        const LogFormat& log_format = log_formats_[id];
+        for (size_t i = 0; i < log_format.log_messages.size(); i++) {
+            log_output_callback_(formatLogMessage(log_format, log_format.log_messages[i]));
         }
     }
 }
 
 void LoggingControl::replayAllLogMessages() {
+    if (!log_output_callback_)
+        return;
     for (const auto& log_format : log_formats_) {
-        for (const auto& log_message : log_format.second.log_messages) {
-            if (log_output_callback_) {
-                log_output_callback_(log_message);
-            }
+        for (size_t i = 0; i < log_format.log_messages.size(); i++) {
+            log_output_callback_(formatLogMessage(log_format, log_format.log_messages[i]));
         }
     }
 }
 
-std::string LoggingControl::getCurrentTimestamp() const {
-    std::time_t now = std::time(nullptr);
+std::string LoggingControl::getTimestamp(int64_t time_ns) const {
+    std::time_t now = std::chrono::system_clock::to_time_t(system_base_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(time_ns)));
     char buffer[20];
     std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
     return std::string(buffer);
 }
 
 const LogFormat* LoggingControl::getLogFormat(const std::string& log_format_id) const {
-    auto format_it = log_formats_.find(log_format_id);
-    if (format_it != log_formats_.end()) {
-        return &format_it->second;
+    int id = getLogFormatId(log_format_id);
+    if (id >= 0) {
+        return &log_formats_[id];
     }
     return nullptr;
 }
 
 const UserData* LoggingControl::getUserData(const std::string& userid) const {
-    auto user_it = users_.find(userid);
-    if (user_it != users_.end()) {
-        return &user_it->second;
+    int id = getUserId(userid);
+    if (id >= 0) {
+        return &users_[id];
     }
     return nullptr;
 }
@@ -109,6 +109,68 @@ TEST_F(LoggingControlTest, MessageCountFilterAndBufferLength) {
     EXPECT_EQ(logger.getLogFormat("format1")->log_messages.size(), 5);
 }
 
+TEST_F(LoggingControlTest, BufferKeepsNewestAndIdsMatchNames) {
+    logger.setBufferLength(3);
+    int user1 = logger.getUserId("user1");
+    int format1 = logger.getLogFormatId("format1");
+
+    EXPECT_EQ(user1, logger.addUser("user1", "User One"));
+    EXPECT_EQ(logger.getUserId("user3"), -1);
+    EXPECT_EQ(logger.getLogFormatId("format3"), -1);
+
+    for (int i = 0; i < 5; i++) {
+        std::vector<std::string> data_values = {"user1", "message " + std::to_string(i)};
+        if (i % 2)
+            logger.logMessage(user1, format1, data_values);
+        else
+            logger.logMessage("user1", "format1", data_values);
+    }
+    EXPECT_EQ(logger.getLogFormat("format1")->log_messages.size(), 3);
+
+    std::ostringstream log_messages_stream;
+    logger.setLogOutputCallback([&log_messages_stream](const LogMessage& log_message) {
+        log_messages_stream << log_message.userid << " " << log_message.message << "\n";
+    });
+    logger.replayLogMessages("format1");
+    EXPECT_EQ(log_messages_stream.str(), "user1 User: user1, Message: message 2\n"
+                                         "user1 User: user1, Message: message 3\n"
+                                         "user1 User: user1, Message: message 4\n");
+}
+
+TEST_F(LoggingControlTest, LongBufferMessageIsKeptWhole) {
+    std::vector<std::string> received;
+    logger.setLogOutputCallback([&received](const LogMessage& log_message) {
+        received.push_back(log_message.message);
+    });
+
+    // one short of the record, at the record size and well past it
+    std::string fits(LOG_ARGS_SIZE - 1, 'a');
+    std::string at(LOG_ARGS_SIZE, 'b');
+    std::string longer(4 * LOG_ARGS_SIZE, 'c');
+    logger.logMessage("user1", "format1", &fits[0]);
+    logger.logMessage("user1", "format1", &at[0]);
+    logger.logMessage("user1", "format1", &longer[0]);
+    // a short one into the same format after a long one
+    logger.logMessage("user1", "format1", (char*)"short");
+
+    received.clear();
+    logger.replayLogMessages("format1");
+    ASSERT_EQ(received.size(), 4u);
+    EXPECT_EQ(received[0], fits);
+    EXPECT_EQ(received[1], at);
+    EXPECT_EQ(received[2], longer);
+    EXPECT_EQ(received[3], "short");
+
+    // a short message in the slot a long one had
+    logger.setBufferLength(1);
+    logger.logMessage("user1", "format1", &longer[0]);
+    logger.logMessage("user1", "format1", (char*)"short");
+    received.clear();
+    logger.replayLogMessages("format1");
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0], "short");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,44 @@
+#ifndef GCOM_BLOCK_DECODE_H
+#define GCOM_BLOCK_DECODE_H
+
+// gcom_block_decode.h
+// decode a whole register block at once into a column of values
+//
+// big input blocks ( cell voltages, temperatures ) are usually one item type all the way through.
+// When every map item in a reg_struct has the same size, sign, float, scale and shift flags and the items
+// sit back to back, block_decode_spec marks the block homogeneous at config load.
+// processGroupCallback then decodes the span it read in one go instead of a mapix lookup and
+// a decode call per item.
+//
+// items of 1 or 2 registers only, no masks and no starting_bit_pos, anything else stays on the per item kernels.
+// byte_swap is not handled here, the per item decode ignores it as well.
+// the results are the same values decode_kernel gives
+//    float or scaled   double column
+//    otherwise         int64 column, unsigned values fit since they are at most 32 bits
+//
+// SSE2 and AVX2 kernels with a scalar fallback, the best one the cpu has is picked at startup.
+
+#include "gcom_config.h"
+
+enum class BlockDecodeIsa {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// fill in spec for reg, false ( and spec.homogeneous false ) if the block has to go item by item
+bool block_decode_spec(const cfg::reg_struct& reg, BlockDecodeSpec& spec);
+
+// the column a homogeneous block decodes into, Float means f64 otherwise i64
+DecodeValue::Kind block_decode_kind(const BlockDecodeSpec& spec);
+
+BlockDecodeIsa block_decode_isa();
+const char* block_decode_isa_name(BlockDecodeIsa isa);
+
+// decode num_items items starting at buf16, out must hold num_items values
+void block_decode_f64(const BlockDecodeSpec& spec, const u16* buf16, int num_items, double* out,
+                      BlockDecodeIsa isa = block_decode_isa());
+void block_decode_i64(const BlockDecodeSpec& spec, const u16* buf16, int num_items, s64* out,
+                      BlockDecodeIsa isa = block_decode_isa());
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef GCOM_CHANNEL_H
+#define GCOM_CHANNEL_H
+
+// gcom_channel.h
+// bounded lock free channel used by the io_threads, the response thread and the timer
+// replaces the std::queue + std::mutex + condition_variable channels
+//
+// the queue itself is the vendored rigtorp MPMCQueue
+// consumers that find the queue empty sleep on a futex word that producers bump after each push
+// producers only make the wake syscall when someone is actually sleeping
+// a producer that finds the queue full spins briefly then sleeps on a second futex word the
+// consumers bump as they pop. That check is a plain load on the consumer side, so a wake can be
+// missed in a race, the producer sleeps at most Space_Wait_Ns before it looks again
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <climits>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rigtorp/MPMCQueue.h"
+
+#ifndef GCOM_CHANNEL_DEFAULT_SIZE
+#define GCOM_CHANNEL_DEFAULT_SIZE 4096
+#endif
+
+// futex wait / wake on a single 32 bit sequence word
+struct chanWaker {
+    alignas(64) std::atomic<uint32_t> seq{0};
+    alignas(64) std::atomic<int> waiters{0};
+
+    // producers call this after every push (or once after a batch)
+    void notify(int num = 1) {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) > 0) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAKE_PRIVATE, num, nullptr, nullptr, 0);
+        }
+    }
+
+    void notify_all() {
+        notify(INT_MAX);
+    }
+
+    // sleep until seq moves away from old_seq or timeout_ns elapses ( < 0 means forever)
+    void wait(uint32_t old_seq, int64_t timeout_ns) {
+        if (timeout_ns < 0) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT_PRIVATE, old_seq, nullptr, nullptr, 0);
+            return;
+        }
+        timespec ts;
+        ts.tv_sec  = timeout_ns / 1000000000;
+        ts.tv_nsec = timeout_ns % 1000000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT_PRIVATE, old_seq, &ts, nullptr, 0);
+    }
+};
+
+template <typename T>
+class lfChannel {
+private:
+    static constexpr int64_t Space_Wait_Ns = 1000000;   // 1 mS
+
+    rigtorp::MPMCQueue<T> queue;
+    chanWaker waker;
+    chanWaker space;    // producers waiting on a full queue
+
+    // num slots came free, wake the producers waiting for them
+    void freed(int num) {
+        if (space.waiters.load(std::memory_order_relaxed) > 0)
+            space.notify(num);
+    }
+
+    bool pop(T& message) {
+        if (!queue.try_pop(message))
+            return false;
+        freed(1);
+        return true;
+    }
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // the common wait loop, timeout_ns < 0 waits forever
+    bool wait_pop(T& message, int64_t timeout_ns) {
+        if (pop(message))
+            return true;
+        if (timeout_ns == 0)
+            return false;
+
+        int64_t deadline = (timeout_ns > 0) ? now_ns() + timeout_ns : 0;
+        while (true) {
+            waker.waiters.fetch_add(1, std::memory_order_seq_cst);
+            uint32_t old_seq = waker.seq.load(std::memory_order_seq_cst);
+            // a producer may have pushed after our first look
+            if (pop(message)) {
+                waker.waiters.fetch_sub(1, std::memory_order_seq_cst);
+                return true;
+            }
+            int64_t remain = -1;
+            if (timeout_ns > 0) {
+                remain = deadline - now_ns();
+                if (remain <= 0) {
+                    waker.waiters.fetch_sub(1, std::memory_order_seq_cst);
+                    return false;
+                }
+            }
+            waker.wait(old_seq, remain);
+            waker.waiters.fetch_sub(1, std::memory_order_seq_cst);
+
+            if (pop(message))
+                return true;
+            if (timeout_ns > 0 && now_ns() >= deadline)
+                return false;
+        }
+    }
+
+    // bounded queue, a full queue applies backpressure to the producer
+    template <typename P>
+    void push_wait(P&& message) {
+        for (int spins = 0; spins < 64; ++spins) {
+            if (queue.try_push(std::forward<P>(message)))
+                return;
+        }
+        while (true) {
+            space.waiters.fetch_add(1, std::memory_order_seq_cst);
+            uint32_t old_seq = space.seq.load(std::memory_order_seq_cst);
+            // a consumer may have popped after our last look
+            bool pushed = queue.try_push(std::forward<P>(message));
+            if (!pushed)
+                space.wait(old_seq, Space_Wait_Ns);
+            space.waiters.fetch_sub(1, std::memory_order_seq_cst);
+            if (pushed || queue.try_push(std::forward<P>(message)))
+                return;
+        }
+    }
+
+public:
+    explicit lfChannel(size_t capacity = GCOM_CHANNEL_DEFAULT_SIZE)
+        : queue(capacity) {}
+
+    lfChannel(const lfChannel&) = delete;
+    lfChannel& operator=(const lfChannel&) = delete;
+
+    void send(T&& message) {
+        push_wait(std::move(message));
+        waker.notify();
+    }
+
+    void send(const T& message) {
+        push_wait(message);
+        waker.notify();
+    }
+
+    // returns false and leaves the message alone if the queue is full
+    bool try_send(T&& message) {
+        if (!queue.try_push(std::move(message)))
+            return false;
+        waker.notify();
+        return true;
+    }
+
+    // push a whole batch then make (at most) one wake call
+    void sendBatch(std::vector<T>& messages) {
+        if (messages.empty())
+            return;
+        for (auto& message : messages) {
+            push_wait(std::move(message));
+        }
+        waker.notify(static_cast<int>(messages.size()));
+        messages.clear();
+    }
+
+    bool receive(T& message) {
+        return wait_pop(message, -1);
+    }
+
+    bool receive(T& message, double durationInSeconds) {
+        if (durationInSeconds <= 0.0)
+            return pop(message);
+        return wait_pop(message, static_cast<int64_t>(durationInSeconds * 1e9));
+    }
+
+    template <typename Rep, typename Period>
+    bool receive(T& message, const std::chrono::duration<Rep, Period>& duration) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        if (ns <= 0)
+            return pop(message);
+        return wait_pop(message, ns);
+    }
+
+    // wait up to durationInSeconds for the first item then take up to max_items without waiting
+    size_t receiveBatch(std::vector<T>& messages, size_t max_items, double durationInSeconds) {
+        T message;
+        if (!receive(message, durationInSeconds))
+            return 0;
+        messages.emplace_back(std::move(message));
+        size_t count = 1;
+        size_t more = 0;
+        while (count < max_items && queue.try_pop(message)) {
+            messages.emplace_back(std::move(message));
+            ++count;
+            ++more;
+        }
+        if (more)
+            freed(static_cast<int>(more));
+        return count;
+    }
+
+    bool peekpop(T& message) {
+        return pop(message);
+    }
+
+    // best effort only
+    size_t size() const {
+        auto sz = queue.size();
+        return sz > 0 ? static_cast<size_t>(sz) : 0;
+    }
+
+    bool empty() const {
+        return queue.empty();
+    }
+
+    // wake every sleeping consumer, used on shutdown
+    void wakeAll() {
+        waker.notify_all();
+    }
+};
+
+#endif
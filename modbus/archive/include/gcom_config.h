@@ -65,6 +65,50 @@ enum class WorkTypes {
     // ... Add other types as needed
 };
 
+// the result of a map item decode, one of u / s / f depending on kind
+struct DecodeValue {
+    enum class Kind : uint8_t {
+        None,
+        Unsigned,
+        Signed,
+        Float
+    };
+    Kind kind = Kind::None;
+    union {
+        u64 u;
+        s64 s;
+        double f;
+    };
+
+    DecodeValue() : u(0) {}
+    void set(u64 v)    { kind = Kind::Unsigned; u = v; }
+    void set(s64 v)    { kind = Kind::Signed;   s = v; }
+    void set(double v) { kind = Kind::Float;    f = v; }
+
+    // same types gcom_decode_any puts in its std::any
+    std::any to_any() const {
+        switch (kind) {
+            case Kind::Unsigned: return u;
+            case Kind::Signed:   return s;
+            case Kind::Float:    return f;
+            default:             return std::any();
+        }
+    }
+};
+
+// set at config load when every item in a register block decodes the same way, see gcom_block_decode.h
+struct BlockDecodeSpec {
+    bool homogeneous = false;
+    int first_offset = 0;
+    int num_items = 0;
+    int size = 1;           // registers per item, 1 or 2
+    bool word_swap = false;
+    bool is_signed = false;
+    bool is_float = false;
+    double scale = 0.0;
+    int shift = 0;
+};
+
 
 struct cfg {
 
@@ -90,9 +134,19 @@ struct cfg {
         int device_id;
         bool debug;
         int connection_timeout;
+        int max_poll_gap = 0;      // unmapped registers the poll planner may read between register blocks
+        int pipeline_depth = 0;    // > 1 keeps that many requests in flight per io_thread connection
+        int reactor_threads = 0;   // > 0 runs the connections on that many epoll loops instead of one io_thread each
+        bool pub_on_change = false;      // only publish items whose registers changed since the last read
+        double full_pub_interval = 10.0; // seconds between full pubs when pub_on_change is set
+        double set_batch_window = 0.0;   // seconds fims sets are held to merge into multi register writes
 
     } connection;
     
+    struct map_struct;
+    // decode kernel picked for a map item at config load, see gcom_decode_kernel.h
+    using DecodeFn = u64 (*)(const u16* raw16, const map_struct& item, DecodeValue& out);
+
     struct map_struct {
         std::string id;
         std::string name;
@@ -115,6 +169,8 @@ struct cfg {
         u64 care_mask;  // new
         bool uses_masks;//  new
 
+        DecodeFn decode = nullptr;
+
         bool is_float;
         bool is_signed;
         bool is_word_swap;
@@ -153,8 +209,8 @@ struct cfg {
 
         double offtime;
 
-        u64 forced_val;
-        u64 raw_val;
+        // forced_val, raw_val and the deadband / debounce state live in the PointStore ( gcom_point_store.h )
+        int32_t point_id = -1;
 
 //input.bit_str_known std::vector<bool>  ->num_bit_strs
 
@@ -168,16 +224,11 @@ struct cfg {
         //map_struct *base;   // base for packed bits.
         int device_id;
 
-        double  debounce_time = 0.0;  // time when debounce is turned off
         double  debounce = 0.0;   // time to debounce
         double  deadband = 0.0;  // time when debounce is turned off
         bool use_debounce;
         bool use_deadband;
 
-        double float_val;  // used in deadband
-        double last_float_val;  // used in deadband
-        u64 last_raw_val; // used in deadband
-
         // todo fix these up
         bool use_bool = false;
         bool use_hex = false;
@@ -203,6 +254,7 @@ struct cfg {
         std::vector<int>bad_regs;
         std::vector<std::shared_ptr<map_struct>>maps;
         std::map<int, std::shared_ptr<map_struct>>mapix; // faster lookup for maps
+        BlockDecodeSpec block;
         std::string id;
         std::string comp_id;
         //std::weak_ptr<comp_struct>comp; // done
@@ -289,7 +341,7 @@ struct cfg {
     std::string typeToStr(Register_Types rtype);
     /// @brief [componnts][uri][item] 
     std::map<std::string, std::map<std::string, std::map<std::string, std::shared_ptr<map_struct>>>> itemMap;
-    std::map<int, std::map<Register_Types, std::map<int, std::shared_ptr<cfg::map_struct>>>>idMap;
+    // the device_id / type / offset lookup is MapIndex::find_id ( gcom_map_index.h )
     //std::map<std::string, std::map<std::string, std::map<std::string, cfg::map_struct*>>>::iterator findItem (std::string_view uri);
 
     std::map<std::string,std::shared_ptr<cfg::map_struct>>* findMapItem(std::vector<std::string> keys);
@@ -344,38 +396,44 @@ using MapIdMap = std::map<int, std::map<cfg::Register_Types, std::map<int, cfg::
 
 #include "shared_utils.hpp"
 
+// split = false leaves uriv empty, for callers that look the uri up in the UriRouter ( gcom_uri_router.h )
 struct Uri_req {
-    Uri_req (std::string_view& uri_view, const char* uri)
+    Uri_req (std::string_view& uri_view, const char* uri, bool split = true)
     {
-        static constexpr auto Raw_Request_Suffix           = "/_raw"sv;
-        static constexpr auto Timings_Request_Suffix       = "/_timings"sv;
-        static constexpr auto Reset_Timings_Request_Suffix = "/_reset_timings"sv;
-        static constexpr auto Reload_Request_Suffix        = "/_reload"sv;
-        static constexpr auto Disable_Suffix               = "/_disable"sv;
-        static constexpr auto Enable_Suffix                = "/_enable"sv;
-        static constexpr auto Force_Suffix                 = "/_force"sv;
-        static constexpr auto Unforce_Suffix               = "/_unforce"sv;
-        uri_view                 = std::string_view{uri, strlen(uri)};
-        is_raw_request           = str_ends_with(uri_view, Raw_Request_Suffix);
-        is_timings_request       = str_ends_with(uri_view, Timings_Request_Suffix);
-        is_reset_timings_request = str_ends_with(uri_view, Reset_Timings_Request_Suffix);
-        is_reload_request        = str_ends_with(uri_view, Reload_Request_Suffix);
-        is_enable_request        = str_ends_with(uri_view, Enable_Suffix);
-        is_disable_request       = str_ends_with(uri_view, Disable_Suffix);
-        is_force_request         = str_ends_with(uri_view, Force_Suffix);
-        is_unforce_request       = str_ends_with(uri_view, Unforce_Suffix);
-        if (is_raw_request)           uri_view.remove_suffix(Raw_Request_Suffix.size());
-        if (is_timings_request)       uri_view.remove_suffix(Timings_Request_Suffix.size());
-        if (is_reset_timings_request) uri_view.remove_suffix(Reset_Timings_Request_Suffix.size());
-        if (is_reload_request)        uri_view.remove_suffix(Reload_Request_Suffix.size());
-        if (is_enable_request)        uri_view.remove_suffix(Enable_Suffix.size());
-        if (is_disable_request)       uri_view.remove_suffix(Disable_Suffix.size());
-        if (is_force_request)         uri_view.remove_suffix(Force_Suffix.size());
-        if (is_unforce_request)       uri_view.remove_suffix(Unforce_Suffix.size());
-        splitUri(uri_view);
+        uri_view = std::string_view{uri, strlen(uri)};
+        stripSuffix(uri_view);
+        if (split)
+            splitUri(uri_view);
 
     }
 
+    // a uri has at most one /_suffix, so look at the last segment once
+    void stripSuffix(std::string_view& uri_view)
+    {
+        is_raw_request           = false;
+        is_timings_request       = false;
+        is_reset_timings_request = false;
+        is_reload_request        = false;
+        is_enable_request        = false;
+        is_disable_request       = false;
+        is_force_request         = false;
+        is_unforce_request       = false;
+        auto slash = uri_view.rfind('/');
+        if (slash == std::string_view::npos || slash + 1 >= uri_view.size() || uri_view[slash + 1] != '_')
+            return;
+        auto suffix = uri_view.substr(slash);
+        if      (suffix == "/_raw"sv)           is_raw_request = true;
+        else if (suffix == "/_timings"sv)       is_timings_request = true;
+        else if (suffix == "/_reset_timings"sv) is_reset_timings_request = true;
+        else if (suffix == "/_reload"sv)        is_reload_request = true;
+        else if (suffix == "/_enable"sv)        is_enable_request = true;
+        else if (suffix == "/_disable"sv)       is_disable_request = true;
+        else if (suffix == "/_force"sv)         is_force_request = true;
+        else if (suffix == "/_unforce"sv)       is_unforce_request = true;
+        else return;
+        uri_view.remove_suffix(suffix.size());
+    }
+
     bool str_ends_with(const std::string_view& str, const std::string_view& suffix)
     {
 	    return str.size() >= suffix.size() 
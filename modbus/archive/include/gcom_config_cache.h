@@ -0,0 +1,45 @@
+#ifndef GCOM_CONFIG_CACHE_H
+#define GCOM_CONFIG_CACHE_H
+
+// gcom_config_cache.h
+// binary snapshot of the extracted config, skips the json parse on startup and reload
+//
+// gcom_parse_file turns the whole file into a std::map<std::string, std::any> tree and the
+// extract_* functions then walk it with a getItemFromMap lookup for every field of every item.
+// For a big site that is most of the startup time and all of it happens again on each _reload.
+// After a good extract gcom_load_cfg_file writes the connection, components, registers and map
+// items to <config file>.cache as flat records:
+//    Header    magic, CONFIG_CACHE_VERSION, the FNV-1a hash of the json bytes and where the tables sit
+//    comps     one CompRec each, pointing at its run of regs
+//    regs      one RegRec each, pointing at its run of root maps
+//    maps      one MapRec each, the packed bit ranges follow the roots of their reg
+//    strs      StrRefs for the bit_strings
+//    ints      bit_str_num
+//    chars     every string, not terminated
+// All the records are fixed size and 8 byte aligned so the file is used straight from mmap.
+// The next load hashes the json file, a cache with the same hash and version is rebuilt into the
+// shared_ptr tree with no parsing. Anything else, a changed file, a new version or a short or
+// damaged cache, falls back to the json and writes a new cache.
+// Bump CONFIG_CACHE_VERSION whenever a cached field is added to the records.
+
+#include <string>
+
+#include "gcom_config.h"
+
+#define CONFIG_CACHE_VERSION 1
+
+// FNV-1a 64 of the file contents, false if the file can't be read
+bool config_file_hash(const char* filename, u64& hash);
+// where the cache for filename lives
+std::string config_cache_name(const char* filename);
+
+// adds the cached connection, components and items to myCfg, false ( and myCfg untouched ) on
+// any mismatch. The caller still runs the addSub / addPub / register sizing steps
+bool config_cache_load(const char* cache_file, u64 hash, struct cfg& myCfg);
+// the connection and myCfg.components from first_comp on, the ones this load added.
+// written to a temp file and renamed in, a reader never sees half a cache
+bool config_cache_save(const char* cache_file, u64 hash, const struct cfg& myCfg, size_t first_comp = 0);
+
+int bench_config_cache(int num_comps, int loops);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef GCOM_DECODE_KERNEL_H
+#define GCOM_DECODE_KERNEL_H
+
+// gcom_decode_kernel.h
+// register decode kernels, one instantiation per map_struct flag combination
+//
+// gcom_decode_any tests size, word swap, masks, signed, float and scale for every point it decodes
+// and hands the result back in a std::any.
+// Here those flags are template parameters so each kernel is straight line code,
+// select_decode_kernel picks the right one when the config is loaded and it is kept in map_struct::decode.
+// shift, scale, starting_bit_pos and the masks are still read from the item.
+//
+// the results match gcom_decode_any
+//    float                    f64  ( value / scale ) + shift
+//    unsigned / signed scaled f64  ( value / scale ) + shift
+//    unsigned                 u64  ( value + shift ) >> starting_bit_pos
+//    signed                   s64  ( value + shift ) >> starting_bit_pos
+
+#include <cstring>
+
+#include "gcom_config.h"
+
+template <int Size, bool WordSwap, bool Masks, bool Signed, bool Float, bool Scaled>
+u64 decode_kernel(const u16* raw16, const cfg::map_struct& item, DecodeValue& out) {
+    u64 raw_data;
+    u64 current_unsigned_val;
+    s64 current_signed_val = 0;
+    double current_float_val = 0.0;
+
+    if constexpr (Size == 1) {
+        raw_data = raw16[0];
+        current_unsigned_val = raw_data;
+    } else if constexpr (Size == 2) {
+        raw_data = (static_cast<u64>(raw16[0]) << 16) |
+                   (static_cast<u64>(raw16[1]) <<  0);
+        if constexpr (WordSwap)
+            current_unsigned_val = (static_cast<u64>(raw16[0]) <<  0) |
+                                   (static_cast<u64>(raw16[1]) << 16);
+        else
+            current_unsigned_val = raw_data;
+    } else {
+        raw_data = (static_cast<u64>(raw16[0]) << 48) |
+                   (static_cast<u64>(raw16[1]) << 32) |
+                   (static_cast<u64>(raw16[2]) << 16) |
+                   (static_cast<u64>(raw16[3]) <<  0);
+        if constexpr (WordSwap)
+            current_unsigned_val = (static_cast<u64>(raw16[0]) <<  0) |
+                                   (static_cast<u64>(raw16[1]) << 16) |
+                                   (static_cast<u64>(raw16[2]) << 32) |
+                                   (static_cast<u64>(raw16[3]) << 48);
+        else
+            current_unsigned_val = raw_data;
+    }
+
+    if constexpr (Masks) {
+        current_unsigned_val ^= item.invert_mask;
+        current_unsigned_val &= item.care_mask;
+    }
+
+    // reinterpret, signed wins over float and size 1 is never float
+    if constexpr (Signed) {
+        if constexpr (Size == 1) {
+            int16_t to_reinterpret;
+            uint16_t bits = static_cast<uint16_t>(current_unsigned_val);
+            memcpy(&to_reinterpret, &bits, sizeof(to_reinterpret));
+            current_signed_val = to_reinterpret;
+        } else if constexpr (Size == 2) {
+            int32_t to_reinterpret;
+            uint32_t bits = static_cast<uint32_t>(current_unsigned_val);
+            memcpy(&to_reinterpret, &bits, sizeof(to_reinterpret));
+            current_signed_val = to_reinterpret;
+        } else {
+            memcpy(&current_signed_val, &current_unsigned_val, sizeof(current_signed_val));
+        }
+    } else if constexpr (Float && Size == 2) {
+        float to_reinterpret;
+        uint32_t bits = static_cast<uint32_t>(current_unsigned_val);
+        memcpy(&to_reinterpret, &bits, sizeof(to_reinterpret));
+        current_float_val = to_reinterpret;
+    } else if constexpr (Float && Size == 4) {
+        memcpy(&current_float_val, &current_unsigned_val, sizeof(current_float_val));
+    }
+
+    // scale and shift
+    if constexpr (Float) {
+        if constexpr (Scaled)
+            current_float_val /= item.scale;
+        current_float_val += static_cast<double>(item.shift);
+        out.set(current_float_val);
+    } else if constexpr (Scaled) {
+        double scaled;
+        if constexpr (Signed)
+            scaled = static_cast<double>(current_signed_val) / item.scale;
+        else
+            scaled = static_cast<double>(current_unsigned_val) / item.scale;
+        out.set(scaled + static_cast<double>(item.shift));
+    } else if constexpr (Signed) {
+        current_signed_val += item.shift;
+        current_signed_val >>= item.starting_bit_pos;
+        out.set(current_signed_val);
+    } else {
+        current_unsigned_val += item.shift;
+        current_unsigned_val >>= item.starting_bit_pos;
+        out.set(current_unsigned_val);
+    }
+    return raw_data;
+}
+
+// pick the kernel for the item flags, call again if the flags change
+cfg::DecodeFn select_decode_kernel(const cfg::map_struct& item);
+
+// decode one item, falls back to picking a kernel for items that never went through the config load
+inline u64 decode_item(const u16* raw16, const cfg::map_struct& item, DecodeValue& out) {
+    auto decode = item.decode ? item.decode : select_decode_kernel(item);
+    return decode(raw16, item, out);
+}
+
+#endif
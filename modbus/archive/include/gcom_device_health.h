@@ -0,0 +1,106 @@
+#ifndef GCOM_DEVICE_HEALTH_H
+#define GCOM_DEVICE_HEALTH_H
+
+// gcom_device_health.h
+// per device connection health, adaptive poll rates and bad register quarantine
+//
+// the response thread records every finished transaction against its device_id
+//    rtt             ewma of tRun for the good transactions
+//    timeout_rate    ewma of the link failures ( timeouts, resets, no connection )
+//    exception_rate  ewma of the modbus exceptions
+// a device goes Sick after fails_sick failures in a row or once its timeout rate is past half.
+// the pub timers then only poll it every 1 << backoff cycles, the backoff grows with each
+// failure and halves with each good transaction. io threads give a Sick device one try and a
+// Degraded one two, so the healthy devices sharing those threads keep their pub cadence.
+//
+// an illegal data address exception on a poll starts a probe of that span. The span is split
+// in two and both halves go out as probe work, halves that fail are split again until the
+// single bad registers are left. Those go into the bad_regs of the reg_struct that declares
+// them ( the poll planner routes around them ) for a hold time. When the hold is up the
+// register is probed on its own, good releases it, bad doubles the hold.
+// one probe runs per device at a time.
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "gcom_config.h"
+#include "gcom_iothread.h"
+
+enum class DeviceState {
+    Healthy,
+    Degraded,
+    Sick
+};
+
+struct DeviceStats {
+    double rtt = 0.0;
+    double timeout_rate = 0.0;
+    double exception_rate = 0.0;
+    u64 transactions = 0;
+    u64 timeouts = 0;
+    u64 exceptions = 0;
+    int fails_in_row = 0;
+    int backoff = 0;
+    DeviceState state = DeviceState::Healthy;
+};
+
+struct Quarantine {
+    int device_id;
+    cfg::Register_Types reg_type;
+    double tUntil;   // probe again after this
+    double hold;     // seconds, doubles each time the probe fails
+    bool probing = false;
+};
+
+class DeviceHealth {
+public:
+    using QueueFn = std::function<bool(IO_WorkHandle)>;
+
+    DeviceHealth();
+
+    // a finished transaction, not a probe
+    void record(const IO_Work& io_work, double tNow);
+    // a finished probe, the caller releases the work
+    void probe_done(const IO_Work& io_work, double tNow);
+
+    // asked once per device per pub cycle of comp
+    bool should_poll(cfg::comp_struct* comp, int device_id);
+    // how many times an io thread tries a transaction for this device
+    int max_tries(int device_id, int max_io_tries);
+    // probe the quarantined registers whose hold is up
+    void reprobe(double tNow);
+    // the config was reloaded, the reg_structs are gone
+    void clear();
+
+    DeviceStats stats(int device_id);
+    bool is_quarantined(cfg::reg_struct* reg, int offset);
+    void show();
+
+    // probes go out through this, pollWork unless a test swaps it
+    QueueFn queue;
+
+    static const char* state_name(DeviceState state);
+
+private:
+    void update_state(DeviceStats& dev);
+    void split_probe(const IO_Work& io_work, std::vector<IO_WorkHandle>& probes);
+    IO_WorkHandle make_probe(int device_id, cfg::Register_Types reg_type, int offset, int num,
+                             const std::vector<cfg::reg_struct*>& regs, double tNow);
+    void quarantine_reg(const IO_Work& io_work, double tNow);
+    void push_bad_regs(cfg::reg_struct* reg);
+    void send(std::vector<IO_WorkHandle>& probes);
+
+    std::mutex mtx;
+    std::map<int, DeviceStats> devices;
+    std::map<std::pair<cfg::comp_struct*, int>, u64> cycles;
+    std::map<int, int> probes_out;   // device_id -> probes in flight
+    std::map<cfg::reg_struct*, std::map<int, Quarantine>> quarantine;
+};
+
+extern DeviceHealth deviceHealth;
+
+int test_device_health();
+
+#endif
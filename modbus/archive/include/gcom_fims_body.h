@@ -0,0 +1,84 @@
+#ifndef GCOM_FIMS_BODY_H
+#define GCOM_FIMS_BODY_H
+
+// gcom_fims_body.h
+// decode the body of an incoming fims set straight onto its map items
+//
+// gcom_parse_data makes a new dom parser for every message and turns the whole body into a
+// std::map<std::string, std::any> before any key gets looked up.
+// FimsBodyDecoder keeps one On-Demand parser per thread, so its buffers only get allocated while
+// the bodies keep growing, and makes one pass over the body resolving each key against the uri's
+// items as it goes. Values come out typed, to_any() is there for encode_map_struct.
+
+#include <any>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <simdjson.h>
+
+#include "gcom_config.h"
+
+// a value from a set body, bare or clothed as {"value": x}
+struct SetValue {
+    enum class Kind : uint8_t {
+        None,
+        Bool,
+        Int,
+        Float,
+        String
+    };
+    Kind kind = Kind::None;
+    union {
+        bool b;
+        s64 i;
+        double f;
+    };
+    std::string s;
+
+    SetValue() : i(0) {}
+    void set(bool v)   { kind = Kind::Bool;  b = v; }
+    void set(s64 v)    { kind = Kind::Int;   i = v; }
+    void set(double v) { kind = Kind::Float; f = v; }
+    void set(std::string_view v) { kind = Kind::String; s.assign(v); }
+
+    // same types extractJsonValue puts in its std::any
+    std::any to_any() const {
+        switch (kind) {
+            case Kind::Bool:   return b;
+            case Kind::Int:    return i;
+            case Kind::Float:  return f;
+            case Kind::String: return s;
+            default:           return std::any();
+        }
+    }
+};
+
+class FimsBodyDecoder {
+public:
+    using Items = std::map<std::string, std::shared_ptr<cfg::map_struct>>;
+    using Result = std::vector<std::pair<std::shared_ptr<cfg::map_struct>, SetValue>>;
+
+    // the decoder for the calling thread
+    static FimsBodyDecoder& local();
+
+    // a single item set
+    bool decode_single(const char* body, size_t len, SetValue& out);
+
+    // a multi item set {"id": x, "id2": {"value": y}}, keys with no item ( or no usable value )
+    // are skipped and counted in missing
+    bool decode_multi(const char* body, size_t len, const Items& items, Result& result, int* missing = nullptr);
+
+private:
+    bool iterate(const char* body, size_t len);
+
+    simdjson::ondemand::parser parser;
+    simdjson::ondemand::document doc;
+    std::string buf;    // padded copy of the body
+    std::string key;    // item lookup scratch
+};
+
+int bench_fims_set(int loops);
+
+#endif
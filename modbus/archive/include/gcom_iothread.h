@@ -7,75 +7,44 @@
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <memory>
 
 //#include "rigtorp/SPSCQueue.h"
-//#include "rigtorp/MPMCQueue.h"
+#include "gcom_channel.h"
 
 //#include "semaphore.hpp" // Linux semaphore wrapper with helper functions (use PCQ_Semaphore)
 
 #include "shared_utils.hpp"
+#include "simple_arena.hpp"
 #include "gcom_config.h"
 
 #define NEW_FPS_ERROR_PRINT(fmt_str, ...)            fmt::print(stderr, FMT_COMPILE(fmt_str), ##__VA_ARGS__)
 #define NEW_FPS_ERROR_PRINT_NO_COMPILE(fmt_str, ...) fmt::print(stderr, fmt_str, ##__VA_ARGS__) 
 #define NEW_FPS_ERROR_PRINT_NO_ARGS(fmt_str)         fmt::print(stderr, FMT_COMPILE(fmt_str))
 // Channel definition
+// the io channels are bounded lock free queues with a futex wakeup (see gcom_channel.h)
 template <typename T>
-class ioChannel {
-private:
-    std::queue<T> queue;
-    std::mutex mtx;
-    std::condition_variable cv;
+using ioChannel = lfChannel<T>;
 
-public:
-    void send(T&& message) {
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            queue.emplace(std::move(message));
-        }
-        cv.notify_one();
-    }
 
-    bool receive(T& message) {
-        std::unique_lock<std::mutex> lock(mtx);
-        while (queue.empty()) {
-            cv.wait(lock);
-        }
+struct IO_Work;
+class MapIndex;
 
-        message = std::move(queue.front());
-        queue.pop();
-        return true;
-    }
+// intrusive handle to an IO_Work held in the ioWorkPool
+// there is no ref count, the work belongs to whichever stage holds it
+// ( pub timer -> io thread -> response thread ) and goes back with ioWorkPool.release()
+struct IO_WorkHandle {
+    IO_Work* ptr = nullptr;
 
-    bool receive(T& message, double durationInSeconds) {
-        std::unique_lock<std::mutex> lock(mtx);
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>(durationInSeconds));
-        if (cv.wait_for(lock, duration, [this] { return !queue.empty(); })) {
-            message = std::move(queue.front());
-            queue.pop();
-            return true;
-        }
-        return false; // timed out without receiving a message
-    }
+    IO_WorkHandle() = default;
+    IO_WorkHandle(std::nullptr_t) {}
+    explicit IO_WorkHandle(IO_Work* p) : ptr(p) {}
 
-    bool receive(T& message, const std::chrono::seconds& duration) {
-        std::unique_lock<std::mutex> lock(mtx);
-        if (cv.wait_for(lock, duration, [this] { return !queue.empty(); })) {
-            message = std::move(queue.front());
-            queue.pop();
-            return true;
-        }
-        return false; // timed out without receiving a message
-    }
-    bool peekpop(T& message) {
-        std::unique_lock<std::mutex> lock(mtx);
-        if (!queue.empty()) {
-            message = std::move(queue.front());
-            queue.pop();
-            return true;
-        }
-        return false;
-    }
+    IO_Work* get() const { return ptr; }
+    IO_Work* operator->() const { return ptr; }
+    IO_Work& operator*() const { return *ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+    void reset() { ptr = nullptr; }
 };
 
 
@@ -98,9 +67,15 @@ struct IO_Work {
     int num_registers;
     std::vector<int> disabled_registers;
 
-    std::vector<std::shared_ptr<struct cfg::map_struct>> items;
-    std::shared_ptr<struct cfg::reg_struct> reg_map;
-    std::shared_ptr<struct cfg::comp_struct> comp_map;
+    // none of these are owned, mindex below keeps them alive while the work is in flight
+    std::vector<struct cfg::map_struct*> items;
+    struct cfg::reg_struct* reg_map = nullptr;
+    struct cfg::comp_struct* comp_map = nullptr;
+    // a planned poll can span several register blocks, decode walks each of these
+    std::vector<struct cfg::reg_struct*> reg_maps;
+    // the index current when the work was made, it holds the comps so a reload
+    // that swaps in a new one can't free the items and regs above under us
+    std::shared_ptr<const MapIndex> mindex;
 
 
     double tStart;
@@ -125,7 +100,32 @@ struct IO_Work {
     //     return *this;
     // };
 
-    ioChannel<std::shared_ptr<IO_Work>>* io_repChan;  // Thread picks up IO_work and processes it
+    ioChannel<IO_WorkHandle>* io_repChan;  // Thread picks up IO_work and processes it
+
+    // a bit range set only owns these bits of buf16[0], see gcom_set_batch.h
+    u16 set_mask = 0xffff;
+    // a merged set write, the sets it carries get its result
+    std::vector<IO_WorkHandle> batched;
+    // a bad register probe from DeviceHealth ( gcom_device_health.h ), not part of a pub
+    bool probe = false;
+
+    // the pool calls this on release, vectors keep their capacity
+    void reset() {
+        items.clear();
+        disabled_registers.clear();
+        reg_map = nullptr;
+        comp_map = nullptr;
+        reg_maps.clear();
+        mindex.reset();
+        io_repChan = nullptr;
+        set_mask = 0xffff;
+        batched.clear();
+        probe = false;
+        errors = 0;
+        errno_code = 0;
+        test_mode = false;
+        test_it = false;
+    }
 
     void clear_bufs() {
         memset(buf8, 0, sizeof(buf8));    // Set buf8 to 0
@@ -151,9 +151,52 @@ struct IO_Work {
 
 
 
+// fixed set of IO_Work slots carved out of a Simple_Arena at startup
+// the free list is a lock free queue of slot pointers so acquire/release never malloc
+// if the pool runs dry we fall back to the heap and count a miss
+struct IO_WorkPoolStats {
+    u64 hits;
+    u64 misses;
+    u64 in_use;
+    u64 high_water;
+    u64 capacity;
+};
+
+class IO_WorkPool {
+public:
+    ~IO_WorkPool();
+
+    bool init(size_t num_works);
+    bool is_init() const { return slots != nullptr; }
+
+    IO_WorkHandle acquire();
+    void release(IO_WorkHandle io_work);
+
+    IO_WorkPoolStats stats() const;
+    void reset_stats();
+
+private:
+    bool is_pooled(const IO_Work* io_work) const {
+        return io_work >= slots && io_work < slots + capacity;
+    }
+
+    Simple_Arena arena;
+    IO_Work* slots = nullptr;
+    size_t capacity = 0;
+    std::unique_ptr<rigtorp::MPMCQueue<IO_Work*>> free_list;
+
+    std::atomic<u64> hits{0};
+    std::atomic<u64> misses{0};
+    std::atomic<u64> in_use{0};
+    std::atomic<u64> high_water{0};
+};
+
+extern IO_WorkPool ioWorkPool;
+
+
 struct PubGroup {
     std::string key;
-    std::vector<std::shared_ptr<IO_Work>> works;
+    std::vector<IO_WorkHandle> works;
     int work_group;  // size
     double tNow;
     bool done=false;
@@ -162,6 +205,8 @@ struct PubGroup {
 
 struct ThreadControl;
 
+class MbPipeline;
+
 struct IO_Thread {
     alignas(64) modbus_t* ctx = nullptr;
     //xMain_Thread* main_work;
@@ -185,11 +230,15 @@ struct IO_Thread {
     double connect_time;
     double cTime; // TODO deprecatd
 
+    // connection.pipeline_depth > 1 runs this thread with the pipelined engine ( gcom_pipeline.h )
+    int pipeline_depth = 0;
+    MbPipeline* pipe = nullptr;
+
 };
 
-std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
-bool pollWork (std::shared_ptr<IO_Work> io_work);
-bool setWork (std::shared_ptr<IO_Work> io_work);
+IO_WorkHandle make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
+bool pollWork (IO_WorkHandle io_work);
+bool setWork (IO_WorkHandle io_work);
 
 
 #endif
@@ -0,0 +1,86 @@
+#ifndef GCOM_MAP_INDEX_H
+#define GCOM_MAP_INDEX_H
+
+// gcom_map_index.h
+// flat map item lookup built once per config load
+//
+// reg_struct::mapix is a std::map of shared_ptrs, every lookup in the response thread walks a tree
+// and bumps a refcount. MapIndex flattens the loaded config into
+//    items    every map item as a raw pointer, the roots then the packed bit ranges.
+//             the position in items is the item's point_id
+//    blocks   one per reg_struct, a dense array over its register range holding the item index
+//             at each item's first register and -1 everywhere else
+//    ids      ( device_id, reg_type, offset ) sorted for a binary search, replaces cfg::idMap
+//
+// a MapIndex never changes once built. gcom_load_cfg_file builds a new one and swaps it in,
+// readers take the current one with map_index() and keep it for the length of their work so a
+// reload can't pull the items out from under them. The snapshot holds the components alive.
+// the index also carries the PointStore for its items, that one is written by the io threads,
+// the UriRouter for the fims uris ( gcom_uri_router.h ) and the PubLayout for the pubs ( gcom_pub_layout.h ).
+
+#include <memory>
+#include <vector>
+
+#include "gcom_config.h"
+#include "gcom_point_store.h"
+#include "gcom_pub_layout.h"
+#include "gcom_uri_router.h"
+
+class MapIndex {
+public:
+    struct Block {
+        const cfg::reg_struct* reg = nullptr;
+        int base = 0;                  // register offset of slots[0]
+        std::vector<int32_t> slots;    // index into items or -1
+        size_t regs_at = 0;            // where slots[0]'s register sits in PointStore::regs
+    };
+
+    struct IdKey {
+        int device_id;
+        cfg::Register_Types reg_type;
+        int offset;
+        int32_t item;
+
+        bool operator<(const IdKey& b) const {
+            if (device_id != b.device_id)
+                return device_id < b.device_id;
+            if (reg_type != b.reg_type)
+                return reg_type < b.reg_type;
+            return offset < b.offset;
+        }
+    };
+
+    static std::shared_ptr<const MapIndex> build(const cfg& myCfg);
+
+    // nullptr if the reg_struct was not part of this load
+    const Block* block(const cfg::reg_struct* reg) const;
+
+    // the item starting at offset in reg, nullptr if none
+    const cfg::map_struct* find(const cfg::reg_struct* reg, int offset) const;
+
+    // the item for a device / type / offset, nullptr if none
+    const cfg::map_struct* find_id(int device_id, cfg::Register_Types reg_type, int offset) const;
+
+    std::vector<cfg::map_struct*> items;
+    std::vector<Block> blocks;
+    std::vector<IdKey> ids;
+    std::shared_ptr<PointStore> points;
+    UriRouter router;
+    PubLayout pubs;
+
+    // nullptr if the item has no point in this load
+    PointStore* store(const cfg::map_struct& item) const {
+        return item.point_id >= 0 && item.point_id < (int32_t)items.size()
+            && items[item.point_id] == &item ? points.get() : nullptr;
+    }
+
+private:
+    std::vector<std::pair<const cfg::reg_struct*, int>> by_reg;   // sorted, reg_struct -> blocks index
+    std::vector<std::shared_ptr<cfg::comp_struct>> comps;   // keeps the items alive
+};
+
+// the current index, may be nullptr before the first config load
+std::shared_ptr<const MapIndex> map_index();
+void map_index_swap(std::shared_ptr<const MapIndex> index);
+
+#endif
@@ -1,65 +1,142 @@
 #ifndef GCOM_PERF_H
 #define GCOM_PERF_H
 
-#include <string>
-#include <map>
+// gcom_perf.h
+// timing histograms for the _timings / _reset_timings uris
+//
+// a label is interned to a PerfId once, hot code keeps the id in a static.
+// every thread records into its own PerfHist per id, a log linear histogram of nanoseconds
+// ( HDR style, 64 linear buckets per power of two so a percentile is within 1.6% ).
+// the counters are only written by their own thread, a relaxed load and store, no locked
+// instructions and no shared cache lines on the hot path.
+// a reader merges the threads under the registry mutex. _reset_timings keeps the merged counts
+// as a base and later reads subtract it, the writers never get touched.
+
+#include <atomic>
+#include <cstdint>
 #include <limits>
-#include <queue>
+#include <map>
 #include <mutex>
-#include <condition_variable>
+#include <string>
 #include <vector>
-#include <atomic>
 
-// std::atomic<bool> terminate_thread(false);
-// std::condition_variable termination_cv; // Condition variable for thread termination
+using PerfId = int32_t;
+
+struct PerfHist {
+    static constexpr int Sub_Bits = 7;
+    static constexpr int Sub_Count = 1 << Sub_Bits;    // the first 128 ns are exact
+    static constexpr int Half = Sub_Count / 2;
+    static constexpr int Max_Exp = 34;                 // 2^41 ns, about 36 minutes
+    static constexpr int Num_Buckets = Sub_Count + Max_Exp * Half;
+    static constexpr uint64_t Max_Value = (uint64_t(1) << (Max_Exp + Sub_Bits)) - 1;
+
+    static int index(uint64_t ns) {
+        if (ns < (uint64_t)Sub_Count)
+            return (int)ns;
+        if (ns > Max_Value)
+            ns = Max_Value;
+        int exp = 63 - __builtin_clzll(ns) - (Sub_Bits - 1);
+        return Sub_Count + (exp - 1) * Half + (int)((ns >> exp) - Half);
+    }
+    // the highest value that lands in a bucket
+    static uint64_t value(int idx) {
+        if (idx < Sub_Count)
+            return idx;
+        int exp = (idx - Sub_Count) / Half + 1;
+        uint64_t sub = (idx - Sub_Count) % Half + Half;
+        return ((sub + 1) << exp) - 1;
+    }
+
+    PerfHist() {
+        for (auto& count : counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+
+    // owner thread only
+    void record(uint64_t ns) {
+        auto& count = counts[index(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        total_ns.store(total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts[Num_Buckets];
+    std::atomic<uint64_t> total_ns{0};
+};
 
-void* record_thread_func(void* arg);
-// pthread_t recordThread;
-// bool perf_running = false;
+// merged counts of one id
+struct PerfSnap {
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
 
+    // q in 0 .. 1, ns
+    uint64_t percentile(double q) const;
+    uint64_t max() const;
+};
 
+class PerfRegistry {
+public:
+    static constexpr int Max_Ids = 256;
 
-// Forward declarations
-class Stats;
-class Perf;
-class RecordQueue;
+    static PerfRegistry& get();
 
-// Constants
-const size_t BATCH_SIZE = 10;
+    // the id for a label, the same label always gets the same id. -1 once Max_Ids are in use
+    PerfId intern(const std::string& label);
 
-// Record structure used in RecordQueue
+    void record(PerfId id, uint64_t ns) {
+        if (id < 0 || id >= Max_Ids)
+            return;
+        auto& slot = local().hists[id];
+        auto hist = slot.load(std::memory_order_acquire);
+        if (!hist)
+            hist = add_hist(slot);
+        hist->record(ns);
+    }
+    void record_secs(PerfId id, double secs) {
+        record(id, secs > 0.0 ? (uint64_t)(secs * 1e9) : 0);
+    }
 
-class RecordQueue {
-public:
-    struct Record {
-        std::string label;
-        double duration;
+    // counts since the last reset
+    bool snapshot(PerfId id, PerfSnap& out);
+    void reset();
+
+    // {"label":{"count":n,"avg":x,"p50":x,"p90":x,"p99":x,"p999":x,"max":x}, ...} times in mS
+    std::string timings_json();
+
+private:
+    struct Local {
+        std::atomic<PerfHist*> hists[Max_Ids];
+        Local() {
+            for (auto& hist : hists)
+                hist.store(nullptr, std::memory_order_relaxed);
+        }
     };
 
-    //RecordQueue();
+    Local& local();
+    PerfHist* add_hist(std::atomic<PerfHist*>& slot);
+    void merge(PerfId id, PerfSnap& out);
 
-    void push(const std::string& label, double duration);
-    bool pop(std::vector<Record>& records_batch);
-    bool try_pop(std::vector<Record>& records_batch);
-    void flush();
-    std::queue<std::vector<Record>> batches;
     std::mutex mtx;
-    std::condition_variable cv;
-
-private:
-    std::vector<Record> batch;
+    std::map<std::string, PerfId> ids;
+    std::vector<std::string> labels;
+    // a thread's histograms stay here when it exits, its counts are still in the totals
+    std::vector<Local*> threads;
+    std::vector<PerfSnap> base;
 };
 
+// times its scope, or start() to snap()
 class Perf {
 public:
-    Perf(const std::string& label);
+    explicit Perf(PerfId id);
+    // interns the label, a map lookup under the registry mutex. use the PerfId one in hot code
+    explicit Perf(const std::string& label);
     ~Perf();
 
     void start();
     void snap();
 
 private:
-    std::string label;
+    PerfId id;
     double start_time;
     bool closed;
 };
@@ -67,6 +144,7 @@ private:
 struct Stats {
     double start_time;
     std::string label;
+    PerfId id = -1;
     double max_duration = 0.0;
     double min_duration = std::numeric_limits<double>::max();
     double total_duration = 0.0;
@@ -77,13 +155,13 @@ struct Stats {
     void clear();
     void show();
 
+    // also goes into the label's histogram
     void record_duration(double duration);
     bool started = false;
 };
 
 double get_time_double();
 
-void run_perf();
-void* record_thread_func(void* arg);
+int test_perf();
 
 #endif // GCOM_PERF_H
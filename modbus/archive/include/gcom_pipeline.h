@@ -0,0 +1,129 @@
+#ifndef GCOM_PIPELINE_H
+#define GCOM_PIPELINE_H
+
+// gcom_pipeline.h
+// pipelined modbus tcp client
+//
+// libmodbus does one request / response at a time on a ctx so a 20mS round trip caps
+// an io_thread at ~50 transactions a second.
+// MbPipeline owns its own socket and keeps up to "depth" requests in flight.
+// Replies are matched to requests by the MBAP transaction id.
+// The low bits of the transaction id are the slot number and the high bits a generation count
+// so a late reply for a slot that has since been reused does not match and is dropped.
+//
+// completed io_works come back with the same errors / errno_code values runThreadWork gets from libmodbus
+//    errors > 0                             number of registers / bits read or written
+//    errors -1 errno_code ETIMEDOUT         no reply inside the transaction timeout
+//    errors -1 errno_code MODBUS_ENOBASE+n  modbus exception n from the server
+//    errors -1 errno_code EMBBADDATA        reply did not match the request
+//    errors -1 errno_code ECONNRESET        the connection dropped with this request in flight
+//
+// the server has to accept more than one outstanding request for this to help,
+// a server that serializes requests still works but the gain is lost.
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#include <modbus/modbus.h>
+#include "gcom_iothread.h"
+
+#define MB_PIPELINE_MAX_DEPTH 64
+
+struct MbTxn {
+    uint16_t tid = 0;
+    uint8_t fc = 0;
+    bool busy = false;
+    double tSent = 0.0;
+    double deadline = 0.0;
+    IO_WorkHandle io_work;
+};
+
+struct MbPipelineStats {
+    u64 sent = 0;
+    u64 received = 0;
+    u64 timeouts = 0;
+    u64 late = 0;
+    u64 exceptions = 0;
+    u64 bad_frames = 0;
+};
+
+class MbPipeline {
+public:
+    MbPipeline(int depth, double timeout);
+    ~MbPipeline();
+
+    // blocking connect with a timeout, the socket is non blocking after that
+    bool open(const std::string& ip, int port, double connect_timeout);
+    // non blocking connect for an event loop, wait for the socket to be writable then call connect_finish
+    bool connect_start(const std::string& ip, int port);
+    bool connect_finish();
+    void close();
+    bool is_open() const { return fd >= 0 && !connecting; }
+    bool is_connecting() const { return connecting; }
+    int socket_fd() const { return fd; }
+
+    // encode and send one request
+    // false means the io_work was not taken, errors is -1 and errno_code says why
+    //    EAGAIN the window is full, EINVAL the request can't be encoded,
+    //    anything else is the socket error and the connection has been closed
+    bool submit(IO_WorkHandle io_work, double tNow);
+
+    // read replies for up to wait seconds and expire overdue transactions
+    // completed io_works are appended to done, returns the number added
+    // a dropped connection fails everything in flight and closes the socket
+    int poll(std::vector<IO_WorkHandle>& done, double wait);
+
+    // the event loop version of poll, read if readable then expire anything past its deadline
+    int service(std::vector<IO_WorkHandle>& done, bool readable, double tNow);
+    // earliest deadline in flight, DBL_MAX if none
+    double next_deadline() const;
+
+    // fail everything in flight with errno_code err
+    int fail_all(std::vector<IO_WorkHandle>& done, int err);
+
+    int in_flight() const { return num_busy; }
+    bool full() const { return num_busy >= depth; }
+
+    int depth;
+    double timeout;
+    MbPipelineStats stats;
+
+private:
+    int encode(IO_Work* io_work, uint16_t tid, uint8_t* frame);
+    bool decode(MbTxn& txn, const uint8_t* pdu, int pdu_len);
+    void complete(MbTxn& txn, std::vector<IO_WorkHandle>& done);
+    bool send_all(const uint8_t* data, int len);
+
+    int fd = -1;
+    bool connecting = false;
+    int num_busy = 0;
+    int slot_mask;
+    int slot_bits;
+    uint16_t generation = 0;
+    std::vector<MbTxn> slots;
+
+    uint8_t rxbuf[MODBUS_TCP_MAX_ADU_LENGTH * 8];
+    int rxlen = 0;
+};
+
+// in process modbus tcp server for bench_pipeline / bench_reactor
+// every client connection acts as one device, replies are delayed by rtt
+struct MockMbServer {
+    bool start(double rtt);
+    void stop();
+
+    int port = 0;
+    double rtt = 0.0;
+
+private:
+    void run();
+
+    int listen_fd = -1;
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+#endif
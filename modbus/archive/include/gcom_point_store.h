@@ -0,0 +1,82 @@
+#ifndef GCOM_POINT_STORE_H
+#define GCOM_POINT_STORE_H
+
+// gcom_point_store.h
+// runtime state of the map items kept as columns
+//
+// map_struct is mostly config, strings, vectors and shared_ptrs, a few hundred bytes an item.
+// the values that change every poll used to sit in the middle of it so a debounce pass or a
+// publish walked one cache line of state per several lines of config.
+// PointStore holds that state as one array per field indexed by map_struct::point_id.
+// point ids are handed out by MapIndex::build ( gcom_map_index.h ) and the store travels with
+// the index, so a reader that took map_index() has items and state from the same load.
+//
+// for connection.pub_on_change the store also keeps a snapshot of every mapped register block.
+// diff_regs compares a fresh read against it, only the items over changed registers get decoded,
+// and pub_check applies the item debounce and deadband before a point goes out.
+
+#include <cstdint>
+#include <vector>
+
+#include "gcom_config.h"
+
+class PointStore {
+public:
+    explicit PointStore(size_t num_points = 0) { resize(num_points); }
+
+    void resize(size_t num_points);
+    size_t size() const { return raw_val.size(); }
+
+    // copy the bits of config the scans need, clears the runtime state
+    void init(int32_t pid, const cfg::map_struct& item);
+
+    // a new decoded value, the current one moves to last_
+    void set_value(int32_t pid, u64 raw, const DecodeValue& val);
+    void set_value(int32_t pid, const DecodeValue& val);
+    DecodeValue get_value(int32_t pid) const;
+
+    // the debounce gate for one point, false while the point is held off
+    bool debounce_check(int32_t pid, double tNow);
+    // the same gate over a list of points, enabled[k] is cleared for any point held off
+    void debounce_scan(const int32_t* pids, size_t num, double tNow, u8* enabled);
+
+    // space for the register snapshots, MapIndex::Block::regs_at is the start of each block
+    void resize_regs(size_t num_regs);
+    // compare num registers of cur with the snapshot at regs_at and copy them in.
+    // sets bit k of changed ( ( num + 63 ) / 64 words ) when register k differs or was never read,
+    // returns the number of changed registers
+    size_t diff_regs(size_t regs_at, const u16* cur, size_t num, u64* changed);
+
+    // a changed point, false if debounce holds it off ( it stays pending ) or it is inside its deadband
+    bool pub_check(int32_t pid, double tNow);
+    // the point went out in a pub, deadband is measured from here
+    void published(int32_t pid) {
+        pub_val[pid] = float_val[pid];
+        pending[pid] = 0;
+    }
+
+    // "id": value  for each point, comma separated
+    void format(fmt::memory_buffer& buf, const std::vector<cfg::map_struct*>& items,
+                const int32_t* pids, size_t num) const;
+
+    std::vector<u64> raw_val;
+    std::vector<u64> last_raw_val;
+    std::vector<double> float_val;        // used in deadband
+    std::vector<double> last_float_val;   // used in deadband
+    std::vector<double> debounce_time;    // time when debounce is turned off
+    std::vector<u64> forced_val;
+
+    std::vector<u64> value;               // DecodeValue u / s / f bits
+    std::vector<DecodeValue::Kind> kind;
+    std::vector<double> debounce;         // map_struct::debounce, 0 when not in use
+    std::vector<double> deadband;         // map_struct::deadband, 0 when not in use
+    std::vector<double> pub_val;          // float_val when last published
+    std::vector<u8> pending;              // changed but held off by debounce
+
+    std::vector<u16> regs;                // register snapshots
+    std::vector<u16> regs_valid;          // 0xffff once a register has been read
+};
+
+int test_point_store();
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef GCOM_POLL_PLANNER_H
+#define GCOM_POLL_PLANNER_H
+
+// gcom_poll_planner.h
+// works out the modbus transactions needed to poll a component
+//
+// the old pub path sent one io_work per reg_struct and compact_io_works only joined
+// ranges that touched. This planner collects the mapped items of every register block
+// in a component, groups them by device_id and register type, and joins neighbours when
+//    the joined read stays inside the function code limit ( 125 regs / 2000 bits )
+//    none of the registers in between are in a bad_regs list
+//    the gap is inside the declaring register block or no bigger than connection.max_poll_gap
+//    reading the gap is cheaper than another round trip for that device
+//
+// the round trip cost is learned per device from completed io ( tRun vs num_registers )
+// plans are cached per comp_struct and rebuilt when the register config or bad_regs change
+// or when the device cost model has moved far enough to change the answer
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include "gcom_config.h"
+
+#define MAX_POLL_REGISTERS 125
+#define MAX_POLL_BITS      2000
+// IO_Work::buf8 holds one byte per bit so bit reads are also held to its size
+#define POLL_BUF_BITS      256
+
+// one modbus read
+struct PollSpan {
+    cfg::Register_Types reg_type;
+    int device_id;
+    int offset;
+    int num_registers;
+    int num_items;
+    // register blocks decoded from this read, not owned
+    std::vector<cfg::reg_struct*> regs;
+};
+
+struct PollPlan {
+    u64 sig = 0;
+    int max_gap = 0;
+    std::map<int, double> dev_gap_limit;  // device_id -> break even gap used for this plan
+    std::vector<PollSpan> spans;
+};
+
+// time = base_time + reg_time * num_registers
+// fitted with an exponentially weighted least squares so old samples fade out
+struct DeviceCost {
+    double base_time = 0.005;   // 5 mS a transaction until we know better
+    double reg_time  = 0.00002; // 20 uS a register
+    double sw = 0.0;
+    double sx = 0.0;
+    double sy = 0.0;
+    double sxx = 0.0;
+    double sxy = 0.0;
+    int samples = 0;
+
+    void record(int num_registers, double tRun);
+    // how many registers we can read for the price of one more transaction
+    double gap_limit() const;
+};
+
+class PollPlanner {
+public:
+    // get the (cached) plan for this component
+    // plans are replaced, never changed, so the caller can hold one across an invalidate or a rebuild
+    std::shared_ptr<const PollPlan> get_plan(cfg::comp_struct* comp, int max_gap);
+
+    // feed a completed transaction into the device cost model
+    void record_io(int device_id, cfg::Register_Types reg_type, int num_registers, double tRun);
+
+    // break even gap for a device
+    double gap_limit(int device_id);
+
+    // drop all cached plans, used when the config is reloaded
+    void invalidate();
+
+    // replace the quarantined registers of a block, the plans using it rebuild on their next get
+    void set_bad_regs(cfg::reg_struct* reg, const std::vector<int>& bad);
+
+    // the merge rule, shared with compact_io_works
+    static int max_span(cfg::Register_Types reg_type);
+    static bool can_merge(cfg::Register_Types reg_type, int span_start, int span_end,
+                          int next_start, int next_end, int max_gap, double gap_limit,
+                          const std::vector<int>& bad);
+
+    static u64 plan_sig(cfg::comp_struct* comp, int max_gap);
+    static void build_plan(PollPlan& plan, cfg::comp_struct* comp, int max_gap,
+                           const std::map<int, double>& gap_limits);
+
+    int rebuilds = 0;
+
+private:
+    bool plan_current(const PollPlan& plan, cfg::comp_struct* comp, int max_gap);
+
+    std::mutex plan_mtx;
+    std::map<cfg::comp_struct*, std::shared_ptr<const PollPlan>> plans;
+
+    std::mutex cost_mtx;
+    std::map<int, DeviceCost> costs;
+};
+
+extern PollPlanner pollPlanner;
+
+#endif
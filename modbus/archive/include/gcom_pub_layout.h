@@ -0,0 +1,75 @@
+#ifndef GCOM_PUB_LAYOUT_H
+#define GCOM_PUB_LAYOUT_H
+
+// gcom_pub_layout.h
+// pub bodies written straight into a reusable send buffer
+//
+// a pub group used to collect its values in a map of uri to a map of id to value, a string and
+// a tree node per point per poll, and build the uri string again for every item.
+// PubLayout is built with the MapIndex ( gcom_map_index.h ) and holds, per point id,
+//    uri      the  /comp_id/id  the point goes out on, an index into uris
+//    key      "id":  with its quotes and colon, all of them back to back in one string
+// PubWriter is per thread. processGroupCallback adds the point ids it decoded, flush writes one
+// body per uri into a thread local fmt::memory_buffer, key bytes copied and values formatted in
+// place, and hands it to the send callback. Once the buffers have grown nothing is allocated.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gcom_config.h"
+#include "gcom_point_store.h"
+
+class PubLayout {
+public:
+    // point ids must already be set, items is MapIndex::items
+    void build(const cfg& myCfg, const std::vector<cfg::map_struct*>& items);
+
+    std::string_view key(int32_t pid) const {
+        return std::string_view(keys.data() + key_at[pid], key_at[pid + 1] - key_at[pid]);
+    }
+
+    std::vector<std::string> uris;
+    std::vector<int32_t> uri_of;     // per point, -1 if the point is not published
+    std::string keys;
+    std::vector<uint32_t> key_at;    // one past the points, key_at[pid + 1] ends the key
+};
+
+class PubWriter {
+public:
+    using SendFn = std::function<void(std::string_view uri, std::string_view body)>;
+
+    // this thread's writer
+    static PubWriter& local();
+
+    void add(const PubLayout& layout, int32_t pid) {
+        int32_t uri = layout.uri_of[pid];
+        if (uri < 0)
+            return;
+        if ((size_t)uri >= by_uri.size())
+            by_uri.resize(layout.uris.size());
+        auto& pids = by_uri[uri];
+        if (pids.empty())
+            touched.push_back(uri);
+        pids.push_back(pid);
+    }
+
+    // {"id":value,...} for every uri with points added since the last flush, in the order they
+    // were added. the points are marked published
+    void flush(const PubLayout& layout, PointStore& points, const SendFn& send);
+
+    static void append_value(fmt::memory_buffer& buf, const DecodeValue& val);
+    static void append_value(fmt::memory_buffer& buf, const PointStore& points, int32_t pid);
+
+    fmt::memory_buffer buf;
+
+private:
+    std::vector<std::vector<int32_t>> by_uri;
+    std::vector<int32_t> touched;
+};
+
+int bench_pub(int num_points);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef GCOM_REACTOR_H
+#define GCOM_REACTOR_H
+
+// gcom_reactor.h
+// epoll io reactor, the alternative to one io_thread per connection
+//
+// StartThreads normally runs one ioThreadFunc per connection and each one blocks inside libmodbus.
+// With connection.reactor_threads > 0 the connections are spread over that many MbReactor loops
+// instead. Each loop drives its sockets with epoll using MbPipeline ( gcom_pipeline.h ) for the framing:
+//    non blocking connect
+//    a deadline per request
+//    reconnect with an exponential backoff
+//
+// work still comes in on io_setChan / io_pollChan and goes back on io_responseChan so
+// pollWork() / setWork() callers do not change.
+// A work for a device_id that has its own connection is passed to the loop that owns it,
+// anything else goes to the least loaded connection of the loop that picked it up.
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gcom_iothread.h"
+#include "gcom_pipeline.h"
+
+class MbReactorGroup;
+
+struct ReactorConn {
+    int idx;
+    std::string ip;
+    int port;
+    int device_id;       // -1 for any device
+    MbPipeline pipe;
+    std::deque<IO_WorkHandle> pending;   // waiting for a window slot or the connect
+    double tRetry = 0.0;
+    double backoff = 0.0;
+    int timeouts = 0;
+    u64 connects = 0;
+
+    ReactorConn(int depth, double timeout) : pipe(depth, timeout) {}
+};
+
+struct MbReactorStats {
+    u64 jobs = 0;
+    u64 fails = 0;
+    u64 connects = 0;
+    u64 wakeups = 0;
+    double cpu_time = 0.0;
+};
+
+class MbReactor {
+public:
+    MbReactor(int id, MbReactorGroup* group);
+    ~MbReactor();
+
+    int add_connection(const std::string& ip, int port, int depth, double timeout, int device_id);
+    bool start();
+    void stop();
+
+    // called by producers after they queue work, only makes a syscall if the loop is asleep
+    void wake();
+
+    int id;
+    ioChannel<IO_WorkHandle> inbox;   // work handed over by another loop
+    MbReactorStats stats;
+    std::vector<std::unique_ptr<ReactorConn>> conns;
+
+private:
+    void run();
+    void connect(ReactorConn& conn, double tNow);
+    void conn_down(ReactorConn& conn, double tNow, std::vector<IO_WorkHandle>& done);
+    void route(IO_WorkHandle io_work, double tNow, std::vector<IO_WorkHandle>& done);
+    void send_pending(ReactorConn& conn, double tNow, std::vector<IO_WorkHandle>& done);
+    void check_timeouts(ReactorConn& conn, std::vector<IO_WorkHandle>& done, size_t first, double tNow);
+    void finish(std::vector<IO_WorkHandle>& done);
+    bool has_input();
+
+    MbReactorGroup* group;
+    int epfd = -1;
+    int evfd = -1;
+    int load = 0;
+    int capacity = 0;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<bool> sleeping{false};
+};
+
+class MbReactorGroup {
+public:
+    ~MbReactorGroup();
+
+    // set up num_loops reactors reading the given channels
+    bool init(int num_loops, ioChannel<IO_WorkHandle>* setChan, ioChannel<IO_WorkHandle>* pollChan,
+              ioChannel<IO_WorkHandle>* respChan);
+    // connections are dealt out round robin, device_id >= 0 pins that device to this connection
+    int add_connection(const std::string& ip, int port, int depth, double timeout, int device_id = -1);
+    bool start();
+    void stop();
+    void wake();
+    bool is_running() const { return running; }
+    void show_stats();
+
+    // -1 if the device has no connection of its own
+    int route_loop(int device_id) const;
+    int route_conn(int device_id) const;
+
+    ioChannel<IO_WorkHandle>* setChan = nullptr;
+    ioChannel<IO_WorkHandle>* pollChan = nullptr;
+    ioChannel<IO_WorkHandle>* respChan = nullptr;
+    std::vector<std::unique_ptr<MbReactor>> loops;
+
+private:
+    std::vector<std::pair<int, int>> routes;   // device_id -> loop, conn
+    int next_loop = 0;
+    bool running = false;
+};
+
+#endif
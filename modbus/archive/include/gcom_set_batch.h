@@ -0,0 +1,72 @@
+#ifndef GCOM_SET_BATCH_H
+#define GCOM_SET_BATCH_H
+
+// gcom_set_batch.h
+// coalesce fims sets into multi register writes
+//
+// encode_map_struct makes one set IO_Work per item, a multi set of 50 points was 50 modbus
+// transactions. SetBatcher holds the sets for connection.set_batch_window seconds ( 0 only merges
+// the sets of one message ), groups them by ( device_id, reg_type ), sorts by offset and sends each
+// run of adjacent or overlapping registers as one FC16 ( holding ) or FC15 ( coil ) write.
+// Later sets of the same register win.
+//
+// a bit range of a packed register only owns the bits in IO_Work::set_mask, the rest of the
+// register comes from the packer's cached raw_val in the PointStore ( read modify write ), and the
+// cache is updated with what was sent so the next window builds on it.
+//
+// the merged work carries the originals in IO_Work::batched, the response thread hands its
+// result back to each of them so every fims set still gets its own response.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gcom_iothread.h"
+
+class SetBatcher {
+public:
+    static constexpr int Max_Write_Registers = 123;   // FC16 limit
+    static constexpr int Max_Write_Coils = 256;       // FC15 allows 1968, IO_Work::buf8 holds 256
+
+    ~SetBatcher() { stop(); }
+
+    // window in seconds, <= 0 does not start the flush thread
+    void start(double window_secs);
+    void stop();
+
+    // takes the set works, they are merged and sent now or when the window closes
+    void add(std::vector<IO_WorkHandle>& works);
+
+    // merge a batch of set works, out gets the works to send.
+    // a run of one unmasked set goes out as it was
+    static void merge(std::vector<IO_WorkHandle>& batch, std::vector<IO_WorkHandle>& out);
+
+    struct Stats {
+        u64 sets = 0;      // works added
+        u64 writes = 0;    // works sent
+    };
+    Stats stats() const;
+
+private:
+    void run();
+    void send(std::vector<IO_WorkHandle>& batch);
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::thread thread;
+    bool running = false;
+    double window = 0.0;
+    std::chrono::steady_clock::time_point tFirst;
+    std::vector<IO_WorkHandle> pending;
+    std::atomic<u64> sets{0};
+    std::atomic<u64> writes{0};
+};
+
+extern SetBatcher setBatcher;
+
+int test_set_batch();
+
+#endif
@@ -7,6 +7,12 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "gcom_channel.h"
 
 namespace timer {
     enum Constants {
@@ -15,6 +21,9 @@ namespace timer {
 }
 // Define the TimeObject class
 
+// prints each TimeObject as it is deleted, off so bench_timer does not print a line per timer
+extern bool timer_debug;
+
 // class TimeObject;
 // std::vector<std::shared_ptr<TimeObject>> timeObjects;
 
@@ -36,7 +45,8 @@ public:
     
     ~TimeObject()
     {
-        std::cout << " Timer object ["<< name<<"] deleted " << std::endl; 
+        if (timer_debug)
+            std::cout << " Timer object ["<< name<<"] deleted " << std::endl; 
     }
 
     TimeObject(std::string timer_name, double timer_runTime, double timer_stopTime, double timer_repeatTime, int timer_count,
@@ -55,7 +65,6 @@ public:
             sync(false) ,
             run(false) 
         {
-            printf(" Timer object created #11 name %p param %p sync %p\n", (void*)&name, (void*)&param, (void*)&sync);
             enabled = true;
             runs = 0;
             offsetTime = 0.0;
@@ -74,7 +83,6 @@ public:
            callback(timer_callback), 
            param(timer_callbackParams) 
         {
-            printf(" Timer object created #12 name %p param %p sync %p\n", (void*)&name, (void*)&param, (void*)&sync);
             enabled = true;
             runs = 0;
             offsetTime = timer_offset;
@@ -92,42 +100,87 @@ public:
 };
 
 
+// same lock free channel as the io threads
 template <typename T>
-class Channel {
-private:
-    std::queue<T> queue;
-    std::mutex mtx;
-    std::condition_variable cv;
-
+using Channel = lfChannel<T>;
+
+
+// hierarchical timing wheel behind addTimeObject and the timer thread
+//
+// four levels of 256 slots over a 1 mS tick: 256 mS, 65 S, 4.6 hours and 49 days.
+// a TimeObject sits in one slot list ( intrusive, by index into the node pool ) so add, cancel and
+// reschedule are O(1). When the level 0 index wraps the next level's slot is cascaded down.
+// names map to handles, a handle is the node index and a generation so a stale one never
+// reaches a reused node.
+// a timer fires on the first tick at or after its runTime, never early. The jitter is the tick
+// plus the thread wakeup, the timer thread records it as "timer_jitter" ( gcom_perf.h ).
+// not thread safe, the timer functions hold timerMutex around it.
+class TimerWheel {
 public:
-    void send(const T& message) {
-        {
-            std::unique_lock<std::mutex> lock(mtx);
-            queue.push(message);
-        }
-        cv.notify_one();
-    }
+    static constexpr double Tick = 0.001;
+    static constexpr int Slot_Bits = 8;
+    static constexpr int Slots = 1 << Slot_Bits;
+    static constexpr int Levels = 4;
 
-    bool receive(T& message) {
-        std::unique_lock<std::mutex> lock(mtx);
-        while (queue.empty()) {
-            cv.wait(lock);
-        }
+    using Handle = uint64_t;    // 0 is no timer
 
-        message = queue.front();
-        queue.pop();
-        return true;
-    }
-    // Overloaded receive with a timeout
-    bool receive(T& message, const std::chrono::microseconds& duration) {
-        std::unique_lock<std::mutex> lock(mtx);
-        if (cv.wait_for(lock, duration, [this] { return !queue.empty(); })) {
-            message = queue.front();
-            queue.pop();
-            return true;
-        }
-        return false; // timed out without receiving a message
+    TimerWheel();
+
+    // linked at obj->runTime, a name already in use moves to the new timer
+    Handle add(std::shared_ptr<TimeObject> obj);
+    // off the wheel and forgotten, also works on a timer that is out firing
+    bool cancel(Handle h);
+    // obj->runTime changed, a timer that is out firing is relinked by finish()
+    bool reschedule(Handle h);
+
+    Handle find(const std::string& name) const;
+    std::shared_ptr<TimeObject> get(Handle h) const;
+
+    // move the wheel up to tNow. due timers come off the wheel and are appended to due,
+    // each one has to go back through finish()
+    void advance(double tNow, std::vector<Handle>& due);
+    // relink at obj->runTime, or drop it
+    void finish(Handle h, bool keep);
+
+    // seconds to the next tick with something in it ( or the next cascade ), -1 when empty
+    double next_wait(double tNow) const;
+
+    size_t size() const { return num_used; }
+
+    template <typename F>
+    void for_each(F f) const {
+        for (auto& node : nodes)
+            if (node.used)
+                f(node.obj);
     }
+
+private:
+    struct Node {
+        std::shared_ptr<TimeObject> obj;
+        uint64_t expire = 0;     // tick
+        int32_t prev = -1;
+        int32_t next = -1;
+        int32_t slot = -1;       // level * Slots + index, -1 while off the wheel
+        uint32_t gen = 1;
+        bool used = false;
+    };
+
+    int32_t resolve(Handle h) const;
+    Handle handle(int32_t idx) const { return ((uint64_t)nodes[idx].gen << 32) | (uint32_t)idx; }
+    void link(int32_t idx, uint64_t min_tick);
+    void unlink(int32_t idx);
+    void release(int32_t idx);
+    void cascade(int level);
+    void rebase(uint64_t tick);
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> free_nodes;
+    std::vector<int32_t> heads;       // Levels * Slots
+    std::unordered_map<std::string, Handle> names;
+    uint64_t now_tick = 0;            // the last tick processed
+    size_t num_used = 0;
+    size_t num_linked = 0;
+    std::vector<int32_t> scratch;
 };
 
 
@@ -137,7 +190,11 @@ std::shared_ptr<TimeObject> createTimeObject(std::string timer_name, double time
 std::shared_ptr<TimeObject> createOffsetTimeObject(std::string timer_name, double timer_runTime, double timer_stopTime, double timer_repeatTime,
      int timer_count, int timer_offset, void (*timer_callback)(std::shared_ptr<TimeObject>,void*), void* timer_callbackParams);
 
+// useSet picked between the old sorted list and std::set engines, both are now the TimerWheel
 void addTimeObject(std::shared_ptr<TimeObject> obj, double offset, bool sync, bool useSet=false);
+std::shared_ptr<TimeObject> findTimeObjectByName(const std::string& name);
+bool removeTimeObjectByName(const std::string& name);
+bool modifyTimeObjectByName(const std::string& name, double newRunTime, double newStopTime, double newRepeatTime, bool useSet);
 //void addSyncTimeObject(std::shared_ptr<TimeObject> obj, double offset = 0.0);
 void showTimerObjects(bool useSet=false);
 void runTimer();
@@ -152,4 +209,5 @@ bool syncTimeObjectByName(const std::string& name, double error_margin_percent,
 // void stopTimer();
 
 int test_timer(bool useSet);
+int bench_timer(int num_timers);
 
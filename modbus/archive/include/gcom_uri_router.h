@@ -0,0 +1,66 @@
+#ifndef GCOM_URI_ROUTER_H
+#define GCOM_URI_ROUTER_H
+
+// gcom_uri_router.h
+// fims uri lookup built once per config load
+//
+// a request used to split its uri into a vector of strings and walk the three levels of
+// cfg::itemMap with them. UriRouter has every  /component/uri  and  /component/uri/id  path
+// from the itemMap in a minimal perfect hash ( hash and displace ), a lookup is one hash of the
+// path, one probe and one compare, no allocations.
+// Uri_req strips any /_suffix before the lookup.
+//
+// the router is built by MapIndex::build and swapped in with it, see gcom_map_index.h
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gcom_config.h"
+
+class UriRouter {
+public:
+    struct Route {
+        int32_t point_id = -1;   // the item, -1 for a /component/uri route
+        int32_t group = -1;      // the /component/uri this path is in
+    };
+
+    struct Group {
+        std::string path;
+        std::map<std::string, std::shared_ptr<cfg::map_struct>> items;   // for multi sets
+    };
+
+    // every path in the itemMap, point ids must already be set
+    void build(const cfg& myCfg);
+
+    // nullptr if the path is not known
+    const Route* find(std::string_view path) const;
+
+    size_t size() const { return num_routes; }
+
+    std::vector<Group> groups;
+
+private:
+    struct Slot {
+        uint32_t key_at = 0;
+        uint32_t key_len = 0;
+        Route route;
+    };
+
+    void add(const std::string& path, Route route);
+    void finish();
+
+    std::string keys;                 // every path back to back
+    std::vector<Slot> slots;
+    std::vector<uint32_t> disp;       // per bucket displacement seed
+    uint64_t slot_mask = 0;
+    size_t num_routes = 0;
+    std::vector<std::pair<std::string, Route>> pending;
+};
+
+int test_uri_router();
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef _MODBUS_SERVER_H_
 #define _MODBUS_SERVER_H_
 
+#include <string>
+#include <vector>
+
 #include "modbus_utils.h"
 
 typedef struct {
@@ -36,6 +39,22 @@ struct char_cmp {
 typedef std::map<const char*, std::pair<bool*, maps**>, char_cmp> body_map;
 typedef std::map<const char*, body_map*, char_cmp> uri_map;
 
+// a value out of a fims body, the parts of a cJSON value the update functions use.
+// bare, clothed {"value": x} or for bit fields and enums the last entry of an array
+typedef struct {
+    double valuedouble;
+    int valueint;
+    bool is_true;
+} fims_value;
+
+// where a modbus write of a register goes, indexed by the offset in its register type.
+// only the first register of a variable has a slot
+typedef struct {
+    int uri;            // index into set_uris, -1 for none
+    uint32_t key_at;    // "id": in set_keys
+    uint32_t key_len;
+} set_slot;
+
 typedef struct sdata
 {
     uri_map uri_to_register;
@@ -45,6 +64,14 @@ typedef struct sdata
     const char** uris;
     const char* base_uri;
     int num_uris;
+
+    // the fims sets of a modbus write request, one multi key set per uri.
+    // built once with the register map so a write never formats a uri or builds a cJSON object
+    std::vector<set_slot> set_slots[Num_Register_Types];
+    std::vector<std::string> set_uris;
+    std::string set_keys;
+    std::vector<std::string> set_bodies;    // one per uri, kept between requests
+    std::vector<int> set_touched;
     sdata()
     {
         memset(regs_to_map, 0, Num_Register_Types * sizeof(maps**));
@@ -55,6 +82,11 @@ typedef struct sdata
         num_uris = 0;
     }
     void load_uri_array();
+    void build_set_table(datalog* data);
+    void set_add(const maps* reg, bool value);
+    void set_add(const maps* reg, double value);
+    // send the sets added since the last flush
+    void set_flush();
 } server_data;
 
 /* Configuration */
@@ -65,8 +97,12 @@ server_data *create_register_map(cJSON *registers, datalog *data);
 cJSON* unwrap_if_clothed(cJSON* obj);
 int extract_valueint_of_last_array_object(cJSON* arr);
 uint32_t json_to_uint32(maps* settings, cJSON* obj);
+uint32_t value_to_uint32(maps* settings, const fims_value& val);
+uint64_t value_to_uint64(maps* settings, const fims_value& val);
 void update_holding_or_input_register_value(maps* settings, cJSON* value, uint16_t* regs, system_config* sys_cfg);
 void update_variable_value(modbus_mapping_t *map, bool *reg_type, maps **settings, cJSON *value, system_config* sys_cfg);
+void update_holding_or_input_register_value(maps* settings, const fims_value& value, uint16_t* regs, system_config* sys_cfg);
+void update_variable_value(modbus_mapping_t *map, bool *reg_type, maps **settings, const fims_value& value, system_config* sys_cfg);
 bool process_fims_message(fims_message *msg, server_data *server_map, system_config& sys_cfg);
 bool process_modbus_message(int bytes_read, int header_length, datalog *data, system_config *config, server_data *server_map, bool serial, uint8_t *query);
 
@@ -0,0 +1,167 @@
+#ifndef _MODBUS_SIM_H_
+#define _MODBUS_SIM_H_
+
+/*
+ * modbus_sim.h
+ *
+ * device simulation for modbus_server, soak and load test a client without the plant.
+ * the optional "simulation" object of the server config:
+ *
+ *  "simulation": {
+ *      "rate": 0.1,                  seconds between generator updates, default 1
+ *      "report_interval": 10,        seconds between transaction rate reports, default 10
+ *      "seed": 1,                    for the random generators and faults
+ *      "first_device_id": 1,         unit ids first_device_id .. + num_devices - 1 are served,
+ *      "num_devices": 120,           each from its own register image. without them every unit id is served
+ *                                    from the one image, as before
+ *      "generators": [
+ *          {"type": "input_registers", "offset": 100, "kind": "ramp",        "min": 0, "max": 100, "period": 60},
+ *          {"type": "input_registers", "offset": 102, "kind": "sine",        "center": 50, "amplitude": 10, "period": 30},
+ *          {"type": "holding_registers", "offset": 4, "kind": "random_walk", "min": 0, "max": 10, "step": 0.5},
+ *          {"type": "input_registers", "offset": 110, "kind": "csv",         "file": "soc.csv", "column": 1}
+ *      ],
+ *      "faults": [
+ *          {"type": "holding_registers", "offset": 0, "num": 100,
+ *           "latency": {"dist": "normal", "mean": 20, "stddev": 5},      ms, dist fixed uniform ( min max ) normal exponential
+ *           "timeout_rate": 0.01, "exception": 4, "exception_rate": 0.02}
+ *      ]
+ *  }
+ *
+ * generator values are engineering values, they are encoded with the scale / size / signed / float of the
+ * variable at that offset ( raw into the register if there is none ). the virtual devices see the same
+ * waveforms shifted by their index. only the base device ( the system device_id, or first_device_id ) takes
+ * fims updates and forwards writes to fims.
+ * a request gets the first fault whose range it touches. a delayed reply is queued, the server loop keeps
+ * serving everyone else while it waits.
+ */
+
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "modbus_server.h"
+
+class ModbusSim
+{
+public:
+    // what to do with a request
+    typedef struct
+    {
+        double delay;       // seconds before the reply goes out
+        bool drop;          // no reply at all, the master times out
+        int exception;      // answer with this exception code, 0 for none
+    } Action;
+
+    ~ModbusSim() { stop(); }
+
+    // read the "simulation" object, NULL leaves the simulation off
+    bool parse(cJSON* sim_obj);
+    // clone the register image for the virtual devices and load the csv files, after mb_mapping is made
+    bool start(server_data* server_map, datalog* data, system_config* sys_cfg);
+    // frees the virtual devices and drops any queued replies
+    void stop();
+    bool enabled() const { return running; }
+
+    // the register image unit_id is served from, NULL if there is no such device
+    modbus_mapping_t* mapping(int unit_id);
+    bool is_base(int unit_id) const;
+
+    Action on_request(const uint8_t* query, int header_length);
+    // reply to query on fd once action.delay has passed
+    void defer(int fd, modbus_mapping_t* map, const uint8_t* query, int len, const Action& action);
+    // fd was closed, its queued replies are dropped
+    void forget_client(int fd);
+    void count_reply(bool exception);
+    void count_drop();
+
+    // run the generators and send the replies that are due. returns the ms until the next thing is due
+    int poll(modbus_t* mb);
+
+private:
+    enum Gen_Kind { Ramp, Sine, Random_Walk, Csv };
+    enum Dist_Kind { Fixed, Uniform, Normal, Exponential };
+
+    typedef struct
+    {
+        int reg_type;
+        unsigned int offset;
+        Gen_Kind kind;
+        double min, max, period, center, amplitude, step;
+        std::string file;
+        int column;
+        std::vector<double> samples;    // csv column
+        std::vector<double> walk;       // random walk, per device
+    } Generator;
+
+    typedef struct
+    {
+        int reg_type;
+        unsigned int first, last;
+        bool has_latency;
+        Dist_Kind dist;
+        double mean, stddev, min, max;  // ms
+        double timeout_rate;
+        int exception;
+        double exception_rate;
+    } Fault;
+
+    typedef struct
+    {
+        double due;
+        uint64_t order;                 // replies due together go out in arrival order
+        int fd;
+        unsigned int fd_gen;
+        modbus_mapping_t* map;
+        int len;
+        int exception;
+        std::vector<uint8_t> query;
+    } Deferred;
+
+    struct Later
+    {
+        bool operator()(const Deferred& a, const Deferred& b) const
+        {
+            return a.due > b.due || (a.due == b.due && a.order > b.order);
+        }
+    };
+
+    void update(double now);
+    double value(Generator& gen, double t, int device);
+    void write(modbus_mapping_t* map, const Generator& gen, double val);
+    void report(double now);
+
+    bool configured = false;
+    bool running = false;
+    double rate = 1.0;
+    double report_interval = 10.0;
+    unsigned int seed = 1;
+    int first_device_id = -1;
+    int num_devices = 0;
+    std::vector<Generator> generators;
+    std::vector<Fault> faults;
+
+    server_data* server_map = NULL;
+    datalog* data = NULL;
+    system_config* sys_cfg = NULL;
+    int base_id = -1;
+    std::vector<modbus_mapping_t*> devices;    // by unit id - first_device_id, the base one is mb_mapping
+
+    std::mt19937_64 rng;
+    double t_start = 0.0;
+    double next_update = 0.0;
+    double next_report = 0.0;
+    double last_report = 0.0;
+    uint64_t ticks = 0;
+    std::priority_queue<Deferred, std::vector<Deferred>, Later> pending;
+    uint64_t num_queued = 0;
+    std::map<int, unsigned int> fd_gens;
+
+    uint64_t replies = 0;
+    uint64_t exceptions = 0;
+    uint64_t dropped = 0;
+    uint64_t delayed = 0;
+};
+
+#endif /* _MODBUS_SIM_H_ */
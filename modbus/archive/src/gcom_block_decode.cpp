@@ -0,0 +1,437 @@
+// gcom_block_decode.cpp
+// homogeneous register block decode, see gcom_block_decode.h
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gcom_config.h"
+#include "gcom_decode_kernel.h"
+#include "gcom_block_decode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GCOM_BLOCK_X86 1
+#include <immintrin.h>
+#endif
+
+bool block_decode_spec(const cfg::reg_struct& reg, BlockDecodeSpec& spec) {
+    spec = BlockDecodeSpec();
+    if (reg.reg_type != cfg::Register_Types::Holding && reg.reg_type != cfg::Register_Types::Input)
+        return false;
+    // not worth it for a handful of items
+    if (reg.maps.size() < 8)
+        return false;
+
+    auto& first = *reg.maps[0];
+    spec.first_offset = first.offset;
+    spec.num_items = reg.maps.size();
+    spec.size = first.size;
+    spec.word_swap = first.is_word_swap;
+    spec.is_signed = first.is_signed;
+    spec.is_float = first.is_float;
+    spec.scale = first.scale;
+    spec.shift = first.shift;
+
+    if (spec.size != 1 && spec.size != 2)
+        return false;
+    // size 1 float and signed float decode to just the shift, leave those odd ones alone
+    if (spec.is_float && (spec.size == 1 || spec.is_signed))
+        return false;
+
+    for (size_t i = 0; i < reg.maps.size(); ++i) {
+        auto& map = *reg.maps[i];
+        if (map.offset != spec.first_offset + (int)i * spec.size
+                || map.size != spec.size
+                || map.is_word_swap != spec.word_swap
+                || map.is_signed != spec.is_signed
+                || map.is_float != spec.is_float
+                || map.scale != spec.scale
+                || map.shift != spec.shift
+                || map.uses_masks
+                || map.starting_bit_pos != 0
+                || map.packed_register
+                || map.is_bit || map.is_enum || map.is_random_enum
+                || map.is_individual_bits || map.is_bit_field) {
+            return false;
+        }
+    }
+    spec.homogeneous = true;
+    return true;
+}
+
+DecodeValue::Kind block_decode_kind(const BlockDecodeSpec& spec) {
+    if (spec.is_float || spec.scale != 0.0)
+        return DecodeValue::Kind::Float;
+    return spec.is_signed ? DecodeValue::Kind::Signed : DecodeValue::Kind::Unsigned;
+}
+
+BlockDecodeIsa block_decode_isa() {
+#ifdef GCOM_BLOCK_X86
+    static const BlockDecodeIsa isa = __builtin_cpu_supports("avx2") ? BlockDecodeIsa::AVX2 : BlockDecodeIsa::SSE2;
+    return isa;
+#else
+    return BlockDecodeIsa::Scalar;
+#endif
+}
+
+const char* block_decode_isa_name(BlockDecodeIsa isa) {
+    switch (isa) {
+        case BlockDecodeIsa::AVX2: return "avx2";
+        case BlockDecodeIsa::SSE2: return "sse2";
+        default:                   return "scalar";
+    }
+}
+
+// the two registers of a size 2 item as a u32, the first register is the high word unless swapped
+static inline u32 item32(const u16* p, bool word_swap) {
+    return word_swap ? ((u32)p[1] << 16) | p[0] : ((u32)p[0] << 16) | p[1];
+}
+
+static void decode_f64_scalar(const BlockDecodeSpec& spec, const u16* buf16, int num_items, double* out) {
+    double shift = spec.shift;
+    for (int i = 0; i < num_items; ++i) {
+        double v;
+        if (spec.size == 1) {
+            v = spec.is_signed ? (double)(int16_t)buf16[i] : (double)buf16[i];
+        } else {
+            u32 raw = item32(&buf16[i * 2], spec.word_swap);
+            if (spec.is_float) {
+                float f;
+                memcpy(&f, &raw, sizeof(f));
+                v = f;
+            } else {
+                v = spec.is_signed ? (double)(int32_t)raw : (double)raw;
+            }
+        }
+        if (spec.scale != 0.0)
+            v /= spec.scale;
+        out[i] = v + shift;
+    }
+}
+
+static void decode_i64_scalar(const BlockDecodeSpec& spec, const u16* buf16, int num_items, s64* out) {
+    for (int i = 0; i < num_items; ++i) {
+        s64 v;
+        if (spec.size == 1) {
+            v = spec.is_signed ? (s64)(int16_t)buf16[i] : (s64)buf16[i];
+        } else {
+            u32 raw = item32(&buf16[i * 2], spec.word_swap);
+            v = spec.is_signed ? (s64)(int32_t)raw : (s64)raw;
+        }
+        out[i] = v + spec.shift;
+    }
+}
+
+#ifdef GCOM_BLOCK_X86
+
+// 4 size 2 items as u32 lanes, a plain load already gives the swapped order
+static inline __m128i load_items32_sse2(const u16* p, bool word_swap) {
+    __m128i x = _mm_loadu_si128((const __m128i*)p);
+    if (!word_swap)
+        x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+    return x;
+}
+
+// u32 lanes to double without going through the signed convert
+static inline __m128d u32lo_to_pd_sse2(__m128i x) {
+    __m128d hi = _mm_cvtepi32_pd(_mm_srli_epi32(x, 16));
+    __m128d lo = _mm_cvtepi32_pd(_mm_and_si128(x, _mm_set1_epi32(0xffff)));
+    return _mm_add_pd(_mm_mul_pd(hi, _mm_set1_pd(65536.0)), lo);
+}
+
+static void decode_f64_sse2(const BlockDecodeSpec& spec, const u16* buf16, int num_items, double* out) {
+    const __m128d scale = _mm_set1_pd(spec.scale);
+    const __m128d shift = _mm_set1_pd((double)spec.shift);
+    const bool scaled = spec.scale != 0.0;
+    auto finish = [&](__m128d d, double* dst) {
+        if (scaled)
+            d = _mm_div_pd(d, scale);
+        _mm_storeu_pd(dst, _mm_add_pd(d, shift));
+    };
+
+    int i = 0;
+    if (spec.size == 1) {
+        for (; i + 8 <= num_items; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&buf16[i]);
+            __m128i lo, hi;
+            if (spec.is_signed) {
+                lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            } else {
+                lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+                hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+            }
+            finish(_mm_cvtepi32_pd(lo), &out[i]);
+            finish(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0xee)), &out[i + 2]);
+            finish(_mm_cvtepi32_pd(hi), &out[i + 4]);
+            finish(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0xee)), &out[i + 6]);
+        }
+    } else {
+        for (; i + 4 <= num_items; i += 4) {
+            __m128i x = load_items32_sse2(&buf16[i * 2], spec.word_swap);
+            __m128i xh = _mm_shuffle_epi32(x, 0xee);
+            if (spec.is_float) {
+                __m128 f = _mm_castsi128_ps(x);
+                finish(_mm_cvtps_pd(f), &out[i]);
+                finish(_mm_cvtps_pd(_mm_movehl_ps(f, f)), &out[i + 2]);
+            } else if (spec.is_signed) {
+                finish(_mm_cvtepi32_pd(x), &out[i]);
+                finish(_mm_cvtepi32_pd(xh), &out[i + 2]);
+            } else {
+                finish(u32lo_to_pd_sse2(x), &out[i]);
+                finish(u32lo_to_pd_sse2(xh), &out[i + 2]);
+            }
+        }
+    }
+    decode_f64_scalar(spec, &buf16[i * spec.size], num_items - i, &out[i]);
+}
+
+static void decode_i64_sse2(const BlockDecodeSpec& spec, const u16* buf16, int num_items, s64* out) {
+    const __m128i shift = _mm_set1_epi64x(spec.shift);
+    // widen 4 i32 lanes to 2 x 2 i64
+    auto store = [&](__m128i x, s64* dst) {
+        __m128i ext = spec.is_signed ? _mm_srai_epi32(x, 31) : _mm_setzero_si128();
+        _mm_storeu_si128((__m128i*)dst, _mm_add_epi64(_mm_unpacklo_epi32(x, ext), shift));
+        _mm_storeu_si128((__m128i*)(dst + 2), _mm_add_epi64(_mm_unpackhi_epi32(x, ext), shift));
+    };
+
+    int i = 0;
+    if (spec.size == 1) {
+        for (; i + 8 <= num_items; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&buf16[i]);
+            if (spec.is_signed) {
+                store(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), &out[i]);
+                store(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), &out[i + 4]);
+            } else {
+                store(_mm_unpacklo_epi16(v, _mm_setzero_si128()), &out[i]);
+                store(_mm_unpackhi_epi16(v, _mm_setzero_si128()), &out[i + 4]);
+            }
+        }
+    } else {
+        for (; i + 4 <= num_items; i += 4)
+            store(load_items32_sse2(&buf16[i * 2], spec.word_swap), &out[i]);
+    }
+    decode_i64_scalar(spec, &buf16[i * spec.size], num_items - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static void decode_f64_avx2(const BlockDecodeSpec& spec, const u16* buf16, int num_items, double* out) {
+    const __m256d scale = _mm256_set1_pd(spec.scale);
+    const __m256d shift = _mm256_set1_pd((double)spec.shift);
+    const bool scaled = spec.scale != 0.0;
+
+    int i = 0;
+    if (spec.size == 1) {
+        for (; i + 8 <= num_items; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&buf16[i]);
+            __m256i x = spec.is_signed ? _mm256_cvtepi16_epi32(v) : _mm256_cvtepu16_epi32(v);
+            __m256d d0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+            __m256d d1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+            if (scaled) {
+                d0 = _mm256_div_pd(d0, scale);
+                d1 = _mm256_div_pd(d1, scale);
+            }
+            _mm256_storeu_pd(&out[i], _mm256_add_pd(d0, shift));
+            _mm256_storeu_pd(&out[i + 4], _mm256_add_pd(d1, shift));
+        }
+    } else {
+        for (; i + 4 <= num_items; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i*)&buf16[i * 2]);
+            if (!spec.word_swap)
+                x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+            __m256d d;
+            if (spec.is_float) {
+                d = _mm256_cvtps_pd(_mm_castsi128_ps(x));
+            } else if (spec.is_signed) {
+                d = _mm256_cvtepi32_pd(x);
+            } else {
+                __m256d hi = _mm256_cvtepi32_pd(_mm_srli_epi32(x, 16));
+                __m256d lo = _mm256_cvtepi32_pd(_mm_and_si128(x, _mm_set1_epi32(0xffff)));
+                d = _mm256_add_pd(_mm256_mul_pd(hi, _mm256_set1_pd(65536.0)), lo);
+            }
+            if (scaled)
+                d = _mm256_div_pd(d, scale);
+            _mm256_storeu_pd(&out[i], _mm256_add_pd(d, shift));
+        }
+    }
+    // the tail is plain sse code, clear the upper halves first or every op there pays the transition
+    _mm256_zeroupper();
+    decode_f64_scalar(spec, &buf16[i * spec.size], num_items - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static void decode_i64_avx2(const BlockDecodeSpec& spec, const u16* buf16, int num_items, s64* out) {
+    const __m256i shift = _mm256_set1_epi64x(spec.shift);
+
+    int i = 0;
+    if (spec.size == 1) {
+        for (; i + 8 <= num_items; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&buf16[i]);
+            __m128i vh = _mm_srli_si128(v, 8);
+            __m256i x0 = spec.is_signed ? _mm256_cvtepi16_epi64(v) : _mm256_cvtepu16_epi64(v);
+            __m256i x1 = spec.is_signed ? _mm256_cvtepi16_epi64(vh) : _mm256_cvtepu16_epi64(vh);
+            _mm256_storeu_si256((__m256i*)&out[i], _mm256_add_epi64(x0, shift));
+            _mm256_storeu_si256((__m256i*)&out[i + 4], _mm256_add_epi64(x1, shift));
+        }
+    } else {
+        for (; i + 4 <= num_items; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i*)&buf16[i * 2]);
+            if (!spec.word_swap)
+                x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+            __m256i w = spec.is_signed ? _mm256_cvtepi32_epi64(x) : _mm256_cvtepu32_epi64(x);
+            _mm256_storeu_si256((__m256i*)&out[i], _mm256_add_epi64(w, shift));
+        }
+    }
+    // the tail is plain sse code, clear the upper halves first or every op there pays the transition
+    _mm256_zeroupper();
+    decode_i64_scalar(spec, &buf16[i * spec.size], num_items - i, &out[i]);
+}
+
+#endif
+
+void block_decode_f64(const BlockDecodeSpec& spec, const u16* buf16, int num_items, double* out, BlockDecodeIsa isa) {
+#ifdef GCOM_BLOCK_X86
+    if (isa == BlockDecodeIsa::AVX2)
+        return decode_f64_avx2(spec, buf16, num_items, out);
+    if (isa == BlockDecodeIsa::SSE2)
+        return decode_f64_sse2(spec, buf16, num_items, out);
+#endif
+    decode_f64_scalar(spec, buf16, num_items, out);
+}
+
+void block_decode_i64(const BlockDecodeSpec& spec, const u16* buf16, int num_items, s64* out, BlockDecodeIsa isa) {
+#ifdef GCOM_BLOCK_X86
+    if (isa == BlockDecodeIsa::AVX2)
+        return decode_i64_avx2(spec, buf16, num_items, out);
+    if (isa == BlockDecodeIsa::SSE2)
+        return decode_i64_sse2(spec, buf16, num_items, out);
+#endif
+    decode_i64_scalar(spec, buf16, num_items, out);
+}
+
+
+struct BlockBenchCase {
+    const char* name;
+    int size;
+    bool is_signed;
+    bool is_float;
+    bool word_swap;
+    double scale;
+    int shift;
+};
+
+static std::shared_ptr<cfg::reg_struct> bench_block_reg(const BlockBenchCase& bc, int num_registers) {
+    auto reg = std::make_shared<cfg::reg_struct>();
+    reg->reg_type = cfg::Register_Types::Input;
+    reg->starting_offset = 1000;
+    reg->number_of_registers = num_registers;
+    for (int off = 0; off + bc.size <= num_registers; off += bc.size) {
+        auto map = std::make_shared<cfg::map_struct>();
+        map->offset = reg->starting_offset + off;
+        map->size = bc.size;
+        map->is_signed = bc.is_signed;
+        map->is_float = bc.is_float;
+        map->is_word_swap = bc.word_swap;
+        map->scale = bc.scale;
+        map->shift = bc.shift;
+        map->decode = select_decode_kernel(*map);
+        reg->maps.push_back(map);
+        reg->mapix[map->offset] = map;
+    }
+    block_decode_spec(*reg, reg->block);
+    return reg;
+}
+
+// 125 register blocks ( one full FC3/FC4 read ) decoded item by item through mapix as
+// processGroupCallback used to, then as a block with each isa
+int bench_block_decode(int loops) {
+    const int num_registers = 125;
+    const BlockBenchCase cases[] = {
+        {"u16 scale 1000", 1, false, false, false, 1000.0, 0},
+        {"s16 scale 10",   1, true,  false, false, 10.0,   0},
+        {"s16",            1, true,  false, false, 0.0,    0},
+        {"u32 word_swap",  2, false, false, true,  0.0,    0},
+        {"s32 scale 100",  2, true,  false, false, 100.0,  5},
+        {"f32",            2, false, true,  false, 0.0,    0},
+    };
+    BlockDecodeIsa isas[] = {BlockDecodeIsa::Scalar, BlockDecodeIsa::SSE2, BlockDecodeIsa::AVX2};
+    int num_isas = 1;
+    if (block_decode_isa() == BlockDecodeIsa::SSE2)
+        num_isas = 2;
+    else if (block_decode_isa() == BlockDecodeIsa::AVX2)
+        num_isas = 3;
+
+    int errors = 0;
+    std::mt19937 rng(4321);
+    std::vector<u16> regs(num_registers);
+    using clk = std::chrono::steady_clock;
+
+    std::cout << " bench_block_decode  " << num_registers << " register blocks, " << loops << " loops, best isa "
+              << block_decode_isa_name(block_decode_isa()) << std::endl;
+
+    for (auto& bc : cases) {
+        auto reg = bench_block_reg(bc, num_registers);
+        auto& spec = reg->block;
+        if (!spec.homogeneous) {
+            std::cout << "    " << bc.name << " not homogeneous" << std::endl;
+            errors++;
+            continue;
+        }
+        for (auto& r : regs)
+            r = (u16)rng();
+        // no NaNs, they would not compare equal
+        if (bc.is_float)
+            for (size_t r = 0; r < regs.size(); r += 2)
+                regs[r] &= 0x7f7f;
+
+        int n = spec.num_items;
+        bool is_f64 = block_decode_kind(spec) == DecodeValue::Kind::Float;
+        std::vector<DecodeValue> ref(n);
+        std::vector<double> f64(n);
+        std::vector<s64> i64(n);
+        double sink = 0.0;
+
+        // the old way, a mapix walk and a decode per item
+        auto t0 = clk::now();
+        for (int l = 0; l < loops; ++l) {
+            int k = 0;
+            for (auto it = reg->mapix.lower_bound(reg->starting_offset);
+                    it != reg->mapix.end() && it->first < reg->starting_offset + num_registers; ++it) {
+                auto& map = *it->second;
+                map.decode(&regs[it->first - reg->starting_offset], map, ref[k++]);
+            }
+            sink += ref[0].f;
+        }
+        double t_item = std::chrono::duration<double>(clk::now() - t0).count();
+        double total = (double)n * loops;
+        printf("    %-16s items %3d  per item  %8.1f M/s", bc.name, n, total / t_item / 1e6);
+
+        for (int a = 0; a < num_isas; ++a) {
+            auto t1 = clk::now();
+            for (int l = 0; l < loops; ++l) {
+                if (is_f64)
+                    block_decode_f64(spec, regs.data(), n, f64.data(), isas[a]);
+                else
+                    block_decode_i64(spec, regs.data(), n, i64.data(), isas[a]);
+                sink += f64[0] + i64[0];
+            }
+            double t_block = std::chrono::duration<double>(clk::now() - t1).count();
+            printf("  %s %8.1f M/s", block_decode_isa_name(isas[a]), total / t_block / 1e6);
+
+            for (int k = 0; k < n; ++k) {
+                bool same = is_f64 ? (f64[k] == ref[k].f) : ((u64)i64[k] == ref[k].u);
+                if (!same) {
+                    if (errors < 10)
+                        printf("\n    mismatch %s %s item %d", bc.name, block_decode_isa_name(isas[a]), k);
+                    errors++;
+                }
+            }
+        }
+        printf("%s\n", sink == 0.12345 ? " " : "");
+    }
+    std::cout << " bench_block_decode errors " << errors << std::endl;
+    return errors;
+}
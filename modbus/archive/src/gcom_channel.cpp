@@ -0,0 +1,121 @@
+// gcom_channel.cpp
+// checks for the lfChannel in gcom_channel.h, the channel itself is all in the header
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "gcom_channel.h"
+
+static double thread_cpu_secs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// MPSC ordering through a small queue, wakeups of a sleeping consumer and a producer on a full queue
+int test_channel() {
+    int errors = 0;
+    using clk = std::chrono::steady_clock;
+    auto check = [&](const char* name, bool ok) {
+        std::cout << " " << name << (ok ? " ok" : " FAILED") << std::endl;
+        if (!ok)
+            errors++;
+    };
+
+    // each producer's values arrive in order, none lost. The queue is far smaller than the
+    // traffic so the producers spend most of their time waiting for room
+    {
+        const int num_producers = 4;
+        const uint64_t per_producer = 50000;
+        lfChannel<uint64_t> chan(64);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < num_producers; ++p) {
+            producers.emplace_back([&chan, p] {
+                for (uint64_t i = 0; i < per_producer; ++i)
+                    chan.send(((uint64_t)p << 32) | i);
+            });
+        }
+        std::vector<uint64_t> next(num_producers, 0);
+        bool in_order = true;
+        uint64_t got = 0;
+        std::vector<uint64_t> batch;
+        while (got < num_producers * per_producer) {
+            batch.clear();
+            if (!chan.receiveBatch(batch, 32, 1.0))
+                break;
+            for (auto v : batch) {
+                int p = (int)(v >> 32);
+                if ((v & 0xffffffff) != next[p]++)
+                    in_order = false;
+            }
+            got += batch.size();
+        }
+        for (auto& t : producers)
+            t.join();
+        check("mpsc all received", got == num_producers * per_producer && chan.empty());
+        check("mpsc per producer order", in_order);
+    }
+
+    // a consumer asleep on an empty channel wakes for a send, a timed receive gives up
+    {
+        lfChannel<int> chan(16);
+        std::atomic<bool> woke{false};
+        int value = 0;
+        std::thread consumer([&] {
+            chan.receive(value);
+            woke = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        bool early = woke;
+        auto t0 = clk::now();
+        chan.send(7);
+        consumer.join();
+        double wake = std::chrono::duration<double>(clk::now() - t0).count();
+        check("consumer sleeps while empty", !early);
+        check("consumer wakes for a send", woke && value == 7 && wake < 0.5);
+
+        int none;
+        t0 = clk::now();
+        bool got = chan.receive(none, 0.05);
+        double waited = std::chrono::duration<double>(clk::now() - t0).count();
+        check("timed receive gives up", !got && waited >= 0.045 && waited < 0.5);
+    }
+
+    // a full queue refuses try_send and holds send until a slot frees, without spinning a core
+    {
+        lfChannel<int> chan(4);
+        bool filled = true;
+        for (int i = 0; i < 4; ++i)
+            filled = chan.try_send(int(i)) && filled;
+        check("try_send fills the queue", filled);
+        check("try_send refused when full", !chan.try_send(4));
+
+        std::atomic<bool> sent{false};
+        double cpu = 0.0;
+        std::thread producer([&] {
+            double c0 = thread_cpu_secs();
+            chan.send(5);
+            cpu = thread_cpu_secs() - c0;
+            sent = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bool held = !sent;
+        int value;
+        chan.receive(value);
+        producer.join();
+        check("send held while full", held);
+        std::cout << "  producer cpu while held " << cpu * 1000.0 << " mS of 200 mS" << std::endl;
+        check("send sleeps while full", cpu < 0.1);
+
+        std::vector<int> rest;
+        chan.receiveBatch(rest, 8, 0.0);
+        check("fifo after the wait", value == 0 && rest == std::vector<int>({1, 2, 3, 5}));
+    }
+
+    std::cout << " test_channel errors " << errors << std::endl;
+    return errors;
+}
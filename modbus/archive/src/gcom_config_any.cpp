@@ -28,6 +28,14 @@
 
 #include "gcom_config_tmpl.h"
 #include "gcom_iothread.h"
+#include "gcom_poll_planner.h"
+#include "gcom_device_health.h"
+#include "gcom_decode_kernel.h"
+#include "gcom_block_decode.h"
+#include "gcom_map_index.h"
+#include "gcom_fims_body.h"
+#include "gcom_set_batch.h"
+#include "gcom_config_cache.h"
 
 using namespace std::string_view_literals;
 
@@ -189,28 +197,43 @@ void sortMapsVector(std::vector<std::shared_ptr<cfg::map_struct>> elements) {
 bool  gcom_load_cfg_file(std::map<std::string, std::any>& gcom_map, const char *filename, struct cfg& myCfg, bool debug) {
 
     bool ok = true;
-    auto fok = gcom_parse_file(gcom_map, filename, debug);
-    if (fok < 0)
-        ok = false; 
-
-            // pull out connection from gcom_map
-    if (!ok) {
-        std::cout << " Unable to parse config file :"<< filename << " quitting" << std::endl;
-        return false;
-    }
+    // an unchanged config file comes back from its binary cache, no json parse ( gcom_config_cache.h )
+    std::string cache_file = config_cache_name(filename);
+    u64 hash = 0;
+    bool hashed = config_file_hash(filename, hash);
+    if (hashed && config_cache_load(cache_file.c_str(), hash, myCfg)) {
+        std::cout << " loaded config from cache :"<< cache_file << std::endl;
+    } else {
+        size_t first_comp = myCfg.components.size();
+        auto fok = gcom_parse_file(gcom_map, filename, debug);
+        if (fok < 0)
+            ok = false; 
+
+                // pull out connection from gcom_map
+        if (!ok) {
+            std::cout << " Unable to parse config file :"<< filename << " quitting" << std::endl;
+            return false;
+        }
 
-    ok = extract_connection(gcom_map, "connection", myCfg, debug);
-    if (!ok) {
-        std::cout << " Unable to extract connection from  :"<< filename << " quitting" << std::endl;
-        return false;
-    }
+        ok = extract_connection(gcom_map, "connection", myCfg, debug);
+        if (!ok) {
+            std::cout << " Unable to extract connection from  :"<< filename << " quitting" << std::endl;
+            return false;
+        }
 
-    // pull out the components into myCfg
-    ok = extract_components(gcom_map, "components", myCfg, debug);
-    if (!ok) {
-        std::cout << " Unable to extract components from  :"<< filename << " quitting" << std::endl;
-        return false;
+        // pull out the components into myCfg
+        ok = extract_components(gcom_map, "components", myCfg, debug);
+        if (!ok) {
+            std::cout << " Unable to extract components from  :"<< filename << " quitting" << std::endl;
+            return false;
+        }
+        // saved ahead of the register sizing below, a cache load goes through the same sizing
+        if (hashed && !config_cache_save(cache_file.c_str(), hash, myCfg, first_comp))
+            std::cout << " Unable to write config cache :"<< cache_file << std::endl;
     }
+    // any cached poll plans and quarantined registers refer to the old components
+    pollPlanner.invalidate();
+    deviceHealth.clear();
 
         for ( auto &myComp : myCfg.itemMap) 
         {
@@ -256,6 +279,7 @@ bool  gcom_load_cfg_file(std::map<std::string, std::any>& gcom_map, const char *
             // maybe report config file error here
             myreg->starting_offset = first_offset;
             myreg->number_of_registers = total_size;
+            block_decode_spec(*myreg, myreg->block);
 
 
             if(debug)
@@ -276,6 +300,8 @@ bool  gcom_load_cfg_file(std::map<std::string, std::any>& gcom_map, const char *
             }
         }
     }
+    // readers pick up the new items on their next group, the old index goes when the last one lets go
+    map_index_swap(MapIndex::build(myCfg));
     myCfg.client_name = "my_client"; 
     return true;
 }
@@ -472,7 +498,7 @@ void printAny(std::any& value, int indent = 0);
 #include <memory>
 #include <algorithm>
 
-std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
+IO_WorkHandle make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
 WorkTypes strToWorkType(std::string roper, bool);
 
 
@@ -515,8 +541,8 @@ WorkTypes strToWorkType(std::string roper, bool);
 
 
 // TODO test for max reg size
-int merge_IO_Work_Reg(std::vector<std::shared_ptr<IO_Work>>& work_vector,
-                  std::vector<std::shared_ptr<IO_Work>>& discard_vector) 
+int merge_IO_Work_Reg(std::vector<IO_WorkHandle>& work_vector,
+                  std::vector<IO_WorkHandle>& discard_vector) 
 {
     auto it = work_vector.begin();
     while (it != work_vector.end()) {
@@ -538,10 +564,10 @@ int merge_IO_Work_Reg(std::vector<std::shared_ptr<IO_Work>>& work_vector,
 }
 
 
-int sort_IO_Work(std::vector<std::shared_ptr<IO_Work>> &work_vector) {
+int sort_IO_Work(std::vector<IO_WorkHandle> &work_vector) {
     // Sorting the vector based on IO_Work->offset
     std::sort(work_vector.begin(), work_vector.end(),
-        [](const std::shared_ptr<IO_Work>& a, const std::shared_ptr<IO_Work>& b) -> bool {
+        [](const IO_WorkHandle& a, const IO_WorkHandle& b) -> bool {
             return a->offset < b->offset;
         });
     return 0;
@@ -615,6 +641,14 @@ uint64_t getanyuval(std::shared_ptr<cfg::map_struct>item, std::any val, uint16_t
     bool is_uint =  false;
     bool is_int =  false;
 
+    u64 forced_val = 0;
+    if(item->is_forced)
+    {
+        auto mindex = map_index();
+        if (auto points = mindex ? mindex->store(*item) : nullptr)
+            forced_val = points->forced_val[item->point_id];
+    }
+
     // if (!item->is_forced)
     // {
     // // handle val being in a value field
@@ -715,7 +749,7 @@ uint64_t getanyuval(std::shared_ptr<cfg::map_struct>item, std::any val, uint16_t
             u16val ^= static_cast<uint16_t>(item->invert_mask);  
             std::cout << ">>>>" <<__func__<< " offset  " << item->offset << " final uval >>" << u16val << " ival >> " << ival << std::endl;
             if(item->is_forced)
-                u16val = static_cast<uint16_t>(item->forced_val);  
+                u16val = static_cast<uint16_t>(forced_val);  
 
 
             regs16[0] = static_cast<uint16_t>(u16val);
@@ -769,7 +803,7 @@ uint64_t getanyuval(std::shared_ptr<cfg::map_struct>item, std::any val, uint16_t
             u32val ^= static_cast<uint32_t>(item->invert_mask);  
 
             if(item->is_forced)
-                u32val = static_cast<uint32_t>(item->forced_val);  
+                u32val = static_cast<uint32_t>(forced_val);  
 
             if(!item->is_byte_swap)
             {
@@ -834,7 +868,7 @@ uint64_t getanyuval(std::shared_ptr<cfg::map_struct>item, std::any val, uint16_t
             uval ^= static_cast<uint64_t>(item->invert_mask);  
 
             if(item->is_forced)
-                uval = item->forced_val;  
+                uval = forced_val;  
 
             if(!item->is_byte_swap)
             {
@@ -863,9 +897,9 @@ uint64_t getanyuval(std::shared_ptr<cfg::map_struct>item, std::any val, uint16_t
     return uval;
 }
 
-bool decode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug)
+bool decode_map_struct(std::vector<IO_WorkHandle>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug)
 {
-    std::shared_ptr<IO_Work> iop;
+    IO_WorkHandle iop;
     iop = make_work(item->reg_type, item->device_id, item->offset, 1, item->reg16, item->reg8, strToWorkType("get", false));
     wvec.emplace_back(iop);
     return true;
@@ -877,9 +911,9 @@ bool decode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_p
 /// @param item  the item we are setting
 /// @param val   the value we are using
 /// @return true if all worked out
-bool encode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug)
+bool encode_map_struct(std::vector<IO_WorkHandle>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug)
 {
-    std::shared_ptr<IO_Work> iop;
+    IO_WorkHandle iop;
     
     // iop->reg_type = item->reg_type;
     // iop->offset = item->offset;
@@ -899,6 +933,7 @@ bool encode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_p
         //item->reg8[0] = bval;
         //iop->u8_buff[0] = bval;
         iop->buf8[0] = bval;
+        iop->items.push_back(item.get());
         wvec.emplace_back(iop);
     }
     else if (item->reg_type == cfg::Register_Types::Holding)
@@ -915,10 +950,18 @@ bool encode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_p
             item->is_forced = false;
         }
         auto uval = getanyuval(item, val, iop->buf16);
+        // a bit range leaves the rest of its packed register alone
+        if (item->packer && item->size == 1 && item->number_of_bits > 0 && item->number_of_bits < 16)
+        {
+            iop->set_mask = static_cast<u16>(((1u << item->number_of_bits) - 1) << item->starting_bit_pos);
+        }
+        iop->items.push_back(item.get());
         if (uri.is_force_request)
         {
             item->is_forced = true;
-            item->forced_val = uval;
+            auto mindex = map_index();
+            if (auto points = mindex ? mindex->store(*item) : nullptr)
+                points->forced_val[item->point_id] = uval;
         }
 
         std::cout << ">>>>" <<__func__<< " uval " << uval << std::endl;
@@ -971,8 +1014,8 @@ bool encode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_p
     return true;
 }
 
-bool encode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug);
-bool decode_map_struct(std::vector<std::shared_ptr<IO_Work>>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug);
+bool encode_map_struct(std::vector<IO_WorkHandle>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug);
+bool decode_map_struct(std::vector<IO_WorkHandle>&wvec, std::shared_ptr<cfg::map_struct>item, std::any val, struct cfg& myCfg, Uri_req& uri, bool debug);
 
 
 bool uri_is_single( std::shared_ptr<cfg::map_struct>& var_result, struct cfg& myCfg, struct Uri_req& uri, bool debug)
@@ -1019,12 +1062,12 @@ bool uri_is_single( std::shared_ptr<cfg::map_struct>& var_result, struct cfg& my
     return single;
 }
 
-bool pollWork (std::shared_ptr<IO_Work> io_work);
+bool pollWork (IO_WorkHandle io_work);
 
-ioChannel<std::shared_ptr<IO_Work>> io_respChan;      // Use Channel to send IO-Work to thread
+ioChannel<IO_WorkHandle> io_respChan;      // Use Channel to send IO-Work to thread
 
 void clearChan(bool debug) {
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     double delay = 0.1;
     if (debug) {
         std::cout << " Clearing respChan" << std::endl;
@@ -1037,6 +1080,7 @@ void clearChan(bool debug) {
             << "  number "<< io_work.get()->num_registers
             << std::endl;
         }            
+        ioWorkPool.release(io_work);
     }
     if (debug) {
         std::cout << " Cleared respChan" << std::endl;
@@ -1058,14 +1102,33 @@ void clearChan(bool debug) {
 
 // };
 
+bool send_set(fims& fims_gateway, std::string_view uri, std::string_view body) noexcept;
+
 bool test_uri_body(struct cfg& myCfg, const char *uri, const char* method, const char*pname,const char*uname,const char*repto, const char* body) {
 
  
  
+    // the router resolves the whole uri in one lookup, the split and itemMap walk is the fallback
     std::string_view uri_view;
-    Uri_req uri_req(uri_view, uri);
-
+    Uri_req uri_req(uri_view, uri, false);
 
+    // the timing histograms, see gcom_perf.h
+    if (uri_req.is_timings_request || uri_req.is_reset_timings_request)
+    {
+        auto& registry = PerfRegistry::get();
+        if (uri_req.is_reset_timings_request)
+            registry.reset();
+        auto timings = registry.timings_json();
+        if (repto && *repto)
+            send_set(myCfg.fims_gateway, repto, timings);
+        else
+            std::cout << __func__<< "  timings " << timings << std::endl ;
+        return true;
+    }
+    auto mindex = map_index();
+    const UriRouter::Route* route = mindex ? mindex->router.find(uri_view) : nullptr;
+    if (!route)
+        uri_req.splitUri(uri_view);
 
     // if (std::string(method) == "set") {
     //     std::cout << myCfg.client_name <<" detected set method, uri :"<< uri << "\n" ;
@@ -1074,9 +1137,9 @@ bool test_uri_body(struct cfg& myCfg, const char *uri, const char* method, const
     //     std::cout << "detected other method\n" ;
     // }
 
-    // create an any object from the data
-    std::any gcom_data;
-    gcom_parse_data(gcom_data, body, strlen(body), true);
+    // the body is decoded straight onto the items, see gcom_fims_body.h
+    auto& decoder = FimsBodyDecoder::local();
+    size_t body_len = body ? strlen(body) : 0;
 
     // std::cout << __func__<< "   decode body [" << body << "]"<< std::endl ;
 
@@ -1086,31 +1149,52 @@ bool test_uri_body(struct cfg& myCfg, const char *uri, const char* method, const
     //look for a single
     bool debug = true;
     std::shared_ptr<cfg::map_struct> var;
-    std::vector<std::shared_ptr<IO_Work>>wvec;
+    std::vector<IO_WorkHandle>wvec;
     
     // have to look for _disable / _enable  / _force /_unforce
 
-    if (uri_is_single(var, myCfg, uri_req, debug))
+    bool single = false;
+    if (route)
+    {
+        single = route->point_id >= 0;
+        // shares the index's ownership, the snapshot keeps the item alive
+        if (single)
+            var = std::shared_ptr<cfg::map_struct>(mindex, mindex->items[route->point_id]);
+    }
+    else
+    {
+        single = uri_is_single(var, myCfg, uri_req, debug);
+    }
+
+    if (single)
     {
         if (std::string(method) == "set") 
         {
             std::cout << __func__<< "  found Set single [" << uri << "]" << std::endl ;
+            SetValue val;
+            if (!decoder.decode_single(body, body_len, val))
+            {
+                std::cout << __func__<< "  unable to decode body [" << (body ? body : "") << "]" << std::endl ;
+                return false;
+            }
             //auto ok = 
-            encode_map_struct(wvec, var, gcom_data, myCfg, uri_req, debug);
+            encode_map_struct(wvec, var, val.to_any(), myCfg, uri_req, debug);
             std::cout << __func__<< "  wvec size  [" << wvec.size() << "]" << std::endl ;
-            auto io_work = wvec.begin();
-            if (io_work != wvec.end()) 
+            for (auto io_work : wvec)
             { 
-                (*io_work)->io_repChan = &io_respChan;
-                pollWork (*io_work);
-                wvec.erase(io_work);
+                io_work->io_repChan = &io_respChan;
             }
-            clearChan(true);
+            // held for connection.set_batch_window, see gcom_set_batch.h
+            setBatcher.add(wvec);
+            wvec.clear();
+            // with a window the set is still held, the batcher's deadline sends it and its response comes later
+            if (myCfg.connection.set_batch_window <= 0.0)
+                clearChan(true);
         }
         else if (std::string(method) == "get") {
             std::cout << __func__<< "  found Get single [" << uri << "]" << std::endl ;
             //auto ok = 
-            decode_map_struct(wvec, var, gcom_data, myCfg, uri_req, debug);
+            decode_map_struct(wvec, var, std::any(), myCfg, uri_req, debug);
             std::cout << __func__<< "  wvec size  [" << wvec.size() << "]" << std::endl ;
             auto io_work = wvec.begin();
             if (io_work != wvec.end()) 
@@ -1128,34 +1212,30 @@ bool test_uri_body(struct cfg& myCfg, const char *uri, const char* method, const
         if (std::string(method) == "set") 
         {
             std::cout << __func__<< "  processing set multi [" << uri << "]" << std::endl ;
-            if (gcom_data.type() == typeid(std::map<std::string, std::any>)) {
-                std::cout << " found map\n";
-                auto baseMap = std::any_cast<std::map<std::string, std::any>>(gcom_data);
-                for (const auto& [key, value] : baseMap) {
-                    auto vok = test_findMapVar(var, myCfg, uri_req.uriv, key);
-                    if(vok) 
-                    {
-                        encode_map_struct(wvec, var, value, myCfg, uri_req, debug);
-                        std::cout << " found :"<< key << " offset "<< var->offset<<std::endl;
-                    }
-                    else
-                    {
-                        std::cout << " Not found :"<< key <<std::endl;
-                    }
-
+            auto items = route ? &mindex->router.groups[route->group].items : myCfg.findMapItem(uri_req.uriv);
+            static thread_local FimsBodyDecoder::Result result;
+            result.clear();
+            int missing = 0;
+            if (items && decoder.decode_multi(body, body_len, *items, result, &missing)) {
+                for (const auto& [item, value] : result) {
+                    encode_map_struct(wvec, item, value.to_any(), myCfg, uri_req, debug);
+                    std::cout << " found :"<< item->id << " offset "<< item->offset<<std::endl;
                 }
-                //printMap(std::any_cast<std::map<std::string, std::any>>(value), indent + 1);
-
+                if (missing)
+                    std::cout << " Not found :"<< missing << " keys" <<std::endl;
+            }
+            else
+            {
+                std::cout << " unable to decode body [" << (body ? body : "") << "]" <<std::endl;
             }
             std::cout << __func__<< "  wvec size  [" << wvec.size() << "]" << std::endl ;
 
-            // TODO comperss this
-            //std::vector<std::shared_ptr<IO_Work>>wvec;
             for (auto io_work : wvec)
             { 
                 (io_work)->io_repChan = &io_respChan;
-                pollWork (io_work);
             }
+            // adjacent registers go out as one write
+            setBatcher.add(wvec);
             wvec.clear();
         }
         else if (std::string(method) == "get") 
@@ -3584,6 +3664,9 @@ bool extract_maps(std::shared_ptr<struct cfg::reg_struct>reg, std::shared_ptr<st
                 if (map->deadband > 0.0) map->use_deadband = true;
                 getItemFromMap(mapData, "use_bool",             map->use_bool,          pmap->use_bool,                         true, true, debug);
 
+                // all the decode flags are in now
+                map->decode = select_decode_kernel(*map);
+
 
                 if ((map->is_enum) 
                         || (map->is_random_enum) 
@@ -3595,8 +3678,6 @@ bool extract_maps(std::shared_ptr<struct cfg::reg_struct>reg, std::shared_ptr<st
                 }
 
                 map->offtime = 0;
-                map->forced_val = 0;
-                map->raw_val = 0;
                 map->device_id = reg->device_id;
                 map->packer = packed;
                 if(!packed)
@@ -3730,6 +3811,12 @@ bool extract_connection(std::map<std::string, std::any>gcom_map, const std::stri
     if(!getItemFromMap(gcom_map, "connection.device_id",            myCfg.connection.device_id,  1,                        true,true,false)) ok = false;
     if(!getItemFromMap(gcom_map, "connection.connection_timeout",   myCfg.connection.connection_timeout,  2,               true,true,false)) ok = false;
     if(!getItemFromMap(gcom_map, "connection.max_num_connections",  myCfg.connection.max_num_connections, 1,              true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.max_poll_gap",         myCfg.connection.max_poll_gap,        0,              true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.pipeline_depth",       myCfg.connection.pipeline_depth,      0,              true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.reactor_threads",      myCfg.connection.reactor_threads,     0,              true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.pub_on_change",        myCfg.connection.pub_on_change,       false,          true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.full_pub_interval",    myCfg.connection.full_pub_interval,   10.0,           true,true,false)) ok = false;
+    if(!getItemFromMap(gcom_map, "connection.set_batch_window",     myCfg.connection.set_batch_window,    0.0,            true,true,false)) ok = false;
     if (ok)
     {
         if (myCfg.connection.connection_timeout < 2 || myCfg.connection.connection_timeout > 10)
@@ -3737,6 +3824,26 @@ bool extract_connection(std::map<std::string, std::any>gcom_map, const std::stri
             // TODO error log
             myCfg.connection.connection_timeout = 2;
         }
+        if (myCfg.connection.max_poll_gap < 0 || myCfg.connection.max_poll_gap > MAX_POLL_REGISTERS)
+        {
+            myCfg.connection.max_poll_gap = 0;
+        }
+        if (myCfg.connection.pipeline_depth < 0)
+        {
+            myCfg.connection.pipeline_depth = 0;
+        }
+        if (myCfg.connection.reactor_threads < 0)
+        {
+            myCfg.connection.reactor_threads = 0;
+        }
+        if (myCfg.connection.full_pub_interval < 0.0)
+        {
+            myCfg.connection.full_pub_interval = 0.0;
+        }
+        if (myCfg.connection.set_batch_window < 0.0)
+        {
+            myCfg.connection.set_batch_window = 0.0;
+        }
     }
     if(true|| debug) {
             printf(" >>>>>>>>>>>>> <%s>  device_id %d\n"
@@ -4324,7 +4431,7 @@ bool compareMapS(const std::shared_ptr<cfg::map_struct>& a, const std::shared_pt
 
 
 // TODO start with a blank result vector
-void check_work_items( std::vector<std::shared_ptr<IO_Work>>& io_work_vec, std::vector<std::shared_ptr<cfg::map_struct>>& io_map_vec, struct cfg & myCfg, const char* oper,bool debug)
+void check_work_items( std::vector<IO_WorkHandle>& io_work_vec, std::vector<std::shared_ptr<cfg::map_struct>>& io_map_vec, struct cfg & myCfg, const char* oper,bool debug)
 {
     // Sort the vector using the custom comparison function
 
@@ -4373,7 +4480,7 @@ void check_work_items( std::vector<std::shared_ptr<IO_Work>>& io_work_vec, std::
             isize = item->size;
             reg_type = item->reg_type;
 
-            io_work->items.emplace_back(item);
+            io_work->items.emplace_back(item.get());
 
             if(debug)
                 std::cout << " >>>>>>>>>>>> state  #1 offset " << offset 
@@ -4438,14 +4545,14 @@ void check_work_items( std::vector<std::shared_ptr<IO_Work>>& io_work_vec, std::
                 isize = item->size;
                 reg_type = item->reg_type;
 
-                io_work->items.emplace_back(item);
+                io_work->items.emplace_back(item.get());
             }
             else
             {
                 offset += isize;
                 isize = item->size;
                 num += item->size;
-                io_work->items.emplace_back(item);
+                io_work->items.emplace_back(item.get());
                 std::cout << " >>>>>>>>>>>> state  #3 offset " << offset << " isize " << isize <<" item->offset " << item->offset << " item size " << item->size << std::endl;
 
             }
@@ -4467,6 +4574,7 @@ void check_work_items( std::vector<std::shared_ptr<IO_Work>>& io_work_vec, std::
 /// @param enabled 
 /// @param item 
 /// @param debug 
+//     the debounce_time lives in the PointStore, PointStore::debounce_scan does a list of items in one pass
 void check_item_debounce(bool &enabled, std::shared_ptr<cfg::map_struct> item, bool debug)
 {
     double tNow = get_time_double();
@@ -4474,45 +4582,41 @@ void check_item_debounce(bool &enabled, std::shared_ptr<cfg::map_struct> item, b
     {
         if(debug)
             std::cout << " item id " << item->id << " using_debounce" << std::endl;
-        if(item->debounce == 0.0)   // && (item->debounce > 0.0) && (io_work->tIo > item->debounce_time))
+        auto mindex = map_index();
+        auto points = mindex ? mindex->store(*item) : nullptr;
+        if(item->debounce == 0.0)
         {
             if(debug)
                 std::cout << " item id" << item->id  << " debounce is zero " << std::endl;
             item->use_debounce = false;
         }
-        else if(item->debounce_time == 0.0)
+        else if(!points)
         {
-            item->debounce_time = ( tNow + item->debounce);
+            // not part of the current load, nowhere to keep the debounce time
             if(debug)
-                std::cout << " debounce time set up  :" << item->debounce_time << std::endl;
+                std::cout << " item id" << item->id  << " has no point " << std::endl;
         }
-        else
+        else if(!points->debounce_check(item->point_id, tNow))
         {
-            if( tNow > item->debounce_time)
-            {
-                if(debug)
-                    std::cout << " debounce time   :" << item->debounce_time << " passed: tNow: " << tNow << std::endl;
-                item->debounce_time += item->debounce;
-            }
-            else
-            {
-                if(debug)
-                    std::cout << " still in debounce time :" << item->debounce_time <<  " tNow: " << tNow << std::endl;
-                enabled =  false;
-            }
+            if(debug)
+                std::cout << " still in debounce time :" << points->debounce_time[item->point_id] <<  " tNow: " << tNow << std::endl;
+            enabled =  false;
+        }
+        else if(debug)
+        {
+            std::cout << " debounce time   :" << points->debounce_time[item->point_id] << " passed: tNow: " << tNow << std::endl;
         }
-    
     }
 }
 
 
-void runThreadWork(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work> io_work, bool debug);
+void runThreadWork(std::shared_ptr<IO_Thread> io_thread, IO_WorkHandle io_work, bool debug);
 //std::shared_ptr<IO_Thread> make_IO_Thread(i, ip, port , connection_timeout, myCfg);
 std::shared_ptr<IO_Thread> make_IO_Thread(int idx, const char* ip, int port, int connection_timeout, struct cfg& myCfg);
 double SetupModbusForThread(std::shared_ptr<IO_Thread> io_thread, bool debug);
 bool CloseModbusForThread(std::shared_ptr<IO_Thread> io_thread, bool debug);
 void buffer_work(cfg::Register_Types reg_type, int device_id, int offset, int num_regs);
-void gcom_modbus_decode(std::shared_ptr<IO_Work>io_work, std::stringstream &ss, struct cfg& myCfg);
+void gcom_modbus_decode(IO_WorkHandle io_work, std::stringstream &ss, struct cfg& myCfg);
 
 
 //return StartThreads(myCfg.connection.max_num_connections, myCfg.connection.ip_address.c_str(), myCfg.connection.port, myCfg.connection.connection_timeout, myCfg);
@@ -4576,7 +4680,7 @@ bool gcom_points_test(std::map<std::string, std::any>gcom_map, struct cfg& myCfg
                                 <<  "\tsize " << item->size  
                                 <<  "\tdevice_id " << item->device_id  
                                 << std::endl;
-                    std::shared_ptr<IO_Work> io_work;
+                    IO_WorkHandle io_work;
                         
                     {
 
@@ -4629,7 +4733,7 @@ bool gcom_points_test(std::map<std::string, std::any>gcom_map, struct cfg& myCfg
 
                     if(enabled) 
                     {
-                        io_work->items.emplace_back(item);
+                        io_work->items.emplace_back(item.get());
                         // double tNow = get_time_double();
 
                         // std::cout   << ">>>>>>>> start time #2 :" << tNow  
@@ -4688,6 +4792,7 @@ bool gcom_points_test(std::map<std::string, std::any>gcom_map, struct cfg& myCfg
                             << item->size
                             << "\n\n"
                             << std::endl;
+                        ioWorkPool.release(io_work);
 
                     }
                     //jobs += io_work->jobs;
@@ -4836,7 +4941,7 @@ bool gcom_point_type_test(std::map<std::string, std::any>gcom_map, struct cfg& m
                 //continue;
                 //std::shared_ptr<IO_Work> io_work;
 
-                std::vector<std::shared_ptr<IO_Work>> io_work_vec;
+                std::vector<IO_WorkHandle> io_work_vec;
                 std::vector<std::shared_ptr<cfg::map_struct>> io_map_vec;
                         
                 // {
@@ -0,0 +1,744 @@
+// gcom_config_cache.cpp
+// binary snapshot of the extracted config, see gcom_config_cache.h
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gcom_config_cache.h"
+#include "gcom_decode_kernel.h"
+
+bool extract_connection(std::map<std::string, std::any>gcom_map, const std::string& query, struct cfg& myCfg, bool debug);
+bool extract_components(std::map<std::string, std::any>gcom_map, const std::string& query, struct cfg& myCfg, bool debug);
+void addMapItem(MapItemMap& imap, const char* comp, const char* uri, std::shared_ptr<cfg::map_struct> item);
+
+namespace {
+
+const char cache_magic[8] = {'G', 'C', 'O', 'M', 'C', 'F', 'G', '\0'};
+
+struct StrRef {
+    u32 off;
+    u32 len;
+};
+
+struct Section {
+    u64 off;
+    u64 count;
+};
+
+struct ConnRec {
+    StrRef device_name;
+    StrRef name;
+    StrRef ip_address;
+    int32_t port;
+    int32_t max_num_connections;
+    int32_t device_id;
+    int32_t connection_timeout;
+    int32_t max_poll_gap;
+    int32_t pipeline_depth;
+    int32_t reactor_threads;
+    u8 debug;
+    u8 pub_on_change;
+    u8 pad[2];
+    double full_pub_interval;
+    double set_batch_window;
+};
+
+struct Header {
+    char magic[8];
+    u32 version;
+    u32 header_size;
+    u64 hash;
+    u64 file_size;
+    Section comps;
+    Section regs;
+    Section maps;
+    Section strs;
+    Section ints;
+    Section chars;
+    ConnRec conn;
+};
+
+struct CompRec {
+    StrRef id;
+    StrRef comp_id;
+    int32_t frequency;
+    int32_t offset_time;
+    int32_t device_id;
+    u32 first_reg;
+    u32 num_regs;
+    u8 is_word_swap;
+    u8 is_byte_swap;
+    u8 pad[2];
+};
+
+struct RegRec {
+    StrRef type;
+    StrRef id;
+    StrRef comp_id;
+    int32_t reg_type;
+    int32_t starting_offset;
+    int32_t number_of_registers;
+    int32_t device_id;
+    u32 first_map;    // the root maps of this reg
+    u32 num_maps;
+    u8 is_word_swap;
+    u8 is_byte_swap;
+    u8 enabled;
+    u8 pad[5];
+};
+
+// MapRec::flags
+constexpr u32 Normal_Set      = 1u << 0;
+constexpr u32 Signed          = 1u << 1;
+constexpr u32 Float           = 1u << 2;
+constexpr u32 Word_Swap       = 1u << 3;
+constexpr u32 Byte_Swap       = 1u << 4;
+constexpr u32 Enum            = 1u << 5;
+constexpr u32 Random_Enum     = 1u << 6;
+constexpr u32 Individual_Bits = 1u << 7;
+constexpr u32 Bit_Field       = 1u << 8;
+constexpr u32 Use_Debounce    = 1u << 9;
+constexpr u32 Use_Deadband    = 1u << 10;
+constexpr u32 Use_Bool        = 1u << 11;
+constexpr u32 Packed_Register = 1u << 12;
+
+struct MapRec {
+    StrRef id;
+    StrRef name;
+    StrRef rtype;
+    double scale;
+    double debounce;
+    double deadband;
+    double offtime;
+    u64 invert_mask;
+    u64 care_mask;
+    u64 bits_known;
+    u64 bits_unknown;
+    int32_t offset;
+    int32_t size;
+    int32_t starting_bit_pos;
+    int32_t number_of_bits;
+    int32_t shift;
+    int32_t reg_type;
+    int32_t device_id;
+    u32 flags;
+    u32 first_str;     // bit_str in strs
+    u32 num_str;
+    u32 first_num;     // bit_str_num in ints
+    u32 num_num;
+    u32 first_range;   // bit_ranges in maps
+    u32 num_ranges;
+};
+
+static_assert(std::is_trivially_copyable<Header>::value, "cache records are copied as bytes");
+static_assert(sizeof(Header) % 8 == 0 && sizeof(CompRec) % 8 == 0 && sizeof(RegRec) % 8 == 0
+              && sizeof(MapRec) % 8 == 0 && sizeof(StrRef) % 8 == 0,
+              "cache records keep the sections 8 byte aligned");
+
+class CacheWriter {
+public:
+    std::string build(u64 hash, const cfg& myCfg, size_t first_comp) {
+        conn(myCfg.connection);
+        for (size_t c = first_comp; c < myCfg.components.size(); ++c)
+            comp(*myCfg.components[c]);
+
+        Header head;
+        memset(&head, 0, sizeof(head));
+        memcpy(head.magic, cache_magic, sizeof(head.magic));
+        head.version = CONFIG_CACHE_VERSION;
+        head.header_size = sizeof(Header);
+        head.hash = hash;
+        head.conn = conn_rec;
+
+        std::string out(sizeof(Header), '\0');
+        head.comps = append(out, comps);
+        head.regs = append(out, regs);
+        head.maps = append(out, maps);
+        head.strs = append(out, strs);
+        head.ints = append(out, ints);
+        head.chars = {out.size(), chars.size()};
+        out += chars;
+        head.file_size = out.size();
+        memcpy(&out[0], &head, sizeof(head));
+        return out;
+    }
+
+private:
+    template <typename T>
+    static Section append(std::string& out, const std::vector<T>& recs) {
+        Section sec = {out.size(), recs.size()};
+        out.append(reinterpret_cast<const char*>(recs.data()), recs.size() * sizeof(T));
+        return sec;
+    }
+
+    StrRef str(const std::string& s) {
+        auto it = seen.find(s);
+        if (it != seen.end())
+            return it->second;
+        StrRef ref = {(u32)chars.size(), (u32)s.size()};
+        chars += s;
+        seen.emplace(s, ref);
+        return ref;
+    }
+
+    void conn(const cfg::connect_struct& c) {
+        memset(&conn_rec, 0, sizeof(conn_rec));
+        conn_rec.device_name = str(c.device_name);
+        conn_rec.name = str(c.name);
+        conn_rec.ip_address = str(c.ip_address);
+        conn_rec.port = c.port;
+        conn_rec.max_num_connections = c.max_num_connections;
+        conn_rec.device_id = c.device_id;
+        conn_rec.connection_timeout = c.connection_timeout;
+        conn_rec.max_poll_gap = c.max_poll_gap;
+        conn_rec.pipeline_depth = c.pipeline_depth;
+        conn_rec.reactor_threads = c.reactor_threads;
+        conn_rec.debug = c.debug;
+        conn_rec.pub_on_change = c.pub_on_change;
+        conn_rec.full_pub_interval = c.full_pub_interval;
+        conn_rec.set_batch_window = c.set_batch_window;
+    }
+
+    void comp(const cfg::comp_struct& comp) {
+        CompRec rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.id = str(comp.id);
+        rec.comp_id = str(comp.comp_id);
+        rec.frequency = comp.frequency;
+        rec.offset_time = comp.offset_time;
+        rec.device_id = comp.device_id;
+        rec.is_word_swap = comp.is_word_swap;
+        rec.is_byte_swap = comp.is_byte_swap;
+        rec.first_reg = regs.size();
+        rec.num_regs = comp.registers.size();
+        comps.push_back(rec);
+        for (auto& reg : comp.registers)
+            this->reg(*reg);
+    }
+
+    void reg(const cfg::reg_struct& reg) {
+        RegRec rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = str(reg.type);
+        rec.id = str(reg.id);
+        rec.comp_id = str(reg.comp_id);
+        rec.reg_type = (int32_t)reg.reg_type;
+        rec.starting_offset = reg.starting_offset;
+        rec.number_of_registers = reg.number_of_registers;
+        rec.device_id = reg.device_id;
+        rec.is_word_swap = reg.is_word_swap;
+        rec.is_byte_swap = reg.is_byte_swap;
+        rec.enabled = reg.enabled;
+        rec.first_map = run(reg.maps);
+        rec.num_maps = reg.maps.size();
+        regs.push_back(rec);
+    }
+
+    // the records of a run sit together, each one's bit ranges go in after the whole run
+    u32 run(const std::vector<std::shared_ptr<cfg::map_struct>>& items) {
+        u32 first = maps.size();
+        maps.resize(maps.size() + items.size());
+        for (size_t i = 0; i < items.size(); ++i)
+            map(first + i, *items[i]);
+        return first;
+    }
+
+    void map(size_t idx, const cfg::map_struct& map) {
+        MapRec rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.id = str(map.id);
+        rec.name = str(map.name);
+        rec.rtype = str(map.rtype);
+        rec.scale = map.scale;
+        rec.debounce = map.debounce;
+        rec.deadband = map.deadband;
+        rec.offtime = map.offtime;
+        rec.invert_mask = map.invert_mask;
+        rec.care_mask = map.care_mask;
+        rec.bits_known = map.bits_known;
+        rec.bits_unknown = map.bits_unknown;
+        rec.offset = map.offset;
+        rec.size = map.size;
+        rec.starting_bit_pos = map.starting_bit_pos;
+        rec.number_of_bits = map.number_of_bits;
+        rec.shift = map.shift;
+        rec.reg_type = (int32_t)map.reg_type;
+        rec.device_id = map.device_id;
+        rec.flags = (map.normal_set         ? Normal_Set      : 0)
+                  | (map.is_signed          ? Signed          : 0)
+                  | (map.is_float           ? Float           : 0)
+                  | (map.is_word_swap       ? Word_Swap       : 0)
+                  | (map.is_byte_swap       ? Byte_Swap       : 0)
+                  | (map.is_enum            ? Enum            : 0)
+                  | (map.is_random_enum     ? Random_Enum     : 0)
+                  | (map.is_individual_bits ? Individual_Bits : 0)
+                  | (map.is_bit_field       ? Bit_Field       : 0)
+                  | (map.use_debounce       ? Use_Debounce    : 0)
+                  | (map.use_deadband       ? Use_Deadband    : 0)
+                  | (map.use_bool           ? Use_Bool        : 0)
+                  | (map.packed_register    ? Packed_Register : 0);
+        rec.first_str = strs.size();
+        rec.num_str = map.bit_str.size();
+        for (auto& s : map.bit_str)
+            strs.push_back(str(s));
+        rec.first_num = ints.size();
+        rec.num_num = map.bit_str_num.size();
+        for (int n : map.bit_str_num)
+            ints.push_back(n);
+        rec.num_ranges = map.bit_ranges.size();
+        rec.first_range = run(map.bit_ranges);
+        maps[idx] = rec;
+    }
+
+    ConnRec conn_rec;
+    std::vector<CompRec> comps;
+    std::vector<RegRec> regs;
+    std::vector<MapRec> maps;
+    std::vector<StrRef> strs;
+    std::vector<int32_t> ints;
+    std::string chars;
+    std::unordered_map<std::string, StrRef> seen;
+};
+
+class CacheReader {
+public:
+    CacheReader(const char* base, size_t size) : base(base), size(size) {}
+
+    bool load(u64 hash, cfg& myCfg) {
+        if (size < sizeof(Header))
+            return false;
+        head = reinterpret_cast<const Header*>(base);
+        if (memcmp(head->magic, cache_magic, sizeof(cache_magic)) != 0
+                || head->version != CONFIG_CACHE_VERSION
+                || head->header_size != sizeof(Header)
+                || head->hash != hash
+                || head->file_size != size)
+            return false;
+        if (!table(head->comps, comps) || !table(head->regs, regs) || !table(head->maps, maps)
+                || !table(head->strs, strs) || !table(head->ints, ints)
+                || head->chars.off > size || head->chars.count > size - head->chars.off)
+            return false;
+        chars = base + head->chars.off;
+
+        // built to the side, myCfg only changes once the whole cache has checked out
+        cfg::connect_struct connection = myCfg.connection;
+        const ConnRec& c = head->conn;
+        connection.device_name = str(c.device_name);
+        connection.name = str(c.name);
+        connection.ip_address = str(c.ip_address);
+        connection.port = c.port;
+        connection.max_num_connections = c.max_num_connections;
+        connection.device_id = c.device_id;
+        connection.connection_timeout = c.connection_timeout;
+        connection.max_poll_gap = c.max_poll_gap;
+        connection.pipeline_depth = c.pipeline_depth;
+        connection.reactor_threads = c.reactor_threads;
+        connection.debug = c.debug;
+        connection.pub_on_change = c.pub_on_change;
+        connection.full_pub_interval = c.full_pub_interval;
+        connection.set_batch_window = c.set_batch_window;
+
+        std::vector<std::shared_ptr<cfg::comp_struct>> components;
+        components.reserve(head->comps.count);
+        for (u64 i = 0; i < head->comps.count; ++i) {
+            const CompRec& rec = comps[i];
+            auto comp = std::make_shared<cfg::comp_struct>();
+            comp->id = str(rec.id);
+            comp->comp_id = str(rec.comp_id);
+            comp->frequency = rec.frequency;
+            comp->offset_time = rec.offset_time;
+            comp->device_id = rec.device_id;
+            comp->is_word_swap = rec.is_word_swap;
+            comp->is_byte_swap = rec.is_byte_swap;
+            if (!in(rec.first_reg, rec.num_regs, head->regs.count))
+                return false;
+            for (u32 r = rec.first_reg; r < rec.first_reg + rec.num_regs; ++r)
+                comp->registers.push_back(reg(regs[r]));
+            components.push_back(comp);
+        }
+        if (!ok)
+            return false;
+
+        myCfg.connection = connection;
+        for (auto& comp : components)
+            myCfg.components.push_back(comp);
+        for (auto& item : items)
+            addMapItem(myCfg.itemMap, item.first->comp_id.c_str(), item.first->id.c_str(), item.second);
+        return true;
+    }
+
+private:
+    template <typename T>
+    bool table(const Section& sec, const T*& recs) {
+        if (sec.off % 8 != 0 || sec.off > size || sec.count > (size - sec.off) / sizeof(T))
+            return false;
+        recs = reinterpret_cast<const T*>(base + sec.off);
+        return true;
+    }
+
+    static bool in(u64 first, u64 num, u64 count) {
+        return first <= count && num <= count - first;
+    }
+
+    std::string str(const StrRef& ref) {
+        if (!in(ref.off, ref.len, head->chars.count)) {
+            ok = false;
+            return std::string();
+        }
+        return std::string(chars + ref.off, ref.len);
+    }
+
+    std::shared_ptr<cfg::reg_struct> reg(const RegRec& rec) {
+        auto reg = std::make_shared<cfg::reg_struct>();
+        reg->type = str(rec.type);
+        reg->id = str(rec.id);
+        reg->comp_id = str(rec.comp_id);
+        reg->reg_type = (cfg::Register_Types)rec.reg_type;
+        reg->starting_offset = rec.starting_offset;
+        reg->number_of_registers = rec.number_of_registers;
+        reg->device_id = rec.device_id;
+        reg->is_word_swap = rec.is_word_swap;
+        reg->is_byte_swap = rec.is_byte_swap;
+        reg->enabled = rec.enabled;
+        if (!in(rec.first_map, rec.num_maps, head->maps.count)) {
+            ok = false;
+            return reg;
+        }
+        for (u32 m = rec.first_map; m < rec.first_map + rec.num_maps && ok; ++m) {
+            auto map = this->map(maps[m], reg, nullptr, 0);
+            reg->maps.push_back(map);
+            reg->mapix[map->offset] = map;
+        }
+        return reg;
+    }
+
+    // same order as extract_maps, the item goes into the itemMap ahead of its bit ranges
+    std::shared_ptr<cfg::map_struct> map(const MapRec& rec, const std::shared_ptr<cfg::reg_struct>& reg,
+                                         const std::shared_ptr<cfg::map_struct>& packer, int depth) {
+        auto map = std::make_shared<cfg::map_struct>();
+        map->id = str(rec.id);
+        map->name = str(rec.name);
+        map->rtype = str(rec.rtype);
+        map->scale = rec.scale;
+        map->debounce = rec.debounce;
+        map->deadband = rec.deadband;
+        map->offtime = rec.offtime;
+        map->invert_mask = rec.invert_mask;
+        map->care_mask = rec.care_mask;
+        map->bits_known = rec.bits_known;
+        map->bits_unknown = rec.bits_unknown;
+        map->offset = rec.offset;
+        map->size = rec.size;
+        map->starting_bit_pos = rec.starting_bit_pos;
+        map->number_of_bits = rec.number_of_bits;
+        map->shift = rec.shift;
+        map->reg_type = (cfg::Register_Types)rec.reg_type;
+        map->device_id = rec.device_id;
+        map->normal_set         = rec.flags & Normal_Set;
+        map->is_signed          = rec.flags & Signed;
+        map->is_float           = rec.flags & Float;
+        map->is_word_swap       = rec.flags & Word_Swap;
+        map->is_byte_swap       = rec.flags & Byte_Swap;
+        map->is_enum            = rec.flags & Enum;
+        map->is_random_enum     = rec.flags & Random_Enum;
+        map->is_individual_bits = rec.flags & Individual_Bits;
+        map->is_bit_field       = rec.flags & Bit_Field;
+        map->use_debounce       = rec.flags & Use_Debounce;
+        map->use_deadband       = rec.flags & Use_Deadband;
+        map->use_bool           = rec.flags & Use_Bool;
+        map->decode = select_decode_kernel(*map);
+        map->packed_register    = rec.flags & Packed_Register;
+        map->packer = packer;
+
+        if (!in(rec.first_str, rec.num_str, head->strs.count)
+                || !in(rec.first_num, rec.num_num, head->ints.count)
+                || !in(rec.first_range, rec.num_ranges, head->maps.count)
+                || (rec.num_ranges && depth > 0)) {
+            ok = false;
+            return map;
+        }
+        for (u32 s = rec.first_str; s < rec.first_str + rec.num_str; ++s)
+            map->bit_str.push_back(str(strs[s]));
+        map->bit_str_num.assign(ints + rec.first_num, ints + rec.first_num + rec.num_num);
+
+        items.emplace_back(reg, map);
+        for (u32 b = rec.first_range; b < rec.first_range + rec.num_ranges && ok; ++b)
+            map->bit_ranges.push_back(this->map(maps[b], reg, map, depth + 1));
+        return map;
+    }
+
+    const char* base;
+    size_t size;
+    const Header* head = nullptr;
+    const CompRec* comps = nullptr;
+    const RegRec* regs = nullptr;
+    const MapRec* maps = nullptr;
+    const StrRef* strs = nullptr;
+    const int32_t* ints = nullptr;
+    const char* chars = nullptr;
+    bool ok = true;
+    std::vector<std::pair<std::shared_ptr<cfg::reg_struct>, std::shared_ptr<cfg::map_struct>>> items;
+};
+
+}  // namespace
+
+bool config_file_hash(const char* filename, u64& hash) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    hash = 14695981039346656037ull;
+    for (unsigned char ch : content) {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return true;
+}
+
+std::string config_cache_name(const char* filename) {
+    return std::string(filename) + ".cache";
+}
+
+bool config_cache_load(const char* cache_file, u64 hash, struct cfg& myCfg) {
+    int fd = open(cache_file, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    bool ok = CacheReader(static_cast<const char*>(base), size).load(hash, myCfg);
+    munmap(base, size);
+    return ok;
+}
+
+bool config_cache_save(const char* cache_file, u64 hash, const struct cfg& myCfg, size_t first_comp) {
+    std::string image = CacheWriter().build(hash, myCfg, first_comp);
+    std::string tmp_file = std::string(cache_file) + ".tmp";
+    FILE* fp = fopen(tmp_file.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(image.data(), 1, image.size(), fp) == image.size();
+    ok &= fclose(fp) == 0;
+    if (ok)
+        ok = rename(tmp_file.c_str(), cache_file) == 0;
+    if (!ok)
+        unlink(tmp_file.c_str());
+    return ok;
+}
+
+
+static bool same_maps(const std::vector<std::shared_ptr<cfg::map_struct>>& a,
+                      const std::vector<std::shared_ptr<cfg::map_struct>>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        auto& x = *a[i];
+        auto& y = *b[i];
+        if (x.id != y.id || x.name != y.name || x.rtype != y.rtype || x.offset != y.offset || x.size != y.size
+                || x.shift != y.shift || x.starting_bit_pos != y.starting_bit_pos || x.number_of_bits != y.number_of_bits
+                || x.scale != y.scale || x.is_signed != y.is_signed || x.is_float != y.is_float
+                || x.invert_mask != y.invert_mask || x.care_mask != y.care_mask || x.decode != y.decode
+                || x.is_enum != y.is_enum || x.is_individual_bits != y.is_individual_bits
+                || x.bit_str != y.bit_str || x.bit_str_num != y.bit_str_num
+                || x.bits_known != y.bits_known || x.bits_unknown != y.bits_unknown
+                || x.packed_register != y.packed_register || !x.packer != !y.packer
+                || x.debounce != y.debounce || x.use_debounce != y.use_debounce
+                || x.reg_type != y.reg_type || x.device_id != y.device_id
+                || !same_maps(x.bit_ranges, y.bit_ranges))
+            return false;
+    }
+    return true;
+}
+
+static bool same_cfg(const cfg& a, const cfg& b) {
+    if (a.connection.ip_address != b.connection.ip_address || a.connection.port != b.connection.port
+            || a.connection.device_id != b.connection.device_id
+            || a.connection.max_poll_gap != b.connection.max_poll_gap
+            || a.components.size() != b.components.size())
+        return false;
+    for (size_t c = 0; c < a.components.size(); ++c) {
+        auto& x = *a.components[c];
+        auto& y = *b.components[c];
+        if (x.id != y.id || x.comp_id != y.comp_id || x.frequency != y.frequency || x.device_id != y.device_id
+                || x.registers.size() != y.registers.size())
+            return false;
+        for (size_t r = 0; r < x.registers.size(); ++r) {
+            auto& p = *x.registers[r];
+            auto& q = *y.registers[r];
+            if (p.type != q.type || p.reg_type != q.reg_type || p.starting_offset != q.starting_offset
+                    || p.number_of_registers != q.number_of_registers || p.device_id != q.device_id
+                    || p.mapix.size() != q.mapix.size() || !same_maps(p.maps, q.maps))
+                return false;
+        }
+    }
+    if (a.itemMap.size() != b.itemMap.size())
+        return false;
+    for (auto& [comp, uris] : a.itemMap) {
+        auto it = b.itemMap.find(comp);
+        if (it == b.itemMap.end() || it->second.size() != uris.size())
+            return false;
+        for (auto& [uri, items] : uris) {
+            auto uit = it->second.find(uri);
+            if (uit == it->second.end() || uit->second.size() != items.size())
+                return false;
+        }
+    }
+    return true;
+}
+
+// a site of num_comps components, each with an analog, an enum and a packed bits register
+static std::string bench_config_json(int num_comps) {
+    std::string js = "{\"connection\":{\"ip_address\":\"127.0.0.1\",\"port\":502,\"device_id\":1,\"max_poll_gap\":4},\"components\":[";
+    for (int c = 0; c < num_comps; ++c) {
+        std::string cid = "comp_" + std::to_string(c);
+        if (c)
+            js += ",";
+        js += "{\"id\":\"" + cid + "\",\"frequency\":1000,\"device_id\":" + std::to_string(1 + c % 8) + ",\"registers\":[";
+        js += "{\"type\":\"Holding\",\"starting_offset\":0,\"number_of_registers\":100,\"map\":[";
+        for (int m = 0; m < 50; ++m) {
+            if (m)
+                js += ",";
+            js += "{\"id\":\"" + cid + "_hr_" + std::to_string(m) + "\",\"name\":\"Holding " + std::to_string(m)
+                + "\",\"offset\":" + std::to_string(m * 2) + ",\"size\":2,\"scale\":10"
+                + (m % 3 ? ",\"signed\":true" : ",\"float\":true") + "}";
+        }
+        js += "]},{\"type\":\"Input\",\"starting_offset\":200,\"number_of_registers\":20,\"map\":[";
+        for (int m = 0; m < 20; ++m) {
+            if (m)
+                js += ",";
+            js += "{\"id\":\"" + cid + "_st_" + std::to_string(m) + "\",\"name\":\"Status " + std::to_string(m)
+                + "\",\"offset\":" + std::to_string(200 + m) + ",\"size\":1,\"enum\":true,"
+                + "\"bit_strings\":[\"Stopped\",{\"value\":1,\"string\":\"Running\"},{\"value\":4,\"string\":\"Fault\"}]}";
+        }
+        js += "]},{\"type\":\"Coil\",\"starting_offset\":300,\"number_of_registers\":1,\"map\":[";
+        js += "{\"id\":\"" + cid + "_alarms\",\"name\":\"Alarms\",\"offset\":300,\"size\":1,\"packed_register\":true,\"bit_ranges\":[";
+        for (int b = 0; b < 8; ++b) {
+            if (b)
+                js += ",";
+            js += "{\"id\":\"" + cid + "_alarm_" + std::to_string(b) + "\",\"name\":\"Alarm " + std::to_string(b)
+                + "\",\"starting_bit_pos\":" + std::to_string(b * 2) + ",\"number_of_bits\":2}";
+        }
+        js += "]}]}]}";
+    }
+    js += "]}";
+    return js;
+}
+
+// cold ( json parse + extract ) against warm ( hash + cache load ) config loads of num_comps components
+// the extracts print every item, stdout is sent to /dev/null while they run
+int bench_config_cache(int num_comps, int loops) {
+    int errors = 0;
+    using clk = std::chrono::steady_clock;
+    std::string json_file = "/tmp/gcom_bench_config_" + std::to_string(getpid()) + ".json";
+    std::string cache_file = config_cache_name(json_file.c_str());
+    {
+        std::ofstream out(json_file);
+        out << bench_config_json(num_comps);
+    }
+    unlink(cache_file.c_str());
+
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    auto quiet = [&](bool on) {
+        fflush(stdout);
+        std::cout.flush();
+        dup2(on ? null_fd : saved_stdout, STDOUT_FILENO);
+    };
+
+    // the last load of each kind is kept for the compare
+    auto keep = [](cfg& to, cfg& from) {
+        to.connection = from.connection;
+        to.components.swap(from.components);
+        to.itemMap.swap(from.itemMap);
+    };
+
+    cfg cold;
+    double t_cold = 0.0;
+    quiet(true);
+    for (int l = 0; l < loops; ++l) {
+        cfg myCfg;
+        std::map<std::string, std::any> gcom_map;
+        auto t0 = clk::now();
+        bool ok = gcom_parse_file(gcom_map, json_file.c_str(), false) == 0
+               && extract_connection(gcom_map, "connection", myCfg, false)
+               && extract_components(gcom_map, "components", myCfg, false);
+        t_cold += std::chrono::duration<double>(clk::now() - t0).count();
+        if (!ok)
+            errors++;
+        if (l == loops - 1)
+            keep(cold, myCfg);
+    }
+    quiet(false);
+
+    u64 hash = 0;
+    if (!config_file_hash(json_file.c_str(), hash) || !config_cache_save(cache_file.c_str(), hash, cold, 0)) {
+        std::cout << " bench_config_cache unable to write " << cache_file << std::endl;
+        errors++;
+    }
+
+    cfg warm;
+    double t_warm = 0.0;
+    for (int l = 0; l < loops; ++l) {
+        cfg myCfg;
+        auto t0 = clk::now();
+        u64 file_hash = 0;
+        bool ok = config_file_hash(json_file.c_str(), file_hash)
+               && config_cache_load(cache_file.c_str(), file_hash, myCfg);
+        t_warm += std::chrono::duration<double>(clk::now() - t0).count();
+        if (!ok)
+            errors++;
+        if (l == loops - 1)
+            keep(warm, myCfg);
+    }
+    if (!same_cfg(cold, warm)) {
+        std::cout << " bench_config_cache cached config differs from the json one" << std::endl;
+        errors++;
+    }
+
+    // a changed file or a damaged cache must fall back to the json
+    cfg stale;
+    if (config_cache_load(cache_file.c_str(), hash + 1, stale) || !stale.components.empty()) {
+        std::cout << " bench_config_cache loaded a cache for the wrong hash" << std::endl;
+        errors++;
+    }
+    struct stat st = {};
+    if (stat(cache_file.c_str(), &st) == 0 && truncate(cache_file.c_str(), st.st_size / 2) == 0
+            && config_cache_load(cache_file.c_str(), hash, stale)) {
+        std::cout << " bench_config_cache loaded a truncated cache" << std::endl;
+        errors++;
+    }
+
+    size_t num_items = 0;
+    for (auto& comp : warm.itemMap)
+        for (auto& uri : comp.second)
+            num_items += uri.second.size();
+    std::cout << " bench_config_cache components " << num_comps << " items " << num_items
+              << "  cold " << t_cold * 1000.0 / loops << " mS"
+              << "  warm " << t_warm * 1000.0 / loops << " mS"
+              << "  cache " << st.st_size << " bytes"
+              << "  speedup " << t_cold / t_warm << std::endl;
+    std::cout << " bench_config_cache errors " << errors << std::endl;
+
+    close(null_fd);
+    close(saved_stdout);
+    unlink(cache_file.c_str());
+    unlink(json_file.c_str());
+    return errors;
+}
@@ -0,0 +1,140 @@
+// gcom_decode_kernel.cpp
+// decode kernel table and bench_decode, see gcom_decode_kernel.h
+
+#include <any>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <utility>
+
+#include "gcom_config.h"
+#include "gcom_decode_kernel.h"
+
+u64 gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct* item, std::any& output, struct cfg& myCfg);
+
+// table index bits, size takes the top two
+//   size_idx << 5 | word_swap << 4 | masks << 3 | signed << 2 | float << 1 | scaled
+static constexpr int size_from_idx(size_t size_idx) {
+    return size_idx == 0 ? 1 : size_idx == 1 ? 2 : 4;
+}
+
+template <size_t I>
+static constexpr cfg::DecodeFn kernel_at() {
+    return &decode_kernel<size_from_idx(I >> 5), ((I >> 4) & 1) != 0, ((I >> 3) & 1) != 0,
+                          ((I >> 2) & 1) != 0, ((I >> 1) & 1) != 0, (I & 1) != 0>;
+}
+
+template <size_t... I>
+static constexpr std::array<cfg::DecodeFn, sizeof...(I)> make_kernel_table(std::index_sequence<I...>) {
+    return {{ kernel_at<I>()... }};
+}
+
+static constexpr auto decode_kernels = make_kernel_table(std::make_index_sequence<3 * 32>{});
+
+cfg::DecodeFn select_decode_kernel(const cfg::map_struct& item) {
+    // anything that is not 1 or 2 registers is decoded as 4, same as gcom_decode_any
+    size_t size_idx = item.size == 1 ? 0 : item.size == 2 ? 1 : 2;
+    size_t idx = (size_idx << 5)
+               | (item.is_word_swap ? 1u << 4 : 0u)
+               | (item.uses_masks   ? 1u << 3 : 0u)
+               | (item.is_signed    ? 1u << 2 : 0u)
+               | (item.is_float     ? 1u << 1 : 0u)
+               | (item.scale != 0.0 ? 1u      : 0u);
+    return decode_kernels[idx];
+}
+
+
+static bool same_value(const std::any& a, const DecodeValue& v) {
+    auto b = v.to_any();
+    if (a.type() != b.type())
+        return false;
+    if (a.type() == typeid(u64))
+        return std::any_cast<u64>(a) == v.u;
+    if (a.type() == typeid(s64))
+        return std::any_cast<s64>(a) == v.s;
+    if (a.type() == typeid(double)) {
+        double x = std::any_cast<double>(a);
+        return x == v.f || (x != x && v.f != v.f);
+    }
+    return false;
+}
+
+// decoded points per second for gcom_decode_any against the kernels on a map of num_points
+// items cycle through every flag combination, the two paths are checked against each other first
+int bench_decode(int num_points, int loops) {
+    int errors = 0;
+    std::mt19937 rng(1234);
+    cfg myCfg;
+
+    std::vector<cfg::map_struct> maps(num_points);
+    std::vector<int> offsets(num_points);
+    int offset = 0;
+    for (int i = 0; i < num_points; ++i) {
+        auto& map = maps[i];
+        int combo = i % 96;
+        map.size = combo >> 5 == 0 ? 1 : combo >> 5 == 1 ? 2 : 4;
+        map.is_word_swap = (combo >> 4) & 1;
+        map.uses_masks   = (combo >> 3) & 1;
+        map.is_signed    = (combo >> 2) & 1;
+        map.is_float     = (combo >> 1) & 1;
+        map.scale        = (combo & 1) ? 10.0 : 0.0;
+        map.is_byte_swap = false;
+        map.invert_mask = 0x00ff00ff00ff00ffULL;
+        map.care_mask = 0x0fffffffffffffffULL;
+        map.shift = (int)(rng() % 5);
+        map.starting_bit_pos = (int)(rng() % 2);
+        map.offset = offset;
+        map.decode = select_decode_kernel(map);
+        offsets[i] = offset;
+        offset += map.size;
+    }
+    std::vector<u16> regs(offset);
+    for (auto& r : regs)
+        r = (u16)rng();
+
+    // both paths have to agree before the times mean anything
+    for (int i = 0; i < num_points; ++i) {
+        std::any output;
+        DecodeValue value;
+        u64 raw_any = gcom_decode_any(&regs[offsets[i]], nullptr, &maps[i], output, myCfg);
+        u64 raw_kernel = maps[i].decode(&regs[offsets[i]], maps[i], value);
+        if (raw_any != raw_kernel || !same_value(output, value)) {
+            if (errors < 10)
+                std::cout << " mismatch at point " << i << " size " << maps[i].size
+                          << " combo " << (i % 96) << std::endl;
+            errors++;
+        }
+    }
+
+    using clk = std::chrono::steady_clock;
+    double sink = 0.0;
+
+    auto t0 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        for (int i = 0; i < num_points; ++i) {
+            std::any output;
+            sink += (double)gcom_decode_any(&regs[offsets[i]], nullptr, &maps[i], output, myCfg);
+            sink += output.has_value() ? 1.0 : 0.0;
+        }
+    }
+    auto t1 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        for (int i = 0; i < num_points; ++i) {
+            DecodeValue value;
+            sink += (double)maps[i].decode(&regs[offsets[i]], maps[i], value);
+            sink += (double)value.u;
+        }
+    }
+    auto t2 = clk::now();
+
+    double t_any = std::chrono::duration<double>(t1 - t0).count();
+    double t_kernel = std::chrono::duration<double>(t2 - t1).count();
+    double total = (double)num_points * loops;
+    std::cout << " bench_decode points " << num_points << " loops " << loops << std::endl;
+    std::cout << "    gcom_decode_any  " << total / t_any / 1e6 << " M points/s" << std::endl;
+    std::cout << "    decode kernels   " << total / t_kernel / 1e6 << " M points/s"
+              << "  speedup " << t_any / t_kernel << std::endl;
+    std::cout << " bench_decode errors " << errors << (sink == 0.0 ? " " : "") << std::endl;
+    return errors;
+}
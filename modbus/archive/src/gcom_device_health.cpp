@@ -0,0 +1,387 @@
+// gcom_device_health.cpp
+// per device health and bad register quarantine, see gcom_device_health.h
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <set>
+
+#include "logger/logger.h"
+#include "gcom_config.h"
+#include "gcom_device_health.h"
+#include "gcom_iothread.h"
+#include "gcom_poll_planner.h"
+
+DeviceHealth deviceHealth;
+
+// weight of the newest transaction in the ewmas
+static constexpr double health_alpha = 0.1;
+// failures in a row that make a device Sick
+static constexpr int fails_sick = 3;
+static constexpr double timeout_sick = 0.5;
+static constexpr double timeout_degraded = 0.1;
+static constexpr double exception_degraded = 0.2;
+// a Sick device is polled at least every 1 << max_backoff cycles
+static constexpr int max_backoff = 5;
+// quarantine hold, doubled on each failed re-probe
+static constexpr double hold_first = 30.0;
+static constexpr double hold_max = 3600.0;
+
+DeviceHealth::DeviceHealth() {
+    queue = [](IO_WorkHandle io_work) { return pollWork(io_work); };
+}
+
+const char* DeviceHealth::state_name(DeviceState state) {
+    switch (state) {
+        case DeviceState::Healthy:  return "healthy";
+        case DeviceState::Degraded: return "degraded";
+        case DeviceState::Sick:     return "sick";
+    }
+    return "unknown";
+}
+
+// libmodbus reports exception n from the server as MODBUS_ENOBASE + n
+static bool is_exception(int errno_code) {
+    return errno_code > MODBUS_ENOBASE && errno_code <= MODBUS_ENOBASE + 0x0b;
+}
+
+void DeviceHealth::update_state(DeviceStats& dev) {
+    if (dev.fails_in_row >= fails_sick || dev.timeout_rate > timeout_sick)
+        dev.state = DeviceState::Sick;
+    else if (dev.timeout_rate > timeout_degraded || dev.exception_rate > exception_degraded)
+        dev.state = DeviceState::Degraded;
+    else
+        dev.state = DeviceState::Healthy;
+}
+
+void DeviceHealth::record(const IO_Work& io_work, double tNow) {
+    // -2 never got as far as the wire
+    if (io_work.wtype == WorkTypes::Noop || (io_work.errors <= 0 && io_work.errors != -1))
+        return;
+
+    std::vector<IO_WorkHandle> probes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto& dev = devices[io_work.device_id];
+        dev.transactions++;
+        bool timeout = false;
+        bool exception = false;
+        if (io_work.errors > 0) {
+            dev.rtt = dev.rtt == 0.0 ? io_work.tRun : dev.rtt + health_alpha * (io_work.tRun - dev.rtt);
+            dev.fails_in_row = 0;
+            dev.backoff /= 2;
+        } else if (is_exception(io_work.errno_code)) {
+            // the device answered, the request was wrong
+            exception = true;
+            dev.exceptions++;
+            dev.fails_in_row = 0;
+        } else {
+            timeout = true;
+            dev.timeouts++;
+            dev.fails_in_row++;
+        }
+        dev.timeout_rate += health_alpha * ((timeout ? 1.0 : 0.0) - dev.timeout_rate);
+        dev.exception_rate += health_alpha * ((exception ? 1.0 : 0.0) - dev.exception_rate);
+        update_state(dev);
+        if (timeout && dev.state == DeviceState::Sick)
+            dev.backoff = std::min(dev.backoff + 1, max_backoff);
+
+        if (io_work.errno_code == EMBXILADD && io_work.wtype == WorkTypes::Get
+                && !io_work.reg_maps.empty() && probes_out[io_work.device_id] == 0) {
+            if (io_work.num_registers == 1)
+                quarantine_reg(io_work, tNow);
+            else
+                split_probe(io_work, probes);
+        }
+    }
+    send(probes);
+}
+
+void DeviceHealth::probe_done(const IO_Work& io_work, double tNow) {
+    std::vector<IO_WorkHandle> probes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto& out = probes_out[io_work.device_id];
+        if (out > 0)
+            out--;
+
+        cfg::reg_struct* held = nullptr;
+        Quarantine* qr = nullptr;
+        if (io_work.num_registers == 1) {
+            for (auto reg : io_work.reg_maps) {
+                auto qit = quarantine.find(reg);
+                if (qit == quarantine.end())
+                    continue;
+                auto it = qit->second.find(io_work.offset);
+                if (it != qit->second.end()) {
+                    held = reg;
+                    qr = &it->second;
+                    break;
+                }
+            }
+        }
+
+        if (io_work.errors > 0) {
+            // a held register answers again
+            if (qr) {
+                quarantine[held].erase(io_work.offset);
+                push_bad_regs(held);
+            }
+        } else if (io_work.errno_code == EMBXILADD) {
+            if (io_work.num_registers == 1)
+                quarantine_reg(io_work, tNow);
+            else
+                split_probe(io_work, probes);
+        } else if (qr) {
+            // no answer, that says nothing about the register, keep the hold and try later
+            qr->probing = false;
+            qr->tUntil = tNow + qr->hold;
+        }
+    }
+    send(probes);
+}
+
+IO_WorkHandle DeviceHealth::make_probe(int device_id, cfg::Register_Types reg_type, int offset, int num,
+                                       const std::vector<cfg::reg_struct*>& regs, double tNow) {
+    auto io_work = make_work(reg_type, device_id, offset, num, nullptr, nullptr, WorkTypes::Get);
+    io_work->tNow = tNow;
+    io_work->work_name = "probe";
+    io_work->work_group = 1;
+    io_work->work_id = 1;
+    io_work->probe = true;
+    io_work->reg_maps.assign(regs.begin(), regs.end());
+    io_work->reg_map = regs.empty() ? nullptr : regs[0];
+    probes_out[device_id]++;
+    return io_work;
+}
+
+void DeviceHealth::split_probe(const IO_Work& io_work, std::vector<IO_WorkHandle>& probes) {
+    int half = io_work.num_registers / 2;
+    probes.push_back(make_probe(io_work.device_id, io_work.reg_type, io_work.offset, half,
+                                io_work.reg_maps, io_work.tNow));
+    probes.push_back(make_probe(io_work.device_id, io_work.reg_type, io_work.offset + half,
+                                io_work.num_registers - half, io_work.reg_maps, io_work.tNow));
+}
+
+// the single register in io_work is bad, hold it in the reg_struct that declares it
+// or, for a gap register, the first block of the read
+void DeviceHealth::quarantine_reg(const IO_Work& io_work, double tNow) {
+    cfg::reg_struct* owner = io_work.reg_maps[0];
+    for (auto reg : io_work.reg_maps) {
+        if (io_work.offset >= reg->starting_offset
+                && io_work.offset < reg->starting_offset + reg->number_of_registers) {
+            owner = reg;
+            break;
+        }
+    }
+    auto& held = quarantine[owner];
+    auto it = held.find(io_work.offset);
+    if (it == held.end()) {
+        held[io_work.offset] = {io_work.device_id, io_work.reg_type, tNow + hold_first, hold_first, false};
+        push_bad_regs(owner);
+        FPS_ERROR_LOG("device %d type %d register %d quarantined for %f seconds",
+            io_work.device_id, (int)io_work.reg_type, io_work.offset, hold_first);
+    } else {
+        auto& qr = it->second;
+        qr.hold = std::min(qr.hold * 2.0, hold_max);
+        qr.tUntil = tNow + qr.hold;
+        qr.probing = false;
+    }
+}
+
+void DeviceHealth::push_bad_regs(cfg::reg_struct* reg) {
+    std::vector<int> bad;
+    for (auto& [offset, qr] : quarantine[reg])
+        bad.push_back(offset);
+    pollPlanner.set_bad_regs(reg, bad);
+}
+
+void DeviceHealth::send(std::vector<IO_WorkHandle>& probes) {
+    for (auto io_work : probes)
+        queue(io_work);
+    probes.clear();
+}
+
+bool DeviceHealth::should_poll(cfg::comp_struct* comp, int device_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto dit = devices.find(device_id);
+    if (dit == devices.end() || dit->second.backoff == 0)
+        return true;
+    u64 cycle = cycles[{comp, device_id}]++;
+    return (cycle % (1ULL << dit->second.backoff)) == 0;
+}
+
+int DeviceHealth::max_tries(int device_id, int max_io_tries) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto dit = devices.find(device_id);
+    if (dit == devices.end())
+        return max_io_tries;
+    switch (dit->second.state) {
+        case DeviceState::Sick:     return 1;
+        case DeviceState::Degraded: return std::min(2, max_io_tries);
+        default:                    return max_io_tries;
+    }
+}
+
+void DeviceHealth::reprobe(double tNow) {
+    std::vector<IO_WorkHandle> probes;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& [reg, held] : quarantine) {
+            for (auto& [offset, qr] : held) {
+                if (qr.probing || tNow < qr.tUntil)
+                    continue;
+                qr.probing = true;
+                probes.push_back(make_probe(qr.device_id, qr.reg_type, offset, 1, {reg}, tNow));
+            }
+        }
+    }
+    send(probes);
+}
+
+void DeviceHealth::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    cycles.clear();
+    quarantine.clear();
+    probes_out.clear();
+}
+
+DeviceStats DeviceHealth::stats(int device_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return devices[device_id];
+}
+
+bool DeviceHealth::is_quarantined(cfg::reg_struct* reg, int offset) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto qit = quarantine.find(reg);
+    return qit != quarantine.end() && qit->second.find(offset) != qit->second.end();
+}
+
+void DeviceHealth::show() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& [device_id, dev] : devices) {
+        std::cout << "    device " << device_id
+                  << " " << state_name(dev.state)
+                  << " rtt(mS) " << dev.rtt * 1000.0
+                  << " timeout_rate " << dev.timeout_rate
+                  << " exception_rate " << dev.exception_rate
+                  << " transactions " << dev.transactions
+                  << " backoff " << (1 << dev.backoff)
+                  << std::endl;
+    }
+    for (auto& [reg, held] : quarantine) {
+        for (auto& [offset, qr] : held) {
+            std::cout << "    quarantined device " << qr.device_id
+                      << " type " << (int)qr.reg_type
+                      << " register " << offset
+                      << " hold " << qr.hold
+                      << std::endl;
+        }
+    }
+}
+
+
+// a device with two sick neighbours, and bad registers found and released by probes
+int test_device_health() {
+    int errors = 0;
+    DeviceHealth health;
+    std::vector<IO_WorkHandle> queued;
+    health.queue = [&queued](IO_WorkHandle io_work) {
+        queued.push_back(io_work);
+        return true;
+    };
+    std::set<int> bad = {25, 32};
+
+    auto check = [&](const char* name, bool ok) {
+        std::cout << " " << name << (ok ? " ok" : " FAILED") << std::endl;
+        if (!ok)
+            errors++;
+    };
+    auto done = [](int device_id, int offset, int num, int errno_code, double tRun) {
+        IO_Work io_work;
+        io_work.device_id = device_id;
+        io_work.reg_type = cfg::Register_Types::Holding;
+        io_work.wtype = WorkTypes::Get;
+        io_work.offset = offset;
+        io_work.num_registers = num;
+        io_work.errors = errno_code ? -1 : num;
+        io_work.errno_code = errno_code;
+        io_work.tRun = tRun;
+        io_work.tNow = 0.0;
+        return io_work;
+    };
+    // answer the queued probes from a device with the bad registers
+    auto run_probes = [&](double tNow) {
+        int runs = 0;
+        while (!queued.empty()) {
+            auto io_work = queued.back();
+            queued.pop_back();
+            bool ok = true;
+            for (int r = io_work->offset; r < io_work->offset + io_work->num_registers; ++r)
+                if (bad.count(r))
+                    ok = false;
+            io_work->errors = ok ? io_work->num_registers : -1;
+            io_work->errno_code = ok ? 0 : EMBXILADD;
+            health.probe_done(*io_work, tNow);
+            ioWorkPool.release(io_work);
+            runs++;
+        }
+        return runs;
+    };
+
+    // device 1 answers, device 2 times out
+    cfg::comp_struct comp;
+    for (int i = 0; i < 10; ++i) {
+        health.record(done(1, 0, 10, 0, 0.004), 0.0);
+        health.record(done(2, 0, 10, ETIMEDOUT, 1.0), 0.0);
+    }
+    health.show();
+    check("device 1 healthy", health.stats(1).state == DeviceState::Healthy);
+    check("device 2 sick", health.stats(2).state == DeviceState::Sick);
+    check("device 2 one try", health.max_tries(2, 10) == 1 && health.max_tries(1, 10) == 10);
+    int polls1 = 0;
+    int polls2 = 0;
+    for (int i = 0; i < 64; ++i) {
+        polls1 += health.should_poll(&comp, 1);
+        polls2 += health.should_poll(&comp, 2);
+    }
+    std::cout << " 64 cycles, device 1 polled " << polls1 << " device 2 polled " << polls2 << std::endl;
+    check("backoff", polls1 == 64 && polls2 == 64 >> max_backoff);
+    for (int i = 0; i < 20; ++i)
+        health.record(done(2, 0, 10, 0, 0.004), 0.0);
+    check("device 2 recovers", health.stats(2).state == DeviceState::Healthy && health.stats(2).backoff == 0);
+
+    // a block from 10 with registers 25 and 32 missing on the device
+    auto reg = std::make_shared<cfg::reg_struct>();
+    reg->reg_type = cfg::Register_Types::Holding;
+    reg->device_id = 3;
+    reg->starting_offset = 10;
+    reg->number_of_registers = 50;
+    auto failed = done(3, 10, 50, EMBXILADD, 0.004);
+    failed.reg_maps.push_back(reg.get());
+    health.record(failed, 0.0);
+    int runs = run_probes(0.0);
+    std::cout << " probes " << runs << " bad_regs";
+    for (auto b : reg->bad_regs)
+        std::cout << " " << b;
+    std::cout << std::endl;
+    check("quarantine", reg->bad_regs == std::vector<int>({25, 32}));
+    check("exception counted", health.stats(3).exceptions == 1 && health.stats(3).state == DeviceState::Healthy);
+
+    // nothing before the hold is up, then 25 comes back and 32 is held for longer
+    health.reprobe(hold_first - 1.0);
+    check("held", queued.empty());
+    bad.erase(25);
+    health.reprobe(hold_first + 1.0);
+    check("reprobe", queued.size() == 2);
+    run_probes(hold_first + 1.0);
+    check("released", reg->bad_regs == std::vector<int>({32}) && !health.is_quarantined(reg.get(), 25));
+    health.reprobe(hold_first * 2 + 2.0);
+    check("hold doubled", queued.empty());
+    health.show();
+
+    health.clear();
+    pollPlanner.invalidate();
+    std::cout << " test_device_health errors " << errors << std::endl;
+    return errors;
+}
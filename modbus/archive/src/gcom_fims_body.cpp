@@ -0,0 +1,194 @@
+// gcom_fims_body.cpp
+// On-Demand fims set body decode, see gcom_fims_body.h
+
+#include <any>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <simdjson.h>
+
+#include "gcom_config.h"
+#include "gcom_fims_body.h"
+
+FimsBodyDecoder& FimsBodyDecoder::local() {
+    thread_local FimsBodyDecoder decoder;
+    return decoder;
+}
+
+bool FimsBodyDecoder::iterate(const char* body, size_t len) {
+    if (!body || len == 0)
+        return false;
+    // On-Demand reads past the end, keep our own padded copy rather than trust the caller's buffer
+    if (buf.size() < len + simdjson::SIMDJSON_PADDING)
+        buf.resize(len + simdjson::SIMDJSON_PADDING);
+    memcpy(buf.data(), body, len);
+    memset(buf.data() + len, 0, simdjson::SIMDJSON_PADDING);
+    return parser.iterate(buf.data(), len, buf.size()).get(doc) == simdjson::SUCCESS;
+}
+
+// works on a document or a value, a document that is just a scalar can't be turned into a value.
+// ints first, same as extractJsonValue
+template <typename T>
+static bool get_set_value(T& val, SetValue& out) {
+    simdjson::ondemand::json_type type;
+    if (val.type().get(type))
+        return false;
+    switch (type) {
+        case simdjson::ondemand::json_type::number: {
+            int64_t ival;
+            if (!val.get_int64().get(ival)) {
+                out.set(static_cast<s64>(ival));
+                return true;
+            }
+            double dval;
+            if (!val.get_double().get(dval)) {
+                out.set(dval);
+                return true;
+            }
+            return false;
+        }
+        case simdjson::ondemand::json_type::boolean: {
+            bool bval;
+            if (val.get_bool().get(bval))
+                return false;
+            out.set(bval);
+            return true;
+        }
+        case simdjson::ondemand::json_type::string: {
+            std::string_view sval;
+            if (val.get_string().get(sval))
+                return false;
+            out.set(sval);
+            return true;
+        }
+        case simdjson::ondemand::json_type::object: {
+            simdjson::ondemand::object obj;
+            if (val.get_object().get(obj))
+                return false;
+            simdjson::ondemand::value inner;
+            if (obj.find_field_unordered("value").get(inner))
+                return false;
+            return get_set_value(inner, out);
+        }
+        default:
+            return false;
+    }
+}
+
+bool FimsBodyDecoder::decode_single(const char* body, size_t len, SetValue& out) {
+    out.kind = SetValue::Kind::None;
+    if (!iterate(body, len))
+        return false;
+    return get_set_value(doc, out);
+}
+
+bool FimsBodyDecoder::decode_multi(const char* body, size_t len, const Items& items, Result& result, int* missing) {
+    if (!iterate(body, len))
+        return false;
+    simdjson::ondemand::object obj;
+    if (doc.get_object().get(obj))
+        return false;
+    for (auto field : obj) {
+        std::string_view key_view;
+        if (field.unescaped_key().get(key_view))
+            return false;
+        key.assign(key_view);
+        auto it = items.find(key);
+        if (it == items.end()) {
+            if (missing)
+                (*missing)++;
+            continue;
+        }
+        simdjson::ondemand::value val;
+        if (field.value().get(val))
+            return false;
+        result.emplace_back(it->second, SetValue());
+        if (!get_set_value(val, result.back().second)) {
+            result.pop_back();
+            if (missing)
+                (*missing)++;
+        }
+    }
+    return true;
+}
+
+
+int gcom_parse_data(std::any& gcom_any, const char* data, size_t length, bool debug);
+
+// set messages a second through gcom_parse_data and a std::map walk, against FimsBodyDecoder
+int bench_fims_set(int loops) {
+    int errors = 0;
+    using clk = std::chrono::steady_clock;
+
+    for (int num_keys : {1, 10, 100}) {
+        FimsBodyDecoder::Items items;
+        std::string body = "{";
+        for (int k = 0; k < num_keys; ++k) {
+            auto map = std::make_shared<cfg::map_struct>();
+            map->id = "item_" + std::to_string(k);
+            items[map->id] = map;
+            if (k)
+                body += ",";
+            body += "\"" + map->id + "\":";
+            switch (k % 4) {
+                case 0: body += std::to_string(k * 10); break;
+                case 1: body += std::to_string(k) + ".25"; break;
+                case 2: body += (k & 4) ? "true" : "false"; break;
+                default: body += "{\"value\":" + std::to_string(k) + "}"; break;
+            }
+        }
+        body += "}";
+
+        std::vector<std::pair<std::shared_ptr<cfg::map_struct>, std::any>> any_result;
+        auto t0 = clk::now();
+        for (int l = 0; l < loops; ++l) {
+            any_result.clear();
+            std::any gcom_data;
+            gcom_parse_data(gcom_data, body.data(), body.size(), false);
+            if (gcom_data.type() != typeid(std::map<std::string, std::any>))
+                continue;
+            auto& base_map = std::any_cast<std::map<std::string, std::any>&>(gcom_data);
+            for (auto& [key, value] : base_map) {
+                auto it = items.find(key);
+                if (it != items.end())
+                    any_result.emplace_back(it->second, value);
+            }
+        }
+        auto t1 = clk::now();
+        FimsBodyDecoder::Result result;
+        auto& decoder = FimsBodyDecoder::local();
+        for (int l = 0; l < loops; ++l) {
+            result.clear();
+            if (!decoder.decode_multi(body.data(), body.size(), items, result))
+                errors++;
+        }
+        auto t2 = clk::now();
+
+        if ((int)result.size() != num_keys || any_result.size() != result.size()) {
+            std::cout << " bench_fims_set " << num_keys << " keys decoded " << result.size()
+                      << " any path " << any_result.size() << std::endl;
+            errors++;
+        }
+        double t_any = std::chrono::duration<double>(t1 - t0).count();
+        double t_od = std::chrono::duration<double>(t2 - t1).count();
+        std::cout << " bench_fims_set keys " << num_keys
+                  << "  dom + any " << loops / t_any << " msgs/s"
+                  << "  on demand " << loops / t_od << " msgs/s"
+                  << "  speedup " << t_any / t_od << std::endl;
+    }
+
+    SetValue val;
+    auto& decoder = FimsBodyDecoder::local();
+    if (!decoder.decode_single("1234", 4, val) || val.kind != SetValue::Kind::Int || val.i != 1234)
+        errors++;
+    if (!decoder.decode_single("{\"value\":2.5}", 13, val) || val.kind != SetValue::Kind::Float || val.f != 2.5)
+        errors++;
+    if (!decoder.decode_single("true", 4, val) || val.kind != SetValue::Kind::Bool || !val.b)
+        errors++;
+    std::cout << " bench_fims_set errors " << errors << std::endl;
+    return errors;
+}
@@ -0,0 +1,207 @@
+// gcom_map_index.cpp
+// build and swap the flat map item index, see gcom_map_index.h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "gcom_config.h"
+#include "gcom_map_index.h"
+
+static std::shared_ptr<const MapIndex> current_index;
+
+std::shared_ptr<const MapIndex> map_index() {
+    return std::atomic_load(&current_index);
+}
+
+void map_index_swap(std::shared_ptr<const MapIndex> index) {
+    std::atomic_store(&current_index, std::move(index));
+}
+
+std::shared_ptr<const MapIndex> MapIndex::build(const cfg& myCfg) {
+    auto index = std::make_shared<MapIndex>();
+    index->comps = myCfg.components;
+
+    for (auto& comp : myCfg.components) {
+        for (auto& regshr : comp->registers) {
+            auto reg = regshr.get();
+            Block blk;
+            blk.reg = reg;
+            if (!reg->maps.empty()) {
+                int lo = reg->maps.front()->offset;
+                int hi = lo;
+                for (auto& map : reg->maps) {
+                    lo = std::min(lo, map->offset);
+                    hi = std::max(hi, map->offset + std::max(map->size, 1));
+                }
+                blk.base = lo;
+                blk.slots.assign(hi - lo, -1);
+            }
+            for (auto& map : reg->maps) {
+                int32_t item = index->items.size();
+                map->point_id = item;
+                index->items.push_back(map.get());
+                // last one wins, same as mapix
+                blk.slots[map->offset - blk.base] = item;
+                index->ids.push_back({reg->device_id, reg->reg_type, map->offset, item});
+            }
+            index->by_reg.push_back({reg, (int)index->blocks.size()});
+            index->blocks.push_back(std::move(blk));
+        }
+    }
+    // the bit ranges get points but no slots, they share the register of their packer
+    size_t num_roots = index->items.size();
+    for (size_t i = 0; i < num_roots; ++i) {
+        for (auto& bits : index->items[i]->bit_ranges) {
+            bits->point_id = index->items.size();
+            index->items.push_back(bits.get());
+        }
+    }
+    index->points = std::make_shared<PointStore>(index->items.size());
+    for (auto item : index->items)
+        index->points->init(item->point_id, *item);
+    size_t num_regs = 0;
+    for (auto& blk : index->blocks) {
+        blk.regs_at = num_regs;
+        num_regs += blk.slots.size();
+    }
+    index->points->resize_regs(num_regs);
+    index->router.build(myCfg);
+    index->pubs.build(myCfg, index->items);
+
+    std::sort(index->by_reg.begin(), index->by_reg.end());
+    // stable so find_id can take the last of a duplicate offset, same as the slots
+    std::stable_sort(index->ids.begin(), index->ids.end());
+    return index;
+}
+
+const MapIndex::Block* MapIndex::block(const cfg::reg_struct* reg) const {
+    auto it = std::lower_bound(by_reg.begin(), by_reg.end(), std::make_pair(reg, 0));
+    if (it == by_reg.end() || it->first != reg)
+        return nullptr;
+    return &blocks[it->second];
+}
+
+const cfg::map_struct* MapIndex::find(const cfg::reg_struct* reg, int offset) const {
+    auto blk = block(reg);
+    if (!blk)
+        return nullptr;
+    int idx = offset - blk->base;
+    if (idx < 0 || idx >= (int)blk->slots.size() || blk->slots[idx] < 0)
+        return nullptr;
+    return items[blk->slots[idx]];
+}
+
+const cfg::map_struct* MapIndex::find_id(int device_id, cfg::Register_Types reg_type, int offset) const {
+    IdKey key{device_id, reg_type, offset, 0};
+    auto it = std::upper_bound(ids.begin(), ids.end(), key);
+    if (it == ids.begin())
+        return nullptr;
+    --it;
+    if (it->device_id != device_id || it->reg_type != reg_type || it->offset != offset)
+        return nullptr;
+    return items[it->item];
+}
+
+
+// build an index over a synthetic config, check every lookup against mapix and time a full walk both ways
+int test_map_index() {
+    int errors = 0;
+    cfg myCfg;
+    const int num_comps = 10;
+    const int num_regs = 8;
+    const int num_maps = 100;
+
+    for (int c = 0; c < num_comps; ++c) {
+        auto comp = std::make_shared<cfg::comp_struct>();
+        comp->id = "comp_" + std::to_string(c);
+        for (int r = 0; r < num_regs; ++r) {
+            auto reg = std::make_shared<cfg::reg_struct>();
+            reg->device_id = c;
+            reg->reg_type = (r & 1) ? cfg::Register_Types::Input : cfg::Register_Types::Holding;
+            reg->starting_offset = r * 1000;
+            int offset = reg->starting_offset;
+            for (int m = 0; m < num_maps; ++m) {
+                auto map = std::make_shared<cfg::map_struct>();
+                map->id = "item_" + std::to_string(m);
+                map->size = 1 + (m % 3 == 0);
+                map->offset = offset;
+                // leave a hole now and then
+                offset += map->size + (m % 7 == 0);
+                reg->maps.push_back(map);
+                reg->mapix[map->offset] = map;
+            }
+            reg->number_of_registers = offset - reg->starting_offset;
+            comp->registers.push_back(reg);
+        }
+        myCfg.components.push_back(comp);
+    }
+
+    auto index = MapIndex::build(myCfg);
+    map_index_swap(index);
+    if (map_index() != index) {
+        std::cout << " map_index swap failed" << std::endl;
+        errors++;
+    }
+
+    for (auto& comp : myCfg.components) {
+        for (auto& reg : comp->registers) {
+            for (int off = reg->starting_offset - 2; off < reg->starting_offset + reg->number_of_registers + 2; ++off) {
+                auto it = reg->mapix.find(off);
+                const cfg::map_struct* want = it == reg->mapix.end() ? nullptr : it->second.get();
+                if (index->find(reg.get(), off) != want)
+                    errors++;
+                if (index->find_id(reg->device_id, reg->reg_type, off) != want)
+                    errors++;
+            }
+        }
+    }
+    std::cout << " test_map_index items " << index->items.size() << " blocks " << index->blocks.size()
+              << " lookup errors " << errors << std::endl;
+
+    // walk every register of every block the way processGroupCallback does
+    using clk = std::chrono::steady_clock;
+    const int loops = 2000;
+    u64 sum_mapix = 0;
+    u64 sum_index = 0;
+    auto t0 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        for (auto& comp : myCfg.components) {
+            for (auto& reg : comp->registers) {
+                int end = reg->starting_offset + reg->number_of_registers;
+                for (auto it = reg->mapix.lower_bound(reg->starting_offset); it != reg->mapix.end() && it->first < end; ++it) {
+                    auto map = it->second;
+                    sum_mapix += map->size;
+                }
+            }
+        }
+    }
+    auto t1 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        auto idx = map_index();
+        for (auto& comp : myCfg.components) {
+            for (auto& reg : comp->registers) {
+                auto blk = idx->block(reg.get());
+                for (auto slot : blk->slots) {
+                    if (slot >= 0)
+                        sum_index += idx->items[slot]->size;
+                }
+            }
+        }
+    }
+    auto t2 = clk::now();
+    double items = (double)index->items.size() * loops;
+    double t_mapix = std::chrono::duration<double>(t1 - t0).count();
+    double t_index = std::chrono::duration<double>(t2 - t1).count();
+    std::cout << "    mapix walk   " << items / t_mapix / 1e6 << " M items/s" << std::endl;
+    std::cout << "    index walk   " << items / t_index / 1e6 << " M items/s  speedup " << t_mapix / t_index << std::endl;
+    if (sum_mapix != sum_index) {
+        std::cout << " walk mismatch " << sum_mapix << " vs " << sum_index << std::endl;
+        errors++;
+    }
+    map_index_swap(nullptr);
+    std::cout << " test_map_index errors " << errors << std::endl;
+    return errors;
+}
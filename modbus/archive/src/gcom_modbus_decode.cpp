@@ -10,14 +10,15 @@
 
 //std::string cfg::typeToStr(cfg::Register_Types rtype);
 
-void gcom_modbus_decode(std::shared_ptr<IO_Work>io_work, std::stringstream &ss, struct cfg& myCfg);
-void decode_bval(bool bval, std::shared_ptr<cfg::map_struct> item, std::stringstream &ss, struct cfg& cfg);
+void gcom_modbus_decode(IO_WorkHandle io_work, std::stringstream &ss, struct cfg& myCfg);
+void decode_bval(bool bval, cfg::map_struct* item, std::stringstream &ss, struct cfg& cfg);
 u64 gcom_decode_any(u16* raw16, u8*raw8, std::shared_ptr<cfg::map_struct>item, std::any& output, struct cfg& myCfg);
-bool modbus_decode(u16 *raw16, std::shared_ptr<cfg::map_struct> item, std::any& value, std::stringstream &ss, struct cfg& cfg);
+u64 gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct* item, std::any& output, struct cfg& myCfg);
+bool modbus_decode(u16 *raw16, cfg::map_struct* item, std::any& value, std::stringstream &ss, struct cfg& cfg);
 
 
 
-void gcom_modbus_decode(std::shared_ptr<IO_Work>io_work, std::stringstream &ss, struct cfg& myCfg)
+void gcom_modbus_decode(IO_WorkHandle io_work, std::stringstream &ss, struct cfg& myCfg)
 {
     std::cout << " decode starting ... # items " << io_work->items.size()
             << " start_register :"               << io_work->start_register
@@ -332,7 +333,7 @@ u64 gcom_decode_any(u16* raw16, u8*raw8, std::shared_ptr<cfg::map_struct>item, s
     return raw_data;
 }
 
-void decode_bval(bool bval, std::shared_ptr<cfg::map_struct> item, std::stringstream &ss, struct cfg& cfg) {
+void decode_bval(bool bval, cfg::map_struct* item, std::stringstream &ss, struct cfg& cfg) {
     ss << addQuote(item->id) << ":";
 
     if (bval) {
@@ -382,7 +383,7 @@ void decode_bval(bool bval, std::shared_ptr<cfg::map_struct> item, std::stringst
 /// @param item 
 /// @param ss 
 /// @param cfg 
-void decode_individual_bits(std::any& value, std::shared_ptr<cfg::map_struct> item, std::stringstream &ss, struct cfg& cfg) {
+void decode_individual_bits(std::any& value, cfg::map_struct* item, std::stringstream &ss, struct cfg& cfg) {
     u64 val = getAnyVal(value, (u64)0) ;
     bool firstOne = true;
     ss << "[";
@@ -408,14 +409,14 @@ void decode_individual_bits(std::any& value, std::shared_ptr<cfg::map_struct> it
 }
 
 
-void decode_bval_from_value(std::any& value, std::shared_ptr<cfg::map_struct> item, std::stringstream &ss, struct cfg& cfg) {
+void decode_bval_from_value(std::any& value, cfg::map_struct* item, std::stringstream &ss, struct cfg& cfg) {
     u64 val = getAnyVal(value, (u64)0) ;
     auto bval = (val != 0);
     decode_bval(bval, item, ss, cfg);
 }        
 
 // TODO add ignored bits
-void decode_bit_field(std::any &value, std::shared_ptr<cfg::map_struct> item, std::stringstream &bss, struct cfg& cfg) {
+void decode_bit_field(std::any &value, cfg::map_struct* item, std::stringstream &bss, struct cfg& cfg) {
     u64 val = getAnyVal(value, (u64)0) ;
     bool firstOne = true;
     int last_idx = (int)(item->bit_str.size() + 1);
@@ -455,7 +456,7 @@ void decode_bit_field(std::any &value, std::shared_ptr<cfg::map_struct> item, st
 /// @param item 
 /// @param bss 
 /// @param cfg 
-void decode_enum(std::any &value, std::shared_ptr<cfg::map_struct> item, std::stringstream &bss, struct cfg& cfg) {
+void decode_enum(std::any &value, cfg::map_struct* item, std::stringstream &bss, struct cfg& cfg) {
     bool enum_found = false;
     u64 val = getAnyVal(value, (u64)0) ;
     std::cout << __func__ << " val "  << val << " bitstr size "<< item->bit_str.size() << " bitstr num size "<< item->bit_str_num.size()<< std::endl;
@@ -477,9 +478,9 @@ void decode_enum(std::any &value, std::shared_ptr<cfg::map_struct> item, std::st
 
 }
 
-bool modbus_decode(u16 *raw16, std::shared_ptr<cfg::map_struct> item, std::any& value, std::stringstream &ss, struct cfg& cfg);
+bool modbus_decode(u16 *raw16, cfg::map_struct* item, std::any& value, std::stringstream &ss, struct cfg& cfg);
 
-void decode_packed(u16 *raw16, std::any &value, std::shared_ptr<cfg::map_struct> item, std::stringstream &bss, struct cfg& cfg) {
+void decode_packed(u16 *raw16, std::any &value, cfg::map_struct* item, std::stringstream &bss, struct cfg& cfg) {
     //bool enum_found = false;
     u64 val = getAnyVal(value, (u64)0) ;
     std::cout << __func__ << " val "  << val << " bitstr size "<< item->bit_ranges.size() << std::endl;
@@ -490,7 +491,7 @@ void decode_packed(u16 *raw16, std::any &value, std::shared_ptr<cfg::map_struct>
         std::any bvalue = (val>>bitem->starting_bit_pos & ((bitem->number_of_bits*bitem->number_of_bits) -1));
 
         //std::cout << __func__ << " id "  << bitem->id << std::endl;
-        modbus_decode(raw16, bitem, bvalue, bss, cfg);
+        modbus_decode(raw16, bitem.get(), bvalue, bss, cfg);
         //std::cout << __func__ << " string "  << css.str() << std::endl;
 
         //bss << css.str();
@@ -508,7 +509,7 @@ void decode_packed(u16 *raw16, std::any &value, std::shared_ptr<cfg::map_struct>
 /// @param ss 
 /// @param cfg 
 /// @return 
-bool modbus_decode(u16 *raw16, std::shared_ptr<cfg::map_struct> item, std::any& value, std::stringstream &ss, struct cfg& cfg)
+bool modbus_decode(u16 *raw16, cfg::map_struct* item, std::any& value, std::stringstream &ss, struct cfg& cfg)
 {
     if (item->is_bit){
         decode_bval_from_value(value, item, ss, cfg);
@@ -735,7 +736,7 @@ u64 gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct* item, std::any&
 
     if (item->size == 1)
     {
-        raw_data = *(u64 *)raw16;
+        raw_data = raw16[0];
 
         current_unsigned_val = raw_data;
         if (item->uses_masks)
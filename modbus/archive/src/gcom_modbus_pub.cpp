@@ -26,6 +26,8 @@
 #include "gcom_config.h"
 #include "gcom_timer.h"
 #include "gcom_iothread.h"
+#include "gcom_poll_planner.h"
+#include "gcom_device_health.h"
 
 
 
@@ -92,8 +94,8 @@
 
 
 double get_time_double(void);
-std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
-bool pollWork (std::shared_ptr<IO_Work> io_work);
+IO_WorkHandle make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype );
+bool pollWork (IO_WorkHandle io_work);
 //bool setWork (std::shared_ptr<IO_Work> io_work) {
 cfg::Register_Types strToRegType(std::string& rtype);
 WorkTypes strToWorkType(std::string roper, bool debug);
@@ -276,19 +278,34 @@ void pubCallback(TimeObject* t, void* p) {
     int work_id = 1;
     auto compshr = mypub->comp.lock();
 
-    for (auto &myreg : compshr->registers) {
-        auto rtype = strToRegType(myreg->type);
-        //auto cfgtype = strToRegType(myreg->type);
-        auto wtype = strToWorkType("poll", false);
+    // one io_work per planned span, the planner merges register blocks and skips bad regs
+    // hold our own ref, a reload or another pub can replace the cached plan while we queue
+    auto plan = pollPlanner.get_plan(compshr.get(), mypub->cfg->connection.max_poll_gap);
+    auto wtype = strToWorkType("poll", false);
+
+    // a sick device sits out some cycles, the pub goes out with the spans that are left
+    std::map<int, bool> poll_dev;
+    std::vector<const PollSpan*> spans;
+    for (auto &span : plan->spans) {
+        auto dit = poll_dev.find(span.device_id);
+        if (dit == poll_dev.end())
+            dit = poll_dev.emplace(span.device_id, deviceHealth.should_poll(compshr.get(), span.device_id)).first;
+        if (dit->second)
+            spans.push_back(&span);
+    }
+    deviceHealth.reprobe(tNow);
 
-        auto io_work = make_work(rtype, myreg->device_id, myreg->starting_offset ,myreg->number_of_registers, nullptr, nullptr, wtype);
+    for (auto spanp : spans) {
+        auto &span = *spanp;
+        auto io_work = make_work(span.reg_type, span.device_id, span.offset, span.num_registers, nullptr, nullptr, wtype);
         // set up collection id
         io_work->tNow = tNow;
-        io_work->work_group = compshr->registers.size();
+        io_work->work_group = spans.size();
         io_work->work_id = work_id++;
         io_work->work_name = t->name;
-        io_work->reg_map = myreg;
-        io_work->comp_map = compshr;
+        io_work->reg_map = span.regs[0];
+        io_work->reg_maps.assign(span.regs.begin(), span.regs.end());
+        io_work->comp_map = compshr.get();
 
         pollWork (io_work);
         // the response collator used this lot to 
@@ -296,27 +313,22 @@ void pubCallback(TimeObject* t, void* p) {
 
         std::cout 
             << " comp " << compshr->id 
-            << " registers " << myreg->type
-            << " start_offset " << myreg->starting_offset 
-            << " number_of_registers " << myreg->number_of_registers 
+            << " registers " << span.regs[0]->type
+            << " start_offset " << span.offset 
+            << " number_of_registers " << span.num_registers 
+            << " items " << span.num_items 
             << " work_time " << io_work->tNow
             << " work_name " << io_work->work_name
             << " work_id " << io_work->work_id 
-            << " in  " << compshr->registers.size() 
+            << " in  " << spans.size() 
             << std::endl;
-            for ( auto &mymap : myreg->maps) {
-            std::cout 
-                << "      id " << mymap->id 
-                << " offset " << mymap->offset 
-                << std::endl;
- 
+
             // set up some other defaults here
                 // // offtime == 0 use reg
                 // offtime < 2 ues forced
                 // offtime < 1 disable
                 // offtime > tNow temp disable
                 // forced val 
-            }
     }
 }
 
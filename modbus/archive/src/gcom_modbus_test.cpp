@@ -120,7 +120,8 @@ std::map<std::string, std::any> gcom_map;
 bool gcom_config_test_uri(std::map<std::string, std::any>gcom_map, struct cfg& myCfg, const char* uri, const char* id);
 void test_parse_message(const char *uri, const char* method, const char* body);
 void test_merge_message(const char *uri, const char* method, const char* body);
-void test_timer();
+int test_timer(bool useSet);
+int bench_timer(int num_timers);
 bool gcom_msg_test(std::map<std::string, std::any>gcom_map, struct cfg& myCfg);
 //
 bool gcom_pub_test(std::map<std::string, std::any>gcom_map, struct cfg& myCfg);
@@ -142,6 +143,21 @@ int  gcom_setup_pubs(std::map<std::string, std::any>& gcom_map, struct cfg& myCf
 
 int test_find_bad_regs();
 bool test_decode_raw();
+int test_io_work_pool();
+int test_poll_planner();
+int test_device_health();
+int bench_pipeline(double secs);
+int bench_reactor(double secs);
+int bench_decode(int num_points, int loops);
+int bench_block_decode(int loops);
+int bench_fims_set(int loops);
+int bench_config_cache(int num_comps, int loops);
+int test_map_index();
+int test_point_store();
+int test_uri_router();
+int test_set_batch();
+int test_channel();
+int bench_pub(int num_points);
 
 
 
@@ -388,7 +404,8 @@ int main(const int argc, const char* argv[]) noexcept {
         std::cout << "test_parse <uri> <body>                                                       : test parsing of a single object" << std::endl;
         std::cout << "test_merge <uri> <body>                                                       : test merging of two maps" << std::endl;
         std::cout << "test_timer                                                                    : basic timer test" << std::endl;
-        std::cout << "test_perf                                                                     : basic perf test" << std::endl;
+        std::cout << "bench_timer [num_timers]                                                      : timer wheel against the sorted list, default 10000 timers" << std::endl;
+        std::cout << "test_perf                                                                     : timing histograms, percentiles and record cost" << std::endl;
         std::cout << "test_encode_base                                                              : basic encode rest" << std::endl;
         std::cout << "test_bit_str                                                                  : test low level bit_str" << std::endl;
         std::cout << "test_points  <go>                                                             : test all points in a config" << std::endl;
@@ -408,6 +425,20 @@ int main(const int argc, const char* argv[]) noexcept {
         std::cout << "test_fims  simple fims test                                                    : set up fims connection then take it dowm"  << std::endl;
         std::cout << "test_bad_regs  simple fims bad regs test                                       : test for bad regs"  << std::endl;
         std::cout << "test_decode  basic test decode to any                                          : test decode"  << std::endl;
+        std::cout << "test_io_pool                                                                  : io_work pool hits / misses / high water" << std::endl;
+        std::cout << "test_poll_planner                                                             : poll span planner gaps / bad regs / fc limits" << std::endl;
+        std::cout << "test_device_health                                                            : device backoff and bad register quarantine / re-probe" << std::endl;
+        std::cout << "bench_pipeline  <secs>                                                        : pipelined client against a mock server at 1/5/20 mS rtt" << std::endl;
+        std::cout << "bench_reactor   <secs>                                                        : epoll reactor against one thread per device at 10/50/200 devices" << std::endl;
+        std::cout << "bench_decode    <points> <loops>                                              : decoded points per second, gcom_decode_any against the decode kernels" << std::endl;
+        std::cout << "bench_block_decode <loops>                                                    : 125 register blocks item by item against the scalar / sse2 / avx2 block decode" << std::endl;
+        std::cout << "bench_fims_set  <loops>                                                       : 1 / 10 / 100 key set bodies a second, gcom_parse_data against the On-Demand decoder" << std::endl;
+        std::cout << "bench_config_cache [components] [loops]                                       : json config load against the binary config cache, default 50 components" << std::endl;
+        std::cout << "test_map_index                                                                : flat map index lookups against mapix and walk times" << std::endl;
+        std::cout << "test_point_store                                                              : point store debounce scan and publish format" << std::endl;
+        std::cout << "test_uri_router                                                               : uri router lookups against the itemMap walk" << std::endl;
+        std::cout << "test_set_batch                                                                : merge fims sets into multi register writes" << std::endl;
+        std::cout << "bench_pub [num_points]                                                        : pub writer against the map built pubs, default 5000 points" << std::endl;
 
         std::cout << "test_cfg_pub  <config_file>                                                    : test pub ( no threads)"  << std::endl;
 
@@ -420,8 +451,7 @@ int main(const int argc, const char* argv[]) noexcept {
 
     if(cmd == "test_perf")
     {
-        test_perf();
-        return 0;
+        return test_perf();
     }
 
     if(cmd == "test_bad_regs") {
@@ -434,6 +464,94 @@ int main(const int argc, const char* argv[]) noexcept {
         return 0;
     }
 
+    if(cmd == "test_io_pool") {
+        return test_io_work_pool();
+    }
+
+    if(cmd == "test_map_index") {
+        return test_map_index();
+    }
+
+    if(cmd == "test_point_store") {
+        return test_point_store();
+    }
+
+    if(cmd == "test_uri_router") {
+        return test_uri_router();
+    }
+
+    if(cmd == "test_set_batch") {
+        return test_set_batch();
+    }
+
+    if(cmd == "test_channel") {
+        return test_channel();
+    }
+
+    if(cmd == "bench_pub")
+    {
+        int num_points = 5000;
+        if (argc > 2)
+            num_points = atoi(argv[2]);
+        return bench_pub(num_points);
+    }
+
+    if(cmd == "test_poll_planner") {
+        return test_poll_planner();
+    }
+
+    if(cmd == "test_device_health") {
+        return test_device_health();
+    }
+
+    if(cmd == "bench_pipeline") {
+        double secs = 1.0;
+        if (argc > 2)
+            secs = atof(argv[2]);
+        return bench_pipeline(secs);
+    }
+
+    if(cmd == "bench_reactor") {
+        double secs = 2.0;
+        if (argc > 2)
+            secs = atof(argv[2]);
+        return bench_reactor(secs);
+    }
+
+    if(cmd == "bench_decode") {
+        int num_points = 10000;
+        int loops = 200;
+        if (argc > 2)
+            num_points = atoi(argv[2]);
+        if (argc > 3)
+            loops = atoi(argv[3]);
+        return bench_decode(num_points, loops);
+    }
+
+    if(cmd == "bench_block_decode") {
+        int loops = 20000;
+        if (argc > 2)
+            loops = atoi(argv[2]);
+        return bench_block_decode(loops);
+    }
+
+    if(cmd == "bench_fims_set") {
+        int loops = 100000;
+        if (argc > 2)
+            loops = atoi(argv[2]);
+        return bench_fims_set(loops);
+    }
+
+    if(cmd == "bench_config_cache") {
+        int num_comps = 50;
+        int loops = 5;
+        if (argc > 2)
+            num_comps = atoi(argv[2]);
+        if (argc > 3)
+            loops = atoi(argv[3]);
+        return bench_config_cache(num_comps, loops);
+    }
+
     if(cmd == "test_fims")
     {
         bool debug = true;
@@ -477,8 +595,15 @@ int main(const int argc, const char* argv[]) noexcept {
 
     if(cmd == "test_timer")
     {
-        test_timer();
-        return 0;
+        return test_timer(false);
+    }
+
+    if(cmd == "bench_timer")
+    {
+        int num_timers = 10000;
+        if (argc > 2)
+            num_timers = atoi(argv[2]);
+        return bench_timer(num_timers);
     }
 
     if(cmd == "test_encode_base")
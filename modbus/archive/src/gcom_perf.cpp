@@ -1,7 +1,10 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
-#include <pthread.h>
+#include <random>
+#include <algorithm>
+
+#include <fmt/format.h>
 
 #include "gcom_perf.h"
 
@@ -9,27 +12,135 @@
 
 double get_time_double();
 
-pthread_t recordThread;
-bool perf_running = false;
-std::atomic<bool> terminate_thread(false);
-std::condition_variable termination_cv; // Condition variable for thread termination
 
+uint64_t PerfSnap::percentile(double q) const {
+    if (count == 0)
+        return 0;
+    uint64_t want = (uint64_t)(q * (double)count);
+    if (want >= count)
+        want = count - 1;
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < counts.size(); ++idx) {
+        seen += counts[idx];
+        if (seen > want)
+            return PerfHist::value(idx);
+    }
+    return max();
+}
+
+uint64_t PerfSnap::max() const {
+    for (size_t idx = counts.size(); idx > 0; --idx) {
+        if (counts[idx - 1])
+            return PerfHist::value(idx - 1);
+    }
+    return 0;
+}
+
+PerfRegistry& PerfRegistry::get() {
+    static PerfRegistry registry;
+    return registry;
+}
 
+PerfId PerfRegistry::intern(const std::string& label) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = ids.find(label);
+    if (it != ids.end())
+        return it->second;
+    if ((int)labels.size() >= Max_Ids)
+        return -1;
+    PerfId id = labels.size();
+    ids[label] = id;
+    labels.push_back(label);
+    base.emplace_back();
+    return id;
+}
 
-void run_perf()
-{
-    if (!perf_running)
-    {
-        std::cout << "starting record thread" <<std::endl;
-        terminate_thread.store(false);
+PerfRegistry::Local& PerfRegistry::local() {
+    thread_local Local* mine = nullptr;
+    if (!mine) {
+        mine = new Local();
+        std::lock_guard<std::mutex> lock(mtx);
+        threads.push_back(mine);
+    }
+    return *mine;
+}
+
+// first sample of an id on this thread
+PerfHist* PerfRegistry::add_hist(std::atomic<PerfHist*>& slot) {
+    auto hist = new PerfHist();
+    slot.store(hist, std::memory_order_release);
+    return hist;
+}
+
+// all the threads, no base taken off. mtx held
+void PerfRegistry::merge(PerfId id, PerfSnap& out) {
+    out.counts.assign(PerfHist::Num_Buckets, 0);
+    out.count = 0;
+    out.total_ns = 0;
+    for (auto thread : threads) {
+        auto hist = thread->hists[id].load(std::memory_order_acquire);
+        if (!hist)
+            continue;
+        for (int idx = 0; idx < PerfHist::Num_Buckets; ++idx)
+            out.counts[idx] += hist->counts[idx].load(std::memory_order_relaxed);
+        out.total_ns += hist->total_ns.load(std::memory_order_relaxed);
+    }
+    for (auto count : out.counts)
+        out.count += count;
+}
+
+bool PerfRegistry::snapshot(PerfId id, PerfSnap& out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (id < 0 || id >= (PerfId)labels.size())
+        return false;
+    merge(id, out);
+    auto& from = base[id];
+    if (!from.counts.empty()) {
+        for (int idx = 0; idx < PerfHist::Num_Buckets; ++idx)
+            out.counts[idx] -= std::min(out.counts[idx], from.counts[idx]);
+        out.count -= std::min(out.count, from.count);
+        out.total_ns -= std::min(out.total_ns, from.total_ns);
+    }
+    return true;
+}
+
+void PerfRegistry::reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (PerfId id = 0; id < (PerfId)labels.size(); ++id)
+        merge(id, base[id]);
+}
 
-        pthread_create(&recordThread, nullptr, record_thread_func, nullptr);
-        perf_running = true;
+std::string PerfRegistry::timings_json() {
+    // intern() can grow labels on another thread, format from our own copy
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        names = labels;
+    }
+    fmt::memory_buffer buf;
+    fmt::format_to(std::back_inserter(buf), "{{");
+    PerfSnap snap;
+    bool first = true;
+    for (PerfId id = 0; id < (PerfId)names.size(); ++id) {
+        if (!snapshot(id, snap) || snap.count == 0)
+            continue;
+        auto ms = [](uint64_t ns) { return (double)ns / 1e6; };
+        fmt::format_to(std::back_inserter(buf),
+                       "{}\"{}\":{{\"count\":{},\"avg\":{},\"p50\":{},\"p90\":{},\"p99\":{},\"p999\":{},\"max\":{}}}",
+                       first ? "" : ",", names[id], snap.count,
+                       (double)snap.total_ns / (double)snap.count / 1e6,
+                       ms(snap.percentile(0.5)), ms(snap.percentile(0.9)), ms(snap.percentile(0.99)),
+                       ms(snap.percentile(0.999)), ms(snap.max()));
+        first = false;
     }
+    fmt::format_to(std::back_inserter(buf), "}}");
+    return fmt::to_string(buf);
 }
 
+
 void Stats::set_label(std::string _label) {
     label = std::move(_label);
+    id = PerfRegistry::get().intern(label);
 }
 void Stats::start() {
     start_time = get_time_double();
@@ -51,7 +162,7 @@ void Stats::show() {
                   << "\tMax(mS): " << max_duration* 1000.0
                   << "\tMin(mS): " << min_duration *1000.0
                   << "\tAvg(mS): " << (total_duration /count) * 1000.0
-                  << "\tCount: " << count 
+                  << "\tCount: " << count
                   << std::endl;
     }
 }
@@ -68,25 +179,21 @@ void Stats::record_duration(double duration) {
     total_duration += duration;
     if (duration > max_duration) max_duration = duration;
     if (duration < min_duration) min_duration = duration;
+    PerfRegistry::get().record_secs(id, duration);
 }
 
-RecordQueue recordQueue;
-class Stats;
-std::map<std::string, Stats> labeled_stats;
-
-Perf::Perf(const std::string& label_) : label(label_) {
+Perf::Perf(PerfId id_) : id(id_) {
     start_time = get_time_double();
     closed =  false;
-    run_perf();
+}
+
+Perf::Perf(const std::string& label) : Perf(PerfRegistry::get().intern(label)) {
 }
 
 Perf::~Perf() {
     if (!closed)
     {
-        auto end_time = get_time_double();
-        //std::cout << label << " duration :"<<(end-start)<<std::endl;
-        recordQueue.push(label, end_time-start_time);
-        closed = true;
+        snap();
     }
 }
 
@@ -97,169 +204,99 @@ void Perf::start() {
 
 void Perf::snap () {
     auto end_time = get_time_double();
-    //std::cout << label << " duration :"<<(end-start)<<std::endl;
-    recordQueue.push(label, end_time-start_time);
+    PerfRegistry::get().record_secs(id, end_time - start_time);
     closed = true;
 }
 
 
-void RecordQueue::push(const std::string& label, double duration) {
-    std::lock_guard<std::mutex> lock(mtx);
-
-    batch.push_back({label, duration});
-
-    if (batch.size() >= BATCH_SIZE) {
-        std::cout << " Pushing batch" << std::endl;
-        batches.push(std::move(batch));
-        batch.clear();
-        cv.notify_one();
-    }
-}
-
-bool RecordQueue::pop(std::vector<Record>& records_batch) {
-    std::unique_lock<std::mutex> lock(mtx);
-    cv.wait(lock, [this]() { return !batches.empty(); });
-
-    records_batch = std::move(batches.front());
-    batches.pop();
-
-    return true;
-}
-    
-bool RecordQueue::try_pop(std::vector<Record>& records_batch) {
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-    
-        if (batches.empty()) {
-            return false;
-        }
-    }
-    return pop(records_batch);
-}
-
-// Force push remaining records, for graceful termination
-void RecordQueue::flush() {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (!batch.empty()) {
-        batches.push(std::move(batch));
-        cv.notify_one();
-    }
-}
-
-void* record_thread_func(void* arg) {
-    std::vector<RecordQueue::Record> records_batch;
-
-    while (true) {
-        {
-            std::unique_lock<std::mutex> lock(recordQueue.mtx);
-            std::cout << "Waiting for a batch or termination signal..." << std::endl;
-            recordQueue.cv.wait(lock, [&]() { 
-                bool shouldWakeup = !recordQueue.batches.empty() || terminate_thread.load();
-                if (shouldWakeup) {
-                    std::cout << "Waking up due to batch or termination signal..." << std::endl;
-                }
-                return shouldWakeup;
-            });
-            
-            if (!recordQueue.batches.empty()) {
-                records_batch = std::move(recordQueue.batches.front());
-                recordQueue.batches.pop();
-            }
-        }
-
-        // Process the batch outside the lock
-        for (const auto& record : records_batch) {
-            std::cout << " recording " << record.label << " duration " << record.duration << std::endl;
-            labeled_stats[record.label].record_duration(record.duration);
-        }
-        records_batch.clear();
-
-        // Termination condition: if termination signal is received and no more batches to process.
-        if (terminate_thread.load() && recordQueue.batches.empty()) {
-            break;
-        }
-    }
-    return nullptr;
-}
-
-
-void display_statistics() {
-    std::cout << "Performance Statistics:\n";
-    for (const auto& pair : labeled_stats) {
-        const auto& label = pair.first;
-        const auto& stats = pair.second;
-        std::cout << "Label: " << label
-                  << "\tMax: " << stats.max_duration* 1000.0
-                  << "\tMin: " << stats.min_duration *1000.0
-                  << "\tAvg: " << (stats.total_duration / stats.count) * 1000.0
-                  << "\tCount: " << stats.count 
-                  << std::endl;
-    }
-}
-
-Stats* getStats(const std::string& label) {
-    if (labeled_stats.find(label) != labeled_stats.end()) {
-        return &labeled_stats[label];
-    }
-    return nullptr;
-}
-
-void runOneSecond() {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-}
-
-void stop_perf() {
-    terminate_thread.store(true);
-    recordQueue.cv.notify_all();  // Notify the recording thread to terminate
-    pthread_join(recordThread, nullptr);
-    perf_running = false;
-}
-
-
+// known distributions recorded from a few threads, check the merged percentiles, the reset and
+// the cost of a record against the old mutex and string queue
 int test_perf() {
-    //baseTimeMs = std::chrono::system_clock::now();
-
-    Stats tStats;
-    tStats.set_label("test_stats");
-    for ( int i = 1; i< 100; ++i) {
-        tStats.start();
-        tStats.snap();
+    int errors = 0;
+    auto& registry = PerfRegistry::get();
+    PerfId uniform_id = registry.intern("test_uniform");
+    PerfId step_id = registry.intern("test_step");
+    if (registry.intern("test_uniform") != uniform_id || uniform_id == step_id)
+        errors++;
+
+    // 1 .. 1000 uS spread over 4 threads, and 99% at 10 uS with 1% at 5 mS
+    const int num_threads = 4;
+    const int per_thread = 250000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t);
+            std::uniform_int_distribution<uint64_t> dist(1000, 1000000);
+            for (int i = 0; i < per_thread; ++i) {
+                registry.record(uniform_id, dist(rng));
+                registry.record(step_id, (i % 100 == 0) ? 5000000 : 10000);
+            }
+        });
     }
-
-    for (int i = 0; i < 10; i++) {
-        {
-            Perf y("test_one_sec_two");
-            Perf x("test_one_sec_one");
-            auto p = std::make_unique<Perf>("test_one_sec");
-            runOneSecond();
+    for (auto& worker : workers)
+        worker.join();
+
+    auto near = [](uint64_t got, double want) {
+        return std::abs((double)got - want) <= want * 0.02;
+    };
+    PerfSnap snap;
+    registry.snapshot(uniform_id, snap);
+    if (snap.count != (uint64_t)num_threads * per_thread)
+        errors++;
+    for (double q : {0.5, 0.9, 0.99}) {
+        double want = 1000.0 + q * 999000.0;
+        if (!near(snap.percentile(q), want)) {
+            std::cout << " test_perf uniform p" << q * 100 << " " << snap.percentile(q) << " want " << want << std::endl;
+            errors++;
         }
     }
-
-    for (int i = 0; i < 100; i++) {
-        Perf p("test_one_msec");
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    registry.snapshot(step_id, snap);
+    if (!near(snap.percentile(0.5), 10000) || !near(snap.percentile(0.98), 10000) || !near(snap.percentile(0.995), 5000000)
+        || !near(snap.max(), 5000000)) {
+        std::cout << " test_perf step p50 " << snap.percentile(0.5) << " p995 " << snap.percentile(0.995) << std::endl;
+        errors++;
     }
 
-    recordQueue.flush();
-    display_statistics();
+    // a reset only shows what came after it
+    registry.reset();
+    registry.snapshot(step_id, snap);
+    if (snap.count != 0)
+        errors++;
+    for (int i = 0; i < 10; ++i)
+        registry.record(step_id, 20000);
+    registry.snapshot(step_id, snap);
+    if (snap.count != 10 || !near(snap.percentile(0.5), 20000))
+        errors++;
 
     {
-        Perf x("final_call");
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        Perf p("test_one_msec");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    stop_perf();
-
-    {
-        Perf x("another_final_call");
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::cout << " _timings " << registry.timings_json() << std::endl;
+
+    // what a sample costs
+    using clk = std::chrono::steady_clock;
+    const int loops = 5000000;
+    PerfId hot_id = registry.intern("test_hot");
+    auto t0 = clk::now();
+    for (int i = 0; i < loops; ++i)
+        registry.record(hot_id, (uint64_t)(i & 0xffff));
+    auto t1 = clk::now();
+    std::mutex mtx;
+    std::vector<std::pair<std::string, double>> queue;
+    std::string label("test_hot");
+    for (int i = 0; i < loops; ++i) {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.push_back({label, (double)(i & 0xffff)});
+        if (queue.size() >= 10)
+            queue.clear();
     }
-   recordQueue.flush();
- 
-    stop_perf();
-    display_statistics();
-    tStats.show();
-
-    return 0;
+    auto t2 = clk::now();
+    double t_hist = std::chrono::duration<double>(t1 - t0).count();
+    double t_queue = std::chrono::duration<double>(t2 - t1).count();
+    std::cout << "    histogram record     " << t_hist / loops * 1e9 << " nS" << std::endl;
+    std::cout << "    mutex + string queue " << t_queue / loops * 1e9 << " nS  speedup " << t_queue / t_hist << std::endl;
+
+    std::cout << " test_perf errors " << errors << std::endl;
+    return errors;
 }
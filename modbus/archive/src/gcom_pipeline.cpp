@@ -0,0 +1,687 @@
+// gcom_pipeline.cpp
+// pipelined modbus tcp client, see gcom_pipeline.h
+// also holds a small in process mock server used by bench_pipeline
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "gcom_config.h"
+#include "gcom_iothread.h"
+#include "gcom_pipeline.h"
+
+#define MBAP_HEADER_LENGTH 7
+
+static inline void put16(uint8_t* p, int v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xff);
+}
+
+static inline int get16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+MbPipeline::MbPipeline(int _depth, double _timeout)
+    : depth(_depth), timeout(_timeout) {
+    if (depth < 1)
+        depth = 1;
+    if (depth > MB_PIPELINE_MAX_DEPTH)
+        depth = MB_PIPELINE_MAX_DEPTH;
+    slot_bits = 0;
+    while ((1 << slot_bits) < depth)
+        slot_bits++;
+    slot_mask = (1 << slot_bits) - 1;
+    slots.resize(1 << slot_bits);
+}
+
+MbPipeline::~MbPipeline() {
+    close();
+}
+
+bool MbPipeline::open(const std::string& ip, int port, double connect_timeout) {
+    if (!connect_start(ip, port))
+        return false;
+    if (connecting) {
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        if (::poll(&pfd, 1, (int)(connect_timeout * 1000.0)) <= 0) {
+            close();
+            errno = ETIMEDOUT;
+            return false;
+        }
+        return connect_finish();
+    }
+    return true;
+}
+
+bool MbPipeline::connect_start(const std::string& ip, int port) {
+    close();
+
+    struct addrinfo hints;
+    struct addrinfo* res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    auto port_str = std::to_string(port);
+    if (getaddrinfo(ip.c_str(), port_str.c_str(), &hints, &res) != 0 || !res)
+        return false;
+
+    int sock = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return false;
+    }
+    int rc = connect(sock, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && errno != EINPROGRESS) {
+        int err = errno;
+        ::close(sock);
+        errno = err;
+        return false;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fd = sock;
+    rxlen = 0;
+    connecting = (rc < 0);
+    return true;
+}
+
+bool MbPipeline::connect_finish() {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        err = errno;
+    if (err != 0) {
+        close();
+        errno = err;
+        return false;
+    }
+    connecting = false;
+    return true;
+}
+
+void MbPipeline::close() {
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    rxlen = 0;
+    connecting = false;
+}
+
+// build the MBAP header and pdu, returns the frame length or -1 if the request can't be sent
+int MbPipeline::encode(IO_Work* io_work, uint16_t tid, uint8_t* frame) {
+    uint8_t* pdu = frame + MBAP_HEADER_LENGTH;
+    int num = io_work->num_registers;
+    bool is_set = (io_work->wtype == WorkTypes::Set) || (io_work->wtype == WorkTypes::SetMulti);
+    int pdu_len = 0;
+
+    put16(pdu + 1, io_work->offset);
+    switch (io_work->reg_type) {
+    case cfg::Register_Types::Holding:
+        if (is_set && num == 1 && io_work->wtype == WorkTypes::Set) {
+            pdu[0] = 0x06;
+            put16(pdu + 3, io_work->buf16[0]);
+            pdu_len = 5;
+        } else if (is_set) {
+            if (num < 1 || num > MODBUS_MAX_WRITE_REGISTERS)
+                return -1;
+            pdu[0] = 0x10;
+            put16(pdu + 3, num);
+            pdu[5] = (uint8_t)(num * 2);
+            for (int i = 0; i < num; ++i)
+                put16(pdu + 6 + i * 2, io_work->buf16[i]);
+            pdu_len = 6 + num * 2;
+        } else {
+            if (num < 1 || num > MODBUS_MAX_READ_REGISTERS)
+                return -1;
+            pdu[0] = 0x03;
+            put16(pdu + 3, num);
+            pdu_len = 5;
+        }
+        break;
+    case cfg::Register_Types::Input:
+        if (num < 1 || num > MODBUS_MAX_READ_REGISTERS)
+            return -1;
+        pdu[0] = 0x04;
+        put16(pdu + 3, num);
+        pdu_len = 5;
+        break;
+    case cfg::Register_Types::Coil:
+        if (is_set && num == 1 && io_work->wtype == WorkTypes::Set) {
+            pdu[0] = 0x05;
+            put16(pdu + 3, io_work->buf8[0] ? 0xff00 : 0x0000);
+            pdu_len = 5;
+        } else if (is_set) {
+            if (num < 1 || num > (int)sizeof(io_work->buf8))
+                return -1;
+            pdu[0] = 0x0f;
+            put16(pdu + 3, num);
+            int nbytes = (num + 7) / 8;
+            pdu[5] = (uint8_t)nbytes;
+            memset(pdu + 6, 0, nbytes);
+            for (int i = 0; i < num; ++i)
+                if (io_work->buf8[i])
+                    pdu[6 + i / 8] |= (uint8_t)(1 << (i % 8));
+            pdu_len = 6 + nbytes;
+        } else {
+            if (num < 1 || num > (int)sizeof(io_work->buf8))
+                return -1;
+            pdu[0] = 0x01;
+            put16(pdu + 3, num);
+            pdu_len = 5;
+        }
+        break;
+    case cfg::Register_Types::Discrete_Input:
+        if (num < 1 || num > (int)sizeof(io_work->buf8))
+            return -1;
+        pdu[0] = 0x02;
+        put16(pdu + 3, num);
+        pdu_len = 5;
+        break;
+    default:
+        return -1;
+    }
+
+    put16(frame, tid);
+    put16(frame + 2, 0);
+    put16(frame + 4, pdu_len + 1);
+    frame[6] = (uint8_t)io_work->device_id;
+    return MBAP_HEADER_LENGTH + pdu_len;
+}
+
+bool MbPipeline::send_all(const uint8_t* data, int len) {
+    int sent = 0;
+    while (sent < len) {
+        auto rc = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (rc > 0) {
+            sent += rc;
+            continue;
+        }
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            if (::poll(&pfd, 1, (int)(timeout * 1000.0)) > 0)
+                continue;
+            errno = ETIMEDOUT;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool MbPipeline::submit(IO_WorkHandle io_work, double tNow) {
+    io_work->errors = -1;
+    if (fd < 0 || connecting) {
+        io_work->errno_code = ENOTCONN;
+        return false;
+    }
+    if (full()) {
+        io_work->errno_code = EAGAIN;
+        return false;
+    }
+    int slot = 0;
+    while (slots[slot].busy)
+        slot++;
+
+    uint16_t tid = (uint16_t)(((generation++) << slot_bits) | slot);
+    uint8_t frame[MODBUS_TCP_MAX_ADU_LENGTH];
+    int len = encode(io_work.get(), tid, frame);
+    if (len < 0) {
+        io_work->errno_code = EINVAL;
+        return false;
+    }
+    if (!send_all(frame, len)) {
+        io_work->errno_code = errno;
+        close();
+        return false;
+    }
+
+    auto& txn = slots[slot];
+    txn.tid = tid;
+    txn.fc = frame[MBAP_HEADER_LENGTH];
+    txn.busy = true;
+    txn.tSent = tNow;
+    txn.deadline = tNow + timeout;
+    txn.io_work = io_work;
+    num_busy++;
+    stats.sent++;
+    return true;
+}
+
+// unpack a reply pdu into the io_work, same results as the libmodbus calls
+bool MbPipeline::decode(MbTxn& txn, const uint8_t* pdu, int pdu_len) {
+    auto io_work = txn.io_work;
+    int num = io_work->num_registers;
+    io_work->errors = -1;
+
+    if (pdu_len >= 2 && (pdu[0] & 0x80)) {
+        io_work->errno_code = MODBUS_ENOBASE + pdu[1];
+        stats.exceptions++;
+        return true;
+    }
+    io_work->errno_code = EMBBADDATA;
+    if (pdu_len < 2 || pdu[0] != txn.fc)
+        return false;
+
+    switch (txn.fc) {
+    case 0x03:
+    case 0x04:
+        if (pdu[1] != num * 2 || pdu_len != 2 + num * 2)
+            return false;
+        for (int i = 0; i < num; ++i)
+            io_work->buf16[i] = (uint16_t)get16(pdu + 2 + i * 2);
+        io_work->errors = num;
+        break;
+    case 0x01:
+    case 0x02:
+        if (pdu[1] != (num + 7) / 8 || pdu_len != 2 + pdu[1])
+            return false;
+        for (int i = 0; i < num; ++i)
+            io_work->buf8[i] = (pdu[2 + i / 8] >> (i % 8)) & 1;
+        io_work->errors = num;
+        break;
+    case 0x05:
+    case 0x06:
+        if (pdu_len != 5)
+            return false;
+        io_work->errors = 1;
+        break;
+    case 0x0f:
+    case 0x10:
+        if (pdu_len != 5)
+            return false;
+        io_work->errors = get16(pdu + 3);
+        break;
+    default:
+        return false;
+    }
+    io_work->errno_code = 0;
+    return true;
+}
+
+void MbPipeline::complete(MbTxn& txn, std::vector<IO_WorkHandle>& done) {
+    done.push_back(txn.io_work);
+    txn.io_work.reset();
+    txn.busy = false;
+    num_busy--;
+}
+
+int MbPipeline::fail_all(std::vector<IO_WorkHandle>& done, int err) {
+    int count = 0;
+    for (auto& txn : slots) {
+        if (!txn.busy)
+            continue;
+        txn.io_work->errors = -1;
+        txn.io_work->errno_code = err;
+        complete(txn, done);
+        count++;
+    }
+    return count;
+}
+
+double MbPipeline::next_deadline() const {
+    double first = std::numeric_limits<double>::max();
+    for (auto& txn : slots)
+        if (txn.busy && txn.deadline < first)
+            first = txn.deadline;
+    return first;
+}
+
+int MbPipeline::poll(std::vector<IO_WorkHandle>& done, double wait) {
+    double tNow = get_time_double();
+    bool readable = false;
+
+    // keep reading when idle too so late replies are drained
+    if (fd >= 0 && !connecting) {
+        double first = std::min(tNow + wait, next_deadline());
+        int wait_ms = (int)((first - tNow) * 1000.0);
+        if (wait_ms < 0)
+            wait_ms = 0;
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        readable = (::poll(&pfd, 1, wait_ms) > 0);
+        tNow = get_time_double();
+    } else if (wait > 0.0) {
+        std::this_thread::sleep_for(std::chrono::microseconds((int)(wait * 1e6)));
+        tNow = get_time_double();
+    }
+    return service(done, readable, tNow);
+}
+
+int MbPipeline::service(std::vector<IO_WorkHandle>& done, bool readable, double tNow) {
+    size_t start = done.size();
+
+    if (fd >= 0 && !connecting) {
+        if (readable) {
+            while (true) {
+                auto rc = recv(fd, rxbuf + rxlen, sizeof(rxbuf) - rxlen, 0);
+                if (rc > 0) {
+                    rxlen += rc;
+                    if (rxlen == (int)sizeof(rxbuf))
+                        break;
+                    continue;
+                }
+                if (rc < 0 && errno == EINTR)
+                    continue;
+                if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                // peer closed or socket error
+                fail_all(done, ECONNRESET);
+                close();
+                return done.size() - start;
+            }
+        }
+
+        int pos = 0;
+        while (rxlen - pos >= MBAP_HEADER_LENGTH + 1) {
+            const uint8_t* frame = rxbuf + pos;
+            int len = get16(frame + 4);
+            if (get16(frame + 2) != 0 || len < 2 || len > MODBUS_TCP_MAX_ADU_LENGTH - 6) {
+                // lost the framing, nothing after this can be trusted
+                stats.bad_frames++;
+                fail_all(done, EMBBADDATA);
+                close();
+                return done.size() - start;
+            }
+            if (rxlen - pos < 6 + len)
+                break;
+            int tid = get16(frame);
+            auto& txn = slots[tid & slot_mask];
+            if (txn.busy && txn.tid == tid) {
+                if (!decode(txn, frame + MBAP_HEADER_LENGTH, len - 1))
+                    stats.bad_frames++;
+                txn.io_work->tRun = tNow - txn.tSent;
+                stats.received++;
+                complete(txn, done);
+            } else {
+                // the transaction already timed out or was never ours
+                stats.late++;
+            }
+            pos += 6 + len;
+        }
+        if (pos > 0) {
+            memmove(rxbuf, rxbuf + pos, rxlen - pos);
+            rxlen -= pos;
+        }
+    }
+
+    for (auto& txn : slots) {
+        if (txn.busy && txn.deadline <= tNow) {
+            txn.io_work->errors = -1;
+            txn.io_work->errno_code = ETIMEDOUT;
+            txn.io_work->tRun = tNow - txn.tSent;
+            stats.timeouts++;
+            complete(txn, done);
+        }
+    }
+    return done.size() - start;
+}
+
+
+// mock modbus tcp server for the benchmarks
+// one epoll thread serves any number of client connections, each one looks like a device
+// answers FC3/FC4 reads with value = address, every reply is held back by rtt
+// requests are accepted while earlier ones are still waiting, like a real link with latency
+bool MockMbServer::start(double _rtt) {
+    rtt = _rtt;
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 512) < 0) {
+        ::close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd, (struct sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    running = true;
+    thread = std::thread(&MockMbServer::run, this);
+    return true;
+}
+
+void MockMbServer::stop() {
+    running = false;
+    if (thread.joinable())
+        thread.join();
+    if (listen_fd >= 0)
+        ::close(listen_fd);
+    listen_fd = -1;
+}
+
+void MockMbServer::run() {
+    struct Client {
+        int rxlen = 0;
+        uint8_t rx[4096];
+    };
+    struct Reply {
+        double due;
+        int fd;
+        int len;
+        uint8_t frame[MODBUS_TCP_MAX_ADU_LENGTH];
+    };
+    std::map<int, std::unique_ptr<Client>> clients;
+    // every reply has the same delay so the queue is already in due order
+    std::deque<Reply> replies;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    struct epoll_event events[64];
+
+    while (running) {
+        double tNow = get_time_double();
+        while (!replies.empty() && replies.front().due <= tNow) {
+            auto& r = replies.front();
+            if (clients.find(r.fd) != clients.end())
+                send(r.fd, r.frame, r.len, MSG_NOSIGNAL);
+            replies.pop_front();
+        }
+        int wait_ms = 20;
+        if (!replies.empty()) {
+            wait_ms = (int)((replies.front().due - tNow) * 1000.0);
+            if (wait_ms < 0)
+                wait_ms = 0;
+        }
+        int num = epoll_wait(epfd, events, 64, wait_ms);
+        tNow = get_time_double();
+        for (int e = 0; e < num; ++e) {
+            int fd = events[e].data.fd;
+            if (fd == listen_fd) {
+                int cfd;
+                while ((cfd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    int one = 1;
+                    setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    clients[cfd] = std::make_unique<Client>();
+                    ev.events = EPOLLIN;
+                    ev.data.fd = cfd;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev);
+                }
+                continue;
+            }
+            auto it = clients.find(fd);
+            if (it == clients.end())
+                continue;
+            auto& cl = *it->second;
+            auto rc = recv(fd, cl.rx + cl.rxlen, sizeof(cl.rx) - cl.rxlen, 0);
+            if (rc <= 0) {
+                if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+                    continue;
+                ::close(fd);
+                clients.erase(it);
+                continue;
+            }
+            cl.rxlen += rc;
+
+            int pos = 0;
+            while (cl.rxlen - pos >= 12) {
+                const uint8_t* req = cl.rx + pos;
+                int len = get16(req + 4);
+                if (cl.rxlen - pos < 6 + len)
+                    break;
+                Reply r;
+                r.due = tNow + rtt;
+                r.fd = fd;
+                memcpy(r.frame, req, MBAP_HEADER_LENGTH);
+                uint8_t* pdu = r.frame + MBAP_HEADER_LENGTH;
+                int fc = req[7];
+                int addr = get16(req + 8);
+                int num_regs = get16(req + 10);
+                if ((fc == 0x03 || fc == 0x04) && num_regs <= MODBUS_MAX_READ_REGISTERS) {
+                    pdu[0] = (uint8_t)fc;
+                    pdu[1] = (uint8_t)(num_regs * 2);
+                    for (int i = 0; i < num_regs; ++i)
+                        put16(pdu + 2 + i * 2, addr + i);
+                    put16(r.frame + 4, 3 + num_regs * 2);
+                    r.len = MBAP_HEADER_LENGTH + 2 + num_regs * 2;
+                } else {
+                    pdu[0] = (uint8_t)(fc | 0x80);
+                    pdu[1] = MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+                    put16(r.frame + 4, 3);
+                    r.len = MBAP_HEADER_LENGTH + 2;
+                }
+                replies.push_back(r);
+                pos += 6 + len;
+            }
+            memmove(cl.rx, cl.rx + pos, cl.rxlen - pos);
+            cl.rxlen -= pos;
+        }
+    }
+    for (auto& cl : clients)
+        ::close(cl.first);
+    ::close(epfd);
+}
+
+// run transactions for secs at each rtt / depth and report transactions per second
+// depth 1 is the same one at a time pattern runThreadWork gets from libmodbus
+int bench_pipeline(double secs) {
+    int errors = 0;
+    const double rtts[] = {0.001, 0.005, 0.020};
+    const int depths[] = {1, 4, 16};
+
+    std::cout << " bench_pipeline  10 register FC3 reads, " << secs << " seconds per run" << std::endl;
+    for (auto rtt : rtts) {
+        double base_rate = 0.0;
+        for (auto depth : depths) {
+            MockMbServer server;
+            if (!server.start(rtt)) {
+                std::cout << " unable to start mock server" << std::endl;
+                return 1;
+            }
+            MbPipeline pipe(depth, 1.0);
+            if (!pipe.open("127.0.0.1", server.port, 1.0)) {
+                std::cout << " unable to connect to mock server" << std::endl;
+                server.stop();
+                return 1;
+            }
+
+            std::vector<IO_Work> works(depth);
+            std::vector<IO_WorkHandle> done;
+            for (int i = 0; i < depth; ++i) {
+                works[i].reg_type = cfg::Register_Types::Holding;
+                works[i].wtype = WorkTypes::Get;
+                works[i].device_id = 1;
+                works[i].offset = i * 10;
+                works[i].num_registers = 10;
+            }
+
+            int bad = 0;
+            u64 count = 0;
+            double tStart = get_time_double();
+            double tEnd = tStart + secs;
+            for (int i = 0; i < depth; ++i)
+                pipe.submit(IO_WorkHandle(&works[i]), tStart);
+            while (pipe.in_flight() > 0) {
+                pipe.poll(done, 0.1);
+                double tNow = get_time_double();
+                for (auto io_work : done) {
+                    count++;
+                    if (io_work->errors != io_work->num_registers || io_work->buf16[3] != io_work->offset + 3)
+                        bad++;
+                    if (tNow < tEnd)
+                        pipe.submit(io_work, tNow);
+                }
+                done.clear();
+            }
+            double tRun = get_time_double() - tStart;
+            double rate = count / tRun;
+            if (depth == 1)
+                base_rate = rate;
+
+            std::cout << "    rtt " << rtt * 1000.0 << " mS"
+                      << " depth " << depth
+                      << " transactions " << count
+                      << " tx/s " << (int)rate
+                      << " gain " << (base_rate > 0.0 ? rate / base_rate : 0.0)
+                      << " bad " << bad
+                      << " timeouts " << pipe.stats.timeouts
+                      << " late " << pipe.stats.late
+                      << std::endl;
+            if (bad)
+                errors++;
+            pipe.close();
+            server.stop();
+        }
+    }
+
+    // replies slower than the transaction timeout must time out and then be dropped as late
+    MockMbServer server;
+    if (server.start(0.020)) {
+        MbPipeline pipe(4, 0.005);
+        if (pipe.open("127.0.0.1", server.port, 1.0)) {
+            std::vector<IO_Work> works(4);
+            std::vector<IO_WorkHandle> done;
+            double tNow = get_time_double();
+            for (auto& work : works) {
+                work.reg_type = cfg::Register_Types::Holding;
+                work.wtype = WorkTypes::Get;
+                work.device_id = 1;
+                work.offset = 0;
+                work.num_registers = 10;
+                pipe.submit(IO_WorkHandle(&work), tNow);
+            }
+            while (pipe.in_flight() > 0)
+                pipe.poll(done, 0.1);
+            // let the late replies arrive
+            double tStop = get_time_double() + 0.1;
+            while (pipe.stats.late < 4 && get_time_double() < tStop)
+                pipe.poll(done, 0.01);
+            std::cout << "    timeout check  timeouts " << pipe.stats.timeouts
+                      << " late " << pipe.stats.late
+                      << std::endl;
+            if (pipe.stats.timeouts < 4 || pipe.stats.late < 4)
+                errors++;
+        }
+        pipe.close();
+        server.stop();
+    }
+    std::cout << " bench_pipeline errors " << errors << std::endl;
+    return errors;
+}
@@ -0,0 +1,334 @@
+// gcom_point_store.cpp
+// column store for the map item runtime state, see gcom_point_store.h
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "gcom_config.h"
+#include "gcom_point_store.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void PointStore::resize(size_t num_points) {
+    raw_val.assign(num_points, 0);
+    last_raw_val.assign(num_points, 0);
+    float_val.assign(num_points, 0.0);
+    last_float_val.assign(num_points, 0.0);
+    debounce_time.assign(num_points, 0.0);
+    forced_val.assign(num_points, 0);
+    value.assign(num_points, 0);
+    kind.assign(num_points, DecodeValue::Kind::None);
+    debounce.assign(num_points, 0.0);
+    deadband.assign(num_points, 0.0);
+    pub_val.assign(num_points, 0.0);
+    pending.assign(num_points, 0);
+}
+
+void PointStore::init(int32_t pid, const cfg::map_struct& item) {
+    raw_val[pid] = 0;
+    last_raw_val[pid] = 0;
+    float_val[pid] = 0.0;
+    last_float_val[pid] = 0.0;
+    debounce_time[pid] = 0.0;
+    forced_val[pid] = 0;
+    value[pid] = 0;
+    kind[pid] = DecodeValue::Kind::None;
+    debounce[pid] = item.use_debounce && item.debounce > 0.0 ? item.debounce : 0.0;
+    deadband[pid] = item.use_deadband && item.deadband > 0.0 ? item.deadband : 0.0;
+    pub_val[pid] = 0.0;
+    pending[pid] = 0;
+}
+
+void PointStore::set_value(int32_t pid, u64 raw, const DecodeValue& val) {
+    last_raw_val[pid] = raw_val[pid];
+    raw_val[pid] = raw;
+    set_value(pid, val);
+}
+
+void PointStore::set_value(int32_t pid, const DecodeValue& val) {
+    last_float_val[pid] = float_val[pid];
+    switch (val.kind) {
+        case DecodeValue::Kind::Unsigned: float_val[pid] = static_cast<double>(val.u); break;
+        case DecodeValue::Kind::Signed:   float_val[pid] = static_cast<double>(val.s); break;
+        case DecodeValue::Kind::Float:    float_val[pid] = val.f; break;
+        default: break;
+    }
+    value[pid] = val.u;
+    kind[pid] = val.kind;
+}
+
+DecodeValue PointStore::get_value(int32_t pid) const {
+    DecodeValue val;
+    val.kind = kind[pid];
+    val.u = value[pid];
+    return val;
+}
+
+// first pass arms the timer and lets the point through, after that one pass per debounce period
+bool PointStore::debounce_check(int32_t pid, double tNow) {
+    double period = debounce[pid];
+    if (period == 0.0)
+        return true;
+    double& until = debounce_time[pid];
+    if (until == 0.0) {
+        until = tNow + period;
+        return true;
+    }
+    if (tNow > until) {
+        until += period;
+        return true;
+    }
+    return false;
+}
+
+void PointStore::debounce_scan(const int32_t* pids, size_t num, double tNow, u8* enabled) {
+    for (size_t k = 0; k < num; ++k) {
+        if (!debounce_check(pids[k], tNow))
+            enabled[k] = 0;
+    }
+}
+
+void PointStore::resize_regs(size_t num_regs) {
+    regs.assign(num_regs, 0);
+    regs_valid.assign(num_regs, 0);
+}
+
+size_t PointStore::diff_regs(size_t regs_at, const u16* cur, size_t num, u64* changed) {
+    u16* prev = &regs[regs_at];
+    u16* valid = &regs_valid[regs_at];
+    size_t num_changed = 0;
+    size_t k = 0;
+    for (size_t w = 0; w < (num + 63) / 64; ++w)
+        changed[w] = 0;
+#if defined(__SSE2__)
+    // 8 registers a step, equal and valid packs down to one byte a register
+    const __m128i ones = _mm_set1_epi16(-1);
+    for (; k + 8 <= num; k += 8) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + k));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + k));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(valid + k));
+        __m128i same = _mm_and_si128(_mm_cmpeq_epi16(p, c), v);
+        u64 bits = ~_mm_movemask_epi8(_mm_packs_epi16(same, same)) & 0xff;
+        if (bits) {
+            changed[k / 64] |= bits << (k % 64);
+            num_changed += __builtin_popcountll(bits);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(prev + k), c);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(valid + k), ones);
+        }
+    }
+#endif
+    for (; k < num; ++k) {
+        if (!valid[k] || prev[k] != cur[k]) {
+            changed[k / 64] |= 1ull << (k % 64);
+            num_changed++;
+            prev[k] = cur[k];
+            valid[k] = 0xffff;
+        }
+    }
+    return num_changed;
+}
+
+bool PointStore::pub_check(int32_t pid, double tNow) {
+    if (!debounce_check(pid, tNow)) {
+        pending[pid] = 1;
+        return false;
+    }
+    if (deadband[pid] > 0.0 && kind[pid] != DecodeValue::Kind::None
+            && std::fabs(float_val[pid] - pub_val[pid]) < deadband[pid]) {
+        pending[pid] = 0;
+        return false;
+    }
+    return true;
+}
+
+void PointStore::format(fmt::memory_buffer& buf, const std::vector<cfg::map_struct*>& items,
+                        const int32_t* pids, size_t num) const {
+    for (size_t k = 0; k < num; ++k) {
+        int32_t pid = pids[k];
+        if (k)
+            fmt::format_to(std::back_inserter(buf), ", ");
+        fmt::format_to(std::back_inserter(buf), "\"{}\": ", items[pid]->id);
+        u64 bits = value[pid];
+        switch (kind[pid]) {
+            case DecodeValue::Kind::Unsigned:
+                fmt::format_to(std::back_inserter(buf), "{}", bits);
+                break;
+            case DecodeValue::Kind::Signed:
+                fmt::format_to(std::back_inserter(buf), "{}", static_cast<s64>(bits));
+                break;
+            case DecodeValue::Kind::Float: {
+                double f;
+                memcpy(&f, &bits, sizeof(f));
+                fmt::format_to(std::back_inserter(buf), "{}", f);
+                break;
+            }
+            default:
+                fmt::format_to(std::back_inserter(buf), "null");
+                break;
+        }
+    }
+}
+
+
+// run the debounce gate through map_struct pointers one item at a time and as a column scan,
+// check both agree and time them
+int test_point_store() {
+    int errors = 0;
+    const int num_points = 4000;
+
+    std::vector<std::shared_ptr<cfg::map_struct>> maps;
+    std::vector<cfg::map_struct*> items;
+    PointStore store(num_points);
+    PointStore check(num_points);
+    for (int i = 0; i < num_points; ++i) {
+        auto map = std::make_shared<cfg::map_struct>();
+        map->id = "point_" + std::to_string(i);
+        map->debounce = (i % 4 == 0) ? 0.0 : 0.001 * (i % 5 + 1);
+        map->use_debounce = map->debounce > 0.0;
+        map->point_id = i;
+        store.init(i, *map);
+        check.init(i, *map);
+        items.push_back(map.get());
+        maps.push_back(map);
+    }
+
+    // the gate itself
+    {
+        PointStore one(1);
+        cfg::map_struct item;
+        item.use_debounce = true;
+        item.debounce = 1.0;
+        one.init(0, item);
+        if (!one.debounce_check(0, 10.0)) errors++;    // arms
+        if (one.debounce_check(0, 10.5)) errors++;     // held off
+        if (!one.debounce_check(0, 11.1)) errors++;    // period passed
+        if (one.debounce_check(0, 11.5)) errors++;     // next period
+    }
+
+    std::vector<int32_t> pids(num_points);
+    for (int i = 0; i < num_points; ++i)
+        pids[i] = i;
+    std::vector<u8> en_item(num_points);
+    std::vector<u8> en_scan(num_points);
+
+    using clk = std::chrono::steady_clock;
+    const int loops = 2000;
+    double t_item = 0.0;
+    double t_scan = 0.0;
+    size_t passed = 0;
+    for (int l = 0; l < loops; ++l) {
+        double tNow = 100.0 + l * 0.0005;
+        auto t0 = clk::now();
+        for (int i = 0; i < num_points; ++i) {
+            auto item = items[i];
+            bool enabled = true;
+            if (item->use_debounce)
+                enabled = check.debounce_check(item->point_id, tNow);
+            en_item[i] = enabled;
+        }
+        auto t1 = clk::now();
+        std::fill(en_scan.begin(), en_scan.end(), 1);
+        store.debounce_scan(pids.data(), pids.size(), tNow, en_scan.data());
+        auto t2 = clk::now();
+        t_item += std::chrono::duration<double>(t1 - t0).count();
+        t_scan += std::chrono::duration<double>(t2 - t1).count();
+        if (en_item != en_scan)
+            errors++;
+        for (auto e : en_scan)
+            passed += e;
+    }
+
+    for (int i = 0; i < num_points; ++i) {
+        DecodeValue val;
+        if (i % 3 == 0)
+            val.set(static_cast<u64>(i));
+        else if (i % 3 == 1)
+            val.set(static_cast<s64>(-i));
+        else
+            val.set(i * 0.5);
+        store.set_value(i, static_cast<u64>(i), val);
+    }
+    fmt::memory_buffer buf;
+    double t_fmt = 0.0;
+    for (int l = 0; l < 100; ++l) {
+        buf.clear();
+        auto t0 = clk::now();
+        store.format(buf, items, pids.data(), pids.size());
+        t_fmt += std::chrono::duration<double>(clk::now() - t0).count();
+    }
+    std::string out(buf.data(), buf.size());
+    if (out.compare(0, 37, "\"point_0\": 0, \"point_1\": -1, \"point_2") != 0) {
+        std::cout << " format mismatch [" << out.substr(0, 40) << "]" << std::endl;
+        errors++;
+    }
+
+    // register diff against a plain compare, a few registers change each pass
+    const size_t num_regs = 4096;
+    store.resize_regs(num_regs);
+    std::vector<u16> cur(num_regs);
+    std::vector<u16> shadow(num_regs);
+    std::vector<u8> seen(num_regs, 0);
+    std::vector<u64> changed((num_regs + 63) / 64);
+    std::mt19937 rng(9);
+    for (auto& r : cur)
+        r = rng();
+    double t_diff = 0.0;
+    const int diff_loops = 2000;
+    for (int l = 0; l < diff_loops; ++l) {
+        for (int n = 0; n < 20; ++n)
+            cur[rng() % num_regs] = rng();
+        // an unaligned window now and then
+        size_t at = (l % 5 == 0) ? rng() % 64 : 0;
+        size_t num = num_regs - at - (l % 3);
+        auto t0 = clk::now();
+        size_t nchg = store.diff_regs(at, &cur[at], num, changed.data());
+        t_diff += std::chrono::duration<double>(clk::now() - t0).count();
+        size_t want = 0;
+        for (size_t k = 0; k < num; ++k) {
+            bool diff = !seen[at + k] || shadow[at + k] != cur[at + k];
+            bool bit = (changed[k / 64] >> (k % 64)) & 1;
+            if (diff != bit)
+                errors++;
+            want += diff;
+            shadow[at + k] = cur[at + k];
+            seen[at + k] = 1;
+        }
+        if (nchg != want)
+            errors++;
+    }
+
+    // deadband measured from the last pub
+    {
+        PointStore one(1);
+        cfg::map_struct item;
+        item.use_deadband = true;
+        item.deadband = 1.0;
+        one.init(0, item);
+        DecodeValue val;
+        val.set(5.0);
+        one.set_value(0, val);
+        if (!one.pub_check(0, 1.0)) errors++;
+        one.published(0);
+        val.set(5.5);
+        one.set_value(0, val);
+        if (one.pub_check(0, 1.0)) errors++;
+        val.set(6.2);
+        one.set_value(0, val);
+        if (!one.pub_check(0, 1.0)) errors++;
+    }
+
+    double checks = (double)num_points * loops;
+    std::cout << " test_point_store points " << num_points << " passed " << passed << std::endl;
+    std::cout << "    item debounce  " << checks / t_item / 1e6 << " M points/s" << std::endl;
+    std::cout << "    scan debounce  " << checks / t_scan / 1e6 << " M points/s  speedup " << t_item / t_scan << std::endl;
+    std::cout << "    format         " << num_points * 100.0 / t_fmt / 1e6 << " M points/s" << std::endl;
+    std::cout << "    register diff  " << (double)num_regs * diff_loops / t_diff / 1e6 << " M regs/s" << std::endl;
+    std::cout << " test_point_store errors " << errors << std::endl;
+    return errors;
+}
@@ -0,0 +1,339 @@
+// gcom_poll_planner.cpp
+// build the poll span plan for a component, see gcom_poll_planner.h
+//
+// bad_regs hold absolute register offsets, the same numbering as map_struct::offset
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+#include "gcom_config.h"
+#include "gcom_poll_planner.h"
+
+PollPlanner pollPlanner;
+
+// old samples fade with this weight per new sample
+static constexpr double cost_decay = 0.95;
+// need this many samples before the fit is used
+static constexpr int cost_min_samples = 8;
+// rebuild a plan when a device break even gap moves by more than this
+static constexpr double cost_change = 0.25;
+
+static bool is_bit_type(cfg::Register_Types reg_type) {
+    return reg_type == cfg::Register_Types::Coil || reg_type == cfg::Register_Types::Discrete_Input;
+}
+
+void DeviceCost::record(int num_registers, double tRun) {
+    if (tRun <= 0.0 || num_registers <= 0)
+        return;
+    double x = num_registers;
+    sw  = sw  * cost_decay + 1.0;
+    sx  = sx  * cost_decay + x;
+    sy  = sy  * cost_decay + tRun;
+    sxx = sxx * cost_decay + x * x;
+    sxy = sxy * cost_decay + x * tRun;
+    samples++;
+    if (samples < cost_min_samples)
+        return;
+
+    double det = sw * sxx - sx * sx;
+    if (det > 1e-6 * sw * sxx) {
+        // the reads vary in size so we can split the time into base and per register
+        double b = (sw * sxy - sx * sy) / det;
+        double a = (sy - b * sx) / sw;
+        reg_time  = std::max(b, 1e-7);
+        base_time = std::max(a, 0.0);
+    } else {
+        // all the reads are the same size, keep the per register guess and fit the base
+        base_time = std::max(sy / sw - reg_time * sx / sw, 0.0);
+    }
+}
+
+double DeviceCost::gap_limit() const {
+    double limit = base_time / reg_time;
+    return std::min(limit, (double)MAX_POLL_BITS);
+}
+
+void PollPlanner::record_io(int device_id, cfg::Register_Types reg_type, int num_registers, double tRun) {
+    // a bit read costs about a sixteenth of a register on the wire
+    if (is_bit_type(reg_type))
+        num_registers = (num_registers + 15) / 16;
+    std::lock_guard<std::mutex> lock(cost_mtx);
+    costs[device_id].record(num_registers, tRun);
+}
+
+double PollPlanner::gap_limit(int device_id) {
+    std::lock_guard<std::mutex> lock(cost_mtx);
+    return costs[device_id].gap_limit();
+}
+
+void PollPlanner::invalidate() {
+    std::lock_guard<std::mutex> lock(plan_mtx);
+    plans.clear();
+}
+
+// bad_regs is read by build_plan under plan_mtx, change it under the same lock
+void PollPlanner::set_bad_regs(cfg::reg_struct* reg, const std::vector<int>& bad) {
+    std::lock_guard<std::mutex> lock(plan_mtx);
+    reg->bad_regs = bad;
+}
+
+int PollPlanner::max_span(cfg::Register_Types reg_type) {
+    if (is_bit_type(reg_type))
+        return std::min(MAX_POLL_BITS, POLL_BUF_BITS);
+    return MAX_POLL_REGISTERS;
+}
+
+// span_start/span_end is the read we have so far, next_start/next_end the item we want to add
+// bad must be sorted
+bool PollPlanner::can_merge(cfg::Register_Types reg_type, int span_start, int span_end,
+                            int next_start, int next_end, int max_gap, double gap_limit,
+                            const std::vector<int>& bad) {
+    if (std::max(span_end, next_end) - span_start > max_span(reg_type))
+        return false;
+    int gap = next_start - span_end;
+    if (gap <= 0)
+        return true;
+    if (gap > max_gap)
+        return false;
+    // gap_limit is in registers, bits are cheaper
+    double limit = is_bit_type(reg_type) ? gap_limit * 16 : gap_limit;
+    if (gap > limit)
+        return false;
+    auto it = std::lower_bound(bad.begin(), bad.end(), span_end);
+    return it == bad.end() || *it >= next_start;
+}
+
+// anything that changes the plan for this comp, apart from the device cost
+u64 PollPlanner::plan_sig(cfg::comp_struct* comp, int max_gap) {
+    u64 sig = 14695981039346656037ULL;
+    auto mix = [&sig](u64 v) {
+        sig ^= v;
+        sig *= 1099511628211ULL;
+    };
+    mix((u64)max_gap);
+    for (auto& reg : comp->registers) {
+        mix((u64)(uintptr_t)reg.get());
+        mix((u64)reg->enabled);
+        mix((u64)reg->device_id);
+        mix((u64)reg->reg_type);
+        mix((u64)reg->starting_offset);
+        mix((u64)reg->number_of_registers);
+        mix((u64)reg->maps.size());
+        mix((u64)reg->bad_regs.size());
+        for (auto b : reg->bad_regs)
+            mix((u64)b);
+    }
+    return sig;
+}
+
+void PollPlanner::build_plan(PollPlan& plan, cfg::comp_struct* comp, int max_gap,
+                             const std::map<int, double>& gap_limits) {
+    struct Item {
+        int start;
+        int end;
+        cfg::reg_struct* reg;
+    };
+    using Key = std::pair<int, cfg::Register_Types>;
+    std::map<Key, std::vector<Item>> groups;
+    std::map<Key, std::vector<int>> group_bad;
+
+    plan.spans.clear();
+    plan.max_gap = max_gap;
+
+    for (auto& regshr : comp->registers) {
+        auto reg = regshr.get();
+        if (!reg->enabled)
+            continue;
+        Key key{reg->device_id, reg->reg_type};
+        auto& bad = group_bad[key];
+        bad.insert(bad.end(), reg->bad_regs.begin(), reg->bad_regs.end());
+
+        auto& items = groups[key];
+        for (auto& map : reg->maps) {
+            Item item{map->offset, map->offset + std::max(map->size, 1), reg};
+            // route around quarantined registers
+            bool is_bad = false;
+            for (auto b : reg->bad_regs) {
+                if (b >= item.start && b < item.end) {
+                    is_bad = true;
+                    break;
+                }
+            }
+            if (!is_bad)
+                items.push_back(item);
+        }
+    }
+
+    for (auto& [key, items] : groups) {
+        if (items.empty())
+            continue;
+        auto& bad = group_bad[key];
+        std::sort(bad.begin(), bad.end());
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+            return a.start < b.start;
+        });
+
+        double limit = 0.0;
+        auto lit = gap_limits.find(key.first);
+        if (lit != gap_limits.end())
+            limit = lit->second;
+
+        PollSpan span;
+        span.reg_type = key.second;
+        span.device_id = key.first;
+        int span_start = items[0].start;
+        int span_end = items[0].end;
+        span.num_items = 1;
+        span.regs.push_back(items[0].reg);
+        cfg::reg_struct* last_reg = items[0].reg;
+
+        for (size_t i = 1; i < items.size(); ++i) {
+            auto& item = items[i];
+            // the gap inside a declared register block was always read by the old pubs
+            int gap_allowed = max_gap;
+            if (item.reg == last_reg
+                    && span_end >= last_reg->starting_offset
+                    && item.start <= last_reg->starting_offset + last_reg->number_of_registers) {
+                gap_allowed = INT_MAX;
+            }
+            if (can_merge(key.second, span_start, span_end, item.start, item.end, gap_allowed, limit, bad)) {
+                span_end = std::max(span_end, item.end);
+                span.num_items++;
+                if (std::find(span.regs.begin(), span.regs.end(), item.reg) == span.regs.end())
+                    span.regs.push_back(item.reg);
+            } else {
+                span.offset = span_start;
+                span.num_registers = span_end - span_start;
+                plan.spans.push_back(span);
+                span.regs.clear();
+                span.regs.push_back(item.reg);
+                span.num_items = 1;
+                span_start = item.start;
+                span_end = item.end;
+            }
+            last_reg = item.reg;
+        }
+        span.offset = span_start;
+        span.num_registers = span_end - span_start;
+        plan.spans.push_back(span);
+    }
+}
+
+bool PollPlanner::plan_current(const PollPlan& plan, cfg::comp_struct* comp, int max_gap) {
+    if (plan.max_gap != max_gap || plan.sig != plan_sig(comp, max_gap))
+        return false;
+    for (auto& [device_id, old_limit] : plan.dev_gap_limit) {
+        double limit = gap_limit(device_id);
+        if (std::fabs(limit - old_limit) > cost_change * old_limit)
+            return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const PollPlan> PollPlanner::get_plan(cfg::comp_struct* comp, int max_gap) {
+    std::lock_guard<std::mutex> lock(plan_mtx);
+    auto& cached = plans[comp];
+    if (cached && plan_current(*cached, comp, max_gap))
+        return cached;
+
+    // build a new one, the old plan stays good for anyone still walking it
+    auto plan = std::make_shared<PollPlan>();
+    for (auto& reg : comp->registers) {
+        if (plan->dev_gap_limit.find(reg->device_id) == plan->dev_gap_limit.end())
+            plan->dev_gap_limit[reg->device_id] = gap_limit(reg->device_id);
+    }
+    build_plan(*plan, comp, max_gap, plan->dev_gap_limit);
+    plan->sig = plan_sig(comp, max_gap);
+    rebuilds++;
+    cached = plan;
+    return cached;
+}
+
+
+static void show_plan(const PollPlan& plan) {
+    for (auto& span : plan.spans) {
+        std::cout << "    device " << span.device_id
+                  << " type " << (int)span.reg_type
+                  << " offset " << span.offset
+                  << " num " << span.num_registers
+                  << " items " << span.num_items
+                  << " regs " << span.regs.size()
+                  << std::endl;
+    }
+}
+
+static std::shared_ptr<cfg::reg_struct> test_reg(cfg::Register_Types reg_type, int start, int num,
+                                                 const std::vector<std::pair<int, int>>& maps) {
+    auto reg = std::make_shared<cfg::reg_struct>();
+    reg->reg_type = reg_type;
+    reg->device_id = 1;
+    reg->starting_offset = start;
+    reg->number_of_registers = num;
+    for (auto& m : maps) {
+        auto map = std::make_shared<cfg::map_struct>();
+        map->offset = m.first;
+        map->size = m.second;
+        reg->maps.push_back(map);
+        reg->mapix[map->offset] = map;
+    }
+    return reg;
+}
+
+// build a few plans and check the span counts
+int test_poll_planner() {
+    int errors = 0;
+    PollPlanner planner;
+    cfg::comp_struct comp;
+
+    // two holding blocks with a 4 register hole and a coil block
+    comp.registers.push_back(test_reg(cfg::Register_Types::Holding, 0, 10, {{0, 1}, {1, 2}, {8, 2}}));
+    comp.registers.push_back(test_reg(cfg::Register_Types::Holding, 14, 10, {{14, 1}, {20, 4}}));
+    comp.registers.push_back(test_reg(cfg::Register_Types::Coil, 100, 20, {{100, 1}, {119, 1}}));
+
+    auto check = [&](const char* name, const PollPlan& plan, size_t want) {
+        std::cout << " " << name << " spans " << plan.spans.size() << " expected " << want << std::endl;
+        show_plan(plan);
+        if (plan.spans.size() != want)
+            errors++;
+    };
+
+    // no gaps allowed between blocks, the declared blocks are still read whole
+    check("max_gap 0", *planner.get_plan(&comp, 0), 3);
+
+    // the 4 register hole is cheap to read
+    check("max_gap 8", *planner.get_plan(&comp, 8), 2);
+
+    // same config, must come from the cache
+    int rebuilds = planner.rebuilds;
+    planner.get_plan(&comp, 8);
+    if (planner.rebuilds != rebuilds) {
+        std::cout << " plan was rebuilt without a change" << std::endl;
+        errors++;
+    }
+
+    // a bad register in the hole splits the read again
+    comp.registers[0]->bad_regs.push_back(12);
+    check("bad reg in gap", *planner.get_plan(&comp, 8), 3);
+
+    // a bad register under an item drops the item and splits the block
+    comp.registers[0]->bad_regs.clear();
+    comp.registers[0]->bad_regs.push_back(1);
+    check("bad reg in item", *planner.get_plan(&comp, 8), 3);
+    comp.registers[0]->bad_regs.clear();
+
+    // a device with a very cheap round trip is not worth reading gaps for
+    for (int i = 0; i < 32; ++i)
+        planner.record_io(1, cfg::Register_Types::Holding, 10 + (i % 4) * 30, 0.0001 + (10 + (i % 4) * 30) * 0.0001);
+    std::cout << " learned gap limit " << planner.gap_limit(1) << std::endl;
+    check("cheap rtt", *planner.get_plan(&comp, 8), 6);
+
+    // the function code limit
+    cfg::comp_struct big;
+    big.registers.push_back(test_reg(cfg::Register_Types::Input, 0, 200, {{0, 100}, {100, 50}, {150, 50}}));
+    check("fc limit", *planner.get_plan(&big, 8), 2);
+
+    std::cout << " test_poll_planner errors " << errors << std::endl;
+    return errors;
+}
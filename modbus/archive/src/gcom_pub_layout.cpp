@@ -0,0 +1,243 @@
+// gcom_pub_layout.cpp
+// pub bodies written straight into a reusable send buffer, see gcom_pub_layout.h
+
+#include <any>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "gcom_config.h"
+#include "gcom_map_index.h"
+#include "gcom_pub_layout.h"
+
+void PubLayout::build(const cfg& myCfg, const std::vector<cfg::map_struct*>& items) {
+    uris.clear();
+    keys.clear();
+    uri_of.assign(items.size(), -1);
+    for (auto& comp : myCfg.components) {
+        int32_t uri = uris.size();
+        uris.push_back("/" + comp->comp_id + "/" + comp->id);
+        for (auto& reg : comp->registers) {
+            for (auto& map : reg->maps) {
+                uri_of[map->point_id] = uri;
+                // the bit ranges go out with their packer
+                for (auto& bits : map->bit_ranges)
+                    uri_of[bits->point_id] = uri;
+            }
+        }
+    }
+    key_at.resize(items.size() + 1);
+    for (size_t pid = 0; pid < items.size(); ++pid) {
+        key_at[pid] = keys.size();
+        keys += '"';
+        keys += items[pid]->id;
+        keys += "\":";
+    }
+    key_at[items.size()] = keys.size();
+}
+
+PubWriter& PubWriter::local() {
+    static thread_local PubWriter writer;
+    return writer;
+}
+
+static void append(fmt::memory_buffer& buf, std::string_view str) {
+    buf.append(str.data(), str.data() + str.size());
+}
+
+static void append_kind(fmt::memory_buffer& buf, DecodeValue::Kind kind, u64 bits) {
+    switch (kind) {
+        case DecodeValue::Kind::Unsigned: {
+            fmt::format_int str(bits);
+            buf.append(str.data(), str.data() + str.size());
+            break;
+        }
+        case DecodeValue::Kind::Signed: {
+            fmt::format_int str(static_cast<s64>(bits));
+            buf.append(str.data(), str.data() + str.size());
+            break;
+        }
+        case DecodeValue::Kind::Float: {
+            double f;
+            memcpy(&f, &bits, sizeof(f));
+            // nan and inf are not json
+            if (std::isfinite(f))
+                fmt::format_to(std::back_inserter(buf), FMT_COMPILE("{}"), f);
+            else
+                append(buf, "null");
+            break;
+        }
+        default:
+            append(buf, "null");
+            break;
+    }
+}
+
+void PubWriter::append_value(fmt::memory_buffer& buf, const DecodeValue& val) {
+    append_kind(buf, val.kind, val.u);
+}
+
+void PubWriter::append_value(fmt::memory_buffer& buf, const PointStore& points, int32_t pid) {
+    append_kind(buf, points.kind[pid], points.value[pid]);
+}
+
+void PubWriter::flush(const PubLayout& layout, PointStore& points, const SendFn& send) {
+    for (auto uri : touched) {
+        auto& pids = by_uri[uri];
+        buf.clear();
+        buf.push_back('{');
+        for (size_t k = 0; k < pids.size(); ++k) {
+            int32_t pid = pids[k];
+            if (k)
+                buf.push_back(',');
+            append(buf, layout.key(pid));
+            append_value(buf, points, pid);
+            points.published(pid);
+        }
+        buf.push_back('}');
+        send(layout.uris[uri], std::string_view(buf.data(), buf.size()));
+        pids.clear();
+    }
+    touched.clear();
+}
+
+
+// one component of num_points items, publish them all through the writer and through the two
+// paths it replaces, check the bodies agree and time them
+int bench_pub(int num_points) {
+    int errors = 0;
+    if (num_points <= 0)
+        num_points = 5000;
+    cfg myCfg;
+    auto comp = std::make_shared<cfg::comp_struct>();
+    comp->comp_id = "components";
+    comp->id = "bench_pub";
+    auto reg = std::make_shared<cfg::reg_struct>();
+    reg->device_id = 1;
+    reg->reg_type = cfg::Register_Types::Holding;
+    reg->starting_offset = 0;
+    for (int m = 0; m < num_points; ++m) {
+        auto map = std::make_shared<cfg::map_struct>();
+        map->id = "point_" + std::to_string(m);
+        map->offset = m;
+        map->size = 1;
+        reg->maps.push_back(map);
+        reg->mapix[map->offset] = map;
+    }
+    reg->number_of_registers = num_points;
+    comp->registers.push_back(reg);
+    myCfg.components.push_back(comp);
+    auto index = MapIndex::build(myCfg);
+    auto& points = *index->points;
+    auto& layout = index->pubs;
+
+    // a mix of the three kinds
+    std::vector<DecodeValue> values(num_points);
+    for (int m = 0; m < num_points; ++m) {
+        auto& val = values[m];
+        if (m % 3 == 0)
+            val.set((u64)(m * 7));
+        else if (m % 3 == 1)
+            val.set((s64)(-m * 13));
+        else
+            val.set(m * 0.125 - 3.5);
+        points.set_value(index->items[m]->point_id, val);
+    }
+
+    using clk = std::chrono::steady_clock;
+    const int loops = 200;
+    size_t sent = 0;
+    std::string body_writer;
+    PubWriter::SendFn send = [&](std::string_view uri, std::string_view body) {
+        sent += uri.size() + body.size();
+        body_writer.assign(body.data(), body.size());
+    };
+
+    // the writer
+    auto& writer = PubWriter::local();
+    auto t0 = clk::now();
+    for (int loop = 0; loop < loops; ++loop) {
+        for (auto item : index->items)
+            writer.add(layout, item->point_id);
+        writer.flush(layout, points, send);
+    }
+    auto t1 = clk::now();
+
+    // a uri string per item into a map of point lists, then PointStore::format
+    std::string body_format;
+    fmt::memory_buffer fmtbuf;
+    for (int loop = 0; loop < loops; ++loop) {
+        std::map<std::string, std::vector<int32_t>> pubpoints;
+        for (auto item : index->items) {
+            std::string uri = "/" + comp->comp_id + "/" + comp->id;
+            pubpoints[uri].push_back(item->point_id);
+        }
+        for (auto& uri_pair : pubpoints) {
+            fmtbuf.clear();
+            points.format(fmtbuf, index->items, uri_pair.second.data(), uri_pair.second.size());
+            body_format = "{" + fmt::to_string(fmtbuf) + "}";
+            sent += uri_pair.first.size() + body_format.size();
+        }
+    }
+    auto t2 = clk::now();
+
+    // a map of uri to a map of id to std::any, stringified
+    std::string body_any;
+    for (int loop = 0; loop < loops; ++loop) {
+        std::map<std::string, std::map<std::string, std::any>> pubmap;
+        for (int m = 0; m < num_points; ++m) {
+            std::string uri = "/" + comp->comp_id + "/" + comp->id;
+            pubmap[uri][index->items[m]->id] = values[m].to_any();
+        }
+        for (auto& uri_pair : pubmap) {
+            fmt::memory_buffer anybuf;
+            fmt::format_to(std::back_inserter(anybuf), "{{");
+            bool first = true;
+            for (auto& id_pair : uri_pair.second) {
+                fmt::format_to(std::back_inserter(anybuf), "{}\"{}\":", first ? "" : ",", id_pair.first);
+                auto& val = id_pair.second;
+                if (val.type() == typeid(u64))
+                    fmt::format_to(std::back_inserter(anybuf), "{}", std::any_cast<u64>(val));
+                else if (val.type() == typeid(s64))
+                    fmt::format_to(std::back_inserter(anybuf), "{}", std::any_cast<s64>(val));
+                else if (val.type() == typeid(double))
+                    fmt::format_to(std::back_inserter(anybuf), "{}", std::any_cast<double>(val));
+                else
+                    fmt::format_to(std::back_inserter(anybuf), "null");
+                first = false;
+            }
+            fmt::format_to(std::back_inserter(anybuf), "}}");
+            body_any = fmt::to_string(anybuf);
+            sent += uri_pair.first.size() + body_any.size();
+        }
+    }
+    auto t3 = clk::now();
+
+    // PointStore::format puts a space after its separators
+    std::string want;
+    for (auto c : body_format)
+        if (c != ' ')
+            want += c;
+    if (body_writer != want) {
+        std::cout << " bench_pub body [" << body_writer.substr(0, 60) << "] expected [" << want.substr(0, 60) << "]" << std::endl;
+        errors++;
+    }
+    if (body_any.size() != body_writer.size() || sent == 0)
+        errors++;
+    for (auto item : index->items)
+        if (points.pending[item->point_id])
+            errors++;
+
+    double t_writer = std::chrono::duration<double>(t1 - t0).count() / loops;
+    double t_format = std::chrono::duration<double>(t2 - t1).count() / loops;
+    double t_any = std::chrono::duration<double>(t3 - t2).count() / loops;
+    std::cout << " bench_pub " << num_points << " points, " << body_writer.size() << " byte body" << std::endl;
+    std::cout << "    pub writer           " << t_writer * 1e6 << " uS" << std::endl;
+    std::cout << "    point lists + format " << t_format * 1e6 << " uS  speedup " << t_format / t_writer << std::endl;
+    std::cout << "    map of std::any      " << t_any * 1e6 << " uS  speedup " << t_any / t_writer << std::endl;
+    std::cout << " bench_pub errors " << errors << std::endl;
+    return errors;
+}
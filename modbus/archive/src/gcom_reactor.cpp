@@ -0,0 +1,613 @@
+// gcom_reactor.cpp
+// epoll io reactor, see gcom_reactor.h
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "gcom_config.h"
+#include "gcom_iothread.h"
+#include "gcom_pipeline.h"
+#include "gcom_poll_planner.h"
+#include "gcom_reactor.h"
+
+// epoll data for the wake eventfd, connections use their index
+#define REACTOR_WAKE_ID 0xffffffffu
+
+static constexpr double backoff_min = 0.2;
+static constexpr double backoff_max = 5.0;
+
+static double thread_cpu_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+MbReactor::MbReactor(int _id, MbReactorGroup* _group)
+    : id(_id), group(_group) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = REACTOR_WAKE_ID;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev);
+}
+
+MbReactor::~MbReactor() {
+    stop();
+    conns.clear();
+    if (evfd >= 0)
+        ::close(evfd);
+    if (epfd >= 0)
+        ::close(epfd);
+}
+
+int MbReactor::add_connection(const std::string& ip, int port, int depth, double timeout, int device_id) {
+    auto conn = std::make_unique<ReactorConn>(depth, timeout);
+    conn->idx = conns.size();
+    conn->ip = ip;
+    conn->port = port;
+    conn->device_id = device_id;
+    capacity += conn->pipe.depth;
+    conns.push_back(std::move(conn));
+    return conns.size() - 1;
+}
+
+bool MbReactor::start() {
+    if (running)
+        return true;
+    running = true;
+    thread = std::thread(&MbReactor::run, this);
+    return true;
+}
+
+void MbReactor::stop() {
+    if (!running)
+        return;
+    running = false;
+    uint64_t one = 1;
+    auto rc = write(evfd, &one, sizeof(one));
+    (void)rc;
+    if (thread.joinable())
+        thread.join();
+}
+
+void MbReactor::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.exchange(false, std::memory_order_seq_cst)) {
+        uint64_t one = 1;
+        auto rc = write(evfd, &one, sizeof(one));
+        (void)rc;
+    }
+}
+
+bool MbReactor::has_input() {
+    if (!inbox.empty())
+        return true;
+    if (load >= capacity)
+        return false;
+    return !group->setChan->empty() || !group->pollChan->empty();
+}
+
+// non blocking connect, the socket shows up as writable when it is done
+void MbReactor::connect(ReactorConn& conn, double tNow) {
+    if (!conn.pipe.connect_start(conn.ip, conn.port)) {
+        conn.backoff = conn.backoff > 0.0 ? std::min(conn.backoff * 2.0, backoff_max) : backoff_min;
+        conn.tRetry = tNow + conn.backoff;
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = conn.pipe.is_connecting() ? EPOLLOUT : EPOLLIN;
+    ev.data.u32 = conn.idx;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, conn.pipe.socket_fd(), &ev);
+    if (!conn.pipe.is_connecting()) {
+        conn.backoff = 0.0;
+        conn.connects++;
+        stats.connects++;
+    }
+}
+
+// the socket has gone, fail what was waiting on it and schedule a reconnect
+void MbReactor::conn_down(ReactorConn& conn, double tNow, std::vector<IO_WorkHandle>& done) {
+    int err = errno ? errno : ECONNRESET;
+    conn.pipe.fail_all(done, ECONNRESET);
+    conn.pipe.close();
+    for (auto io_work : conn.pending) {
+        io_work->errors = -1;
+        io_work->errno_code = err;
+        done.push_back(io_work);
+    }
+    conn.pending.clear();
+    conn.timeouts = 0;
+    conn.backoff = conn.backoff > 0.0 ? std::min(conn.backoff * 2.0, backoff_max) : backoff_min;
+    conn.tRetry = tNow + conn.backoff;
+}
+
+void MbReactor::send_pending(ReactorConn& conn, double tNow, std::vector<IO_WorkHandle>& done) {
+    while (!conn.pending.empty() && conn.pipe.is_open() && !conn.pipe.full()) {
+        auto io_work = conn.pending.front();
+        conn.pending.pop_front();
+        if (!conn.pipe.submit(io_work, tNow)) {
+            io_work->tRun = 0.0;
+            done.push_back(io_work);
+            if (!conn.pipe.is_open())
+                conn_down(conn, tNow, done);
+        }
+    }
+}
+
+void MbReactor::route(IO_WorkHandle io_work, double tNow, std::vector<IO_WorkHandle>& done) {
+    int loop = group->route_loop(io_work->device_id);
+    if (loop >= 0 && loop != id) {
+        group->loops[loop]->inbox.send(std::move(io_work));
+        group->loops[loop]->wake();
+        return;
+    }
+
+    ReactorConn* conn = nullptr;
+    if (loop == id) {
+        conn = conns[group->route_conn(io_work->device_id)].get();
+    } else {
+        // least loaded live connection, a down one only if they are all down
+        int best = std::numeric_limits<int>::max();
+        for (auto& cp : conns) {
+            int cload = cp->pipe.in_flight() + (int)cp->pending.size();
+            if (cp->pipe.socket_fd() < 0)
+                cload += capacity;
+            if (cload < best) {
+                best = cload;
+                conn = cp.get();
+            }
+        }
+    }
+
+    io_work->tIo = tNow;
+    io_work->threadId = id;
+    stats.jobs++;
+    load++;
+    if (!conn || conn->pipe.socket_fd() < 0) {
+        io_work->errors = -1;
+        io_work->errno_code = ENOTCONN;
+        io_work->tRun = 0.0;
+        done.push_back(io_work);
+        return;
+    }
+    if (io_work->wtype == WorkTypes::Noop) {
+        io_work->errors = 1;
+        done.push_back(io_work);
+        return;
+    }
+    conn->pending.push_back(io_work);
+    send_pending(*conn, tNow, done);
+}
+
+// a run of timeouts on a connection that is still up usually means the other end is stuck
+void MbReactor::check_timeouts(ReactorConn& conn, std::vector<IO_WorkHandle>& done, size_t first, double tNow) {
+    bool stuck = false;
+    for (size_t i = first; i < done.size(); ++i) {
+        if (done[i]->errors > 0) {
+            conn.timeouts = 0;
+        } else if (done[i]->errno_code == ETIMEDOUT && ++conn.timeouts >= conn.pipe.depth * 2) {
+            stuck = true;
+        }
+    }
+    if (stuck) {
+        errno = ETIMEDOUT;
+        conn_down(conn, tNow, done);
+    }
+}
+
+void MbReactor::finish(std::vector<IO_WorkHandle>& done) {
+    double tNow = get_time_double();
+    for (auto io_work : done) {
+        load--;
+        io_work->tDone = tNow;
+        if (io_work->errors > 0) {
+            if (io_work->wtype == WorkTypes::Get)
+                pollPlanner.record_io(io_work->device_id, io_work->reg_type, io_work->num_registers, io_work->tRun);
+        } else {
+            stats.fails++;
+        }
+        group->respChan->send(std::move(io_work));
+    }
+    done.clear();
+}
+
+void MbReactor::run() {
+    std::vector<IO_WorkHandle> done;
+    struct epoll_event events[64];
+    IO_WorkHandle io_work;
+
+    double tNow = get_time_double();
+    for (auto& conn : conns)
+        connect(*conn, tNow);
+
+    while (running) {
+        tNow = get_time_double();
+
+        // take new work while there is room, sets go before polls
+        while ((load < capacity || !inbox.empty())
+                && (inbox.peekpop(io_work) || group->setChan->peekpop(io_work) || group->pollChan->peekpop(io_work))) {
+            route(io_work, tNow, done);
+        }
+        finish(done);
+
+        // work out how long we can sleep
+        double tWake = tNow + 0.1;
+        for (auto& conn : conns) {
+            if (conn->pipe.socket_fd() < 0)
+                tWake = std::min(tWake, conn->tRetry);
+            else if (conn->pipe.in_flight() > 0)
+                tWake = std::min(tWake, conn->pipe.next_deadline());
+        }
+        int wait_ms = (int)((tWake - tNow) * 1000.0 + 0.999);
+        if (wait_ms < 0)
+            wait_ms = 0;
+
+        sleeping.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (has_input() || !running)
+            wait_ms = 0;
+        int num = epoll_wait(epfd, events, 64, wait_ms);
+        sleeping.store(false, std::memory_order_relaxed);
+        stats.wakeups++;
+
+        tNow = get_time_double();
+        for (int e = 0; e < num; ++e) {
+            auto eid = events[e].data.u32;
+            if (eid == REACTOR_WAKE_ID) {
+                uint64_t val;
+                auto rc = read(evfd, &val, sizeof(val));
+                (void)rc;
+                continue;
+            }
+            auto& conn = *conns[eid];
+            size_t first = done.size();
+            if (conn.pipe.is_connecting()) {
+                if (conn.pipe.connect_finish()) {
+                    struct epoll_event ev;
+                    ev.events = EPOLLIN;
+                    ev.data.u32 = conn.idx;
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, conn.pipe.socket_fd(), &ev);
+                    conn.backoff = 0.0;
+                    conn.connects++;
+                    stats.connects++;
+                    send_pending(conn, tNow, done);
+                } else {
+                    conn_down(conn, tNow, done);
+                }
+                continue;
+            }
+            conn.pipe.service(done, true, tNow);
+            if (conn.pipe.socket_fd() < 0) {
+                conn_down(conn, tNow, done);
+                continue;
+            }
+            check_timeouts(conn, done, first, tNow);
+            send_pending(conn, tNow, done);
+        }
+
+        // deadlines and reconnects
+        for (auto& conn : conns) {
+            if (conn->pipe.socket_fd() < 0) {
+                if (tNow >= conn->tRetry)
+                    connect(*conn, tNow);
+                continue;
+            }
+            if (conn->pipe.is_connecting()) {
+                // a connect that never completes is a timeout too
+                if (!conn->pending.empty() && conn->pending.front()->tIo + conn->pipe.timeout <= tNow) {
+                    errno = ETIMEDOUT;
+                    conn_down(*conn, tNow, done);
+                }
+                continue;
+            }
+            if (conn->pipe.in_flight() > 0 && conn->pipe.next_deadline() <= tNow) {
+                size_t first = done.size();
+                conn->pipe.service(done, false, tNow);
+                check_timeouts(*conn, done, first, tNow);
+                send_pending(*conn, tNow, done);
+            }
+        }
+        finish(done);
+    }
+
+    // anything still waiting goes back as failed
+    for (auto& conn : conns) {
+        conn->pipe.fail_all(done, ECANCELED);
+        for (auto w : conn->pending) {
+            w->errors = -1;
+            w->errno_code = ECANCELED;
+            done.push_back(w);
+        }
+        conn->pending.clear();
+        conn->pipe.close();
+    }
+    while (inbox.peekpop(io_work)) {
+        io_work->errors = -1;
+        io_work->errno_code = ECANCELED;
+        load++;
+        done.push_back(io_work);
+    }
+    finish(done);
+    stats.cpu_time = thread_cpu_time();
+}
+
+
+MbReactorGroup::~MbReactorGroup() {
+    stop();
+}
+
+bool MbReactorGroup::init(int num_loops, ioChannel<IO_WorkHandle>* _setChan, ioChannel<IO_WorkHandle>* _pollChan,
+                          ioChannel<IO_WorkHandle>* _respChan) {
+    if (running || num_loops < 1)
+        return false;
+    setChan = _setChan;
+    pollChan = _pollChan;
+    respChan = _respChan;
+    loops.clear();
+    routes.assign(256, {-1, -1});
+    next_loop = 0;
+    for (int i = 0; i < num_loops; ++i)
+        loops.push_back(std::make_unique<MbReactor>(i, this));
+    return true;
+}
+
+int MbReactorGroup::add_connection(const std::string& ip, int port, int depth, double timeout, int device_id) {
+    int loop = next_loop;
+    next_loop = (next_loop + 1) % loops.size();
+    int conn = loops[loop]->add_connection(ip, port, depth, timeout, device_id);
+    if (device_id >= 0 && device_id < (int)routes.size())
+        routes[device_id] = {loop, conn};
+    return conn;
+}
+
+int MbReactorGroup::route_loop(int device_id) const {
+    if (device_id < 0 || device_id >= (int)routes.size())
+        return -1;
+    return routes[device_id].first;
+}
+
+int MbReactorGroup::route_conn(int device_id) const {
+    if (device_id < 0 || device_id >= (int)routes.size())
+        return -1;
+    return routes[device_id].second;
+}
+
+bool MbReactorGroup::start() {
+    for (auto& loop : loops)
+        loop->start();
+    running = true;
+    return true;
+}
+
+void MbReactorGroup::stop() {
+    if (!running)
+        return;
+    running = false;
+    for (auto& loop : loops)
+        loop->stop();
+}
+
+void MbReactorGroup::wake() {
+    for (auto& loop : loops)
+        loop->wake();
+}
+
+void MbReactorGroup::show_stats() {
+    for (auto& loop : loops) {
+        std::cout << " reactor " << loop->id
+                  << " connections " << loop->conns.size()
+                  << " jobs " << loop->stats.jobs
+                  << " fails " << loop->stats.fails
+                  << " connects " << loop->stats.connects
+                  << " wakeups " << loop->stats.wakeups
+                  << " cpu " << loop->stats.cpu_time
+                  << std::endl;
+    }
+}
+
+
+// benchmark, every device is polled at poll_rate against the mock server
+// the thread model is one thread per device doing one blocking transaction at a time
+// the reactor model is one epoll loop for all of them
+struct BenchResult {
+    double cpu_time = 0.0;
+    u64 count = 0;
+    u64 fails = 0;
+    u64 overruns = 0;
+    std::vector<double> latency;
+};
+
+static void bench_collect(ioChannel<IO_WorkHandle>& respChan, std::vector<std::atomic<int>>& busy,
+                          BenchResult& res, std::atomic<bool>& run) {
+    std::vector<IO_WorkHandle> works;
+    while (run || !respChan.empty()) {
+        respChan.receiveBatch(works, 64, 0.05);
+        for (auto w : works) {
+            res.count++;
+            if (w->errors <= 0)
+                res.fails++;
+            res.latency.push_back(w->tDone - w->tStart);
+            busy[w->device_id].store(0, std::memory_order_release);
+        }
+        works.clear();
+    }
+}
+
+// offer one poll per device every period, a device still busy from the last one is an overrun
+static void bench_produce(std::vector<IO_Work>& works, std::vector<std::atomic<int>>& busy,
+                          double secs, double period, BenchResult& res,
+                          const std::function<void(IO_WorkHandle)>& send) {
+    double tEnd = get_time_double() + secs;
+    double tNext = get_time_double();
+    while (tNext < tEnd) {
+        for (size_t d = 0; d < works.size(); ++d) {
+            if (busy[d].exchange(1, std::memory_order_acq_rel)) {
+                res.overruns++;
+                continue;
+            }
+            works[d].tStart = get_time_double();
+            works[d].errors = 0;
+            send(IO_WorkHandle(&works[d]));
+        }
+        tNext += period;
+        double tSleep = tNext - get_time_double();
+        if (tSleep > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds((int)(tSleep * 1e6)));
+    }
+    // let the last lot finish
+    double tStop = get_time_double() + 1.0;
+    while (get_time_double() < tStop) {
+        bool any = false;
+        for (auto& b : busy)
+            any |= b.load() != 0;
+        if (!any)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+static void bench_report(const char* model, int devices, int threads, double secs, BenchResult& res) {
+    std::sort(res.latency.begin(), res.latency.end());
+    double avg = 0.0;
+    for (auto l : res.latency)
+        avg += l;
+    if (!res.latency.empty())
+        avg /= res.latency.size();
+    double p99 = res.latency.empty() ? 0.0 : res.latency[(size_t)(res.latency.size() * 0.99)];
+    printf("    %-8s devices %4d threads %4d  cpu %6.2f%%  avg %7.3f mS  p99 %7.3f mS  transactions %7lu fails %lu overruns %lu\n",
+           model, devices, threads, res.cpu_time / secs * 100.0, avg * 1000.0, p99 * 1000.0,
+           (unsigned long)res.count, (unsigned long)res.fails, (unsigned long)res.overruns);
+}
+
+static void bench_setup_works(std::vector<IO_Work>& works) {
+    for (size_t d = 0; d < works.size(); ++d) {
+        works[d].reg_type = cfg::Register_Types::Holding;
+        works[d].wtype = WorkTypes::Get;
+        works[d].device_id = d;
+        works[d].offset = 100;
+        works[d].num_registers = 20;
+    }
+}
+
+static BenchResult bench_threads(int devices, int port, double secs, double period) {
+    BenchResult res;
+    std::vector<IO_Work> works(devices);
+    std::vector<std::atomic<int>> busy(devices);
+    bench_setup_works(works);
+    ioChannel<IO_WorkHandle> respChan;
+    std::vector<std::unique_ptr<ioChannel<IO_WorkHandle>>> chans;
+    for (int d = 0; d < devices; ++d)
+        chans.push_back(std::make_unique<ioChannel<IO_WorkHandle>>(16));
+
+    std::atomic<bool> run{true};
+    std::atomic<bool> collect{true};
+    std::vector<double> cpu(devices, 0.0);
+    std::vector<std::thread> threads;
+    for (int d = 0; d < devices; ++d) {
+        threads.emplace_back([&, d]() {
+            MbPipeline pipe(1, 1.0);
+            pipe.open("127.0.0.1", port, 1.0);
+            IO_WorkHandle w;
+            std::vector<IO_WorkHandle> done;
+            while (run) {
+                if (!chans[d]->receive(w, 0.1))
+                    continue;
+                w->tIo = get_time_double();
+                if (!pipe.submit(w, w->tIo)) {
+                    done.push_back(w);
+                } else {
+                    while (pipe.in_flight() > 0)
+                        pipe.poll(done, 1.0);
+                }
+                for (auto dw : done) {
+                    dw->tDone = get_time_double();
+                    respChan.send(std::move(dw));
+                }
+                done.clear();
+            }
+            cpu[d] = thread_cpu_time();
+        });
+    }
+    std::thread collector(bench_collect, std::ref(respChan), std::ref(busy), std::ref(res), std::ref(collect));
+    // give the connects a moment
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bench_produce(works, busy, secs, period, res, [&](IO_WorkHandle w) {
+        chans[w->device_id]->send(std::move(w));
+    });
+    run = false;
+    for (auto& t : threads)
+        t.join();
+    collect = false;
+    collector.join();
+    for (auto c : cpu)
+        res.cpu_time += c;
+    return res;
+}
+
+static BenchResult bench_reactors(int devices, int port, double secs, double period, int num_loops) {
+    BenchResult res;
+    std::vector<IO_Work> works(devices);
+    std::vector<std::atomic<int>> busy(devices);
+    bench_setup_works(works);
+    ioChannel<IO_WorkHandle> setChan;
+    ioChannel<IO_WorkHandle> pollChan;
+    ioChannel<IO_WorkHandle> respChan;
+
+    MbReactorGroup reactors;
+    reactors.init(num_loops, &setChan, &pollChan, &respChan);
+    for (int d = 0; d < devices; ++d)
+        reactors.add_connection("127.0.0.1", port, 1, 1.0, d);
+    reactors.start();
+
+    std::atomic<bool> collect{true};
+    std::thread collector(bench_collect, std::ref(respChan), std::ref(busy), std::ref(res), std::ref(collect));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bench_produce(works, busy, secs, period, res, [&](IO_WorkHandle w) {
+        pollChan.send(std::move(w));
+        reactors.wake();
+    });
+    reactors.stop();
+    collect = false;
+    collector.join();
+    for (auto& loop : reactors.loops)
+        res.cpu_time += loop->stats.cpu_time;
+    return res;
+}
+
+// 10 / 50 / 200 devices polled every 100 mS, 2 mS simulated round trip
+int bench_reactor(double secs) {
+    const int device_counts[] = {10, 50, 200};
+    const double period = 0.1;
+    int errors = 0;
+
+    MockMbServer server;
+    if (!server.start(0.002)) {
+        std::cout << " unable to start mock server" << std::endl;
+        return 1;
+    }
+    std::cout << " bench_reactor  poll every " << period * 1000.0 << " mS, rtt "
+              << server.rtt * 1000.0 << " mS, " << secs << " seconds per run" << std::endl;
+    for (auto devices : device_counts) {
+        auto tres = bench_threads(devices, server.port, secs, period);
+        bench_report("threads", devices, devices, secs, tres);
+        auto rres = bench_reactors(devices, server.port, secs, period, 1);
+        bench_report("reactor", devices, 1, secs, rres);
+        if (tres.fails || rres.fails)
+            errors++;
+    }
+    server.stop();
+    std::cout << " bench_reactor errors " << errors << std::endl;
+    return errors;
+}
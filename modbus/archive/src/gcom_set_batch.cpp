@@ -0,0 +1,335 @@
+// gcom_set_batch.cpp
+// merge fims sets into multi register writes, see gcom_set_batch.h
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "gcom_config.h"
+#include "gcom_iothread.h"
+#include "gcom_map_index.h"
+#include "gcom_set_batch.h"
+
+SetBatcher setBatcher;
+
+void SetBatcher::start(double window_secs) {
+    stop();
+    std::lock_guard<std::mutex> lock(mtx);
+    window = window_secs;
+    if (window <= 0.0)
+        return;
+    running = true;
+    thread = std::thread(&SetBatcher::run, this);
+}
+
+void SetBatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    if (thread.joinable())
+        thread.join();
+    // anything still held goes out now
+    std::vector<IO_WorkHandle> batch;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        batch.swap(pending);
+    }
+    send(batch);
+}
+
+void SetBatcher::add(std::vector<IO_WorkHandle>& works) {
+    if (works.empty())
+        return;
+    sets += works.size();
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!running) {
+        lock.unlock();
+        send(works);
+        return;
+    }
+    if (pending.empty())
+        tFirst = std::chrono::steady_clock::now();
+    pending.insert(pending.end(), works.begin(), works.end());
+    works.clear();
+    cv.notify_one();
+}
+
+SetBatcher::Stats SetBatcher::stats() const {
+    Stats st;
+    st.sets = sets;
+    st.writes = writes;
+    return st;
+}
+
+void SetBatcher::run() {
+    std::vector<IO_WorkHandle> batch;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (running) {
+        if (pending.empty()) {
+            cv.wait(lock);
+            continue;
+        }
+        auto due = tFirst + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(window));
+        if (cv.wait_until(lock, due, [this] { return !running; }))
+            break;
+        batch.swap(pending);
+        lock.unlock();
+        send(batch);
+        lock.lock();
+    }
+}
+
+void SetBatcher::send(std::vector<IO_WorkHandle>& batch) {
+    if (batch.empty())
+        return;
+    std::vector<IO_WorkHandle> out;
+    merge(batch, out);
+    writes += out.size();
+    for (auto io_work : out)
+        pollWork(io_work);
+}
+
+// where the packer of a bit range set keeps its last raw value
+static PointStore* packer_store(const IO_Work& io_work, const MapIndex* mindex, int32_t& pid) {
+    if (!mindex || io_work.items.empty() || !io_work.items[0]->packer)
+        return nullptr;
+    auto& packer = *io_work.items[0]->packer;
+    pid = packer.point_id;
+    return mindex->store(packer);
+}
+
+void SetBatcher::merge(std::vector<IO_WorkHandle>& batch, std::vector<IO_WorkHandle>& out) {
+    size_t num = batch.size();
+    // arrival order breaks ties, later sets of a register win
+    std::vector<uint32_t> order(num);
+    for (size_t k = 0; k < num; ++k)
+        order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        auto& wa = *batch[a];
+        auto& wb = *batch[b];
+        if (wa.device_id != wb.device_id)
+            return wa.device_id < wb.device_id;
+        if (wa.reg_type != wb.reg_type)
+            return wa.reg_type < wb.reg_type;
+        return wa.offset < wb.offset;
+    });
+
+    auto mindex = map_index();
+    std::vector<uint32_t> run;
+    std::vector<u8> have;
+    size_t k = 0;
+    while (k < num) {
+        auto& first = *batch[order[k]];
+        bool coils = first.reg_type == cfg::Register_Types::Coil;
+        // a holding set is at most 4 registers so an overlap can push a run 3 past the adjacent limit
+        int limit = coils ? Max_Write_Coils : Max_Write_Registers - 3;
+        int start = first.offset;
+        int end = first.offset + std::max(first.num_registers, 1);
+        run.clear();
+        run.push_back(order[k++]);
+        while (k < num) {
+            auto& next = *batch[order[k]];
+            if (next.device_id != first.device_id || next.reg_type != first.reg_type || next.offset > end)
+                break;
+            int next_end = std::max(end, next.offset + std::max(next.num_registers, 1));
+            if (next.offset == end && next_end - start > limit)
+                break;
+            end = next_end;
+            run.push_back(order[k++]);
+        }
+
+        if (run.size() == 1 && batch[run[0]]->set_mask == 0xffff) {
+            out.push_back(batch[run[0]]);
+            continue;
+        }
+
+        int len = end - start;
+        auto wtype = len > 1 ? WorkTypes::SetMulti : WorkTypes::Set;
+        auto merged = make_work(first.reg_type, first.device_id, start, len, nullptr, nullptr, wtype);
+        merged->tNow = first.tNow;
+        merged->work_name = first.work_name;
+        have.assign(len, 0);
+        std::sort(run.begin(), run.end());
+        for (auto idx : run) {
+            auto& io_work = *batch[idx];
+            int at = io_work.offset - start;
+            if (coils) {
+                for (int r = 0; r < io_work.num_registers; ++r)
+                    merged->buf8[at + r] = io_work.buf8[r];
+                continue;
+            }
+            for (int r = 0; r < io_work.num_registers; ++r) {
+                u16 val = io_work.buf16[r];
+                if (r == 0 && io_work.set_mask != 0xffff) {
+                    int32_t pid = -1;
+                    auto store = packer_store(io_work, mindex.get(), pid);
+                    u16 base = have[at] ? merged->buf16[at] : store ? static_cast<u16>(store->raw_val[pid]) : 0;
+                    val = (base & ~io_work.set_mask) | (val & io_work.set_mask);
+                    // the next window starts from what we sent, not the last poll
+                    if (store)
+                        store->raw_val[pid] = (store->raw_val[pid] & ~0xffffull) | val;
+                }
+                merged->buf16[at + r] = val;
+                have[at + r] = 1;
+            }
+        }
+        for (auto idx : run)
+            merged->batched.push_back(batch[idx]);
+        out.push_back(merged);
+    }
+    batch.clear();
+}
+
+
+// merge batches of holding, coil and bit range sets, check the write count and the registers that go out
+int test_set_batch() {
+    int errors = 0;
+    if (!ioWorkPool.is_init())
+        ioWorkPool.init(1024);
+
+    // a packed register with two bit ranges, the packer's last poll read 0xff00
+    cfg myCfg;
+    auto comp = std::make_shared<cfg::comp_struct>();
+    comp->id = "comp_batch";
+    auto reg = std::make_shared<cfg::reg_struct>();
+    reg->device_id = 1;
+    reg->reg_type = cfg::Register_Types::Holding;
+    reg->starting_offset = 500;
+    auto packer = std::make_shared<cfg::map_struct>();
+    packer->id = "status";
+    packer->offset = 500;
+    packer->size = 1;
+    packer->packed_register = true;
+    reg->maps.push_back(packer);
+    reg->mapix[packer->offset] = packer;
+    std::vector<std::shared_ptr<cfg::map_struct>> fields;
+    for (int f = 0; f < 2; ++f) {
+        auto bits = std::make_shared<cfg::map_struct>();
+        bits->id = "field_" + std::to_string(f);
+        bits->offset = 500;
+        bits->size = 1;
+        bits->starting_bit_pos = f * 4;
+        bits->number_of_bits = 4;
+        bits->packer = packer;
+        packer->bit_ranges.push_back(bits);
+        fields.push_back(bits);
+    }
+    reg->number_of_registers = 1;
+    comp->registers.push_back(reg);
+    myCfg.components.push_back(comp);
+    auto index = MapIndex::build(myCfg);
+    map_index_swap(index);
+    index->store(*packer)->raw_val[packer->point_id] = 0xff00;
+
+    auto set = [](cfg::Register_Types reg_type, int device_id, int offset, int num, u16 val) {
+        auto io_work = make_work(reg_type, device_id, offset, num, nullptr, nullptr, WorkTypes::Set);
+        for (int r = 0; r < num; ++r) {
+            io_work->buf16[r] = val + r;
+            io_work->buf8[r] = val & 1;
+        }
+        return io_work;
+    };
+
+    std::vector<IO_WorkHandle> batch;
+    std::vector<IO_WorkHandle> out;
+    // 40 single registers in any order, two doubles on the end and a later write to 105
+    std::vector<int> offsets;
+    for (int off = 100; off < 140; ++off)
+        offsets.push_back(off);
+    std::shuffle(offsets.begin(), offsets.end(), std::mt19937(42));
+    for (auto off : offsets)
+        batch.push_back(set(cfg::Register_Types::Holding, 1, off, 1, off));
+    batch.push_back(set(cfg::Register_Types::Holding, 1, 140, 2, 140));
+    batch.push_back(set(cfg::Register_Types::Holding, 1, 142, 2, 142));
+    batch.push_back(set(cfg::Register_Types::Holding, 1, 105, 1, 9999));
+    // the same offsets on another device stay apart
+    batch.push_back(set(cfg::Register_Types::Holding, 2, 100, 1, 7));
+    // 10 adjacent coils and one on its own
+    for (int off = 20; off < 30; ++off)
+        batch.push_back(set(cfg::Register_Types::Coil, 1, off, 1, off));
+    batch.push_back(set(cfg::Register_Types::Coil, 1, 40, 1, 1));
+    // two bit ranges of the packed register
+    for (int f = 0; f < 2; ++f) {
+        auto io_work = set(cfg::Register_Types::Holding, 1, 500, 1, (u16)((f + 1) << (f * 4)));
+        io_work->set_mask = 0xf << (f * 4);
+        io_work->items.push_back(fields[f].get());
+        batch.push_back(io_work);
+    }
+    size_t num_sets = batch.size();
+    SetBatcher::merge(batch, out);
+
+    // device 1 holding 100-143, device 2 holding 100, coils 20-29, coil 40, the packed register
+    if (out.size() != 5) {
+        std::cout << " test_set_batch writes " << out.size() << " expected 5" << std::endl;
+        errors++;
+    }
+    size_t fanned = 0;
+    for (auto io_work : out) {
+        fanned += io_work->batched.empty() ? 1 : io_work->batched.size();
+        if (io_work->device_id == 1 && io_work->reg_type == cfg::Register_Types::Holding && io_work->offset == 100) {
+            if (io_work->num_registers != 44 || io_work->wtype != WorkTypes::SetMulti)
+                errors++;
+            for (int r = 0; r < io_work->num_registers; ++r) {
+                u16 want = r == 5 ? 9999 : 100 + r;
+                if (io_work->buf16[r] != want)
+                    errors++;
+            }
+        }
+        if (io_work->reg_type == cfg::Register_Types::Coil && io_work->offset == 20) {
+            if (io_work->num_registers != 10)
+                errors++;
+            for (int r = 0; r < 10; ++r)
+                if (io_work->buf8[r] != ((20 + r) & 1))
+                    errors++;
+        }
+        if (io_work->offset == 500) {
+            // 0xff00 with the two nibbles set
+            if (io_work->num_registers != 1 || io_work->wtype != WorkTypes::Set || io_work->buf16[0] != 0xff21) {
+                std::cout << " test_set_batch packed register 0x" << std::hex << io_work->buf16[0] << std::dec << std::endl;
+                errors++;
+            }
+        }
+    }
+    if (fanned != num_sets) {
+        std::cout << " test_set_batch responses " << fanned << " for " << num_sets << " sets" << std::endl;
+        errors++;
+    }
+    if (index->store(*packer)->raw_val[packer->point_id] != 0xff21)
+        errors++;
+
+    // a run longer than one FC16 write splits
+    for (auto io_work : out) {
+        for (auto orig : io_work->batched)
+            ioWorkPool.release(orig);
+        ioWorkPool.release(io_work);
+    }
+    out.clear();
+    for (int off = 1000; off < 1300; ++off)
+        batch.push_back(set(cfg::Register_Types::Holding, 1, off, 1, off));
+    SetBatcher::merge(batch, out);
+    int covered = 0;
+    for (auto io_work : out) {
+        if (io_work->num_registers > SetBatcher::Max_Write_Registers)
+            errors++;
+        covered += io_work->num_registers;
+    }
+    if (covered != 300 || out.size() != 3)
+        errors++;
+    std::cout << " test_set_batch " << num_sets << " sets -> 5 writes, 300 registers -> "
+              << out.size() << " writes" << std::endl;
+    for (auto io_work : out) {
+        for (auto orig : io_work->batched)
+            ioWorkPool.release(orig);
+        ioWorkPool.release(io_work);
+    }
+
+    map_index_swap(nullptr);
+    std::cout << " test_set_batch errors " << errors << std::endl;
+    return errors;
+}
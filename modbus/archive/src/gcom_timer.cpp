@@ -14,223 +14,231 @@
 #include <mutex>
 #include <atomic>
 #include <list>
-#include <set>
 
 #include "gcom_timer.h"
+#include "gcom_perf.h"
 
 
-std::mutex timeObjectsMutex;
-
-std::vector<std::shared_ptr<TimeObject>> timeObjects;
-
+static uint64_t to_tick(double runTime) {
+    if (runTime <= 0.0)
+        return 0;
+    // a hair under so 0.1 / 0.001 does not round up a whole tick
+    return (uint64_t)std::ceil(runTime / TimerWheel::Tick - 1e-6);
+}
 
-// code to use a list...
-std::list<std::shared_ptr<TimeObject>> timeObjectList;
+TimerWheel::TimerWheel() {
+    heads.assign(Levels * Slots, -1);
+}
 
+int32_t TimerWheel::resolve(Handle h) const {
+    uint32_t idx = (uint32_t)h;
+    uint32_t gen = (uint32_t)(h >> 32);
+    if (h == 0 || idx >= nodes.size() || !nodes[idx].used || nodes[idx].gen != gen)
+        return -1;
+    return (int32_t)idx;
+}
 
-// Custom comparator used in a set
-struct CompareTimerSet {
-    bool operator()(const std::shared_ptr<TimeObject>& a, const std::shared_ptr<TimeObject>& b) const {
-        return a->runTime < b->runTime;
+// into the slot for its expire tick, never before min_tick
+void TimerWheel::link(int32_t idx, uint64_t min_tick) {
+    auto& node = nodes[idx];
+    uint64_t expire = std::max(node.expire, min_tick);
+    uint64_t delta = expire - now_tick;
+    // past the top level, park it where it cascades before the level comes round again
+    const uint64_t top = (uint64_t(1) << (Slot_Bits * Levels)) - (uint64_t(1) << (Slot_Bits * (Levels - 1)));
+    if (delta >= top) {
+        expire = now_tick + top;
+        delta = top;
     }
-};
-
-std::set<std::shared_ptr<TimeObject>, CompareTimerSet> timerSet;
-
-std::mutex timerMutex;
-std::condition_variable timerCv;
-bool stopThread = false;
-
-
-void _addTimeObjToSet(std::shared_ptr<TimeObject> timeObj){
-    timerSet.insert(timeObj);
-    timerCv.notify_one();
+    int level = 0;
+    while (level < Levels - 1 && delta >= (uint64_t(1) << (Slot_Bits * (level + 1))))
+        level++;
+    int32_t slot = level * Slots + (int32_t)((expire >> (Slot_Bits * level)) & (Slots - 1));
+    node.slot = slot;
+    node.prev = -1;
+    node.next = heads[slot];
+    if (node.next >= 0)
+        nodes[node.next].prev = idx;
+    heads[slot] = idx;
+    num_linked++;
 }
 
-void addTimeObjToSet(std::shared_ptr<TimeObject> timeObj, double offset, bool isSync) {
-    std::lock_guard<std::mutex> lock(timerMutex);
-    _addTimeObjToSet(timeObj);
+void TimerWheel::unlink(int32_t idx) {
+    auto& node = nodes[idx];
+    if (node.slot < 0)
+        return;
+    if (node.prev >= 0)
+        nodes[node.prev].next = node.next;
+    else
+        heads[node.slot] = node.next;
+    if (node.next >= 0)
+        nodes[node.next].prev = node.prev;
+    node.slot = node.prev = node.next = -1;
+    num_linked--;
 }
 
-std::shared_ptr<TimeObject> findTimerSetByName(const std::set<std::shared_ptr<TimeObject>, CompareTimerSet>& timerSet, const std::string& name) {
-    std::lock_guard<std::mutex> lock(timerMutex);
-    auto it = std::find_if(timerSet.begin(), timerSet.end(),
-                           [&name](const std::shared_ptr<TimeObject>& obj) {
-                               return obj->name == name;
-                           });
+void TimerWheel::release(int32_t idx) {
+    auto& node = nodes[idx];
+    unlink(idx);
+    auto it = names.find(node.obj->name);
+    if (it != names.end() && it->second == handle(idx))
+        names.erase(it);
+    node.obj.reset();
+    node.used = false;
+    node.gen++;
+    free_nodes.push_back(idx);
+    num_used--;
+}
 
-    if (it != timerSet.end()) {
-        return *it;
+TimerWheel::Handle TimerWheel::add(std::shared_ptr<TimeObject> obj) {
+    int32_t idx;
+    if (!free_nodes.empty()) {
+        idx = free_nodes.back();
+        free_nodes.pop_back();
     } else {
-        return nullptr; // or throw an exception, or handle the not-found case as needed
+        idx = nodes.size();
+        nodes.emplace_back();
     }
+    auto& node = nodes[idx];
+    node.used = true;
+    node.expire = to_tick(obj->runTime);
+    node.obj = std::move(obj);
+    num_used++;
+    link(idx, now_tick + 1);
+    auto h = handle(idx);
+    names[node.obj->name] = h;
+    return h;
 }
-// timerThreadFunc
-//checkandrunfirst
-// if (first->runTime <= currentTime) {
-//         // Check if it's not a sync timer or if it's a sync timer that hasn't run yet.
-//         if (!first->sync || (first->sync && !first->run)) {
-//             first->lastRun = currentTime;
-//             first->runs++;
-//             first->run = true;
-
-        // if (first->sync) {
-        // if (first->run) {
-            
-        //     if (first->lastRun + (first->repeatTime*2) <= currentTime) {
-        //         first->run = false;                
-        //     }
-
-void timerSetThreadFunc() {
-    std::cout <<__func__ << " running 1" << std::endl;
-    std::unique_lock<std::mutex> lock(timerMutex);
-    std::cout <<__func__ << " running 2" << std::endl;
-    while (!stopThread) {
-        if (!timerSet.empty()) {
-            auto tNow = get_time_double();
-            auto now = std::chrono::system_clock::now();
-            //auto nowMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
-            //double nowSeconds = nowMicroseconds / 1e6;  // Convert microseconds to seconds
-            //auto nowSeconds = std::chrono::time_point_cast<std::chrono::seconds>(now).time_since_epoch().count();
-            // std::chrono::duration_cast<std::chrono::seconds>(
-            //                std::chrono::system_clock::now().time_since_epoch())
-            //                .count();
-            auto tObj = *timerSet.begin();
-            double waitTime = tObj->runTime - tNow; 
-            if(0)std::cout << " fOUND " << tObj->name 
-                            << " runTime " << tObj->runTime 
-                            << " waitTime " << waitTime 
-                            << std::endl;
-
-            if (waitTime <= 0) {
-                if (1 ||!tObj->sync || (tObj->sync && !tObj->run)) {
-                    tObj->lastRun = tNow;
-                    tObj->runs++;
-                    tObj->run = true;
-
-                    // Run the callback
-                    auto callback = tObj->callback;
-                    auto name = tObj->name;
-                    auto interval = tObj->repeatTime;
-                    // reset sync if we need to 
-                    if (tObj->sync) {
-                        if (tObj->run) {
-                            if (tObj->lastRun + (tObj->repeatTime*2) <= tNow) {
-                                tObj->run = false;                
-                            }
-                        }
-                    }
-                    timerSet.erase(timerSet.begin());
-
-                    tObj->runTime += interval;
-                    if (tObj->sync)
-                        tObj->runTime += interval;
-
-                    lock.unlock(); // Unlock while running the callback
-                    callback(tObj, tObj->param);
-                    lock.lock(); // Re-lock to insert back
-                    if((interval> 0.0) 
-                       && (tObj->stopTime == 0 || tObj->runTime < tObj->stopTime)
-                       && (tObj->count == 0 || tObj->runs < tObj->count)
-                       )
-                    {
-                        if(0)std::cout << " Adding back " << tObj->name 
-                            << " runTime " << tObj->runTime 
-                            << std::endl;
-                        timerSet.insert(tObj);
-                    }
-                    else
-                    {
-                        std::cout << " Dropping " << tObj->name 
-                            << " tNow " << tNow 
-                            << " interval " << interval 
-                            << " count " << tObj->count 
-                            << " runs " << tObj->runs 
-                            << " runTime " << tObj->runTime 
-                            << " stopTime " << tObj->stopTime 
-                            << std::endl;
-
-                    }
-                }
-            } else {
-                timerCv.wait_until(lock, now + std::chrono::duration<double>(waitTime));
-                //timerCv.wait_until(lock, std::chrono::system_clock::now() + std::chrono::seconds(static_cast<long>(nextTimer.runtime - now)));
-            }
-        } else {
-            timerCv.wait(lock);
-        }
-    }
-    std::cout <<__func__ << " stopping " << std::endl;
 
+bool TimerWheel::cancel(Handle h) {
+    int32_t idx = resolve(h);
+    if (idx < 0)
+        return false;
+    release(idx);
+    return true;
 }
 
-// older timeObjectList functions
-
-void _addTimeObject(std::shared_ptr<TimeObject> obj) {
-    
-    // Insert object in sorted position.
-    auto it = std::upper_bound(timeObjectList.begin(), timeObjectList.end(), obj, 
-        [](const std::shared_ptr<TimeObject>& a, const std::shared_ptr<TimeObject>& b) {
-            return a->runTime < b->runTime;
-        }
-    );
-    timeObjectList.insert(it, obj);
+bool TimerWheel::reschedule(Handle h) {
+    int32_t idx = resolve(h);
+    if (idx < 0)
+        return false;
+    auto& node = nodes[idx];
+    if (node.slot < 0)
+        return true;
+    unlink(idx);
+    node.expire = to_tick(node.obj->runTime);
+    link(idx, now_tick + 1);
+    return true;
 }
 
-void addTimeObject(std::shared_ptr<TimeObject> obj) {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    _addTimeObject(obj);
-
+TimerWheel::Handle TimerWheel::find(const std::string& name) const {
+    auto it = names.find(name);
+    return it == names.end() ? 0 : it->second;
 }
 
-std::shared_ptr<TimeObject> getFirst() {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    if (timeObjectList.empty()) {
-        return nullptr;
-    }
-    return timeObjectList.front();
+std::shared_ptr<TimeObject> TimerWheel::get(Handle h) const {
+    int32_t idx = resolve(h);
+    return idx < 0 ? nullptr : nodes[idx].obj;
 }
 
-
-void _modifyAndRelocate(std::shared_ptr<TimeObject> obj, double newRunTime) {
-    obj->runTime = newRunTime;
-    timeObjectList.remove(obj);
-    _addTimeObject(obj);
+// the slot at the current index of a level moves down, the ones due this tick land in level 0
+void TimerWheel::cascade(int level) {
+    int32_t slot = level * Slots + (int32_t)((now_tick >> (Slot_Bits * level)) & (Slots - 1));
+    int32_t idx = heads[slot];
+    heads[slot] = -1;
+    while (idx >= 0) {
+        int32_t next = nodes[idx].next;
+        nodes[idx].slot = -1;
+        num_linked--;
+        link(idx, now_tick);
+        idx = next;
+    }
 }
 
-void modifyAndRelocate(std::shared_ptr<TimeObject> obj, double newRunTime) {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    return _modifyAndRelocate(obj, newRunTime);
-
+// the clock went backwards ( setBaseTime ), put everything back relative to the new tick
+void TimerWheel::rebase(uint64_t tick) {
+    scratch.clear();
+    for (int32_t idx = 0; idx < (int32_t)nodes.size(); ++idx) {
+        if (nodes[idx].slot >= 0) {
+            unlink(idx);
+            scratch.push_back(idx);
+        }
+    }
+    now_tick = tick;
+    for (auto idx : scratch)
+        link(idx, now_tick + 1);
 }
 
-
-
-std::shared_ptr<TimeObject> findByName(const std::string& nameToFind) {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    auto it = std::find_if(timeObjectList.begin(), timeObjectList.end(), 
-        [&nameToFind](const std::shared_ptr<TimeObject>& obj) {
-            return obj->name == nameToFind;
+void TimerWheel::advance(double tNow, std::vector<Handle>& due) {
+    uint64_t target = tNow > 0.0 ? (uint64_t)(tNow / Tick) : 0;
+    if (target + Slots < now_tick)
+        rebase(target);
+    if (num_linked == 0) {
+        now_tick = std::max(now_tick, target);
+        return;
+    }
+    while (now_tick < target) {
+        ++now_tick;
+        if ((now_tick & (Slots - 1)) == 0) {
+            // the highest level whose lower digits all wrapped goes first
+            int top = 1;
+            while (top < Levels - 1 && ((now_tick >> (Slot_Bits * top)) & (Slots - 1)) == 0)
+                top++;
+            for (int level = top; level >= 1; --level)
+                cascade(level);
+        }
+        int32_t idx = heads[now_tick & (Slots - 1)];
+        heads[now_tick & (Slots - 1)] = -1;
+        while (idx >= 0) {
+            auto& node = nodes[idx];
+            int32_t next = node.next;
+            node.slot = node.prev = node.next = -1;
+            num_linked--;
+            if (node.expire <= now_tick)
+                due.push_back(handle(idx));
+            else
+                link(idx, now_tick + 1);
+            idx = next;
+        }
+        if (num_linked == 0) {
+            now_tick = target;
+            break;
         }
-    );
-
-    if (it != timeObjectList.end()) {
-        return *it; // Found the object
-    } else {
-        return nullptr; // Object with the given name not found
     }
 }
 
+void TimerWheel::finish(Handle h, bool keep) {
+    int32_t idx = resolve(h);
+    if (idx < 0)
+        return;
+    auto& node = nodes[idx];
+    if (node.slot >= 0)
+        return;
+    if (!keep) {
+        release(idx);
+        return;
+    }
+    node.expire = to_tick(node.obj->runTime);
+    link(idx, now_tick + 1);
+}
 
-//std::vector<TimeObject> timeObjects;
+double TimerWheel::next_wait(double tNow) const {
+    if (num_linked == 0)
+        return -1.0;
+    uint64_t tick = now_tick + 1;
+    // stop at the next wrap, the cascade there may bring something down
+    while (heads[tick & (Slots - 1)] < 0 && (tick & (Slots - 1)) != 0)
+        tick++;
+    return std::max(0.0, (double)tick * Tick - tNow);
+}
 
 
-Channel<int> timerChannel;
-Channel<std::string> signalChannel;
-std::condition_variable timerCV;
+std::mutex timerMutex;
+std::condition_variable timerCv;
+TimerWheel timerWheel;
 std::atomic<bool> shouldTerminate;
 
 bool timeInit = false;
+bool timer_debug = false;
 std::mutex timeDoubleMutex;
 std::chrono::system_clock::time_point baseTime;
 
@@ -266,7 +274,7 @@ void setTimeObject(const std::shared_ptr<TimeObject> newObj, double offset, bool
     auto origRunTime = newObj->runTime;
     auto tNow = get_time_double();
     if (newObj->repeatTime > 0 && tNow >= newObj->runTime) {
-        // no matter when we request a timer, they are always sync'd to the same time 
+        // no matter when we request a timer, they are always sync'd to the same time
         double nextRepeatTime = std::ceil(tNow / newObj->repeatTime ) * newObj->repeatTime;
         // Calculate the new run time based on repeated intervals and the offset
         double nextRunTime = nextRepeatTime + newObj->offsetTime;
@@ -279,69 +287,19 @@ void setTimeObject(const std::shared_ptr<TimeObject> newObj, double offset, bool
     }
 
 }
-void addTimeObject(const std::shared_ptr<TimeObject> newObj, double offset, bool isSync, bool useSet) {
-    //std::cout << __func__ << " check 1" << std::endl;
-    // Use the helper function to insert the object in the correct position
-    //std::cout << __func__ << " check 2" << std::endl;
-    if (useSet)
-    {
-        std::lock_guard<std::mutex> lock(timerMutex);
-        setTimeObject(newObj, offset, isSync);
-        return _addTimeObjToSet(newObj);
-    }
 
-    else
+void addTimeObject(const std::shared_ptr<TimeObject> newObj, double offset, bool isSync, [[maybe_unused]] bool useSet) {
     {
-        std::lock_guard<std::mutex> lock(timeObjectsMutex);
+        std::lock_guard<std::mutex> lock(timerMutex);
         setTimeObject(newObj, offset, isSync);
-        _addTimeObject(newObj);
+        timerWheel.add(newObj);
     }
-    //std::cout << __func__ << " check 3" << std::endl;
-
-    timerChannel.send(timer::RECALIBRATE);
-    //std::cout << __func__ << " check 4" << std::endl;
+    timerCv.notify_one();
 }
 
-// void addTimeObject(const std::shared_ptr<TimeObject> newObj, double offset, bool isSync) {
-
-// //void addTimeObject(const TimeObject& obj, double offset) {
-//     std::lock_guard<std::mutex> lock(timeObjectsMutex);
-
-//     newObj->offsetTime = offset;
-//     newObj->sync = isSync;
-
-
-//     auto origRunTime = newObj->runTime;
-//     auto tNow = get_time_double();
-//     if (newObj->repeatTime> 0 && tNow >= newObj->runTime) {
-//         // no matter when we request a timer they are always sync'd to the same time 
-
-//         double nextRepeatTime = std::ceil(tNow / newObj->repeatTime ) * newObj->repeatTime;
-//         // Calculate the new run time based on repeated intervals and the offset
-//         double nextRunTime = nextRepeatTime + newObj->offsetTime;
-
-//         // update newObj.runTime
-//         newObj->runTime = nextRunTime;
-//     } else {
-//         // Only respect the initial runTime
-//         newObj->runTime = origRunTime;
-//     }
-
-//     // Add the newObj to the vector and sort
-//     timeObjects.push_back(newObj);
-
-
-//     std::sort(timeObjects.begin(), timeObjects.end(), 
-//         [](const std::shared_ptr<TimeObject>& a, const std::shared_ptr<TimeObject>& b) {
-//         return a->runTime < b->runTime;
-//     });
-
-//     timerChannel.send(timer::RECALIBRATE);
-// }
-
 
 bool shouldStopDuetoTime(const std::shared_ptr<TimeObject>& obj)
-{ 
+{
     if (!obj) {
         throw std::invalid_argument("The provided shared_ptr is nullptr.");
     }
@@ -351,65 +309,13 @@ bool shouldStopDuetoTime(const std::shared_ptr<TimeObject>& obj)
 
 // do we have a stop count specified and have we run that many times
 bool shouldStopDuetoCount(const std::shared_ptr<TimeObject>& obj)
-{ 
+{
     if (!obj) {
         std::cout << __func__ << " this is not a time obj"<<std::endl;
         throw std::invalid_argument("The provided shared_ptr is nullptr.");
     }
 
-    return obj->count != 0 && obj->runs > obj->count;
-}
-
-
-
-// Helper function that updates runTime and relocates the time object WITHOUT locking the mutex.
-
-void checkAndRunFirst() {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    
-    if (timeObjectList.empty()) return;
-
-    double currentTime = get_time_double();
-    std::shared_ptr<TimeObject>& first = timeObjectList.front();
-
-    if (first->runTime <= currentTime) {
-        // Check if it's not a sync timer or if it's a sync timer that hasn't run yet.
-        if (!first->sync || (first->sync && !first->run)) {
-            first->lastRun = currentTime;
-            first->runs++;
-            first->run = true;
-
-            //printf(" timer obj ... %p  ", (void*)first.get());
-            //std::cout << " Timer running callback for name [" << first->name << "] " << std::endl;
-            //std::cout << "               for param [" << first->param << "] " << std::endl;
-            first->callback(first, first->param);  // still pass raw pointer to callback
-
-            // Check if it's a repeating timer and shouldn't be stopped due to time or count.
-            if (first->repeatTime > 0 && !shouldStopDuetoTime(first) && !shouldStopDuetoCount(first)) {
-                _modifyAndRelocate(first, first->runTime + first->repeatTime); // update the runTime and reposition in the list without locking
-            } else {
-                timeObjectList.pop_front(); // Remove the timer object if it doesn't repeat or should be stopped.
-            }
-        }
-        // allow the rest to run
-        // we may resync if    first->lastRun + (first->repeatTime*2) < currentTime;
-
-        if (first->sync) {
-        if (first->run) {
-            
-            if (first->lastRun + (first->repeatTime*2) <= currentTime) {
-                first->run = false;                
-            }
-
-            if (first->repeatTime > 0 && !shouldStopDuetoTime(first) && !shouldStopDuetoCount(first)) {
-                _modifyAndRelocate(first, first->runTime + first->repeatTime); // update the runTime and reposition in the list without locking
-            } else {
-                timeObjectList.pop_front(); // Remove the timer object if it doesn't repeat or should be stopped.
-            }
-        }
-        }
-        timerChannel.send(timer::RECALIBRATE);
-    }
+    return obj->count != 0 && obj->runs >= obj->count;
 }
 
 
@@ -419,223 +325,140 @@ void exampleCallback(std::shared_ptr<TimeObject> t, void* p) {
 }
 
 std::shared_ptr<TimeObject> findTimeObjectByName(const std::string& name) {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    auto it = std::find_if(timeObjects.begin(), timeObjects.end(),
-                           [&name](const std::shared_ptr<TimeObject>& obj) { return obj->name == name; });
-    return (it != timeObjects.end()) ? *it : nullptr;
+    std::lock_guard<std::mutex> lock(timerMutex);
+    return timerWheel.get(timerWheel.find(name));
 }
 
 bool removeTimeObjectByName(const std::string& name) {
-    std::lock_guard<std::mutex> lock(timeObjectsMutex);
-    
-    // Use find_if to locate the named object
-    auto it = std::find_if(timeObjectList.begin(), timeObjectList.end(), 
-                           [&name](const std::shared_ptr<TimeObject>& obj) { return obj->name == name; });
-    
-    // If found, erase it
-    if (it != timeObjectList.end()) {
-        timeObjectList.erase(it);
-        timerChannel.send(timer::RECALIBRATE);
-        return true;
-    }
-    return false;
+    std::lock_guard<std::mutex> lock(timerMutex);
+    return timerWheel.cancel(timerWheel.find(name));
 }
 
-// TODO useSet
-//std::shared_ptr<TimeObject> findTimerSetByName(const std::set<std::shared_ptr<TimeObject>, CompareTimerSet>& timerSet, const std::string& name) {
-//    std::lock_guard<std::mutex> lock(timerMutex);
-
-bool syncTimeObjectByName(const std::string& name, double error_margin_percent, bool useSet) {
+bool syncTimeObjectByName(const std::string& name, double error_margin_percent, [[maybe_unused]] bool useSet) {
     double tNow = get_time_double();
-
-    if (useSet)
     {
-        auto tObj = findTimerSetByName(timerSet, name);
         std::lock_guard<std::mutex> lock(timerMutex);
-        if (tObj && tObj->sync)
-        {
-            timerSet.erase(tObj);
-            if ((tObj->runTime - tNow) < (tObj->repeatTime * error_margin_percent)) {
-                tObj->runTime = tNow + tObj->repeatTime;
-            }
-            tObj->run = false;
-            timerSet.insert(tObj);
-            return true;
-
-        }
-        return false;
-    }
-    else
-    {
-        std::lock_guard<std::mutex> lock(timeObjectsMutex);
-        auto it = std::find_if(timeObjectList.begin(), timeObjectList.end(),
-                            [&name](const std::shared_ptr<TimeObject>& obj) { return obj->name == name; });
-        if (it != timeObjectList.end()) {
-            
-            // if we are before the runTime, (runtime-tNow) is > 0
-            // if we are after the runTime, (runtime-tNow) is < 0
-            if (((*it)->runTime - tNow) < ((*it)->repeatTime * error_margin_percent)) {
-                (*it)->runTime = tNow + (*it)->repeatTime;
-            }
-            if((*it)->sync)
-                (*it)->run = false;
-
-            // Relocate the modified object.
-            _modifyAndRelocate(*it, (*it)->runTime);
-
-            timerChannel.send(timer::RECALIBRATE);
-            return true;
+        auto h = timerWheel.find(name);
+        auto tObj = timerWheel.get(h);
+        if (!tObj)
+            return false;
+
+        // if we are before the runTime, (runtime-tNow) is > 0
+        // if we are after the runTime, (runtime-tNow) is < 0
+        if ((tObj->runTime - tNow) < (tObj->repeatTime * error_margin_percent)) {
+            tObj->runTime = tNow + tObj->repeatTime;
         }
-        return false;
-    }
-}
-
-bool modifyTimeObjectByName(const std::string& name, double newRunTime, double newStopTime, double newRepeatTime, bool useSet) {
-    if (useSet)
-    {
-       
-        auto tObj = findTimerSetByName(timerSet, name);
-        if (tObj)
-        {
-            std::lock_guard<std::mutex> lock(timerMutex);
-            timerSet.erase(tObj);
-
-            if(newRunTime > 0) tObj->runTime = newRunTime;
-            if(newStopTime > 0 ) tObj->stopTime = newStopTime;
-            if(newRepeatTime > 0) tObj->repeatTime = newRepeatTime;
-            if((tObj->repeatTime > 0.0) && (tObj->stopTime != 0 && tObj->runTime < tObj->stopTime))
-                    timerSet.insert(tObj);
-            return true;
-
-        }
-        return false;
-    }
-    else
-    {
-        std::lock_guard<std::mutex> lock(timeObjectsMutex);
-        auto it = std::find_if(timeObjectList.begin(), timeObjectList.end(), 
-                            [&name](const std::shared_ptr<TimeObject>& obj) {
-            return obj->name == name;
-        });
-        
-
-        if (it != timeObjectList.end()) {
-            if(newRunTime > 0) (*it)->runTime = newRunTime;
-            if(newStopTime > 0 ) (*it)->stopTime = newStopTime;
-            if(newRepeatTime > 0) (*it)->repeatTime = newRepeatTime;
-            
-            // Relocate the modified object.
-            _modifyAndRelocate(*it, (*it)->runTime);
-
-            timerChannel.send(timer::RECALIBRATE);
-            return true;
-        }
-        return false;
+        if (tObj->sync)
+            tObj->run = false;
+        timerWheel.reschedule(h);
     }
+    timerCv.notify_one();
+    return true;
 }
 
-void showTimerObjects(bool useSet) {
-    if (useSet)
+bool modifyTimeObjectByName(const std::string& name, double newRunTime, double newStopTime, double newRepeatTime, [[maybe_unused]] bool useSet) {
     {
         std::lock_guard<std::mutex> lock(timerMutex);
-
-        for (const auto& tPtr : timerSet) {
-            std::cout << tPtr->name 
-                  << " runTime :"    << tPtr->runTime 
-                  << " repeatTime :" << tPtr->repeatTime 
-                  << " runs :"       << tPtr->runs 
-                  << " lastRun :"    << tPtr->lastRun 
-                  << std::endl;
-
-        }
+        auto h = timerWheel.find(name);
+        auto tObj = timerWheel.get(h);
+        if (!tObj)
+            return false;
+        if(newRunTime > 0) tObj->runTime = newRunTime;
+        if(newStopTime > 0 ) tObj->stopTime = newStopTime;
+        if(newRepeatTime > 0) tObj->repeatTime = newRepeatTime;
+        timerWheel.reschedule(h);
     }
-    else
-    {
-        std::lock_guard<std::mutex> lock(timeObjectsMutex);
+    timerCv.notify_one();
+    return true;
+}
 
-        for (const auto& tPtr : timeObjectList) {
-            std::cout << tPtr->name 
-                  << " runTime :" << tPtr->runTime 
-                  << " runs :" << tPtr->runs 
-                  << " lastRun :" << tPtr->lastRun 
+void showTimerObjects([[maybe_unused]] bool useSet) {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    timerWheel.for_each([](const std::shared_ptr<TimeObject>& tPtr) {
+        std::cout << tPtr->name
+                  << " runTime :"    << tPtr->runTime
+                  << " repeatTime :" << tPtr->repeatTime
+                  << " runs :"       << tPtr->runs
+                  << " lastRun :"    << tPtr->lastRun
                   << std::endl;
-        }
-    }
+    });
 }
 
 
+struct FiredTimer {
+    TimerWheel::Handle handle;
+    std::shared_ptr<TimeObject> obj;   // null when a sync timer is waiting for its sync
+    bool keep;
+};
 
-
+// pull the due timers off the wheel and update them under the lock, run the callbacks without it
 void timerThreadFunc() {
-    shouldTerminate = false;
-
+    auto& registry = PerfRegistry::get();
+    const PerfId jitter_id = registry.intern("timer_jitter");
+    std::vector<TimerWheel::Handle> due;
+    std::vector<FiredTimer> fired;
+    std::unique_lock<std::mutex> lock(timerMutex);
     while (!shouldTerminate) {
-        double delay = -1;
-        bool shouldRunFirst = false; // flag to determine if we need to run the first timer
-
-        {
-            std::lock_guard<std::mutex> lock(timeObjectsMutex);
-            if (!timeObjectList.empty()) {
-                delay = timeObjectList.front()->runTime - get_time_double();
-                if (delay < 0) {
-                    shouldRunFirst = true;
-                }
-            }
-        }
-
-        if (shouldRunFirst) {
-            checkAndRunFirst();
+        double tNow = get_time_double();
+        timerWheel.advance(tNow, due);
+        if (due.empty()) {
+            double wait = timerWheel.next_wait(tNow);
+            if (wait < 0)
+                timerCv.wait(lock);
+            else
+                timerCv.wait_for(lock, std::chrono::duration<double>(wait));
             continue;
         }
 
-        int timerMessage = 0;
-        std::string signalMessage;
-
-        // Convert delay from seconds to std::chrono::microseconds
-        std::chrono::microseconds waitDuration = (delay > 0) ? std::chrono::microseconds(static_cast<int>(delay * 1000000.0)) : std::chrono::microseconds::max();
-
-        // First, we'll check for timer-related messages with the specified delay.
-        bool gotTimerMsg = timerChannel.receive(timerMessage, waitDuration);
-
-        // Immediately after, we'll check for signals without waiting.
-        bool gotSignalMsg = signalChannel.receive(signalMessage, std::chrono::microseconds(0));
-
-        // Process messages
-        if (gotTimerMsg) {
-            if (timerMessage != timer::RECALIBRATE)
-                std::cout << " got timer message :" << timerMessage << " at time " << get_time_double() << std::endl;
-            // Handle timer channel message
-        }
-
-        if (gotSignalMsg) {
-            std::cout << " got signal message :" << signalMessage << " at time " << get_time_double() << std::endl;
-            // Handle signal channel message
+        for (auto h : due) {
+            auto tObj = timerWheel.get(h);
+            bool call = !tObj->sync || !tObj->run;
+            if (call) {
+                registry.record_secs(jitter_id, tNow - tObj->runTime);
+                tObj->lastRun = tNow;
+                tObj->runs++;
+                tObj->run = true;
+            }
+            // a sync timer that has not been synced for two periods runs free again
+            else if (tObj->lastRun + (tObj->repeatTime*2) <= tNow) {
+                tObj->run = false;
+            }
+            tObj->runTime += tObj->repeatTime;
+            bool keep = tObj->repeatTime > 0 && !shouldStopDuetoTime(tObj) && !shouldStopDuetoCount(tObj);
+            fired.push_back({h, call ? tObj : nullptr, keep});
         }
+        due.clear();
 
-        // If no messages were received and no timer was triggered, perform a default action or continue the loop.
-        if (!gotTimerMsg && !gotSignalMsg && delay <= 0) {
-            // Handle no message case (if needed)
-            continue;
+        lock.unlock();
+        for (auto& fire : fired) {
+            if (fire.obj && fire.obj->callback)
+                fire.obj->callback(fire.obj, fire.obj->param);
         }
+        lock.lock();
+        for (auto& fire : fired)
+            timerWheel.finish(fire.handle, fire.keep);
+        fired.clear();
     }
 }
 
 
 
 std::thread timerThread;
-    
+
 void runTimer()
 {
+    shouldTerminate = false;
     timerThread = std::thread(timerThreadFunc);
 }
 
 void stopTimer()
 {
-    shouldTerminate = true;
-    timerChannel.send(3456);
-    // Cleanup
-    timerThread.join(); // In a real-world scenario, we'd have a mechanism to signal the timer thread to exit and then join.
-
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        shouldTerminate = true;
+    }
+    timerCv.notify_all();
+    timerThread.join();
 }
 
 void setBaseTime()
@@ -643,33 +466,32 @@ void setBaseTime()
     baseTime = std::chrono::system_clock::now();
 }
 
-std::shared_ptr<TimeObject> createTimeObject(std::string timer_name, double timer_runTime, double timer_stopTime, 
+std::shared_ptr<TimeObject> createTimeObject(std::string timer_name, double timer_runTime, double timer_stopTime,
     double timer_repeatTime, int timer_count, void (*timer_callback)(std::shared_ptr<TimeObject>,void*), void* timer_callbackParams)
 {
     double offset = 0.0;
     auto tobj = std::make_shared<TimeObject>(timer_name, timer_runTime, timer_stopTime,
          timer_repeatTime, timer_count, offset, timer_callback, timer_callbackParams);
-    timeObjects.emplace_back(tobj);
 
     return tobj;
 }
 
-std::shared_ptr<TimeObject> createOffsetTimeObject(std::string timer_name, double timer_runTime, double timer_stopTime, 
+std::shared_ptr<TimeObject> createOffsetTimeObject(std::string timer_name, double timer_runTime, double timer_stopTime,
          double timer_repeatTime, int timer_count, int timer_offset, void (*timer_callback)(std::shared_ptr<TimeObject>,void*), void* timer_callbackParams)
 {
-    auto tobj = std::make_shared<TimeObject>(timer_name, timer_runTime, timer_stopTime, 
+    auto tobj = std::make_shared<TimeObject>(timer_name, timer_runTime, timer_stopTime,
             timer_repeatTime, timer_count, timer_offset, timer_callback, timer_callbackParams);
-    timeObjects.emplace_back(tobj);
     return tobj;
 }
 
 
 
 
-int test_timer(bool useSet = false) 
+int test_timer(bool useSet = false)
 {
     setBaseTime();
-    std::cout << __func__ << " Running "<< (useSet?"Using SetList":"using origList")<< std::endl;
+    timer_debug = true;
+    std::cout << __func__ << " Running on the timer wheel" << std::endl;
 
     double start = get_time_double();
 
@@ -678,13 +500,11 @@ int test_timer(bool useSet = false)
     int exampleParam2 = 12;
     int exampleParam3 = 13;
     int exampleParam5 = 15;
-    int exampleParam6 = 16;
 
     auto obj1 = std::make_shared<TimeObject>("obj1", 15.0,   0,    0.1,  0,   exampleCallback, &exampleParam1);
     auto obj2 = std::make_shared<TimeObject>("obj2", 1.0,   0,    1.0,    0,   exampleCallback, &exampleParam2);
     auto obj3 = std::make_shared<TimeObject>("obj3", 10.0,   0,    0.001,    10,   exampleCallback, &exampleParam3);
     auto obj5 = std::make_shared<TimeObject>("obj5", 1.0,   0,    0.2,    0,   exampleCallback, &exampleParam5);
-    auto obj6 = std::make_shared<TimeObject>("obj6", 1.0,   0,    0.2,    0,   exampleCallback, &exampleParam6);
 
     addTimeObject(obj1, 0.0, false, useSet);
     addTimeObject(obj2, 0.0, true, useSet);
@@ -697,50 +517,157 @@ int test_timer(bool useSet = false)
     modifyTimeObjectByName("obj4", 2.0, 0, 0, useSet);
     showTimerObjects(useSet);
 
-    std::thread timerThread;
-    if (useSet)
-        timerThread = std::thread(timerSetThreadFunc);
-    else
-        timerThread = std::thread(timerThreadFunc);
+    runTimer();
 
     // Simulate some external activity
-    std::this_thread::sleep_for(std::chrono::seconds(4));
-    if (!useSet)
-        signalChannel.send("External Signal 1");
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(600));
-    if (!useSet)
-        timerChannel.send(3456);
+    std::this_thread::sleep_for(std::chrono::milliseconds(4600));
     std::cout << " syncing obj2 now after 4.6 seconds" << std::endl;
     syncTimeObjectByName("obj2",0.4,useSet);
 
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-    if (!useSet)
-        signalChannel.send("External Signal 2");
-
     // Let's wait for a while to observe the behavior
-    std::this_thread::sleep_for(std::chrono::seconds(2));
+    std::this_thread::sleep_for(std::chrono::seconds(7));
     std::cout << "adding obj5" << std::endl;
     addTimeObject(obj5, 0.0, false, useSet);
 
     std::cout << "sleeping for 5 secs" << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(5));
     std::cout << "killing threads" << std::endl;
-    shouldTerminate = true;
-    stopThread = true;
-    timerCv.notify_one();
-    //std::cout << "killed threads" << std::endl;
-    //addTimeObject(obj6, 0.0, false, useSet);
-    // Cleanup
-
-    timerThread.join(); // In a real-world scenario, we'd have a mechanism to signal the timer thread to exit and then join.
+    stopTimer();
 
     showTimerObjects(useSet);
     double end = get_time_double();
 
+    std::cout << " obj3 runs " << obj3->runs << " ( count " << obj3->count << " )" << std::endl;
     std::cout << " duration secs :" << (end - start)  << std::endl;
+    for (auto name : {"obj1", "obj2", "obj5"})
+        removeTimeObjectByName(name);
 
-    return 0;
+    return obj3->runs == obj3->count ? 0 : 1;
+}
+
+
+static void benchCallback(std::shared_ptr<TimeObject> /*t*/, void* p) {
+    static_cast<std::atomic<uint64_t>*>(p)->fetch_add(1, std::memory_order_relaxed);
+}
+
+// num_timers pub style timers ( 100 mS to 1 S at staggered offsets ) through the wheel and through
+// the sorted list the timer used to keep, on simulated time. then live on the timer thread for the jitter
+int bench_timer(int num_timers)
+{
+    int errors = 0;
+    using clk = std::chrono::steady_clock;
+    const double sim_secs = 10.0;
+    auto make = [&](std::vector<std::shared_ptr<TimeObject>>& objs, void* param) {
+        objs.clear();
+        for (int i = 0; i < num_timers; ++i) {
+            double repeat = 0.1 * (1 + i % 10);
+            auto obj = std::make_shared<TimeObject>("bench_" + std::to_string(i), 1.0 + (i % 1000) * 0.001,
+                                                    0, repeat, 0, benchCallback, param);
+            objs.push_back(obj);
+        }
+    };
+    std::cout.setstate(std::ios_base::failbit);    // TimeObject is chatty
+    std::vector<std::shared_ptr<TimeObject>> objs;
+
+    // the old engine, a sorted list and a remove and upper_bound insert for every fire
+    make(objs, nullptr);
+    std::list<std::shared_ptr<TimeObject>> list;
+    auto by_time = [](const std::shared_ptr<TimeObject>& a, const std::shared_ptr<TimeObject>& b) {
+        return a->runTime < b->runTime;
+    };
+    auto t0 = clk::now();
+    for (auto& obj : objs)
+        list.insert(std::upper_bound(list.begin(), list.end(), obj, by_time), obj);
+    uint64_t list_fires = 0;
+    for (double tNow = 0.0; tNow < sim_secs; tNow += TimerWheel::Tick) {
+        while (!list.empty() && list.front()->runTime <= tNow) {
+            auto obj = list.front();
+            obj->runTime += obj->repeatTime;
+            list.remove(obj);
+            list.insert(std::upper_bound(list.begin(), list.end(), obj, by_time), obj);
+            list_fires++;
+        }
+    }
+    auto t1 = clk::now();
+    size_t list_found = 0;
+    for (int i = 0; i < num_timers; i += 10) {
+        std::string name = "bench_" + std::to_string(i);
+        list_found += std::find_if(list.begin(), list.end(), [&](auto& obj) { return obj->name == name; }) != list.end();
+    }
+    auto t2 = clk::now();
+
+    make(objs, nullptr);
+    TimerWheel wheel;
+    std::vector<TimerWheel::Handle> due;
+    auto t3 = clk::now();
+    for (auto& obj : objs)
+        wheel.add(obj);
+    uint64_t wheel_fires = 0;
+    for (double tNow = 0.0; tNow < sim_secs; tNow += TimerWheel::Tick) {
+        wheel.advance(tNow, due);
+        for (auto h : due) {
+            auto obj = wheel.get(h);
+            if (obj->runTime > tNow + 1e-9)
+                errors++;
+            obj->runTime += obj->repeatTime;
+            wheel.finish(h, true);
+        }
+        wheel_fires += due.size();
+        due.clear();
+    }
+    auto t4 = clk::now();
+    size_t wheel_found = 0;
+    for (int i = 0; i < num_timers; i += 10)
+        wheel_found += wheel.get(wheel.find("bench_" + std::to_string(i))) != nullptr;
+    auto t5 = clk::now();
+    for (int i = 0; i < num_timers; i += 2)
+        wheel.cancel(wheel.find("bench_" + std::to_string(i)));
+    if (wheel.size() != (size_t)(num_timers / 2))
+        errors++;
+    std::cout.clear();
+
+    // the same fires either way, the wheel may take one more on a tick boundary
+    if (wheel_fires + num_timers < list_fires || list_fires + num_timers < wheel_fires || wheel_found != list_found) {
+        std::cout << " bench_timer fires list " << list_fires << " wheel " << wheel_fires << std::endl;
+        errors++;
+    }
+    double t_list = std::chrono::duration<double>(t1 - t0).count();
+    double t_wheel = std::chrono::duration<double>(t4 - t3).count();
+    double t_list_find = std::chrono::duration<double>(t2 - t1).count();
+    double t_wheel_find = std::chrono::duration<double>(t5 - t4).count();
+    std::cout << " bench_timer " << num_timers << " timers " << sim_secs << " secs simulated" << std::endl;
+    std::cout << "    sorted list   " << t_list / list_fires * 1e9 << " nS a fire   "
+              << t_list_find / list_found * 1e9 << " nS a name" << std::endl;
+    std::cout << "    wheel         " << t_wheel / wheel_fires * 1e9 << " nS a fire   "
+              << t_wheel_find / wheel_found * 1e9 << " nS a name   speedup " << t_list / t_wheel << std::endl;
+
+    // live, callbacks on the timer thread
+    std::atomic<uint64_t> live_fires{0};
+    make(objs, &live_fires);
+    auto& registry = PerfRegistry::get();
+    PerfId jitter_id = registry.intern("timer_jitter");
+    registry.reset();
+    std::cout.setstate(std::ios_base::failbit);
+    double tStart = get_time_double();
+    for (auto& obj : objs) {
+        obj->runTime += tStart;
+        addTimeObject(obj, 0.0, false);
+    }
+    runTimer();
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    stopTimer();
+    for (auto& obj : objs)
+        removeTimeObjectByName(obj->name);
+    std::cout.clear();
+    PerfSnap snap;
+    registry.snapshot(jitter_id, snap);
+    std::cout << "    live " << live_fires << " fires  jitter mS p50 " << snap.percentile(0.5) / 1e6
+              << " p99 " << snap.percentile(0.99) / 1e6 << " max " << snap.max() / 1e6 << std::endl;
+    if (live_fires == 0)
+        errors++;
+
+    std::cout << " bench_timer errors " << errors << std::endl;
+    return errors;
 }
 
 
@@ -750,4 +677,3 @@ int main() {
      return test_timer();
 }
 #endif
-
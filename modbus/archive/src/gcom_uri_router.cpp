@@ -0,0 +1,245 @@
+// gcom_uri_router.cpp
+// perfect hash over the fims uris of a config, see gcom_uri_router.h
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "gcom_config.h"
+#include "gcom_uri_router.h"
+
+static inline uint64_t path_hash(std::string_view path) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : path) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static inline uint64_t path_mix(uint64_t h, uint64_t seed) {
+    h ^= seed * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+void UriRouter::build(const cfg& myCfg) {
+    groups.clear();
+    pending.clear();
+    for (auto& [comp, uris] : myCfg.itemMap) {
+        for (auto& [uri, items] : uris) {
+            Group group;
+            group.path = "/" + comp + "/" + uri;
+            group.items = items;
+            int32_t gid = groups.size();
+            add(group.path, {-1, gid});
+            for (auto& [id, item] : items)
+                add(group.path + "/" + id, {item->point_id, gid});
+            groups.push_back(std::move(group));
+        }
+    }
+    finish();
+}
+
+void UriRouter::add(const std::string& path, Route route) {
+    pending.emplace_back(path, route);
+}
+
+// hash and displace: the keys go into buckets of about four, the biggest buckets are placed first,
+// each bucket gets the first seed that lands all its keys on free slots
+void UriRouter::finish() {
+    size_t num = pending.size();
+    num_routes = 0;
+    keys.clear();
+    slots.clear();
+    disp.clear();
+    slot_mask = 0;
+    if (num == 0)
+        return;
+
+    std::vector<uint64_t> hashes(num);
+    std::vector<uint32_t> key_at(num);
+    for (size_t k = 0; k < num; ++k) {
+        hashes[k] = path_hash(pending[k].first);
+        key_at[k] = keys.size();
+        keys += pending[k].first;
+    }
+
+    size_t num_buckets = std::max<size_t>(1, num / 4);
+    std::vector<std::vector<uint32_t>> buckets(num_buckets);
+    for (size_t k = 0; k < num; ++k)
+        buckets[hashes[k] % num_buckets].push_back(k);
+    std::vector<uint32_t> order(num_buckets);
+    for (size_t b = 0; b < num_buckets; ++b)
+        order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    size_t table = 8;
+    while (table < num + num / 4)
+        table <<= 1;
+
+    std::vector<uint8_t> used;
+    std::vector<uint64_t> placed;
+    for (int grow = 0; grow < 8; ++grow, table <<= 1) {
+        uint64_t mask = table - 1;
+        used.assign(table, 0);
+        disp.assign(num_buckets, 0);
+        bool ok = true;
+        for (auto b : order) {
+            auto& bucket = buckets[b];
+            if (bucket.empty())
+                break;
+            bool fits = false;
+            for (uint32_t seed = 1; seed < (1u << 16) && !fits; ++seed) {
+                placed.clear();
+                fits = true;
+                for (auto k : bucket) {
+                    uint64_t slot = path_mix(hashes[k], seed) & mask;
+                    if (used[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                        fits = false;
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (fits) {
+                    for (auto slot : placed)
+                        used[slot] = 1;
+                    disp[b] = seed;
+                }
+            }
+            if (!fits) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok)
+            continue;
+
+        slots.assign(table, Slot());
+        slot_mask = mask;
+        for (size_t k = 0; k < num; ++k) {
+            auto& slot = slots[path_mix(hashes[k], disp[hashes[k] % num_buckets]) & mask];
+            slot.key_at = key_at[k];
+            slot.key_len = pending[k].first.size();
+            slot.route = pending[k].second;
+        }
+        num_routes = num;
+        pending.clear();
+        return;
+    }
+    // two paths with the same 64 bit hash, leave the router empty and let the itemMap walk do it
+    std::cout << " UriRouter unable to place " << num << " uris" << std::endl;
+    keys.clear();
+    disp.clear();
+    pending.clear();
+}
+
+const UriRouter::Route* UriRouter::find(std::string_view path) const {
+    if (num_routes == 0 || path.empty())
+        return nullptr;
+    uint64_t h = path_hash(path);
+    auto& slot = slots[path_mix(h, disp[h % disp.size()]) & slot_mask];
+    if (slot.key_len != path.size() || memcmp(keys.data() + slot.key_at, path.data(), path.size()) != 0)
+        return nullptr;
+    return &slot.route;
+}
+
+
+// route every path of a synthetic itemMap, check misses, and time it against splitting the uri
+// and walking the itemMap the way test_findMapVar does
+int test_uri_router() {
+    int errors = 0;
+    cfg myCfg;
+    const int num_comps = 4;
+    const int num_uris = 25;
+    const int num_items = 100;
+    int32_t point_id = 0;
+    std::vector<std::string> paths;
+    std::vector<int32_t> want;
+    std::vector<std::shared_ptr<cfg::map_struct>> maps;
+    for (int c = 0; c < num_comps; ++c) {
+        std::string comp = "components_" + std::to_string(c);
+        for (int u = 0; u < num_uris; ++u) {
+            std::string uri = "comp_sel_" + std::to_string(2400 + u);
+            for (int i = 0; i < num_items; ++i) {
+                auto map = std::make_shared<cfg::map_struct>();
+                map->id = "item_" + std::to_string(i);
+                map->point_id = point_id++;
+                myCfg.itemMap[comp][uri][map->id] = map;
+                paths.push_back("/" + comp + "/" + uri + "/" + map->id);
+                want.push_back(map->point_id);
+                maps.push_back(map);
+            }
+        }
+    }
+
+    UriRouter router;
+    router.build(myCfg);
+    size_t expect = num_comps * num_uris * (num_items + 1);
+    if (router.size() != expect) {
+        std::cout << " test_uri_router routes " << router.size() << " expected " << expect << std::endl;
+        errors++;
+    }
+    for (size_t k = 0; k < paths.size(); ++k) {
+        auto route = router.find(paths[k]);
+        if (!route || route->point_id != want[k])
+            errors++;
+        else if (router.groups[route->group].items.size() != (size_t)num_items)
+            errors++;
+        if (router.find(paths[k] + "x") || router.find(paths[k] + "/"))
+            errors++;
+    }
+    auto group = router.find("/components_1/comp_sel_2403");
+    if (!group || group->point_id != -1 || router.groups[group->group].path != "/components_1/comp_sel_2403")
+        errors++;
+    std::cout << " test_uri_router routes " << router.size() << " groups " << router.groups.size()
+              << " lookup errors " << errors << std::endl;
+
+    using clk = std::chrono::steady_clock;
+    const int loops = 50;
+    size_t found_walk = 0;
+    size_t found_router = 0;
+    auto t0 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        for (auto& path : paths) {
+            std::string_view uri_view;
+            Uri_req uri_req(uri_view, path.c_str());
+            auto& keys = uri_req.uriv;
+            auto comp = myCfg.itemMap.find(keys[1]);
+            if (comp == myCfg.itemMap.end())
+                continue;
+            auto uri = comp->second.find(keys[2]);
+            if (uri == comp->second.end())
+                continue;
+            found_walk += uri->second.count(keys[3]);
+        }
+    }
+    auto t1 = clk::now();
+    for (int l = 0; l < loops; ++l) {
+        for (auto& path : paths) {
+            std::string_view uri_view;
+            Uri_req uri_req(uri_view, path.c_str(), false);
+            found_router += router.find(uri_view) != nullptr;
+        }
+    }
+    auto t2 = clk::now();
+    double lookups = (double)paths.size() * loops;
+    double t_walk = std::chrono::duration<double>(t1 - t0).count();
+    double t_router = std::chrono::duration<double>(t2 - t1).count();
+    std::cout << "    split + itemMap  " << lookups / t_walk / 1e6 << " M uris/s" << std::endl;
+    std::cout << "    router           " << lookups / t_router / 1e6 << " M uris/s  speedup " << t_walk / t_router << std::endl;
+    if (found_walk != found_router || found_router != paths.size() * loops) {
+        std::cout << " found " << found_walk << " vs " << found_router << std::endl;
+        errors++;
+    }
+    std::cout << " test_uri_router errors " << errors << std::endl;
+    return errors;
+}
@@ -5,6 +5,8 @@
  *      Author: jcalcagni
  */
 #include <stdio.h>
+#include <climits>
+#include <set>
 #include <vector>
 #include <string>
 #include <string.h>
@@ -16,6 +18,7 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <sys/uio.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <net/if.h>
 #include <netdb.h>
@@ -25,9 +28,11 @@
 #include <fims/libfims.h>
 #include <modbus/modbus.h>
 #include "modbus_server.h"
+#include "modbus_sim.h"
 
 #define MICROSECOND_TO_MILLISECOND 1000
 #define NANOSECOND_TO_MILLISECOND  1000000
+#define MAX_EPOLL_EVENTS           64
 
 volatile bool running = true;
 
@@ -169,7 +174,8 @@ int establish_connection(system_config* config)
         return -1;
     }
 
-    if (-1 == listen(sock, 1))
+    // a load test brings up hundreds of masters at once
+    if (-1 == listen(sock, SOMAXCONN))
     {
         FPS_ERROR_PRINT("Failed to listen on socket: %s.\n", strerror(errno));
         close(sock);
@@ -644,6 +650,193 @@ int extract_valueint_of_last_array_object(cJSON* arr)
     return val->valueint;
 }
 
+/**
+ * @brief The parts of a cJSON value the update functions read. Bit fields and enumerations take the "value"
+ * of the last object in their array, anything else is unwrapped if clothed.
+ */
+static fims_value cjson_to_fims_value(maps* settings, cJSON* obj)
+{
+    fims_value out = {0.0, 0, false};
+    if(!settings->is_bool && (settings->bit_field || settings->enum_type || settings->random_enum_type))
+    {
+        out.valueint = extract_valueint_of_last_array_object(obj);
+        out.valuedouble = out.valueint;
+        return out;
+    }
+    cJSON* val = unwrap_if_clothed(obj);
+    out.is_true = cJSON_IsTrue(val);
+    out.valueint = val->valueint;
+    out.valuedouble = val->valuedouble;
+    return out;
+}
+
+/**
+ * @brief One pass over a fims body without building a cJSON tree. Values come out the way cjson_to_fims_value
+ * reads them: bare, clothed {"value": x} or the last entry of an array. Strings and nulls come out as 0.
+ */
+struct body_scanner
+{
+    const char* p;
+
+    void skip_ws()
+    {
+        while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+            p++;
+    }
+
+    // p on the opening quote, leaves it after the closing one. escapes are skipped, not decoded
+    bool string(const char*& start, size_t& len)
+    {
+        start = ++p;
+        while(*p != '\0' && *p != '"')
+        {
+            if(*p == '\\' && p[1] != '\0')
+                p++;
+            p++;
+        }
+        if(*p != '"')
+            return false;
+        len = p - start;
+        p++;
+        return true;
+    }
+
+    bool literal(const char* word, size_t len)
+    {
+        if(strncmp(p, word, len) != 0)
+            return false;
+        p += len;
+        return true;
+    }
+
+    // p on the opening brace, found(key, len, value) for each member
+    template <typename Found>
+    bool members(Found&& found, int depth)
+    {
+        p++;
+        skip_ws();
+        if(*p == '}')
+        {
+            p++;
+            return true;
+        }
+        while(true)
+        {
+            skip_ws();
+            const char* key;
+            size_t len;
+            if(*p != '"' || !string(key, len))
+                return false;
+            skip_ws();
+            if(*p++ != ':')
+                return false;
+            fims_value member = {0.0, 0, false};
+            if(!value(member, depth + 1))
+                return false;
+            found(key, len, member);
+            skip_ws();
+            if(*p == ',')
+            {
+                p++;
+                continue;
+            }
+            if(*p != '}')
+                return false;
+            p++;
+            return true;
+        }
+    }
+
+    bool value(fims_value& out, int depth)
+    {
+        skip_ws();
+        if(depth > 32)
+            return false;
+        switch(*p)
+        {
+            case '{':
+                return members([&out](const char* key, size_t len, const fims_value& member) {
+                    if(len == 5 && strncmp(key, "value", 5) == 0)
+                        out = member;
+                }, depth);
+            case '[':
+                p++;
+                skip_ws();
+                if(*p == ']')
+                {
+                    p++;
+                    return true;
+                }
+                while(true)
+                {
+                    fims_value entry = {0.0, 0, false};
+                    if(!value(entry, depth + 1))
+                        return false;
+                    out = entry;
+                    skip_ws();
+                    if(*p == ',')
+                    {
+                        p++;
+                        continue;
+                    }
+                    if(*p != ']')
+                        return false;
+                    p++;
+                    return true;
+                }
+            case '"':
+            {
+                const char* start;
+                size_t len;
+                return string(start, len);
+            }
+            case 't':
+                out.is_true = true;
+                return literal("true", 4);
+            case 'f':
+                return literal("false", 5);
+            case 'n':
+                return literal("null", 4);
+            default:
+            {
+                char* end;
+                double d = strtod(p, &end);
+                if(end == p)
+                    return false;
+                p = end;
+                out.valuedouble = d;
+                // cJSON saturates valueint the same way
+                out.valueint = (d >= INT_MAX) ? INT_MAX : (d <= (double)INT_MIN) ? INT_MIN : static_cast<int>(d);
+                return true;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Numbers printed the way cJSON_PrintUnformatted prints them.
+ */
+static void append_number(std::string& out, double d)
+{
+    char buf[32];
+    if(d != d || d - d != 0.0)
+    {
+        out += "null";
+        return;
+    }
+    int as_int = (d >= INT_MAX) ? INT_MAX : (d <= (double)INT_MIN) ? INT_MIN : static_cast<int>(d);
+    int len;
+    if(static_cast<double>(as_int) == d)
+        len = snprintf(buf, sizeof(buf), "%d", as_int);
+    else
+    {
+        len = snprintf(buf, sizeof(buf), "%1.15g", d);
+        if(strtod(buf, NULL) != d)
+            len = snprintf(buf, sizeof(buf), "%1.17g", d);
+    }
+    out.append(buf, len);
+}
+
 /**
  * @brief Encode the source value, found in the cJSON object, as a 32-bit unsigned integer.
  * 
@@ -663,35 +856,39 @@ int extract_valueint_of_last_array_object(cJSON* arr)
  */
 uint32_t json_to_uint32(maps* settings, cJSON* obj)
 {
-    cJSON* val = unwrap_if_clothed(obj);
+    return value_to_uint32(settings, cjson_to_fims_value(settings, obj));
+}
+
+uint32_t value_to_uint32(maps* settings, const fims_value& val)
+{
     // source value may be in a variety of data types. use configuration settings to know which data type to expect
     // and parse the value into the uint32_t appropriately, including necessary type casts and/or direct memory copies.
     uint32_t encoded_val;
     if (settings->is_bool)
     {
-        encoded_val = static_cast<uint32_t> (cJSON_IsTrue(val) || val->valueint == 1);
+        encoded_val = static_cast<uint32_t> (val.is_true || val.valueint == 1);
     }
     else if(settings->bit_field || settings->enum_type || settings->random_enum_type)
     {
-        encoded_val = static_cast<uint32_t> (extract_valueint_of_last_array_object(obj));
+        encoded_val = static_cast<uint32_t> (val.valueint);
     }
     // direct float: transmitted directly bit-for-bit
     else if(settings->floating_pt)
     {
-        float scaled_val = val->valuedouble * (settings->scale == 0.0 ? 1.0 : settings->scale);
+        float scaled_val = val.valuedouble * (settings->scale == 0.0 ? 1.0 : settings->scale);
         memcpy(&encoded_val, &scaled_val, sizeof(encoded_val));
     }
     // indirect float: scaled and truncated to int, then transmitted as int to be descaled on client side
     else if(settings->scale != 0.0)
     {
-        float scaled_val = val->valuedouble * settings->scale;
+        float scaled_val = val.valuedouble * settings->scale;
         int casted_val = static_cast<int> (scaled_val);
         memcpy(&encoded_val, &casted_val, sizeof(encoded_val));
     }
     // source value is either a signed or unsigned integer
     else
     {
-        memcpy(&encoded_val, &(val->valueint), sizeof(encoded_val));
+        memcpy(&encoded_val, &(val.valueint), sizeof(encoded_val));
     }
     return encoded_val;
 }
@@ -714,35 +911,40 @@ uint32_t json_to_uint32(maps* settings, cJSON* obj)
  */
 uint64_t json_to_uint64(maps* settings, cJSON* obj)
 {
-    cJSON* val = unwrap_if_clothed(obj);
+    return value_to_uint64(settings, cjson_to_fims_value(settings, obj));
+}
+
+uint64_t value_to_uint64(maps* settings, const fims_value& val)
+{
     // source value may be in a variety of data types. use configuration settings to know which data type to expect
-    // and parse the value into the uint32_t appropriately, including necessary type casts and/or direct memory copies.
+    // and parse the value into the uint64_t appropriately, including necessary type casts and/or direct memory copies.
     uint64_t encoded_val;
     if (settings->is_bool)
     {
-        encoded_val = static_cast<uint64_t> (cJSON_IsTrue(val) || val->valueint == 1);
+        encoded_val = static_cast<uint64_t> (val.is_true || val.valueint == 1);
     }
     else if(settings->bit_field || settings->enum_type || settings->random_enum_type)
     {
-        encoded_val = static_cast<uint64_t> (extract_valueint_of_last_array_object(obj));
+        encoded_val = static_cast<uint64_t> (val.valueint);
     }
     // direct float: transmitted directly bit-for-bit
     else if(settings->floating_pt)
     {
-        double scaled_val = val->valuedouble * (settings->scale == 0.0 ? 1.0 : settings->scale);
+        double scaled_val = val.valuedouble * (settings->scale == 0.0 ? 1.0 : settings->scale);
         memcpy(&encoded_val, &scaled_val, sizeof(encoded_val));
     }
     // indirect float: scaled and truncated to int, then transmitted as int to be descaled on client side
     else if(settings->scale != 0.0)
     {
-        double scaled_val = val->valuedouble * settings->scale;
+        double scaled_val = val.valuedouble * settings->scale;
         int64_t casted_val = static_cast<int64_t> (scaled_val);
         memcpy(&encoded_val, &casted_val, sizeof(encoded_val));
     }
-    // source value is either a signed or unsigned integer
+    // source value is either a signed or unsigned integer, valueint would cap it at 32 bits
     else
     {
-        memcpy(&encoded_val, &(val->valueint), sizeof(encoded_val));
+        int64_t casted_val = static_cast<int64_t> (val.valuedouble);
+        memcpy(&encoded_val, &casted_val, sizeof(encoded_val));
     }
     return encoded_val;
 }
@@ -758,9 +960,14 @@ uint64_t json_to_uint64(maps* settings, cJSON* obj)
  * targeted variable's register.
  */
 void update_holding_or_input_register_value(maps* settings, cJSON* value, uint16_t* regs, system_config* sys_cfg)
+{
+    update_holding_or_input_register_value(settings, cjson_to_fims_value(settings, value), regs, sys_cfg);
+}
+
+void update_holding_or_input_register_value(maps* settings, const fims_value& value, uint16_t* regs, system_config* sys_cfg)
 {
     // extract the new variable value, rawly represented in 32 bits stored in a 32-bit unsigned integer
-    uint32_t val = json_to_uint32(settings, value);
+    uint32_t val = value_to_uint32(settings, value);
 
     // load individual Modbus registers with new value
     if(settings->num_regs == 1)
@@ -783,7 +990,7 @@ void update_holding_or_input_register_value(maps* settings, cJSON* value, uint16
     }
     else if(settings->num_regs == 4)
     {
-        uint64_t val64 = json_to_uint64(settings, value);
+        uint64_t val64 = value_to_uint64(settings, value);
 
         if (!sys_cfg->byte_swap) // regular
         {
@@ -816,7 +1023,21 @@ void update_holding_or_input_register_value(maps* settings, cJSON* value, uint16
  */
 void update_variable_value(modbus_mapping_t* map, bool* reg_type, maps** settings, cJSON* value, system_config* sys_cfg)
 {
-    cJSON* obj = unwrap_if_clothed(value);
+    for(int i = 0; i < Num_Register_Types; i++)
+    {
+        if(reg_type[i] == false)
+            continue;
+        bool types[Num_Register_Types] = {false, false, false, false};
+        types[i] = true;
+        update_variable_value(map, types, settings, cjson_to_fims_value(settings[i], value), sys_cfg);
+    }
+}
+
+/**
+ * @brief Same as the cJSON version with the value already pulled out of the fims body.
+ */
+void update_variable_value(modbus_mapping_t* map, bool* reg_type, maps** settings, const fims_value& value, system_config* sys_cfg)
+{
     for(int i = 0; i < Num_Register_Types; i++)
     {
         if(reg_type[i] == false)
@@ -824,7 +1045,7 @@ void update_variable_value(modbus_mapping_t* map, bool* reg_type, maps** setting
         if((i == Coil) || (i == Discrete_Input))
         {
             uint8_t* regs = (i == Coil) ? map->tab_bits : map->tab_input_bits;
-            regs[settings[i]->reg_off] = cJSON_IsTrue(obj) || obj->valueint == 1;
+            regs[settings[i]->reg_off] = value.is_true || value.valueint == 1;
         }
         else if((i == Input_Register) || (i == Holding_Register))
         {
@@ -859,25 +1080,12 @@ bool process_modbus_message(int bytes_read, int header_length, datalog* data, sy
                 FPS_ERROR_PRINT("Wrote to undefined coil.\n");
                 return false;
             }
-            cJSON* send_body = cJSON_CreateObject();
-            if(send_body != NULL)
+            if(value == 0 || value == 0xFF00)
+                server_map->set_add(reg, value == 0xFF00);
+            else
             {
-                if(value == 0 || value == 0xFF00)
-                {
-                    char uri[512];
-                    sprintf(uri, "%s/%s", reg->uri, reg->reg_name);
-                    cJSON_AddBoolToObject(send_body, "value", (value == 0xFF00) ? true : false);
-                    char* body_msg = cJSON_PrintUnformatted(send_body);
-                    server_map->p_fims->Send("set", uri, NULL, body_msg);
-                    free(body_msg);
-                    cJSON_Delete(send_body);
-                }
-                else
-                {
-                    FPS_ERROR_PRINT("Invalid value sent to coil.\n");
-                    cJSON_Delete(send_body);
-                    return false;
-                }
+                FPS_ERROR_PRINT("Invalid value sent to coil.\n");
+                return false;
             }
         }
         // Let the modbus_reply handle error message
@@ -905,18 +1113,8 @@ bool process_modbus_message(int bytes_read, int header_length, datalog* data, sy
                     if(reg == NULL)
                         //undefined coil
                         continue;
-                    cJSON* send_body = cJSON_CreateObject();
-                    if(send_body != NULL)
-                    {
-                        char uri[512];
-                        sprintf(uri, "%s/%s", reg->uri, reg->reg_name);
-                        uint8_t value = (query[header_length + 6 + i] >> j) & 0x01;
-                        cJSON_AddBoolToObject(send_body, "value", (value == 1) ? true : false);
-                        char* body_msg = cJSON_PrintUnformatted(send_body);
-                        server_map->p_fims->Send("set", uri, NULL, body_msg);
-                        free(body_msg);
-                        cJSON_Delete(send_body);
-                    }
+                    uint8_t value = (query[header_length + 6 + i] >> j) & 0x01;
+                    server_map->set_add(reg, value == 1);
                 }
             }
         }
@@ -947,34 +1145,19 @@ bool process_modbus_message(int bytes_read, int header_length, datalog* data, sy
                 }
                 else
                 {
-                    cJSON* send_body = cJSON_CreateObject();
-                    if(send_body != NULL)
+                    if(reg->is_bool)
+                        server_map->set_add(reg, num_regs == 1);
+                    else
                     {
-                        char uri[512];
-                        sprintf(uri, "%s/%s", reg->uri, reg->reg_name);
-
-                        if(reg->is_bool)
-                        {
-                            bool temp_reg;
-                            temp_reg = (num_regs == 1);
-                            cJSON_AddBoolToObject(send_body, "value", temp_reg);
-                        }
+                        double temp_reg;
+                        if(reg->sign == true)
+                            temp_reg = static_cast<double>(static_cast<int16_t>(num_regs));
                         else
-                        {
-                            double temp_reg;
-                            if(reg->sign == true)
-                                temp_reg = static_cast<double>(static_cast<int16_t>(num_regs));
-                            else
-                                temp_reg = static_cast<double>(num_regs);
+                            temp_reg = static_cast<double>(num_regs);
 
-                            if(reg->scale != 0.0)
-                                temp_reg /= reg->scale;
-                            cJSON_AddNumberToObject(send_body, "value", temp_reg);
-                        }
-                        char* body_msg = cJSON_PrintUnformatted(send_body);
-                        server_map->p_fims->Send("set", uri, NULL, body_msg);
-                        free(body_msg);
-                        cJSON_Delete(send_body);
+                        if(reg->scale != 0.0)
+                            temp_reg /= reg->scale;
+                        server_map->set_add(reg, temp_reg);
                     }
                 }
             }
@@ -1093,26 +1276,18 @@ bool process_modbus_message(int bytes_read, int header_length, datalog* data, sy
                 if (reg->scale != 0.0)
                     temp_reg /= reg->scale;
 
-                cJSON* send_body = cJSON_CreateObject();
-                if(send_body != NULL)
-                {
-                    char uri[512];
-                    sprintf(uri, "%s/%s", reg->uri, reg->reg_name);
-                    if(reg->is_bool)
-                        cJSON_AddBoolToObject(send_body, "value", (temp_reg == 1));
-                    else
-                        cJSON_AddNumberToObject(send_body, "value", temp_reg);
-                    char* body_msg = cJSON_PrintUnformatted(send_body);
-                    server_map->p_fims->Send("set", uri, NULL, body_msg);
-                    free(body_msg);
-                    cJSON_Delete(send_body);
-                }
+                if(reg->is_bool)
+                    server_map->set_add(reg, temp_reg == 1);
+                else
+                    server_map->set_add(reg, temp_reg);
                 i += reg->num_regs;
             }
         }
         // Let the modbus_reply handle error message
     }
     // else no extra work to be done let standard reply handle
+    // one set per uri for everything the request wrote
+    server_map->set_flush();
     return true;
 }
 
@@ -1239,24 +1414,30 @@ bool process_fims_message(fims_message* msg, server_data* server_map, system_con
                 FPS_ERROR_PRINT("Received pub not in uri list: %s.\n", msg->uri);
                 return false;
             }
-            cJSON* body_obj = cJSON_Parse(msg->body);
-            if(body_obj == NULL || body_obj->child == NULL)
-            {
-                if(body_obj != NULL)
-                    cJSON_Delete(body_obj);
+            if(msg->body == NULL)
                 return false;
-            }
-            for(cJSON* id_obj = body_obj->child; id_obj != NULL; id_obj = id_obj->next)
+            // pubs arrive at the rate of every component we mirror so they skip the cJSON tree.
+            // values are held until the whole body has scanned, a bad body changes nothing
+            static std::string key;
+            static std::vector<std::pair<std::pair<bool*, maps**>*, fims_value>> updates;
+            body_map* body = uri_it->second;
+            updates.clear();
+            body_scanner scan = {msg->body};
+            scan.skip_ws();
+            bool ok = *scan.p == '{' && scan.members([&](const char* id, size_t len, const fims_value& value) {
+                key.assign(id, len);
+                body_map::iterator body_it = body->find(key.c_str());
+                // Value not in our array ignore
+                if(body_it != body->end())
+                    updates.push_back({&body_it->second, value});
+            }, 0);
+            if(!ok)
             {
-                body_map::iterator body_it = uri_it->second->find(id_obj->string);
-                if(body_it == uri_it->second->end())
-                {
-                    // Value not in our array ignore
-                    continue;
-                }
-                update_variable_value(server_map->mb_mapping, body_it->second.first, body_it->second.second, id_obj, sys_cfg);
+                FPS_ERROR_PRINT("Received invalid json object for pub %s.\n", msg->uri);
+                return false;
             }
-            cJSON_Delete(body_obj);
+            for(auto& update : updates)
+                update_variable_value(server_map->mb_mapping, update.first->first, update.first->second, update.second, sys_cfg);
         }
         else
             // Not our message so ignore
@@ -1370,6 +1551,16 @@ bool haveInput(int fd, double timeout) {
 //    return false;
 // }
 
+// level triggered, a client with more than one request queued gets woken again
+static bool epoll_watch(int epoll_fd, int fd)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0 || errno == EEXIST;
+}
+
 /* Main Server */
 int main(int argc, char *argv[])
 {
@@ -1380,24 +1571,30 @@ int main(int argc, char *argv[])
 
     server_data *server_map = NULL;
     int header_length, serial_fd, fims_socket;
-    int fd_max = 0;
-    int reload_fd_max = 0;
     int rc = 0;
     int server_socket = -1;
     int fims_connect = 0;
-    fd_set all_connections;
-    fd_set rd_connections;
-    fd_set wr_connections;
-    fd_set er_connections;
-    FD_ZERO(&all_connections);
+    int num_events;
+    // epoll has no FD_SETSIZE cap and only hands back the fds that are ready.
+    // the clients stay registered across a reload
+    std::set<int> client_fds;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd == -1)
+    {
+        FPS_ERROR_PRINT("Failed to create epoll instance: %s.\n", strerror(errno));
+        return 1;
+    }
     system_config sys_cfg;
     memset(&sys_cfg, 0, sizeof(system_config));
     datalog data[Num_Register_Types];
     memset(data, 0, sizeof(datalog)*Num_Register_Types);
+    ModbusSim sim;
 
     do
     {
         reload = false; // initialize and reset if we reload
+        serial_fd = -1;
 
         // FPS_ERROR_PRINT("Reading config file and starting setup.\n");
         cJSON* config = get_config_json(argc, argv);
@@ -1437,11 +1634,18 @@ int main(int argc, char *argv[])
             cJSON_Delete(config);
             goto cleanup;
         }
+        if(!sim.parse(cJSON_GetObjectItem(config, "simulation")))
+        {
+            rc = 1;
+            cJSON_Delete(config);
+            goto cleanup;
+        }
         cJSON_Delete(config);
 
         // load the server map's URI array from the uri_to_register map.
         // must be done after register map creation to get a count of how many unique URIs there are.
         server_map->load_uri_array();
+        server_map->build_set_table(data);
 
         // configure Modbus mapping
         server_map->mb_mapping = modbus_mapping_new_start_address(data[Coil].start_offset, data[Coil].num_regs,
@@ -1461,6 +1665,13 @@ int main(int argc, char *argv[])
             goto cleanup;
         }
 
+        // the virtual devices start from the register image as configured
+        if(!sim.start(server_map, data, &sys_cfg))
+        {
+            rc = 1;
+            goto cleanup;
+        }
+
         server_map->p_fims = new fims();
         if (server_map->p_fims == NULL)
         {
@@ -1547,15 +1758,17 @@ int main(int argc, char *argv[])
                         
         }
 
-        fd_set connections_with_data;
         fims_socket = server_map->p_fims->get_socket();
-        serial_fd = -1;
         header_length = modbus_get_header_length(sys_cfg.mb);
 
         if(server_socket != -1)
         {
-            FD_SET(server_socket, &all_connections);
-            fd_max = server_socket;
+            if(!epoll_watch(epoll_fd, server_socket))
+            {
+                FPS_ERROR_PRINT("Failed to watch server socket: %s.\n", strerror(errno));
+                rc = 1;
+                goto cleanup;
+            }
         }
         else
         {
@@ -1566,57 +1779,38 @@ int main(int argc, char *argv[])
                 rc = 1;
                 goto cleanup;
             }
-            FD_SET(serial_fd, &all_connections);
-            fd_max = serial_fd;
+            if(!epoll_watch(epoll_fd, serial_fd))
+            {
+                FPS_ERROR_PRINT("Failed to watch serial file descriptor: %s.\n", strerror(errno));
+                rc = 1;
+                goto cleanup;
+            }
         }
 
-        if(fims_socket != -1)
-            FD_SET(fims_socket, &all_connections);
-        else
+        if(fims_socket == -1 || !epoll_watch(epoll_fd, fims_socket))
         {
             FPS_ERROR_PRINT("Failed to get fims socket.\n");
             rc = 1;
             goto cleanup;
         }
 
-        fd_max = (fd_max > fims_socket) ? fd_max: fims_socket;
-        if (fd_max < reload_fd_max) fd_max = reload_fd_max;
-
         running = true;
         FPS_ERROR_PRINT("Setup complete: Entering main loop.\n");
         while(running)
         {
-            connections_with_data = all_connections;
-            FD_ZERO(&rd_connections);
-            FD_ZERO(&wr_connections);
-            FD_ZERO(&er_connections);
-
-            // Select will block forever until one of the file descriptors has data
-            if(-1 == select(fd_max+1, &connections_with_data, &wr_connections, &er_connections, NULL))
+            // blocks until one of the fds has data, only the ready ones come back.
+            // a simulation wakes up for its next generator update or delayed reply
+            num_events = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, sim.poll(sys_cfg.mb));
+            if(num_events == -1)
             {
-                FPS_ERROR_PRINT("server select() failure: %s.\n", strerror(errno));
+                if(errno == EINTR)
+                    continue;
+                FPS_ERROR_PRINT("server epoll_wait() failure: %s.\n", strerror(errno));
                 break;
             }
-            //Loop through file descriptors to see which have data to read
-            for(int current_fd = 0; current_fd <= fd_max; current_fd++)
+            for(int event = 0; event < num_events; event++)
             {
-                // if no data on this file descriptor skip to the next one
-                if(!FD_ISSET(current_fd, &connections_with_data))
-                    continue;
-                if(FD_ISSET(current_fd, &er_connections))
-                {
-                    char message[1024];
-                    FPS_ERROR_PRINT("server select() error on fd : %d lets close it .\n", current_fd);
-                    snprintf(message, 1024, "Connection closed for fd  %d ", current_fd);
-                    emit_event(server_map->p_fims, "Modbus Server", message, 1);
-                    close(current_fd);
-                    FD_CLR(current_fd, &all_connections);
-                    FD_CLR(current_fd, &er_connections);
-                    if(current_fd == fd_max)
-                        fd_max--;
-                    continue;
-                }
-                
+                int current_fd = events[event].data.fd;
                 if(current_fd == server_socket)
                 {
                     // A new client is connecting to us
@@ -1632,11 +1826,15 @@ int main(int argc, char *argv[])
                         FPS_ERROR_PRINT("Error accepting new connections: %s\n", strerror(errno));
                         break;
                     }
+                    else if(!epoll_watch(epoll_fd, new_fd))
+                    {
+                        FPS_ERROR_PRINT("Error watching new connection: %s\n", strerror(errno));
+                        close(new_fd);
+                    }
                     else
                     {
                         char message[1024];
-                        FD_SET(new_fd, &all_connections);
-                        fd_max = (new_fd > fd_max) ? new_fd : fd_max;
+                        client_fds.insert(new_fd);
                         snprintf(message, 1024, "New connection from %s:%d on interface %s",
                         inet_ntoa(client_address.sin_addr), client_address.sin_port, sys_cfg.name);
                         FPS_ERROR_PRINT("%s\n", message);
@@ -1653,11 +1851,11 @@ int main(int argc, char *argv[])
                         {
                             // fims connection closed
                             FPS_ERROR_PRINT("Fims connection closed.\n");
-                            FD_CLR(current_fd, &all_connections);
+                            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, current_fd, NULL);
                             break;
                         }
                         else
-                            FPS_ERROR_PRINT("No fims message. Select led us to a bad place.\n");
+                            FPS_ERROR_PRINT("No fims message. Epoll led us to a bad place.\n");
                     }
                     else
                     {
@@ -1689,27 +1887,68 @@ int main(int argc, char *argv[])
                                                                                       sys_cfg.name, modbus_strerror(errno));
                         FPS_ERROR_PRINT("%s\n", message);
                         emit_event(server_map->p_fims, "Modbus Server", message, 1);
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, serial_fd, NULL);
                         modbus_close(sys_cfg.mb);
                         // likely redundant close
                         close(serial_fd);
-                        FD_CLR(current_fd, &all_connections);
-                        if(current_fd == fd_max)
-                            fd_max--;
+                        serial_fd = -1;
                         running = false;
                         break;
                     }
                 }
+                else if((events[event].events & EPOLLIN) == 0)
+                {
+                    // error or hang up with nothing left to read
+                    char message[1024];
+                    FPS_ERROR_PRINT("server epoll_wait() error on fd : %d lets close it .\n", current_fd);
+                    snprintf(message, 1024, "Connection closed for fd  %d ", current_fd);
+                    emit_event(server_map->p_fims, "Modbus Server", message, 1);
+                    close(current_fd);
+                    client_fds.erase(current_fd);
+                    sim.forget_client(current_fd);
+                }
                 else
                 {
                     // incoming tcp modbus communication
                     modbus_set_socket(sys_cfg.mb, current_fd);
-                    modbus_set_debug(sys_cfg.mb, 1);
+                    // a frame dump per transaction would swamp a simulation
+                    modbus_set_debug(sys_cfg.mb, !sim.enabled());
 
                     uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
 
                     rc = modbus_receive(sys_cfg.mb, query);
                     //printf(" got message from slave [%d]\n",sys_cfg.mb->slave);
-                    if (rc > 0)
+                    if (rc > 0 && sim.enabled())
+                    {
+                        // the unit id ends the mbap header
+                        int unit_id = query[header_length - 1];
+                        modbus_mapping_t* mapping = sim.mapping(unit_id);
+                        ModbusSim::Action action = sim.on_request(query, header_length);
+                        if(mapping == NULL || action.drop)
+                        {
+                            // no such device, or a timeout. the client hears nothing
+                            sim.count_drop();
+                        }
+                        else
+                        {
+                            // only the base device writes through to fims, and not when the write is refused
+                            if(sim.is_base(unit_id) && action.exception == 0)
+                                process_modbus_message(rc, header_length, data, &sys_cfg, server_map, false, query);
+                            if(action.delay > 0.0)
+                                sim.defer(current_fd, mapping, query, rc, action);
+                            else if(action.exception != 0)
+                            {
+                                modbus_reply_exception(sys_cfg.mb, query, action.exception);
+                                sim.count_reply(true);
+                            }
+                            else
+                            {
+                                modbus_reply(sys_cfg.mb, query, rc, mapping);
+                                sim.count_reply(false);
+                            }
+                        }
+                    }
+                    else if (rc > 0)
                     {
                         bool send_reply = true;
                         process_modbus_message(rc, header_length, data, &sys_cfg, server_map, false, query);
@@ -1758,9 +1997,8 @@ int main(int argc, char *argv[])
                         FPS_ERROR_PRINT("%s\n", message);
                         emit_event(server_map->p_fims, "Modbus Server", message, 1);
                         close(current_fd);
-                        FD_CLR(current_fd, &all_connections);
-                        if(current_fd == fd_max)
-                            fd_max--;
+                        client_fds.erase(current_fd);
+                        sim.forget_client(current_fd);
                     }
                 }
             }
@@ -1770,6 +2008,8 @@ int main(int argc, char *argv[])
 
         cleanup:
 
+        // the virtual devices and queued replies go before the register image they were copied from
+        sim.stop();
         if(sys_cfg.eth_dev       != NULL) free(sys_cfg.eth_dev);
         if(sys_cfg.ip_address    != NULL) free(sys_cfg.ip_address);
         if(sys_cfg.service       != NULL) free(sys_cfg.service);
@@ -1799,32 +2039,30 @@ int main(int argc, char *argv[])
             if(server_map->p_fims != NULL)
             {
                 if(server_map->p_fims->Connected() == true)
-                {
-                    FD_CLR(server_map->p_fims->get_socket(), &all_connections);
                     server_map->p_fims->Close();
-                }
                 delete server_map->p_fims;
             }
             if(server_map->mb_mapping != NULL)
                 modbus_mapping_free(server_map->mb_mapping);
             delete server_map;
         }
-        if (reload)
+        // a reload opens its own listening socket and serial context, the tcp clients stay connected
+        if(server_socket != -1)
         {
-            reload_fd_max = fd_max; // record it
+            closeSocket(server_socket);
+            server_socket = -1;
         }
-        for(int fd = 0; fd < fd_max; fd++) {
-            if (FD_ISSET(fd, &all_connections)) {
-                if (!reload)
-                {
-                    closeSocket(fd);
-                    FD_CLR(fd, &all_connections);
-                }
-            }
+        if(serial_fd != -1)
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, serial_fd, NULL);
+        if (!reload)
+        {
+            for(int fd : client_fds)
+                closeSocket(fd);
+            client_fds.clear();
         }
-        if (!reload) FD_ZERO(&all_connections);
     } while (reload);
 
+    close(epoll_fd);
     return rc;
 }
 
@@ -1840,3 +2078,88 @@ void sdata::load_uri_array()
     for(auto it = uri_to_register.begin(); it != uri_to_register.end(); ++it, i++)
         uris[i] = it->first;
 }
+
+/**
+ * @brief Fills set_slots, set_uris and set_keys from the register map. Registers of a type that was not
+ * in this config get no slots.
+ */
+void sdata::build_set_table(datalog* data)
+{
+    std::map<const char*, int, char_cmp> uri_index;
+    set_uris.clear();
+    set_keys.clear();
+    set_touched.clear();
+    for(int i = 0; i < Num_Register_Types; i++)
+    {
+        set_slots[i].clear();
+        if(regs_to_map[i] == NULL)
+            continue;
+        set_slots[i].assign(data[i].num_regs, set_slot{-1, 0, 0});
+        for(unsigned int j = 0; j < data[i].map_size; j++)
+        {
+            maps* reg = &data[i].register_map[j];
+            auto uri_it = uri_index.insert(std::make_pair(reg->uri, (int)set_uris.size())).first;
+            if(uri_it->second == (int)set_uris.size())
+                set_uris.push_back(reg->uri);
+            set_slot& slot = set_slots[i][reg->reg_off];
+            slot.uri = uri_it->second;
+            slot.key_at = set_keys.size();
+            set_keys += '"';
+            set_keys += reg->reg_name;
+            set_keys += "\":";
+            slot.key_len = set_keys.size() - slot.key_at;
+        }
+    }
+    set_bodies.assign(set_uris.size(), std::string());
+}
+
+/**
+ * @brief Starts reg's entry in the body for its uri, {"id":{"value": so far. NULL if reg has no slot.
+ */
+static std::string* set_body(server_data* srv, const maps* reg)
+{
+    std::vector<set_slot>& slots = srv->set_slots[reg->reg_type];
+    if(reg->reg_off >= slots.size() || slots[reg->reg_off].uri < 0)
+        return NULL;
+    const set_slot& slot = slots[reg->reg_off];
+    std::string& body = srv->set_bodies[slot.uri];
+    if(body.empty())
+    {
+        srv->set_touched.push_back(slot.uri);
+        body += '{';
+    }
+    else
+        body += ',';
+    body.append(srv->set_keys, slot.key_at, slot.key_len);
+    body += "{\"value\":";
+    return &body;
+}
+
+void sdata::set_add(const maps* reg, bool value)
+{
+    std::string* body = set_body(this, reg);
+    if(body != NULL)
+        *body += value ? "true}" : "false}";
+}
+
+void sdata::set_add(const maps* reg, double value)
+{
+    std::string* body = set_body(this, reg);
+    if(body == NULL)
+        return;
+    append_number(*body, value);
+    *body += '}';
+}
+
+void sdata::set_flush()
+{
+    for(int uri : set_touched)
+    {
+        std::string& body = set_bodies[uri];
+        body += '}';
+        p_fims->Send("set", set_uris[uri].c_str(), NULL, body.c_str());
+        // keeps its capacity for the next request
+        body.clear();
+    }
+    set_touched.clear();
+}
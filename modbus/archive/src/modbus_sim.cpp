@@ -0,0 +1,547 @@
+/*
+ * modbus_sim.cpp
+ *
+ * scripted device simulation for modbus_server, see modbus_sim.h
+ */
+#include <stdio.h>
+#include <climits>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+#include <cjson/cJSON.h>
+#include <fims/fps_utils.h>
+#include <fims/libfims.h>
+#include <modbus/modbus.h>
+#include "modbus_sim.h"
+
+static double sim_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double get_number(cJSON* obj, const char* name, double def)
+{
+    cJSON* item = cJSON_GetObjectItem(obj, name);
+    return cJSON_IsNumber(item) ? item->valuedouble : def;
+}
+
+// holding_registers or input_registers for the generators, any of the four for the faults
+static int get_reg_type(cJSON* obj, bool writable_only)
+{
+    cJSON* type = cJSON_GetObjectItem(obj, "type");
+    if(!cJSON_IsString(type))
+        return -1;
+    if(strcmp(type->valuestring, "holding_registers") == 0)
+        return Holding_Register;
+    if(strcmp(type->valuestring, "input_registers") == 0)
+        return Input_Register;
+    if(writable_only)
+        return -1;
+    if(strcmp(type->valuestring, "coils") == 0)
+        return Coil;
+    if(strcmp(type->valuestring, "discrete_inputs") == 0)
+        return Discrete_Input;
+    return -1;
+}
+
+bool ModbusSim::parse(cJSON* sim_obj)
+{
+    configured = false;
+    generators.clear();
+    faults.clear();
+    if(sim_obj == NULL)
+        return true;
+    if(!cJSON_IsObject(sim_obj))
+    {
+        FPS_ERROR_PRINT("simulation must be an object.\n");
+        return false;
+    }
+
+    rate = get_number(sim_obj, "rate", 1.0);
+    report_interval = get_number(sim_obj, "report_interval", 10.0);
+    seed = (unsigned int)get_number(sim_obj, "seed", 1);
+    first_device_id = (int)get_number(sim_obj, "first_device_id", -1);
+    num_devices = (int)get_number(sim_obj, "num_devices", 0);
+    if(rate <= 0.0 || report_interval <= 0.0)
+    {
+        FPS_ERROR_PRINT("simulation rate and report_interval must be greater than 0.\n");
+        return false;
+    }
+    if(num_devices < 0 || num_devices > 247 || (num_devices > 0 && (first_device_id < 0 || first_device_id + num_devices > 256)))
+    {
+        FPS_ERROR_PRINT("simulation devices %d .. %d are not valid unit ids.\n", first_device_id, first_device_id + num_devices - 1);
+        return false;
+    }
+
+    cJSON* gens = cJSON_GetObjectItem(sim_obj, "generators");
+    for(int i = 0; i < cJSON_GetArraySize(gens); i++)
+    {
+        cJSON* obj = cJSON_GetArrayItem(gens, i);
+        cJSON* kind = cJSON_GetObjectItem(obj, "kind");
+        cJSON* offset = cJSON_GetObjectItem(obj, "offset");
+        Generator gen;
+        gen.reg_type = get_reg_type(obj, true);
+        if(gen.reg_type == -1 || !cJSON_IsNumber(offset) || offset->valueint < 0 || !cJSON_IsString(kind))
+        {
+            FPS_ERROR_PRINT("simulation generator %d needs a type of holding_registers or input_registers, an offset and a kind.\n", i);
+            return false;
+        }
+        gen.offset = offset->valueint;
+        if(strcmp(kind->valuestring, "ramp") == 0)
+            gen.kind = Ramp;
+        else if(strcmp(kind->valuestring, "sine") == 0)
+            gen.kind = Sine;
+        else if(strcmp(kind->valuestring, "random_walk") == 0)
+            gen.kind = Random_Walk;
+        else if(strcmp(kind->valuestring, "csv") == 0)
+            gen.kind = Csv;
+        else
+        {
+            FPS_ERROR_PRINT("simulation generator %d has unknown kind %s.\n", i, kind->valuestring);
+            return false;
+        }
+        gen.min       = get_number(obj, "min", 0.0);
+        gen.max       = get_number(obj, "max", 100.0);
+        gen.period    = get_number(obj, "period", 60.0);
+        gen.center    = get_number(obj, "center", (gen.min + gen.max) / 2);
+        gen.amplitude = get_number(obj, "amplitude", (gen.max - gen.min) / 2);
+        gen.step      = get_number(obj, "step", 1.0);
+        gen.column    = (int)get_number(obj, "column", 0);
+        if(gen.period <= 0.0 || gen.max < gen.min)
+        {
+            FPS_ERROR_PRINT("simulation generator %d needs a period greater than 0 and min no more than max.\n", i);
+            return false;
+        }
+        if(gen.kind == Csv)
+        {
+            cJSON* file = cJSON_GetObjectItem(obj, "file");
+            if(!cJSON_IsString(file))
+            {
+                FPS_ERROR_PRINT("simulation generator %d needs a csv file.\n", i);
+                return false;
+            }
+            gen.file = file->valuestring;
+        }
+        generators.push_back(gen);
+    }
+
+    cJSON* fault_list = cJSON_GetObjectItem(sim_obj, "faults");
+    for(int i = 0; i < cJSON_GetArraySize(fault_list); i++)
+    {
+        cJSON* obj = cJSON_GetArrayItem(fault_list, i);
+        cJSON* offset = cJSON_GetObjectItem(obj, "offset");
+        Fault fault;
+        fault.reg_type = get_reg_type(obj, false);
+        if(fault.reg_type == -1 || !cJSON_IsNumber(offset) || offset->valueint < 0)
+        {
+            FPS_ERROR_PRINT("simulation fault %d needs a register type and an offset.\n", i);
+            return false;
+        }
+        fault.first = offset->valueint;
+        fault.last = fault.first + (unsigned int)get_number(obj, "num", 1) - 1;
+
+        cJSON* latency = cJSON_GetObjectItem(obj, "latency");
+        fault.has_latency = latency != NULL;
+        fault.dist = Fixed;
+        fault.mean   = get_number(latency, "mean", 0.0);
+        fault.stddev = get_number(latency, "stddev", 0.0);
+        fault.min    = get_number(latency, "min", 0.0);
+        fault.max    = get_number(latency, "max", fault.mean);
+        cJSON* dist = cJSON_GetObjectItem(latency, "dist");
+        if(cJSON_IsString(dist))
+        {
+            if(strcmp(dist->valuestring, "fixed") == 0)
+                fault.dist = Fixed;
+            else if(strcmp(dist->valuestring, "uniform") == 0)
+                fault.dist = Uniform;
+            else if(strcmp(dist->valuestring, "normal") == 0)
+                fault.dist = Normal;
+            else if(strcmp(dist->valuestring, "exponential") == 0)
+                fault.dist = Exponential;
+            else
+            {
+                FPS_ERROR_PRINT("simulation fault %d has unknown latency dist %s.\n", i, dist->valuestring);
+                return false;
+            }
+        }
+
+        fault.timeout_rate = get_number(obj, "timeout_rate", 0.0);
+        fault.exception = (int)get_number(obj, "exception", 0);
+        // an exception without a rate is always sent
+        fault.exception_rate = get_number(obj, "exception_rate", fault.exception != 0 ? 1.0 : 0.0);
+        if(fault.exception < 0 || fault.exception > 0xff)
+        {
+            FPS_ERROR_PRINT("simulation fault %d exception %d is not an exception code.\n", i, fault.exception);
+            return false;
+        }
+        faults.push_back(fault);
+    }
+
+    configured = true;
+    return true;
+}
+
+bool ModbusSim::start(server_data* srv_map, datalog* srv_data, system_config* cfg)
+{
+    if(!configured)
+        return true;
+    server_map = srv_map;
+    data = srv_data;
+    sys_cfg = cfg;
+
+    for(size_t i = 0; i < generators.size(); i++)
+    {
+        Generator& gen = generators[i];
+        datalog& dl = data[gen.reg_type];
+        if(gen.offset < dl.start_offset || gen.offset >= dl.start_offset + dl.num_regs)
+        {
+            FPS_ERROR_PRINT("simulation generator %zu offset %u is outside the %s in the register map.\n",
+                            i, gen.offset, gen.reg_type == Holding_Register ? "holding registers" : "input registers");
+            return false;
+        }
+        if(gen.kind == Csv)
+        {
+            std::ifstream in(gen.file);
+            if(!in)
+            {
+                FPS_ERROR_PRINT("simulation failed to open csv file %s.\n", gen.file.c_str());
+                return false;
+            }
+            // rows without a number in the column, like a header, are skipped
+            std::string line;
+            while(std::getline(in, line))
+            {
+                std::stringstream row(line);
+                std::string cell;
+                for(int col = 0; std::getline(row, cell, ','); col++)
+                {
+                    if(col != gen.column)
+                        continue;
+                    char* end;
+                    double val = strtod(cell.c_str(), &end);
+                    if(end != cell.c_str())
+                        gen.samples.push_back(val);
+                    break;
+                }
+            }
+            if(gen.samples.empty())
+            {
+                FPS_ERROR_PRINT("simulation csv file %s has no numbers in column %d.\n", gen.file.c_str(), gen.column);
+                return false;
+            }
+        }
+    }
+
+    // the base device is the one fims sees, the others get a copy of its registers
+    if(num_devices == 0)
+    {
+        base_id = sys_cfg->device_id;
+        devices.push_back(server_map->mb_mapping);
+    }
+    else
+    {
+        bool in_range = sys_cfg->device_id >= first_device_id && sys_cfg->device_id < first_device_id + num_devices;
+        base_id = in_range ? sys_cfg->device_id : first_device_id;
+        modbus_mapping_t* base = server_map->mb_mapping;
+        for(int id = first_device_id; id < first_device_id + num_devices; id++)
+        {
+            if(id == base_id)
+            {
+                devices.push_back(base);
+                continue;
+            }
+            modbus_mapping_t* map = modbus_mapping_new_start_address(data[Coil].start_offset, data[Coil].num_regs,
+                                        data[Discrete_Input].start_offset,   data[Discrete_Input].num_regs,
+                                        data[Holding_Register].start_offset, data[Holding_Register].num_regs,
+                                        data[Input_Register].start_offset,   data[Input_Register].num_regs);
+            if(map == NULL)
+            {
+                FPS_ERROR_PRINT("simulation failed to allocate the mapping for device %d: %s\n", id, modbus_strerror(errno));
+                return false;
+            }
+            memcpy(map->tab_bits,            base->tab_bits,            base->nb_bits * sizeof(uint8_t));
+            memcpy(map->tab_input_bits,      base->tab_input_bits,      base->nb_input_bits * sizeof(uint8_t));
+            memcpy(map->tab_registers,       base->tab_registers,       base->nb_registers * sizeof(uint16_t));
+            memcpy(map->tab_input_registers, base->tab_input_registers, base->nb_input_registers * sizeof(uint16_t));
+            devices.push_back(map);
+        }
+    }
+    for(size_t i = 0; i < generators.size(); i++)
+        if(generators[i].kind == Random_Walk)
+            generators[i].walk.assign(devices.size(), (generators[i].min + generators[i].max) / 2);
+
+    rng.seed(seed);
+    t_start = sim_now();
+    next_update = t_start;
+    last_report = t_start;
+    next_report = t_start + report_interval;
+    ticks = 0;
+    replies = exceptions = dropped = delayed = 0;
+    running = true;
+    FPS_RELEASE_PRINT("Simulation started: %zu devices, %zu generators every %g s, %zu fault rules.\n",
+                      devices.size(), generators.size(), rate, faults.size());
+    return true;
+}
+
+void ModbusSim::stop()
+{
+    for(size_t i = 0; i < devices.size(); i++)
+        if(server_map == NULL || devices[i] != server_map->mb_mapping)
+            modbus_mapping_free(devices[i]);
+    devices.clear();
+    while(!pending.empty())
+        pending.pop();
+    running = false;
+    server_map = NULL;
+    data = NULL;
+    sys_cfg = NULL;
+}
+
+modbus_mapping_t* ModbusSim::mapping(int unit_id)
+{
+    if(num_devices == 0)
+        return devices[0];
+    if(unit_id < first_device_id || unit_id >= first_device_id + num_devices)
+        return NULL;
+    return devices[unit_id - first_device_id];
+}
+
+bool ModbusSim::is_base(int unit_id) const
+{
+    return num_devices == 0 || unit_id == base_id;
+}
+
+ModbusSim::Action ModbusSim::on_request(const uint8_t* query, int header_length)
+{
+    Action action = {0.0, false, 0};
+    if(faults.empty())
+        return action;
+
+    const uint8_t* pdu = query + header_length;
+    int reg_type;
+    unsigned int first = (pdu[1] << 8) + pdu[2];
+    unsigned int count = (pdu[3] << 8) + pdu[4];
+    switch(pdu[0])
+    {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_WRITE_MULTIPLE_COILS:
+            reg_type = Coil;
+            break;
+        case MODBUS_FC_WRITE_SINGLE_COIL:
+            reg_type = Coil;
+            count = 1;
+            break;
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+            reg_type = Discrete_Input;
+            break;
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+            reg_type = Input_Register;
+            break;
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+            reg_type = Holding_Register;
+            break;
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+        case MODBUS_FC_MASK_WRITE_REGISTER:
+            reg_type = Holding_Register;
+            count = 1;
+            break;
+        default:
+            return action;
+    }
+    if(count == 0)
+        count = 1;
+
+    for(size_t i = 0; i < faults.size(); i++)
+    {
+        const Fault& fault = faults[i];
+        if(fault.reg_type != reg_type || first > fault.last || first + count - 1 < fault.first)
+            continue;
+
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        if(fault.timeout_rate > 0.0 && chance(rng) < fault.timeout_rate)
+        {
+            action.drop = true;
+            return action;
+        }
+        if(fault.exception != 0 && chance(rng) < fault.exception_rate)
+            action.exception = fault.exception;
+        if(fault.has_latency)
+        {
+            double ms = fault.mean;
+            switch(fault.dist)
+            {
+                case Fixed:
+                    break;
+                case Uniform:
+                    ms = std::uniform_real_distribution<double>(fault.min, fault.max)(rng);
+                    break;
+                case Normal:
+                    ms = std::normal_distribution<double>(fault.mean, fault.stddev)(rng);
+                    break;
+                case Exponential:
+                    ms = fault.mean > 0.0 ? std::exponential_distribution<double>(1.0 / fault.mean)(rng) : 0.0;
+                    break;
+            }
+            action.delay = ms > 0.0 ? ms / 1000.0 : 0.0;
+        }
+        return action;
+    }
+    return action;
+}
+
+void ModbusSim::defer(int fd, modbus_mapping_t* map, const uint8_t* query, int len, const Action& action)
+{
+    Deferred reply;
+    reply.due = sim_now() + action.delay;
+    reply.order = num_queued++;
+    reply.fd = fd;
+    reply.fd_gen = fd_gens[fd];
+    reply.map = map;
+    reply.len = len;
+    reply.exception = action.exception;
+    reply.query.assign(query, query + len);
+    pending.push(reply);
+    delayed++;
+}
+
+void ModbusSim::forget_client(int fd)
+{
+    // a reused fd is a new client, the replies queued for the old one are not sent
+    fd_gens[fd]++;
+}
+
+void ModbusSim::count_reply(bool exception)
+{
+    replies++;
+    if(exception)
+        exceptions++;
+}
+
+void ModbusSim::count_drop()
+{
+    dropped++;
+}
+
+double ModbusSim::value(Generator& gen, double t, int device)
+{
+    // the devices are spread over one period
+    double shift = (double)device / devices.size();
+    switch(gen.kind)
+    {
+        case Ramp:
+            return gen.min + (gen.max - gen.min) * fmod(t / gen.period + shift, 1.0);
+        case Sine:
+            return gen.center + gen.amplitude * sin(2 * M_PI * (t / gen.period + shift));
+        case Random_Walk:
+        {
+            double& walk = gen.walk[device];
+            walk += std::uniform_real_distribution<double>(-gen.step, gen.step)(rng);
+            walk = walk < gen.min ? gen.min : walk > gen.max ? gen.max : walk;
+            return walk;
+        }
+        case Csv:
+            return gen.samples[(ticks + device) % gen.samples.size()];
+    }
+    return 0.0;
+}
+
+void ModbusSim::write(modbus_mapping_t* map, const Generator& gen, double val)
+{
+    uint16_t* regs = gen.reg_type == Holding_Register ? map->tab_registers : map->tab_input_registers;
+    unsigned int reg_off = gen.offset - data[gen.reg_type].start_offset;
+    maps* settings = server_map->regs_to_map[gen.reg_type][reg_off];
+    if(settings != NULL && settings->reg_off == reg_off)
+    {
+        // scaled and sized like a fims set of the variable
+        fims_value fval;
+        fval.valuedouble = val;
+        fval.valueint = val >= INT_MAX ? INT_MAX : val <= INT_MIN ? INT_MIN : (int)val;
+        fval.is_true = val != 0.0;
+        update_holding_or_input_register_value(settings, fval, regs, sys_cfg);
+    }
+    else
+        regs[reg_off] = (uint16_t)(int32_t)val;
+}
+
+void ModbusSim::update(double now)
+{
+    double t = now - t_start;
+    for(size_t i = 0; i < generators.size(); i++)
+        for(size_t d = 0; d < devices.size(); d++)
+            write(devices[d], generators[i], value(generators[i], t, d));
+    ticks++;
+}
+
+void ModbusSim::report(double now)
+{
+    double span = now - last_report;
+    double tps = span > 0.0 ? replies / span : 0.0;
+    FPS_RELEASE_PRINT("Simulation %s: %.1f transactions/s over %zu devices, %lu exceptions, %lu dropped, %lu delayed, %zu queued.\n",
+                      sys_cfg->name, tps, devices.size(), (unsigned long)exceptions, (unsigned long)dropped,
+                      (unsigned long)delayed, pending.size());
+    if(server_map->p_fims != NULL && server_map->p_fims->Connected() && server_map->base_uri != NULL)
+    {
+        char uri[256];
+        char body[512];
+        snprintf(uri, sizeof(uri), "%s/_simulation", server_map->base_uri);
+        snprintf(body, sizeof(body), "{\"transactions_per_second\":%.1f,\"transactions\":%lu,\"exceptions\":%lu,"
+                 "\"dropped\":%lu,\"delayed\":%lu,\"devices\":%zu}",
+                 tps, (unsigned long)replies, (unsigned long)exceptions, (unsigned long)dropped,
+                 (unsigned long)delayed, devices.size());
+        server_map->p_fims->Send("pub", uri, NULL, body);
+    }
+    replies = exceptions = dropped = delayed = 0;
+    last_report = now;
+}
+
+int ModbusSim::poll(modbus_t* mb)
+{
+    if(!running)
+        return -1;
+    double now = sim_now();
+
+    if(now >= next_update)
+    {
+        update(now);
+        next_update += rate;
+        // fell behind, skip the missed updates rather than run them back to back
+        if(next_update < now)
+            next_update = now + rate;
+    }
+
+    while(!pending.empty() && pending.top().due <= now)
+    {
+        const Deferred& reply = pending.top();
+        if(reply.fd_gen == fd_gens[reply.fd])
+        {
+            modbus_set_socket(mb, reply.fd);
+            if(reply.exception != 0)
+                modbus_reply_exception(mb, reply.query.data(), reply.exception);
+            else
+                modbus_reply(mb, reply.query.data(), reply.len, reply.map);
+            count_reply(reply.exception != 0);
+        }
+        pending.pop();
+    }
+
+    if(now >= next_report)
+    {
+        report(now);
+        next_report += report_interval;
+        if(next_report < now)
+            next_report = now + report_interval;
+    }
+
+    double next = next_update < next_report ? next_update : next_report;
+    if(!pending.empty() && pending.top().due < next)
+        next = pending.top().due;
+    // round up so the wait does not come back just short of it
+    return next > now ? (int)ceil((next - now) * 1000.0) : 0;
+}
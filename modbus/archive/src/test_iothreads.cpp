@@ -19,6 +19,15 @@
 #include "logger/logger.h"
 #include "gcom_config.h"
 #include "gcom_iothread.h"
+#include "gcom_poll_planner.h"
+#include "gcom_device_health.h"
+#include "gcom_pipeline.h"
+#include "gcom_reactor.h"
+#include "gcom_decode_kernel.h"
+#include "gcom_block_decode.h"
+#include "gcom_map_index.h"
+#include "gcom_pub_layout.h"
+#include "gcom_set_batch.h"
 
 #define BAD_DATA_ADDRESS 112345680
 
@@ -90,16 +99,15 @@ void responseThreadFunc(ThreadControl& control,struct cfg& myCfg);
 
 struct IO_Work;
 // Global Channel Definitions
-ioChannel<std::shared_ptr<IO_Work>> io_pollChan;      // Use Channel to send IO-Work to thread
-ioChannel<std::shared_ptr<IO_Work>> io_setChan;      // Use Channel to send IO-Work to thread
-ioChannel<std::shared_ptr<IO_Work>> io_responseChan;  // Thread picks up IO_work and processes it
-ioChannel<std::shared_ptr<IO_Work>> io_poolChan;      // Response channel returns io_work to the pool
+ioChannel<IO_WorkHandle> io_pollChan;      // Use Channel to send IO-Work to thread
+ioChannel<IO_WorkHandle> io_setChan;      // Use Channel to send IO-Work to thread
+ioChannel<IO_WorkHandle> io_responseChan;  // Thread picks up IO_work and processes it
 ioChannel<int> io_threadChan;                         // Thread Control 
+IO_WorkPool ioWorkPool;                               // Response thread returns io_work to the pool
 
 struct ThreadControl {
-    ioChannel<std::shared_ptr<IO_Work>>* io_pollChan;      // Use Channel to send IO-Work to thread
-    ioChannel<std::shared_ptr<IO_Work>>* io_responseChan;  // Thread picks up IO_work and processes it
-    ioChannel<std::shared_ptr<IO_Work>>* io_poolChan;      // Response channel returns io_work to the pool
+    ioChannel<IO_WorkHandle>* io_pollChan;      // Use Channel to send IO-Work to thread
+    ioChannel<IO_WorkHandle>* io_responseChan;  // Thread picks up IO_work and processes it
 
     bool ioThreadRunning = true;
     bool responseThreadRunning = true;
@@ -130,6 +138,7 @@ struct ThreadControl {
 };
 
 ThreadControl threadControl;
+MbReactorGroup ioReactors;                            // used instead of the io_threads when connection.reactor_threads > 0
 
 
 double get_time_double();
@@ -154,7 +163,8 @@ bool compare_by_offset(const IO_Work& a, const IO_Work& b) {
 }
 
 //std::vector<std::unique_ptr<IO_Work>> 
-bool compact_io_works(std::vector<std::unique_ptr<IO_Work>>& compacted,std::vector<std::unique_ptr<IO_Work>>& io_works) {
+// ranges separated by up to max_gap registers are merged when the device cost model says the gap is cheaper than another transaction
+bool compact_io_works(std::vector<std::unique_ptr<IO_Work>>& compacted,std::vector<std::unique_ptr<IO_Work>>& io_works, int max_gap = 0) {
     //std::vector<std::unique_ptr<IO_Work>> compacted;
 
     // 1. Group IO_Work by device_id and reg_type, and sort by offset within each group
@@ -165,10 +175,12 @@ bool compact_io_works(std::vector<std::unique_ptr<IO_Work>>& compacted,std::vect
         grouped_works[{work->device_id, work->reg_type}].push_back(std::move(work));
     }
 
+    static const std::vector<int> no_bad_regs;
     for (auto& [key, group] : grouped_works) {
         std::sort(group.begin(), group.end(), [](const std::unique_ptr<IO_Work>& a, const std::unique_ptr<IO_Work>& b) {
             return a->offset < b->offset;
         });
+        double gap_limit = pollPlanner.gap_limit(key.first);
 
         // 2. Merge Overlapping and Contiguous Ranges
         for (size_t i = 0; i < group.size(); ++i) {
@@ -184,13 +196,15 @@ bool compact_io_works(std::vector<std::unique_ptr<IO_Work>>& compacted,std::vect
                     continue;
                 }
                 
-                // Check for contiguous and combinable range
-                if (merged->offset + merged->num_registers == group[j]->offset &&
-                    merged->num_registers + group[j]->num_registers <= 125) {
+                // Check for contiguous ( or cheap gap ) and combinable range
+                if (PollPlanner::can_merge(merged->reg_type, merged->offset, merged->offset + merged->num_registers,
+                                           group[j]->offset, group[j]->offset + group[j]->num_registers,
+                                           max_gap, gap_limit, no_bad_regs)) {
                     // Merge operation (for buf8 and buf16 as necessary)
                     // memcpy(merged->buf8 + merged->num_registers, group[j]->buf8, group[j]->num_registers);
                     // memcpy(merged->buf16 + merged->num_registers, group[j]->buf16, group[j]->num_registers * sizeof(u16));
-                    merged->num_registers += group[j]->num_registers;
+                    merged->num_registers = std::max(merged->offset + merged->num_registers,
+                                                     group[j]->offset + group[j]->num_registers) - merged->offset;
                     j++;
                 } else {
                     // Break if neither contained nor contiguous and combinable
@@ -647,7 +661,7 @@ void test_compact_io_works() {
 double SetupModbusForThread(std::shared_ptr<IO_Thread> io_thread, bool debug);
 
 
-void runThreadError(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work> io_work, int &io_tries, int &max_io_tries, bool debug) {
+void runThreadError(std::shared_ptr<IO_Thread> io_thread, IO_WorkHandle io_work, int &io_tries, int &max_io_tries, bool debug) {
     io_thread->fails++;
 
     if (io_thread->ctx == nullptr && io_thread->ip != "")
@@ -819,7 +833,7 @@ void runThreadError(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Wor
 
 }
 //process_io_range
-void runThreadWork(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work> io_work, bool debug) {
+void runThreadWork(std::shared_ptr<IO_Thread> io_thread, IO_WorkHandle io_work, bool debug) {
     io_work->tIo = get_time_double();
     io_work->threadId = io_thread->tid;
     io_thread->jobs++;
@@ -842,7 +856,8 @@ void runThreadWork(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work
         //                                    set_errors = modbus_write_registers(my_workspace.ctx, curr_decode.offset, curr_decode.flags.get_size(), set_buffer);
         // Register_Types::Coil:              set_errors = modbus_write_bit(my_workspace.ctx, offset, val.set_val.u == 1UL);
     int io_tries = 0;
-    int max_io_tries = 10;
+    // a sick device gets one try, its timeouts should not hold this thread for the others
+    int max_io_tries = deviceHealth.max_tries(io_work->device_id, 10);
     while (io_tries < max_io_tries)
     {
         io_tries++;
@@ -970,6 +985,10 @@ void runThreadWork(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work
 
         // }
         io_work->tRun = tRun;
+        // good reads train the poll planner cost model for this device
+        if (io_work->errors > 0 && io_work->wtype == WorkTypes::Get) {
+            pollPlanner.record_io(io_work->device_id, io_work->reg_type, io_work->num_registers, tRun);
+        }
         if (1 || debug || io_work->errors < 0) {
             std::lock_guard<std::mutex> lock2(io_output_mutex); 
             if (io_work->errors < 0) {
@@ -1013,17 +1032,133 @@ void runThreadWork(std::shared_ptr<IO_Thread> io_thread, std::shared_ptr<IO_Work
     io_responseChan.send(std::move(io_work));
 }
 
+// the pipelined engine has no ctx to repair, a dead or stuck connection is closed and
+// runThreadPipeline reconnects with a backoff
+void runPipelineError(std::shared_ptr<IO_Thread> io_thread, IO_WorkHandle io_work, int &timeouts, bool debug) {
+    io_thread->fails++;
+    if (io_work->errno_code == ETIMEDOUT) {
+        // the server may have stopped answering without dropping the socket
+        if (++timeouts >= io_thread->pipeline_depth * 2 && io_thread->pipe->is_open()) {
+            std::lock_guard<std::mutex> lock2(io_output_mutex); 
+            FPS_ERROR_LOG("thread_id %d  %d timeouts in a row, dropping the connection",
+                io_thread->tid, timeouts);
+            io_thread->pipe->close();
+            timeouts = 0;
+        }
+    }
+    std::lock_guard<std::mutex> lock2(io_output_mutex); 
+    FPS_ERROR_LOG("thread_id %d type %d offset %d error %d code  %d -> %s ",
+            io_thread->tid, (int)io_work->reg_type, io_work->offset,
+            io_work->errors, io_work->errno_code, modbus_strerror(io_work->errno_code) );
+}
+
+// keeps up to pipeline_depth requests in flight on one socket, used in place of runThreadWork
+// failed transactions go straight to the response thread, the next poll cycle asks again
+void runThreadPipeline(ThreadControl& control, std::shared_ptr<IO_Thread> io_thread, bool debug) {
+    std::vector<IO_WorkHandle> done;
+    IO_WorkHandle io_work;
+    int signal;
+    bool run = true;
+    int timeouts = 0;
+    double backoff = 0.2;
+    double tRetry = 0.0;
+
+    io_thread->pipe = new MbPipeline(io_thread->pipeline_depth, io_thread->connection_timeout);
+    auto pipe = io_thread->pipe;
+
+    while (run && control.ioThreadRunning) {
+        // the signals are only there to wake idle threads, don't let them pile up
+        while (io_threadChan.peekpop(signal)) {
+            if (signal == 0)
+                run = false;
+        }
+
+        double tNow = get_time_double();
+        if (!pipe->is_open() && tNow >= tRetry) {
+            if (pipe->open(io_thread->ip, io_thread->port, io_thread->connection_timeout)) {
+                io_thread->connect_time = get_time_double() - tNow;
+                backoff = 0.2;
+                std::lock_guard<std::mutex> lock2(io_output_mutex); 
+                FPS_INFO_LOG("thread_id %d pipeline depth %d connected to %s:%d",
+                    io_thread->tid, pipe->depth, io_thread->ip.c_str(), io_thread->port);
+            } else {
+                tRetry = tNow + backoff;
+                backoff = std::min(backoff * 2.0, 5.0);
+                std::lock_guard<std::mutex> lock2(io_output_mutex); 
+                FPS_ERROR_LOG("thread_id %d pipeline connect to %s:%d failed, retry in %f seconds",
+                    io_thread->tid, io_thread->ip.c_str(), io_thread->port, tRetry - tNow);
+            }
+        }
+
+        // fill the window, sets go before polls
+        while (!pipe->full() && (io_setChan.peekpop(io_work) || io_pollChan.peekpop(io_work))) {
+            io_work->tIo = tNow;
+            io_work->threadId = io_thread->tid;
+            io_thread->jobs++;
+            if (io_work->wtype == WorkTypes::Noop) {
+                io_work->errors = 1;
+                done.push_back(io_work);
+                continue;
+            }
+            if (!pipe->submit(io_work, tNow)) {
+                io_work->tRun = 0.0;
+                done.push_back(io_work);
+                if (!pipe->is_open())
+                    pipe->fail_all(done, ECONNRESET);
+            }
+        }
+
+        if (pipe->in_flight() == 0 && done.empty()) {
+            if (io_threadChan.receive(signal, 0.1) && signal == 0)
+                run = false;
+            continue;
+        }
+        pipe->poll(done, 0.005);
+
+        for (auto work : done) {
+            work->tDone = get_time_double();
+            if (work->errors > 0) {
+                timeouts = 0;
+                if (work->wtype == WorkTypes::Get) {
+                    pollPlanner.record_io(work->device_id, work->reg_type, work->num_registers, work->tRun);
+                }
+            } else {
+                runPipelineError(io_thread, work, timeouts, debug);
+            }
+            io_responseChan.send(std::move(work));
+        }
+        done.clear();
+    }
+
+    // anything still in flight goes back as failed
+    pipe->fail_all(done, ECANCELED);
+    for (auto work : done) {
+        work->tDone = get_time_double();
+        io_responseChan.send(std::move(work));
+    }
+    {
+        std::lock_guard<std::mutex> lock2(io_output_mutex); 
+        FPS_INFO_LOG("thread_id %d pipeline sent %d received %d timeouts %d late %d exceptions %d",
+            io_thread->tid, (int)pipe->stats.sent, (int)pipe->stats.received, (int)pipe->stats.timeouts,
+            (int)pipe->stats.late, (int)pipe->stats.exceptions);
+    }
+}
+
 
 // thread function
 void ioThreadFunc(ThreadControl& control, std::shared_ptr<IO_Thread> io_thread) {
     //int id = tid;
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     int signal;
     bool run = true;
     bool debug = true;
     double delay = 0.1;
 
-    if (io_thread->ip != "") {
+    if (io_thread->pipeline_depth > 1 && io_thread->ip != "") {
+        runThreadPipeline(control, io_thread, debug);
+        run = false;
+    }
+    else if (io_thread->ip != "") {
         for (int i = 0; i < 5 && io_thread->ctx == nullptr ; ++i) {
             double ctime = SetupModbusForThread(io_thread, debug);
             //std::cout << "   done ModbusSetup; connect_time :"<< ctime << std::endl;
@@ -1038,7 +1173,9 @@ void ioThreadFunc(ThreadControl& control, std::shared_ptr<IO_Thread> io_thread)
                 //     std::fesetexceptflag(nullptr, FE_ALL_EXCEPT);  // Enable all floating point exceptions
                 //     feenableexcept(FE_DIVBYZERO);  // Enable the division by zero exception
 
-                    if (io_pollChan.receive(io_work)) {
+                    // sets go before polls, neither call blocks since the signal may
+                    // have been consumed by another thread that already took the work
+                    if (io_setChan.peekpop(io_work) || io_pollChan.peekpop(io_work)) {
                         runThreadWork(io_thread, io_work, debug);
                     }
                 // catch (const std::runtime_error& e) {
@@ -1057,7 +1194,7 @@ void ioThreadFunc(ThreadControl& control, std::shared_ptr<IO_Thread> io_thread)
 }
 
 void clearpollChan(bool debug) {
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     double delay = 0.1;
     if (debug) {
         std::cout << " Clearing pollChan" << std::endl;
@@ -1070,6 +1207,7 @@ void clearpollChan(bool debug) {
             << "  number "<< io_work.get()->num_registers
             << std::endl;
         }            
+        ioWorkPool.release(io_work);
     }
     if (debug) {
         std::cout << " Cleared pollChan" << std::endl;
@@ -1078,7 +1216,7 @@ void clearpollChan(bool debug) {
 }
 
 void clearsetChan(bool debug) {
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     double delay = 0.1;
     if (debug) {
         std::cout << " Clearing setChan" << std::endl;
@@ -1091,6 +1229,7 @@ void clearsetChan(bool debug) {
             << "  number "<< io_work.get()->num_registers
             << std::endl;
         }            
+        ioWorkPool.release(io_work);
     }
     if (debug) {
         std::cout << " Cleared setChan" << std::endl;
@@ -1098,7 +1237,7 @@ void clearsetChan(bool debug) {
 }
 
 void clearrespChan(bool debug){
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     double delay = 0.1;
     if (debug) {
         std::cout << " Clearing respChan" << std::endl;
@@ -1111,6 +1250,7 @@ void clearrespChan(bool debug){
             << "  number "<< io_work.get()->num_registers
             << std::endl;
         }            
+        ioWorkPool.release(io_work);
     }
     if (debug) {
         std::cout << " Cleared responseChan" << std::endl;
@@ -1122,7 +1262,7 @@ void clearrespChan(bool debug){
 // 
 void sendpollChantoResp(bool debug)
 {
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
     double delay = 0.1;
     if (debug) {
         std::cout << " Pulling  pollChan" << std::endl;
@@ -1159,6 +1299,10 @@ u64 gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct* item, std::any&
 
 
 std::map<std::string, PubGroup> pubGroups;
+// connection.pub_on_change, when each pub group is due a full pub
+std::map<std::string, double> fullPubTimes;
+
+bool send_pub(fims& fims_gateway, std::string_view uri, std::string_view body) noexcept;
 
 // this will decode the io_work items 
 // and produce the fims output message
@@ -1166,6 +1310,54 @@ std::string regTypeToStr(cfg::Register_Types &reg_type);
 
 #include <cxxabi.h>
 
+// decode the items of a homogeneous register block that fall inside this read in one pass
+// items with a point go into the PointStore and their ids onto pids, the rest into values
+static void decodeBlockItems(IO_Work* io_work, cfg::reg_struct* reg_map, const MapIndex* mindex,
+                             std::map<std::string, DecodeValue>& values, PubWriter& writer)
+{
+    static thread_local std::vector<double> f64col;
+    static thread_local std::vector<s64> i64col;
+    auto& spec = reg_map->block;
+
+    int start = io_work->offset - spec.first_offset;
+    int first = start <= 0 ? 0 : (start + spec.size - 1) / spec.size;
+    int last = std::min(spec.num_items, (start + io_work->num_registers) / spec.size);
+    int num = last - first;
+    if (num <= 0)
+        return;
+    const u16* buf16 = &io_work->buf16[first * spec.size - start];
+
+    auto put = [&](int k, const DecodeValue& val) {
+        auto& map = *reg_map->maps[first + k];
+        if (auto points = mindex ? mindex->store(map) : nullptr) {
+            points->set_value(map.point_id, val);
+            writer.add(mindex->pubs, map.point_id);
+        } else {
+            values[map.id] = val;
+        }
+    };
+    DecodeValue val;
+    auto kind = block_decode_kind(spec);
+    if (kind == DecodeValue::Kind::Float) {
+        f64col.resize(num);
+        block_decode_f64(spec, buf16, num, f64col.data());
+        for (int k = 0; k < num; ++k) {
+            val.set(f64col[k]);
+            put(k, val);
+        }
+    } else {
+        i64col.resize(num);
+        block_decode_i64(spec, buf16, num, i64col.data());
+        for (int k = 0; k < num; ++k) {
+            if (kind == DecodeValue::Kind::Signed)
+                val.set(i64col[k]);
+            else
+                val.set((u64)i64col[k]);
+            put(k, val);
+        }
+    }
+}
+
 void processGroupCallback(struct PubGroup pg, struct cfg& myCfg)
 {
     //auto compsh = pg.comp.lock();
@@ -1175,8 +1367,31 @@ void processGroupCallback(struct PubGroup pg, struct cfg& myCfg)
                 << " process time mS " << (tNow - pg.tNow)*1000.0
                 << std::endl;  
 
-    // TODO decode and create body
-    std::map<std::string,std::map<std::string,std::any>> pubmap;
+    // only items loaded without an index end up here
+    std::map<std::string,std::map<std::string,DecodeValue>> pubmap;
+    // the values of items with a point are in the PointStore, the writer collects their ids per uri
+    auto& writer = PubWriter::local();
+    // decode against the index the works were made with, a reload may have swapped in another since.
+    // each work holds its own so its items stay alive until it is released
+    std::shared_ptr<const MapIndex> mindex;
+    for (auto& io_work : pg.works) {
+        if (io_work->mindex) {
+            mindex = io_work->mindex;
+            break;
+        }
+    }
+    if (!mindex)
+        mindex = map_index();
+    // change driven pubs decode only the items over changed registers, with a full pub now and then
+    bool pub_changes = myCfg.connection.pub_on_change && mindex;
+    bool full_pub = true;
+    if (pub_changes) {
+        auto& tFull = fullPubTimes[pg.key];
+        full_pub = tNow >= tFull;
+        if (full_pub)
+            tFull = tNow + myCfg.connection.full_pub_interval;
+    }
+    std::vector<u64> changed;
     
     //fmt::memory_buffer send_buf;
     //send_buf.push_back('{');
@@ -1195,15 +1410,15 @@ void processGroupCallback(struct PubGroup pg, struct cfg& myCfg)
                     , (int)io_work->errors
                     , (int)io_work->errno_code
                 );
-            io_poolChan.send(std::move(io_work));
+            ioWorkPool.release(io_work);
             continue;
         }
-        printf(" <%s> comp_map %p uri /%s/%s ", __func__, (void*)comp_map.get()
+        printf(" <%s> comp_map %p uri /%s/%s ", __func__, (void*)comp_map
                     , io_work->comp_map->comp_id.c_str()
                     , io_work->comp_map->id.c_str()
                     );
         auto reg_map = io_work.get()->reg_map;
-        printf(" <%s> reg_map %p ", __func__, (void*)reg_map.get());
+        printf(" <%s> reg_map %p ", __func__, (void*)reg_map);
 
         auto offset = io_work.get()->offset;
         printf(" offset %d", (int)offset);
@@ -1211,76 +1426,119 @@ void processGroupCallback(struct PubGroup pg, struct cfg& myCfg)
         auto offnum = io_work.get()->num_registers;
         printf(" offnum %d\n", (int)offnum);
 
-        int onum = 0;
-        while (onum < offnum ) {
-            // use the mapix to find the map item
-            // now we need to build up a pub object
-            //  uri  
-            //               id 
-            //                            value
-
-
-            if (reg_map->mapix.find(offset+onum) != reg_map->mapix.end()) {
-                printf(" <%s> reg_map --> extracting  offset %d\n", __func__, (int)(offset+onum));
-
-                auto map = reg_map->mapix[offset+onum];
-                printf("         reg_map from mapix --> found map %p  id [%s]\n",  (void*)(map.get()), map->id.c_str());
-                // auto regsp = map.get()->reg.lock();
-                // printf("                            --> found map->reg %p \n",  (void*)(regsp.get()));
-                // auto comp = reg->comp.lock();
-                // printf("                            --> found reg->comp %p \n", (void*)(comp.get()));
-                // printf("                            --> comp->id %s \n", comp->id.c_str());
-
-                std::cout << __func__ 
-                    << " ****** OK map offset " << offset+onum
-                    // << " comp "<< comp->comp_id
-                    // << " comp id "<< comp->id
-                    // << " map id "<< map->id
-                    << " size " << map->size
-                    << " decode 0x" << std::hex << io_work.get()->buf16[onum] <<std::dec 
-                    << std::endl;
-                    //now using the decode and the map item create the any               
-                    //in  gcom_modbus_decode.cpp
-                    //    void decode_to_string(u16* regs16, u8* regs8, struct cfg::map_struct& item, fmt::memory_buffer& buf, struct cfg& myCfg)
-
-                    //auto raw_val = gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct& item, std::any& output, struct cfg& myCfg);
-                    //auto raw_val = 
-                    std::any output;
-                    gcom_decode_any(&io_work.get()->buf16[onum], 
-                                             &io_work.get()->buf8[onum], 
-                                             map.get(), 
-                                             output, 
-                                             myCfg);
-
-                    std::string uri = "/"+ io_work->comp_map->comp_id + "/" + io_work->comp_map->id; 
-                    std::string id = map->id ; //"/"+ io_work->comp_map->comp_id + "/" + io_work->comp_map->id; 
-                    if (pubmap.find(uri)==pubmap.end()) {
-                        pubmap[uri]= std::map<std::string,std::any>();
-                    }
-                    // this may be OK 
-                    // or we could put the raw data in the pubmap 
-                    // or a std::pair map_struct, std::any 
-                    pubmap[uri][id]=output;
-
-                    // having got that drop it into the pubmap
-                    //or we can decode it  into a string and have a pubmap of 
-                    // std::map<<std::string,std:map<std::string,std::string>> pubstrmap
-
-                onum+=map->size;     
-                //onum = offnum;
-                //the value to decode starts at io_work.get()->u16_buff[onum]
-
-
-            }
-            else 
-            {
-                std::cout << __func__ 
-                    << "******* ERROR map offset " << offset+onum
-                    << " not found decode stopped"
-                    << std::endl;
-                break;
-            }
-            //onum = offnum;
+        // a planned read may cover several register blocks and the unmapped gaps between them
+        // so walk the mapped items of each block that fall inside this read
+        size_t num_regs = std::max<size_t>(1, io_work->reg_maps.size());
+        for (size_t rnum = 0; rnum < num_regs; ++rnum) {
+          if (!io_work->reg_maps.empty())
+              reg_map = io_work->reg_maps[rnum];
+          // the flat index covers anything from a config load, mapix is the fallback
+          const MapIndex::Block* blk = mindex ? mindex->block(reg_map) : nullptr;
+          int lo = 0;
+          int hi = 0;
+          if (blk) {
+              lo = std::max(offset, blk->base);
+              hi = std::min(offset + offnum, blk->base + (int)blk->slots.size());
+          }
+          // diff the read against the last one, the snapshot is kept up to date on full pubs too.
+          // coils and discrete inputs come back in buf8, those always go out in full
+          bool gate = false;
+          if (pub_changes && blk && hi > lo
+                  && (io_work->reg_type == cfg::Register_Types::Holding || io_work->reg_type == cfg::Register_Types::Input)) {
+              changed.resize((hi - lo + 63) / 64);
+              mindex->points->diff_regs(blk->regs_at + (lo - blk->base), &io_work->buf16[lo - offset], hi - lo, changed.data());
+              gate = !full_pub;
+          }
+          // every item the same type, decode the whole span as a column
+          if (!gate && reg_map->block.homogeneous
+                  && (io_work->reg_type == cfg::Register_Types::Holding || io_work->reg_type == cfg::Register_Types::Input)) {
+              std::string uri = "/"+ io_work->comp_map->comp_id + "/" + io_work->comp_map->id; 
+              decodeBlockItems(io_work.get(), reg_map, mindex.get(), pubmap[uri], writer);
+              continue;
+          }
+          auto decodeOne = [&](int onum, const cfg::map_struct* map) {
+              if (onum + std::max(map->size, 1) <= offnum) {
+                  if(0)printf(" <%s> reg_map --> extracting  offset %d\n", __func__, (int)(offset+onum));
+
+                  if(0)printf("         reg_map from mapix --> found map %p  id [%s]\n",  (void*)map, map->id.c_str());
+                  // auto regsp = map.get()->reg.lock();
+                  // printf("                            --> found map->reg %p \n",  (void*)(regsp.get()));
+                  // auto comp = reg->comp.lock();
+                  // printf("                            --> found reg->comp %p \n", (void*)(comp.get()));
+                  // printf("                            --> comp->id %s \n", comp->id.c_str());
+
+                  if(0)std::cout << __func__ 
+                      << " ****** OK map offset " << offset+onum
+                      // << " comp "<< comp->comp_id
+                      // << " comp id "<< comp->id
+                      // << " map id "<< map->id
+                      << " size " << map->size
+                      << " decode 0x" << std::hex << io_work.get()->buf16[onum] <<std::dec 
+                      << std::endl;
+                      //now using the decode and the map item create the any               
+                      //in  gcom_modbus_decode.cpp
+                      //    void decode_to_string(u16* regs16, u8* regs8, struct cfg::map_struct& item, fmt::memory_buffer& buf, struct cfg& myCfg)
+
+                      //auto raw_val = gcom_decode_any(u16* raw16, u8*raw8, struct cfg::map_struct& item, std::any& output, struct cfg& myCfg);
+                      //auto raw_val = 
+                      DecodeValue output;
+                      auto raw_val = decode_item(&io_work.get()->buf16[onum], *map, output);
+
+                      if (auto points = mindex ? mindex->store(*map) : nullptr) {
+                          points->set_value(map->point_id, raw_val, output);
+                          if (!gate || points->pub_check(map->point_id, tNow))
+                              writer.add(mindex->pubs, map->point_id);
+                          return;
+                      }
+                      std::string uri = "/"+ io_work->comp_map->comp_id + "/" + io_work->comp_map->id; 
+                      std::string id = map->id ; //"/"+ io_work->comp_map->comp_id + "/" + io_work->comp_map->id; 
+                      if (pubmap.find(uri)==pubmap.end()) {
+                          pubmap[uri]= std::map<std::string,DecodeValue>();
+                      }
+                      // this may be OK 
+                      // or we could put the raw data in the pubmap 
+                      // or a std::pair map_struct, std::any 
+                      pubmap[uri][id]=output;
+
+                      // having got that drop it into the pubmap
+                      //or we can decode it  into a string and have a pubmap of 
+                      // std::map<<std::string,std:map<std::string,std::string>> pubstrmap
+
+                  //the value to decode starts at io_work.get()->u16_buff[onum]
+
+
+              }
+              else 
+              {
+                  std::cout << __func__ 
+                      << "******* ERROR map offset " << offset+onum
+                      << " runs past the end of the read, skipped"
+                      << std::endl;
+              }
+          };
+
+          if (blk) {
+              for (int off = lo; off < hi; ++off) {
+                  int32_t slot = blk->slots[off - blk->base];
+                  if (slot < 0)
+                      continue;
+                  // skip items with none of their registers changed unless debounce is holding them
+                  if (gate && !mindex->points->pending[slot]) {
+                      int first = off - lo;
+                      int last = std::min(off + std::max(mindex->items[slot]->size, 1), hi) - lo;
+                      bool any = false;
+                      for (int k = first; k < last && !any; ++k)
+                          any = (changed[k / 64] >> (k % 64)) & 1;
+                      if (!any)
+                          continue;
+                  }
+                  decodeOne(off - offset, mindex->items[slot]);
+              }
+          } else {
+              auto mapit = reg_map->mapix.lower_bound(offset);
+              for ( ; mapit != reg_map->mapix.end() && mapit->first < offset + offnum; ++mapit)
+                  decodeOne(mapit->first - offset, mapit->second.get());
+          }
         }
 
         //if (debug) {
@@ -1294,58 +1552,32 @@ void processGroupCallback(struct PubGroup pg, struct cfg& myCfg)
     //}
 
         //std::cout << " processing pubgroup " << pg.key << "created at :" << pg.tNow << std::endl;  
-        io_poolChan.send(std::move(io_work));
+        ioWorkPool.release(io_work);
     }
  
+    // no fims connection when run from the test commands, the pub goes to stdout
+    PubWriter::SendFn send = [&](std::string_view uri, std::string_view body) {
+        if (myCfg.fims_gateway.Connected())
+            send_pub(myCfg.fims_gateway, uri, body);
+        else
+            std::cout << "\"" << uri << "\":" << body << std::endl;
+    };
+    if (mindex)
+        writer.flush(mindex->pubs, *mindex->points, send);
+    auto& pubbuf = writer.buf;
     for (const auto& uri_pair : pubmap) {
-        std::cout << "\"" << uri_pair.first << "\":{";
-    
+        if (uri_pair.second.empty())
+            continue;
+        pubbuf.clear();
+        pubbuf.push_back('{');
         bool firstItem = true;
         for (const auto& id_pair : uri_pair.second) {
-            if (!firstItem) {
-                std::cout << ", ";
-            }
-            std::cout << "\"" << id_pair.first << "\": ";
-        
-            // Convert std::any back to the original type and print
-            // This example assumes output is of type std::string
-            // You'd need to replace std::string with the actual type stored in std::any
-            const std::any& output = id_pair.second;
-            try {
-                std::string value = std::any_cast<std::string>(output);
-                std::cout << "\"" << value << "\""; // or use your own serialization for complex types
-            } catch (const std::bad_any_cast& e) {
-                try {
-                        long  value = std::any_cast<long>(output);
-                        std::cout << value; // or use your own serialization for complex types
-                    } catch (const std::bad_any_cast& e) {
-                        try {
-                            int value = std::any_cast<int>(output);
-                            std::cout << value; // or use your own serialization for complex types
-                        } catch (const std::bad_any_cast& e) {
-                            try {
-                                bool value = std::any_cast<bool>(output);
-                                std::cout << value; // or use your own serialization for complex types
-                            } catch (const std::bad_any_cast& e) {
-
-                                std::cerr << "Bad any_cast: " << e.what() << "\n";
-                                // Handle error: for example, print an error message, throw an exception, or skip this item
-                                int status;
-                                char *demangled_name = abi::__cxa_demangle(output.type().name(), 0, 0, &status);
-                                if(status == 0) {
-                                    std::cerr << "Type contained in std::any: " << demangled_name << "\n";
-                                    free(demangled_name);
-                                } else {
-                                    std::cerr << "Could not demangle type name: " << output.type().name() << "\n";
-                                }
-                            }
-                        }
-                    }
-            }
-        
+            fmt::format_to(std::back_inserter(pubbuf), "{}\"{}\":", firstItem ? "" : ",", id_pair.first);
+            PubWriter::append_value(pubbuf, id_pair.second);
             firstItem = false;
         }
-        std::cout << "}"<<std::endl;
+        pubbuf.push_back('}');
+        send(uri_pair.first, std::string_view(pubbuf.data(), pubbuf.size()));
     }
 }
 
@@ -1353,7 +1585,7 @@ void discardGroupCallback(struct PubGroup pg, struct cfg& myCfg)
 {
     std::cout << " >>>>>>>>>>>>>>>>>>>>>>>>>>>>>> dropping pubgroup " << pg.key << " created at :" << pg.tNow << std::endl;  
     for (auto io_work :pg.works) {
-        io_poolChan.send(std::move(io_work));
+        ioWorkPool.release(io_work);
     }
 }
 
@@ -1362,7 +1594,7 @@ void discardGroupCallback(struct PubGroup pg, struct cfg& myCfg)
 // io_work->tNow
 // io_work->work_group
 
-void processRespWork(std::shared_ptr<IO_Work> io_work, struct cfg& myCfg) {
+void processRespWork(IO_WorkHandle io_work, struct cfg& myCfg) {
 
     std::string key = io_work->work_name;// + std::to_string(io_work->work_id);
 
@@ -1375,7 +1607,7 @@ void processRespWork(std::shared_ptr<IO_Work> io_work, struct cfg& myCfg) {
         //printf("<%s> >>>>>>>> checking pubgroup  %f against incoming   %f \n", __func__, pubGroups[key].tNow, io_work->tNow);
         if (io_work->tNow  < pubGroups[key].tNow) {
             printf("<%s> >>>>>>>> discarding stale incoming io_work; current pubgroup id  %f is later than incoming  id  %f \n", __func__, pubGroups[key].tNow, io_work->tNow);
-            io_poolChan.send(std::move(io_work));
+            ioWorkPool.release(io_work);
             return;
         }
         
@@ -1399,20 +1631,51 @@ void processRespWork(std::shared_ptr<IO_Work> io_work, struct cfg& myCfg) {
 
 // Response Thread Function
 void responseThreadFunc(ThreadControl& control, struct cfg &myCfg) {
-    std::shared_ptr<IO_Work> io_work;
+    auto& registry = PerfRegistry::get();
+    const PerfId io_response_id = registry.intern("io_response");
+    std::vector<IO_WorkHandle> io_works;
+    io_works.reserve(64);
     double delay = 0.1;
     while (control.responseThreadRunning) {
-        if (io_responseChan.receive(io_work, delay)) {
+        // drain whatever the io threads have finished in one wakeup
+        io_responseChan.receiveBatch(io_works, 64, delay);
+        for (auto& io_work : io_works) {
             io_work->tReceive = get_time_double();
+
+            // probes only feed the quarantine
+            if (io_work->probe) {
+                deviceHealth.probe_done(*io_work, io_work->tReceive);
+                ioWorkPool.release(io_work);
+                continue;
+            }
+            deviceHealth.record(*io_work, io_work->tReceive);
+
+            // a merged set write, each set it carried gets the result
+            if (!io_work->batched.empty()) {
+                for (auto orig : io_work->batched) {
+                    orig->errors = io_work->errors;
+                    orig->errno_code = io_work->errno_code;
+                    orig->tIo = io_work->tIo;
+                    orig->tDone = io_work->tDone;
+                    orig->tReceive = io_work->tReceive;
+                    processRespWork(orig, myCfg);
+                }
+                io_work->batched.clear();
+                ioWorkPool.release(io_work);
+                continue;
+            }
             
+            // processRespWork can hand the work back to the pool, take what we need first
+            auto tEnd = io_work->tStart;
+
             // Collate batches response_received_work
             processRespWork(io_work, myCfg);
 
             double tNow = get_time_double();
             {
                 std::lock_guard<std::mutex> lock2(io_output_mutex); 
-                auto tEnd = io_work->tStart;
                 auto duration  = tNow - tEnd;
+                registry.record_secs(io_response_id, duration);
                 control.num_responses++;
                 control.tResponse+=duration;
 
@@ -1425,6 +1688,7 @@ void responseThreadFunc(ThreadControl& control, struct cfg &myCfg) {
             }
             //io_poolChan.send(std::move(io_work));
         }
+        io_works.clear();
     }
 }
 
@@ -1438,11 +1702,139 @@ void randomDelay(int minMicroseconds, int maxMicroseconds) {
 }
 
 
+IO_WorkPool::~IO_WorkPool()
+{
+    // the arena only frees the memory
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i].~IO_Work();
+    }
+}
+
+bool IO_WorkPool::init(size_t num_works)
+{
+    if (slots || num_works == 0)
+        return false;
+    if (!arena.initialize(sizeof(IO_Work) * num_works + alignof(IO_Work)))
+        return false;
+    if (!arena.allocate(slots, num_works))
+        return false;
+    capacity = num_works;
+    free_list = std::make_unique<rigtorp::MPMCQueue<IO_Work*>>(num_works);
+    for (size_t i = 0; i < capacity; ++i) {
+        free_list->push(&slots[i]);
+    }
+    return true;
+}
+
+IO_WorkHandle IO_WorkPool::acquire()
+{
+    IO_Work* io_work = nullptr;
+    if (free_list && free_list->try_pop(io_work)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        io_work = new IO_Work();
+    }
+    auto used = in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    auto hwm = high_water.load(std::memory_order_relaxed);
+    while (used > hwm && !high_water.compare_exchange_weak(hwm, used, std::memory_order_relaxed)) {
+    }
+    return IO_WorkHandle(io_work);
+}
+
+void IO_WorkPool::release(IO_WorkHandle io_work)
+{
+    if (!io_work)
+        return;
+    in_use.fetch_sub(1, std::memory_order_relaxed);
+    if (!is_pooled(io_work.get())) {
+        delete io_work.get();
+        return;
+    }
+    io_work->reset();
+    free_list->push(io_work.get());
+}
+
+IO_WorkPoolStats IO_WorkPool::stats() const
+{
+    return { hits.load(std::memory_order_relaxed),
+             misses.load(std::memory_order_relaxed),
+             in_use.load(std::memory_order_relaxed),
+             high_water.load(std::memory_order_relaxed),
+             (u64)capacity };
+}
+
+void IO_WorkPool::reset_stats()
+{
+    hits = 0;
+    misses = 0;
+    high_water = in_use.load();
+}
+
+// two polls in flight for every register group we pub plus room for sets
+size_t io_work_pool_size(struct cfg& myCfg)
+{
+    size_t num_regs = 0;
+    for (auto& comp : myCfg.components) {
+        num_regs += comp->registers.size();
+    }
+    return num_regs * 2 + 256;
+}
+
+void show_io_work_pool(void)
+{
+    auto st = ioWorkPool.stats();
+    FPS_INFO_LOG("io_work pool capacity %d in_use %d high_water %d hits %d misses %d"
+                , (int)st.capacity, (int)st.in_use, (int)st.high_water, (int)st.hits, (int)st.misses);
+}
+
+// run a few poll cycles through the pool, after the first cycle everything should be a hit
+int test_io_work_pool()
+{
+    ioWorkPool.init(64);
+    std::vector<IO_WorkHandle> cycle;
+    for (int run = 0; run < 10; ++run) {
+        for (int i = 0; i < 48; ++i) {
+            auto io_work = ioWorkPool.acquire();
+            io_work->work_name = "pub_components_test";
+            io_work->offset = i * 10;
+            io_work->num_registers = 10;
+            cycle.emplace_back(io_work);
+        }
+        for (auto io_work : cycle) {
+            ioWorkPool.release(io_work);
+        }
+        cycle.clear();
+    }
+    auto st = ioWorkPool.stats();
+    std::cout << " io_work pool capacity " << st.capacity
+              << " hits " << st.hits
+              << " misses " << st.misses
+              << " high_water " << st.high_water
+              << " in_use " << st.in_use
+              << std::endl;
+
+    // overflow the pool, the extra works come from the heap and are deleted on release
+    for (int i = 0; i < 80; ++i) {
+        cycle.emplace_back(ioWorkPool.acquire());
+    }
+    for (auto io_work : cycle) {
+        ioWorkPool.release(io_work);
+    }
+    st = ioWorkPool.stats();
+    std::cout << " after overflow hits " << st.hits
+              << " misses " << st.misses
+              << " high_water " << st.high_water
+              << " in_use " << st.in_use
+              << std::endl;
+    return (st.misses == 16 && st.in_use == 0) ? 0 : 1;
+}
+
 void buffer_work(cfg::Register_Types reg_type, int device_id, int offset, int num_regs) 
 {
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
 
-    io_work = std::make_shared<IO_Work>();
+    io_work = ioWorkPool.acquire();
 
     // Modify io_work data if necessary here
     io_work->tStart = get_time_double();
@@ -1456,7 +1848,7 @@ void buffer_work(cfg::Register_Types reg_type, int device_id, int offset, int nu
     // io_work->wtype = wtype;
     io_work->test_mode = false;
 
-    io_poolChan.send(std::move(io_work));
+    ioWorkPool.release(io_work);
     
     return; // (io_work);
     //io_pollChan.send(std::move(io_work));
@@ -1466,18 +1858,15 @@ void buffer_work(cfg::Register_Types reg_type, int device_id, int offset, int nu
 }
 
 
-std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype ) {
+IO_WorkHandle make_work(cfg::Register_Types reg_type,  int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype ) {
 
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
 
     // if (!io_poolChan.receive(io_work,0)) {  // Assuming receive will return false if no item is available.
     //     std::cout << " create an io_work object "<< std::endl;
     //     io_work = std::make_shared<IO_Work>();
     // }
-    if (!io_poolChan.peekpop(io_work)) {  // Assuming receive will return false if no item is available.
-        //std::cout << " create an io_work object "<< std::endl;
-        io_work = std::make_shared<IO_Work>();
-    }
+    io_work = ioWorkPool.acquire();
 
     // Modify io_work data if necessary here
     io_work->tStart = get_time_double();
@@ -1490,6 +1879,7 @@ std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id,
     io_work->set_bufs(num_regs, u16bufs, u8bufs);
     io_work->wtype = wtype;
     io_work->test_mode = false;
+    io_work->mindex = map_index();
 
     
     return (io_work);
@@ -1502,18 +1892,26 @@ std::shared_ptr<IO_Work> make_work(cfg::Register_Types reg_type,  int device_id,
 //bool pollWork (std::shared_ptr<IO_Work> io_work) {
 //bool setWork (std::shared_ptr<IO_Work> io_work) {
 
-bool pollWork (std::shared_ptr<IO_Work> io_work) {
+// tell whoever is running the io that there is work queued
+static void wakeIo() {
+    if (ioReactors.is_running())
+        ioReactors.wake();
+    else
+        io_threadChan.send(1);
+}
+
+bool pollWork (IO_WorkHandle io_work) {
     //std::cout << "Sending a poll item "<<std::endl;
     io_pollChan.send(std::move(io_work));
-    io_threadChan.send(1);
+    wakeIo();
 
     return true;  // You might want to return a status indicating success or failure.
 
 }
 
-bool setWork (std::shared_ptr<IO_Work> io_work) {
+bool setWork (IO_WorkHandle io_work) {
     io_setChan.send(std::move(io_work));
-    io_threadChan.send(1);
+    wakeIo();
 
     return true;  // You might want to return a status indicating success or failure.
 
@@ -1522,11 +1920,9 @@ bool setWork (std::shared_ptr<IO_Work> io_work) {
 
 bool queue_work(cfg::Register_Types reg_type,int device_id, int offset, int num_regs, uint16_t* u16bufs, uint8_t* u8bufs, WorkTypes wtype ) {
 
-    std::shared_ptr<IO_Work> io_work;
+    IO_WorkHandle io_work;
 
-    if (!io_poolChan.receive(io_work,0)) {  // Assuming receive will return false if no item is available.
-        io_work = std::make_shared<IO_Work>();
-    }
+    io_work = ioWorkPool.acquire();
 
     // Modify io_work data if necessary here
     io_work->tStart = get_time_double();
@@ -1541,7 +1937,7 @@ bool queue_work(cfg::Register_Types reg_type,int device_id, int offset, int num_
 
     
     io_pollChan.send(std::move(io_work));
-    io_threadChan.send(1);
+    wakeIo();
 
     return true;  // You might want to return a status indicating success or failure.
 }
@@ -1584,6 +1980,7 @@ std::shared_ptr<IO_Thread> make_IO_Thread(int idx, const char* ip, int port, int
     if(ip)io_thread->ip = ip;
     io_thread->port = port;
     io_thread->connection_timeout = connection_timeout;
+    io_thread->pipeline_depth = myCfg.connection.pipeline_depth;
     return (io_thread);
 }
 
@@ -1606,9 +2003,33 @@ bool StartThreads(int num_threads, const char *ip, int port, int connection_time
         //std::cout << " test_io_threads running  at "<< tNow << std::endl;
     }
 
+    // size the io_work pool once from the config, later calls keep the first pool
+    if (!ioWorkPool.is_init()) {
+        ioWorkPool.init(io_work_pool_size(myCfg));
+    }
+
     // Start the response thread
     startRespThread(myCfg);
 
+    // fims sets are held this long to go out as multi register writes
+    setBatcher.start(myCfg.connection.set_batch_window);
+
+    // the reactor drives all the connections from a few epoll loops
+    if (myCfg.connection.reactor_threads > 0 && ip && *ip) {
+        int num_loops = std::min(myCfg.connection.reactor_threads, std::max(num_threads, 1));
+        int depth = std::max(myCfg.connection.pipeline_depth, 1);
+        ioReactors.init(num_loops, &io_setChan, &io_pollChan, &io_responseChan);
+        for (int i = 0 ; i < num_threads; ++i)
+            ioReactors.add_connection(ip, port, depth, (double)connection_timeout);
+        ioReactors.start();
+        {
+            std::lock_guard<std::mutex> lock2(io_output_mutex); 
+            FPS_INFO_LOG("io reactors running, %d loops for %d connections at depth %d", num_loops, num_threads, depth);
+            FPS_LOG_IT("startup");
+        }
+        return true;
+    }
+
     //int num_threads = 4;
     for (int i = 0 ; i < num_threads; ++i)
     {        
@@ -1652,6 +2073,14 @@ bool StartThreads(struct cfg& myCfg, bool debug)
 
 bool StopThreads(struct cfg& myCfg, bool debug)
 {
+    // held sets go out while there is still something to run them
+    setBatcher.stop();
+    // the reactors hand back their in flight work so stop them before the response thread
+    if (ioReactors.is_running()) {
+        ioReactors.stop();
+        std::lock_guard<std::mutex> lock2(io_output_mutex); 
+        ioReactors.show_stats();
+    }
     threadControl.stopThreads();
     {
         std::lock_guard<std::mutex> lock2(io_output_mutex); 
@@ -1659,6 +2088,10 @@ bool StopThreads(struct cfg& myCfg, bool debug)
     }
 
     threadControl.responseThread.join();
+    {
+        std::lock_guard<std::mutex> lock2(io_output_mutex); 
+        show_io_work_pool();
+    }
     return true;
 }
 
@@ -1897,10 +2330,16 @@ bool SetUPModbusCtx(int num_threads, const char *ip , int port, int connection_t
 
 bool CloseModbusForThread(std::shared_ptr<IO_Thread> io_thread, bool debug)
 {
+    if (io_thread->pipe) {
+        delete io_thread->pipe;
+        io_thread->pipe = nullptr;
+    }
     auto ctx = io_thread->ctx;
     io_thread->ctx = nullptr;
-    modbus_close(ctx);
-    modbus_free(ctx);
+    if (ctx) {
+        modbus_close(ctx);
+        modbus_free(ctx);
+    }
     return true;
 
 }
@@ -1,61 +1,101 @@
 import os
+import sys
 import glob
+import struct
 import datetime
 
+# Segment store written by loggen, see include/log_store.h
+#   <user>/<logID>.idx         16 byte header then (first_ns, last_ns, seq, count) per segment
+#   <user>/<logID>.<seq>.seg   256 byte header then 256 byte records (time_ns, 4 lengths, 4 x 60 byte vars)
+IDX_HEADER = struct.Struct("<8sII")
+IDX_ENTRY = struct.Struct("<qqQQ")
+SEG_HEADER = struct.Struct("<8sIIQQqqQ")
+RECORD = struct.Struct("<q4H60s60s60s60s")
+RECORD_SIZE = 256
+
 # Read log ID formats
 #def read_log_formats(project):
 #    with open(f"/var/log/{project}/logids") as f:
 #        log_formats = dict(line.strip().split('\t', 1) for line in f)
 #    return log_formats
 def read_log_formats(project):
+    log_formats = {}
+    if not os.path.exists(f"/var/log/{project}/logids"):
+        return log_formats
     with open(f"/var/log/{project}/logids") as f:
-        log_formats = {}
         for line in f:
             parts = line.strip().split(':', 1)
             if len(parts) == 2:
                 log_formats[parts[0]] = parts[1]
     return log_formats
-def parse_log_line(line, user_name, file_name, log_formats):
-    parts = line.strip().split('\t')
-    timestamp = datetime.datetime.strptime(parts[0], "%Y-%m-%dT%H:%M:%S")
-    log_id = file_name
-    vars = parts[1:]
+
+def parse_record(data, user_name, log_id, log_formats):
+    fields = RECORD.unpack_from(data)
+    timestamp = datetime.datetime.fromtimestamp(fields[0] / 1e9)
+    vars = [fields[5 + i][:fields[1 + i]].decode(errors="replace") for i in range(4)]
     format = log_formats.get(log_id, "")
-    formatted_message = format.format(*vars)
+    formatted_message = format.format(*vars) if format else "\t".join(vars)
     fm = user_name+"\t"+log_id + "\t" + formatted_message
     return (timestamp, fm)
 
-# # Parse a log line into a tuple (timestamp, formatted message)
-# def parse_log_line(line, log_formats):
-#     parts = line.strip().split('\t')
-#     timestamp = datetime.datetime.fromisoformat(parts[0])
-#     log_id = parts[1]
-#     vars = parts[2:]
-#     format = log_formats.get(log_id, "")
-#     formatted_message = format.format(*vars)
-#     return (timestamp, formatted_message)
+# first record in [lo, hi) with time >= ns, records are time ordered within a segment
+def seek_record(f, lo, hi, ns):
+    while lo < hi:
+        mid = (lo + hi) // 2
+        f.seek(RECORD_SIZE * (mid + 1))
+        if struct.unpack("<q", f.read(8))[0] < ns:
+            lo = mid + 1
+        else:
+            hi = mid
+    return lo
+
+# Read the log entries of one logID between start_ns and end_ns, the index skips the
+# segments outside the range and a binary search skips the records outside it
+def read_log_entries(idx_file, log_formats, start_ns=0, end_ns=2**63 - 1):
+    user_dir = os.path.dirname(idx_file)
+    user_name = os.path.basename(user_dir)
+    log_id = os.path.basename(idx_file)[:-len(".idx")]
+
+    with open(idx_file, "rb") as f:
+        data = f.read()
+    if len(data) < IDX_HEADER.size or not data.startswith(b"SLIDX1"):
+        return []
+    entries = []
+    for pos in range(IDX_HEADER.size, len(data) - IDX_ENTRY.size + 1, IDX_ENTRY.size):
+        first_ns, last_ns, seq, count = IDX_ENTRY.unpack_from(data, pos)
+        seg_file = os.path.join(user_dir, f"{log_id}.{seq:06d}.seg")
+        if first_ns > end_ns or not os.path.exists(seg_file):
+            continue
+        with open(seg_file, "rb") as seg:
+            if last_ns == 0:
+                # live segment, the writer keeps the count and last time in its header
+                head = SEG_HEADER.unpack(seg.read(SEG_HEADER.size))
+                last_ns, count = head[6], head[7]
+            if last_ns < start_ns:
+                continue
+            first = seek_record(seg, 0, count, start_ns)
+            last = seek_record(seg, first, count, end_ns + 1)
+            seg.seek(RECORD_SIZE * (first + 1))
+            for _ in range(first, last):
+                entries.append(parse_record(seg.read(RECORD_SIZE), user_name, log_id, log_formats))
+    return entries
 
-# Read all log entries from a file
-def read_log_entries(filename, log_formats):
-    #print(filename)
-    file_split = os.path.basename(filename)
-    file_split = filename.split('/')
-    file_name = file_split[-1]
-    user_name = file_split[-2]
-    
-    with open(filename) as f:
-        return [parse_log_line(line, user_name, file_name, log_formats) for line in f]
+def parse_time(arg):
+    return int(datetime.datetime.fromisoformat(arg).timestamp() * 1e9)
 
+# logviewer.py [project] [from] [to], times as 2024-01-31T12:00:00
 def main():
-    project = "testProject2"
+    project = sys.argv[1] if len(sys.argv) > 1 else "testProject2"
+    start_ns = parse_time(sys.argv[2]) if len(sys.argv) > 2 else 0
+    end_ns = parse_time(sys.argv[3]) if len(sys.argv) > 3 else 2**63 - 1
     log_formats = read_log_formats(project)
 
-    # Get all log files
-    log_files = glob.glob(f"/var/log/{project}/*/*")
-    print(log_files)
+    # Get all log indexes
+    idx_files = glob.glob(f"/var/log/{project}/*/*.idx")
+    print(idx_files)
 
-    # Read all log entries from all files
-    log_entries = [entry for log_file in log_files for entry in read_log_entries(log_file, log_formats)]
+    # Read all log entries in the range from all of them
+    log_entries = [entry for idx_file in idx_files for entry in read_log_entries(idx_file, log_formats, start_ns, end_ns)]
 
     # Sort log entries by timestamp
     log_entries.sort()
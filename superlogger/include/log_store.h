@@ -0,0 +1,294 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+// log_store.h
+// per user / logID log streams in preallocated, memory mapped segment files
+//
+//   <base>/<user>/<logID>.<seq>.seg   SegHeader then fixed size LogRecords, time ordered
+//   <base>/<user>/<logID>.idx         IdxHeader then one IdxEntry per segment ( first / last time, count )
+//
+// A segment is made at its full size and mapped once, a log line is a clock read and a copy into the
+// next record, no syscalls. The record count and last time in the segment header are stored after the
+// record so a reader never sees a half written one. A segment rolls when it is full or older than the
+// roll time, that is the only time the index is written. The viewers read the index to find the
+// segments that overlap a time range and binary search the records in them, no scanning.
+// Vars longer than LOG_VAR_SIZE are cut short.
+//
+// Each open stream maps ( segment_records + 1 ) * 256 bytes, 4 MB by default, so a store with many
+// user / logID streams wants smaller segments. With preallocate off the segment is only sized with
+// ftruncate and takes disk blocks as records land, a full disk then shows up as a SIGBUS on the write.
+// A LogStore is not thread safe, it has a single writer. Give each thread its own store ( on its own
+// base dir ) or put a lock around log() to share one.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_STORE_VERSION 1
+#define LOG_NUM_VARS 4
+#define LOG_VAR_SIZE 60
+
+struct LogRecord {
+    int64_t time_ns;                        // system_clock since epoch
+    uint16_t len[LOG_NUM_VARS];
+    char vars[LOG_NUM_VARS][LOG_VAR_SIZE];
+};
+static_assert(sizeof(LogRecord) == 256, "the viewers read LogRecord as 256 bytes");
+
+struct SegHeader {
+    char magic[8];                          // "SLSEG1"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;                      // records
+    uint64_t seq;
+    int64_t first_ns;
+    int64_t last_ns;                        // updated with each record
+    uint64_t count;                         // updated with each record, after it is written
+    char user[64];
+    char log_id[64];
+    char pad[256 - 8 - 4 - 4 - 8 - 8 - 8 - 8 - 8 - 64 - 64];
+};
+static_assert(sizeof(SegHeader) == sizeof(LogRecord), "records start one record in");
+
+struct IdxHeader {
+    char magic[8];                          // "SLIDX1"
+    uint32_t version;
+    uint32_t entry_size;
+};
+
+struct IdxEntry {
+    int64_t first_ns;
+    int64_t last_ns;                        // 0 while the segment is live, read its header then
+    uint64_t seq;
+    uint64_t count;
+};
+
+class LogStore {
+public:
+    struct Options {
+        uint64_t segment_records = 16384;   // 4 MB segments
+        std::chrono::seconds roll_time{3600};
+        bool preallocate = true;            // reserve the disk blocks when a segment is made
+    };
+
+    LogStore(const std::string& baseDir, Options opts)
+        : baseDir(baseDir), opts(opts) {
+        std::filesystem::create_directories(this->baseDir);
+    }
+
+    explicit LogStore(const std::string& baseDir)
+        : LogStore(baseDir, Options()) {}
+
+    ~LogStore() {
+        for (auto& user : streams)
+            for (auto& stream : user.second)
+                stream.second->close();
+    }
+
+    LogStore(const LogStore&) = delete;
+    LogStore& operator=(const LogStore&) = delete;
+
+    bool log(const std::string& userID, const std::string& logID, const std::string vars[LOG_NUM_VARS]) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        Stream* stream = find(userID, logID);
+        if (!stream)
+            return false;
+        if (stream->full(now, opts) && !stream->roll(now, opts))
+            return false;
+        stream->append(now, vars);
+        return true;
+    }
+
+    const std::filesystem::path& dir() const { return baseDir; }
+
+private:
+    class Stream {
+    public:
+        Stream(std::filesystem::path dir, const std::string& user, const std::string& logID)
+            : dir(std::move(dir)), user(user), logID(logID) {}
+
+        // picks up the live segment from the index or starts the first one
+        bool open(int64_t now, const LogStore::Options& opts) {
+            std::filesystem::create_directories(dir);
+            auto idxPath = dir / (logID + ".idx");
+            idxFd = ::open(idxPath.c_str(), O_RDWR | O_CREAT, 0644);
+            if (idxFd < 0)
+                return false;
+            struct stat st;
+            if (fstat(idxFd, &st) != 0)
+                return false;
+            if (st.st_size < (off_t)sizeof(IdxHeader)) {
+                IdxHeader head = {};
+                memcpy(head.magic, "SLIDX1", 6);
+                head.version = LOG_STORE_VERSION;
+                head.entry_size = sizeof(IdxEntry);
+                if (pwrite(idxFd, &head, sizeof(head), 0) != (ssize_t)sizeof(head))
+                    return false;
+                numEntries = 0;
+            } else {
+                numEntries = (st.st_size - sizeof(IdxHeader)) / sizeof(IdxEntry);
+            }
+            if (numEntries > 0) {
+                IdxEntry last;
+                if (pread(idxFd, &last, sizeof(last), entryOffset(numEntries - 1)) == (ssize_t)sizeof(last)
+                        && last.last_ns == 0 && map(last.seq, false, false) && !full(now, opts))
+                    return true;
+                if (seg)
+                    seal();
+            }
+            return roll(now, opts);
+        }
+
+        bool full(int64_t now, const LogStore::Options& opts) const {
+            return !seg || seg->count >= seg->capacity
+                || (seg->count > 0 && now - seg->first_ns > std::chrono::duration_cast<std::chrono::nanoseconds>(opts.roll_time).count());
+        }
+
+        // seals the live segment in the index and starts the next one
+        bool roll(int64_t now, const LogStore::Options& opts) {
+            uint64_t seq = 0;
+            if (seg) {
+                seq = seg->seq + 1;
+                seal();
+            } else if (numEntries > 0) {
+                IdxEntry last;
+                if (pread(idxFd, &last, sizeof(last), entryOffset(numEntries - 1)) == (ssize_t)sizeof(last))
+                    seq = last.seq + 1;
+            }
+            capacity = std::max<uint64_t>(opts.segment_records, 1);
+            if (!map(seq, true, opts.preallocate))
+                return false;
+            SegHeader* head = seg;
+            memcpy(head->magic, "SLSEG1", 6);
+            head->version = LOG_STORE_VERSION;
+            head->record_size = sizeof(LogRecord);
+            head->capacity = capacity;
+            head->seq = seq;
+            head->first_ns = now;
+            head->last_ns = now;
+            snprintf(head->user, sizeof(head->user), "%s", user.c_str());
+            snprintf(head->log_id, sizeof(head->log_id), "%s", logID.c_str());
+            IdxEntry entry = {now, 0, seq, 0};
+            entryIdx = numEntries++;
+            return pwrite(idxFd, &entry, sizeof(entry), entryOffset(entryIdx)) == (ssize_t)sizeof(entry);
+        }
+
+        void append(int64_t now, const std::string vars[LOG_NUM_VARS]) {
+            uint64_t n = seg->count;
+            LogRecord& rec = records[n];
+            rec.time_ns = now;
+            for (int i = 0; i < LOG_NUM_VARS; ++i) {
+                size_t len = std::min(vars[i].size(), (size_t)LOG_VAR_SIZE);
+                rec.len[i] = len;
+                memcpy(rec.vars[i], vars[i].data(), len);
+            }
+            __atomic_store_n(&seg->last_ns, now, __ATOMIC_RELAXED);
+            __atomic_store_n(&seg->count, n + 1, __ATOMIC_RELEASE);
+        }
+
+        void close() {
+            if (seg)
+                seal();
+            if (idxFd >= 0)
+                ::close(idxFd);
+            idxFd = -1;
+        }
+
+    private:
+        off_t entryOffset(uint64_t i) const {
+            return sizeof(IdxHeader) + i * sizeof(IdxEntry);
+        }
+
+        std::filesystem::path segPath(uint64_t seq) const {
+            char name[32];
+            snprintf(name, sizeof(name), ".%06llu.seg", (unsigned long long)seq);
+            return dir / (logID + name);
+        }
+
+        bool map(uint64_t seq, bool create, bool preallocate) {
+            auto path = segPath(seq);
+            int fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+            if (fd < 0)
+                return false;
+            if (!create) {
+                SegHeader head;
+                if (pread(fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head) || memcmp(head.magic, "SLSEG1", 6) != 0
+                        || head.record_size != sizeof(LogRecord)) {
+                    ::close(fd);
+                    return false;
+                }
+                capacity = head.capacity;
+            }
+            size_t bytes = (capacity + 1) * sizeof(LogRecord);
+            if (create && (!preallocate || posix_fallocate(fd, 0, bytes) != 0) && ftruncate(fd, bytes) != 0) {
+                ::close(fd);
+                return false;
+            }
+            void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (base == MAP_FAILED)
+                return false;
+            seg = static_cast<SegHeader*>(base);
+            records = reinterpret_cast<LogRecord*>(seg + 1);
+            mapped = bytes;
+            if (!create)
+                entryIdx = numEntries - 1;
+            return true;
+        }
+
+        void seal() {
+            IdxEntry entry = {seg->first_ns, seg->count ? seg->last_ns : seg->first_ns, seg->seq, seg->count};
+            if (pwrite(idxFd, &entry, sizeof(entry), entryOffset(entryIdx)) != (ssize_t)sizeof(entry))
+                perror("log store index");
+            munmap(seg, mapped);
+            seg = nullptr;
+            records = nullptr;
+        }
+
+        std::filesystem::path dir;
+        std::string user;
+        std::string logID;
+        int idxFd = -1;
+        uint64_t numEntries = 0;
+        uint64_t entryIdx = 0;
+        uint64_t capacity = 0;
+        SegHeader* seg = nullptr;
+        LogRecord* records = nullptr;
+        size_t mapped = 0;
+    };
+
+    Stream* find(const std::string& userID, const std::string& logID) {
+        auto& user = streams[userID];
+        auto it = user.find(logID);
+        if (it != user.end())
+            return it->second.get();
+        auto stream = std::make_unique<Stream>(baseDir / userID, userID, logID);
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!stream->open(now, opts)) {
+            std::cerr << "Error opening log store for " << userID << "/" << logID << "\n";
+            return nullptr;
+        }
+        return user.emplace(logID, std::move(stream)).first->second.get();
+    }
+
+    std::filesystem::path baseDir;
+    Options opts;
+    std::unordered_map<std::string, std::unordered_map<std::string, std::unique_ptr<Stream>>> streams;
+};
+
+#endif
@@ -1,47 +1,67 @@
-#include <fstream>
 #include <iostream>
 #include <string>
 #include <filesystem>
-#include <ctime>
-#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "log_store.h"
 
 namespace fs = std::filesystem;
 
 class Logger {
 private:
     std::string project;
-    fs::path baseDir;
+    LogStore store;
 
 public:
-    Logger(const std::string& project)
-        : project(project), baseDir("/var/log/" + project) {
-        // Ensure baseDir exists
-        fs::create_directories(baseDir);
-    }
+    Logger(const std::string& project, const std::string& logDir = "/var/log/")
+        : project(project), store((fs::path(logDir) / project).string()) {}
+
+    Logger(const std::string& project, const std::string& logDir, LogStore::Options opts)
+        : project(project), store((fs::path(logDir) / project).string(), opts) {}
 
+    // one record in <baseDir>/<userID>/<logID>.<seq>.seg, see log_store.h
     void log(const std::string& userID, const std::string& logID, const std::string vars[4]) {
-        // Ensure user directory exists
-        fs::path userDir = baseDir / userID;
-        fs::create_directories(userDir);
-
-        // Open log file
-        std::ofstream file(userDir / logID, std::ios_base::app);
-        if (!file) {
-            std::cerr << "Error opening log file\n";
-            return;
-        }
+        if (!store.log(userID, logID, vars))
+            std::cerr << "Error writing log " << userID << "/" << logID << "\n";
+    }
+};
 
-        // Get current time
-        auto t = std::time(nullptr);
-        auto tm = *std::localtime(&t);
+// loggen bench [lines] [log dir] [segment records]
+// lines/sec through Logger::log, spread over a few users and logIDs
+static int bench(int lines, const std::string& logDir, LogStore::Options opts) {
+    const char* users[] = {"testUser1", "testUser2", "testUser3", "testUser4"};
+    const char* logIDs[] = {"logID1", "logID2", "logID3"};
+    std::string userIDs[4], ids[3];
+    for (int i = 0; i < 4; ++i)
+        userIDs[i] = users[i];
+    for (int i = 0; i < 3; ++i)
+        ids[i] = logIDs[i];
+    std::string vars[4] = {"var1", "pump_02", "status", "0"};
 
-        // Write log entry
-        //file << std::put_time(&tm, "%FT%T") << "\t" << logID << "\t" << vars[0] << "\t" << vars[1] << "\t" << vars[2] << "\t" << vars[3] << "\n";
-        file << std::put_time(&tm, "%FT%T") << "\t" << vars[0] << "\t" << vars[1] << "\t" << vars[2] << "\t" << vars[3] << "\n";
+    fs::remove_all(fs::path(logDir) / "benchProject");
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        Logger logger("benchProject", logDir, opts);
+        for (int i = 0; i < lines; ++i) {
+            vars[3] = std::to_string(i);
+            logger.log(userIDs[i & 3], ids[i % 3], vars);
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << lines << " lines in " << secs * 1000 << " ms, " << (long)(lines / secs) << " lines/s\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        LogStore::Options opts;
+        if (argc > 4)
+            opts.segment_records = strtoull(argv[4], nullptr, 0);
+        return bench(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? argv[3] : "/tmp", opts);
     }
-};
 
-int main() {
     Logger logger("testProject2");
 
     std::string vars[4] = {"var1", "var2", "var3", "var4"};